@@ -0,0 +1,30 @@
+#ifndef __PROJECT_H__
+#define __PROJECT_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <unistd.h>
+
+typedef bool BOOL;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef long LONG;
+
+/* The harnesses use instance 0, but the multi-instance code is the one that is fuzzed */
+#define CCID_MAX_INSTANCE_COUNT 2
+
+#if (!defined(TRUE))
+	#define TRUE 1
+#endif
+
+#if (!defined(FALSE))
+	#define FALSE 0
+#endif
+
+#endif
\ No newline at end of file
@@ -16,6 +16,28 @@ typedef uint16_t WORD;
 typedef uint32_t DWORD;
 typedef long LONG;
 
+/* A Linux host may drive several devices at once (see CCID_SelectInstance) */
+#define CCID_MAX_INSTANCE_COUNT 8
+
+/* The serial traffic may be recorded into a file (see CCID_CaptureFileStart) */
+#define CCID_CAPTURE 1
+
+/* The latency of every command is recorded (see CCID_GetHistograms) */
+#define CCID_HISTOGRAMS 1
+
+/* The events of the driver go to a trace ring, not to stdout (see CCID_TraceRead) */
+#define CCID_TRACE 1
+
+/* Every exchange is decomposed into its stages (see CCID_ExchangeEx) */
+#define CCID_TIMELINE 1
+
+/* The stages of the protocol are USDT probes, when the SDT header is installed (see ccid_probes.h) */
+#if (defined(__has_include))
+#if (__has_include(<sys/sdt.h>))
+#define CCID_PROBES 1
+#endif
+#endif
+
 #if (!defined(TRUE))
 	#define TRUE 1
 #endif
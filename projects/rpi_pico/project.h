@@ -12,6 +12,7 @@
 #include "pico/stdlib.h"
 #include "pico/cyw43_arch.h"
 #include "hardware/gpio.h"
+#include "hardware/sync.h"
 
 #define UART_ID uart0
 
@@ -27,6 +28,11 @@
 
 #define LED_PIN 25
 
+// The RP2040 is a Cortex-M0+: the counters and the trace ring index of the library are protected by masking the interrupts.
+// This does not stop the other core, so the library must run on one core only.
+#define CCID_IRQ_SAVE() save_and_disable_interrupts()
+#define CCID_IRQ_RESTORE(s) restore_interrupts(s)
+
 typedef bool BOOL;
 typedef uint8_t BYTE;
 typedef uint16_t WORD;
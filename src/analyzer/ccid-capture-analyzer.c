@@ -0,0 +1,618 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid-capture-analyzer.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Analyzer of the captures of the serial traffic: decodes the frames, pairs the commands with their responses, and tells where the time goes (wire, device, time extensions)
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include <project.h>
+
+#include "../pcsc-serial.h"
+#include "../scard/scard.h"
+#include "../ccid/ccid.h"
+#include "../ccid/ccid_hal.h"
+
+/* Bit rate of a genuine coupler */
+#define ANALYZER_DEFAULT_BITRATE 38400
+/* Framing of a message on the wire: START_BYTE, endpoint, header, checksum */
+#define ANALYZER_FRAME_OVERHEAD (2 + CCID_HEADER_LENGTH + 1)
+/* Longest frame the analyzer decodes (extended APDUs), longer ones are counted as garbage */
+#define ANALYZER_MAX_FRAME_LENGTH (ANALYZER_FRAME_OVERHEAD + 65545)
+/* Distinct commands (endpoint and request) in the statistics */
+#define ANALYZER_MAX_COMMANDS 32
+/* Instances a capture may hold (see CCID_CAPTURE_INSTANCE_MASK) */
+#define ANALYZER_MAX_INSTANCES 16
+
+/* Position of the fields in a frame */
+#define POS_ENDPOINT 1
+#define POS_REQUEST  2
+#define POS_LENGTH   3
+#define POS_SLOT     7
+#define POS_SEQUENCE 8
+#define POS_STATUS   9
+#define POS_ERROR    10
+
+/* bStatus of a RDR_to_PC bulk message: time extension requested */
+#define ANALYZER_STATUS_TIME_EXTENSION 0x80
+#define ANALYZER_STATUS_COMMAND_MASK   0xC0
+
+/**
+ * @brief Receiver of one direction of one instance: the records are cut anywhere, the frames are rebuilt here
+ */
+typedef struct
+{
+	BYTE bState;
+	DWORD dwOffset;
+	DWORD dwLength;
+	DWORD dwFirstUs; /* Time of the record the first byte is in */
+	DWORD dwLastUs; /* Time of the record the last byte is in */
+	BYTE abFrame[ANALYZER_MAX_FRAME_LENGTH];
+} ANALYZER_STREAM_ST;
+
+#define STREAM_IDLE    0
+#define STREAM_FRAME   1
+
+/**
+ * @brief A command that waits for its response
+ */
+typedef struct
+{
+	BOOL fPending;
+	BYTE bEndpoint;
+	BYTE bRequest;
+	BYTE bSlot;
+	DWORD dwStartUs;
+	DWORD dwCommandBytes;
+	DWORD dwCommandPayload;
+	DWORD dwExtensions;
+	DWORD dwExtensionBytes;
+} ANALYZER_PENDING_ST;
+
+/**
+ * @brief Figures of a set of exchanges (a command type, a slot, or all)
+ */
+typedef struct
+{
+	BYTE bEndpoint;
+	BYTE bRequest;
+	DWORD dwCount;
+	DWORD* adwRttUs;
+	DWORD dwRttCapacity;
+	uint64_t qwRttUs;
+	uint64_t qwWireUs;
+	uint64_t qwThinkUs;
+	uint64_t qwPayloadBytes;
+	uint64_t qwWireBytes;
+	DWORD dwExtensions;
+} ANALYZER_STATS_ST;
+
+BOOL fVerbose = FALSE;
+
+static DWORD dwBitRate = ANALYZER_DEFAULT_BITRATE;
+static BOOL fListFrames = FALSE;
+static BOOL fListExchanges = FALSE;
+static const char* szFileName = NULL;
+
+static ANALYZER_STREAM_ST aStreams[ANALYZER_MAX_INSTANCES][2];
+static ANALYZER_PENDING_ST aPendingControl[ANALYZER_MAX_INSTANCES];
+static ANALYZER_PENDING_ST aPendingBulk[ANALYZER_MAX_INSTANCES][256];
+
+static ANALYZER_STATS_ST aCommandStats[ANALYZER_MAX_COMMANDS];
+static DWORD dwCommandStatsCount;
+static ANALYZER_STATS_ST aSlotStats[256];
+static ANALYZER_STATS_ST totalStats;
+
+/* Counters of the whole capture */
+static DWORD dwRecords, dwLostRecords;
+static uint64_t aqwBytes[2];
+static DWORD adwFrames[2];
+static DWORD dwGarbageBytes, dwChecksumErrors;
+static DWORD dwInterrupts, dwTimeExtensions, dwUnexpected;
+static DWORD dwCaptureFirstUs, dwCaptureLastUs;
+
+static BOOL parse_args(int argc, char** argv);
+
+/**
+ * @brief The analyzer never cancels anything
+ */
+BOOL SCARD_LIB(IsCancelledHook)(void)
+{
+	return FALSE;
+}
+
+static int compare_dword(const void* a, const void* b)
+{
+	DWORD x = *(const DWORD*) a;
+	DWORD y = *(const DWORD*) b;
+	return (x > y) - (x < y);
+}
+
+static DWORD get_dword(const BYTE abBuffer[])
+{
+	return (DWORD) abBuffer[0] | ((DWORD) abBuffer[1] << 8) | ((DWORD) abBuffer[2] << 16) | ((DWORD) abBuffer[3] << 24);
+}
+
+/**
+ * @brief Time the given number of bytes takes on the wire (start and stop bits included)
+ */
+static DWORD wire_us(uint64_t qwBytes)
+{
+	if (dwBitRate == 0)
+		return 0;
+	return (DWORD) (qwBytes * 10 * 1000000 / dwBitRate);
+}
+
+static const char* request_name(BYTE bEndpoint, BYTE bRequest)
+{
+	static char szName[32];
+
+	if ((bEndpoint == CCID_COMM_CONTROL_TO_RDR) || (bEndpoint == CCID_COMM_CONTROL_TO_PC))
+	{
+		switch (bRequest)
+		{
+			case GET_STATUS: return "GET_STATUS";
+			case GET_DESCRIPTOR: return "GET_DESCRIPTOR";
+			case SET_CONFIGURATION: return "SET_CONFIGURATION";
+		}
+		snprintf(szName, sizeof(szName), "CONTROL_%02X", bRequest);
+		return szName;
+	}
+
+	if (bEndpoint == CCID_COMM_INTERRUPT_RDR_TO_PC)
+		return (bRequest == RDR_TO_PC_INTERRUPT) ? "NotifySlotChange" : "Interrupt";
+
+	switch (bRequest)
+	{
+		case PC_TO_RDR_SETPARAMETERS: return "SetParameters";
+		case PC_TO_RDR_ICCPOWERON: return "IccPowerOn";
+		case PC_TO_RDR_ICCPOWEROFF: return "IccPowerOff";
+		case PC_TO_RDR_GETSLOTSTATUS: return "GetSlotStatus";
+		case PC_TO_RDR_ESCAPE: return "Escape";
+		case PC_TO_RDR_GETPARAMETERS: return "GetParameters";
+		case PC_TO_RDR_RESETPARAMETERS: return "ResetParameters";
+		case PC_TO_RDR_XFRBLOCK: return "XfrBlock";
+		case PC_TO_RDR_SETDATARATEANDCLOCKFREQUENCY: return "SetDataRateAndClockFrequency";
+		case RDR_TO_PC_DATABLOCK: return "DataBlock";
+		case RDR_TO_PC_SLOTSTATUS: return "SlotStatus";
+		case RDR_TO_PC_PARAMETERS: return "Parameters";
+		case RDR_TO_PC_ESCAPE: return "Escape";
+		case RDR_TO_PC_DATARATEANDCLOCKFREQUENCY: return "DataRateAndClockFrequency";
+	}
+	snprintf(szName, sizeof(szName), "BULK_%02X", bRequest);
+	return szName;
+}
+
+static void stats_add(ANALYZER_STATS_ST* stats, DWORD dwRttUs, DWORD dwWireUs, DWORD dwThinkUs, DWORD dwPayloadBytes, DWORD dwWireBytes, DWORD dwExtensions)
+{
+	if (stats->dwCount >= stats->dwRttCapacity)
+	{
+		DWORD dwCapacity = stats->dwRttCapacity ? 2 * stats->dwRttCapacity : 64;
+		DWORD* adwRttUs = realloc(stats->adwRttUs, dwCapacity * sizeof(DWORD));
+
+		if (adwRttUs == NULL)
+		{
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+		stats->adwRttUs = adwRttUs;
+		stats->dwRttCapacity = dwCapacity;
+	}
+
+	stats->adwRttUs[stats->dwCount++] = dwRttUs;
+	stats->qwRttUs += dwRttUs;
+	stats->qwWireUs += dwWireUs;
+	stats->qwThinkUs += dwThinkUs;
+	stats->qwPayloadBytes += dwPayloadBytes;
+	stats->qwWireBytes += dwWireBytes;
+	stats->dwExtensions += dwExtensions;
+}
+
+static ANALYZER_STATS_ST* command_stats(BYTE bEndpoint, BYTE bRequest)
+{
+	for (DWORD i = 0; i < dwCommandStatsCount; i++)
+		if ((aCommandStats[i].bEndpoint == bEndpoint) && (aCommandStats[i].bRequest == bRequest))
+			return &aCommandStats[i];
+
+	if (dwCommandStatsCount >= ANALYZER_MAX_COMMANDS)
+		return NULL;
+
+	aCommandStats[dwCommandStatsCount].bEndpoint = bEndpoint;
+	aCommandStats[dwCommandStatsCount].bRequest = bRequest;
+	return &aCommandStats[dwCommandStatsCount++];
+}
+
+/**
+ * @brief A response has come: the exchange is complete
+ * @note A TX record has the time its bytes began to be sent, a RX record the time its last bytes were received: the round trip is from the record of the first byte of the command to the record of the last byte of the response
+ */
+static void exchange_done(BYTE bInstance, ANALYZER_PENDING_ST* pending, const BYTE abFrame[], DWORD dwFrameLength, DWORD dwLastUs)
+{
+	DWORD dwRttUs, dwWireUs, dwThinkUs, dwPayloadBytes, dwWireBytes;
+	ANALYZER_STATS_ST* stats;
+
+	dwRttUs = dwLastUs - pending->dwStartUs;
+	dwWireBytes = pending->dwCommandBytes + pending->dwExtensionBytes + dwFrameLength;
+	dwWireUs = wire_us(dwWireBytes);
+	dwThinkUs = (dwRttUs > dwWireUs) ? dwRttUs - dwWireUs : 0;
+	dwPayloadBytes = pending->dwCommandPayload + (dwFrameLength - ANALYZER_FRAME_OVERHEAD);
+
+	if (fListExchanges)
+	{
+		printf("%10.3f  i%u %-18s rtt=%7.3fms wire=%7.3fms device=%7.3fms ext=%lu bytes=%lu",
+			pending->dwStartUs / 1000.0, bInstance, request_name(pending->bEndpoint, pending->bRequest),
+			dwRttUs / 1000.0, dwWireUs / 1000.0, dwThinkUs / 1000.0, pending->dwExtensions, dwPayloadBytes);
+		if (abFrame[POS_ENDPOINT] == CCID_COMM_BULK_RDR_TO_PC)
+			printf(" slot=%u status=%02X error=%02X", pending->bSlot, abFrame[POS_STATUS], abFrame[POS_ERROR]);
+		printf("\n");
+	}
+
+	stats = command_stats(pending->bEndpoint, pending->bRequest);
+	if (stats != NULL)
+		stats_add(stats, dwRttUs, dwWireUs, dwThinkUs, dwPayloadBytes, dwWireBytes, pending->dwExtensions);
+	if (pending->bEndpoint == CCID_COMM_BULK_PC_TO_RDR)
+		stats_add(&aSlotStats[pending->bSlot], dwRttUs, dwWireUs, dwThinkUs, dwPayloadBytes, dwWireBytes, pending->dwExtensions);
+	stats_add(&totalStats, dwRttUs, dwWireUs, dwThinkUs, dwPayloadBytes, dwWireBytes, pending->dwExtensions);
+
+	pending->fPending = FALSE;
+}
+
+static void list_frame(BYTE bInstance, BOOL fRx, const BYTE abFrame[], DWORD dwFrameLength, DWORD dwTimeUs)
+{
+	BYTE bEndpoint = abFrame[POS_ENDPOINT];
+
+	printf("%10.3f  i%u %s ep=%02X %-18s len=%-5lu", dwTimeUs / 1000.0, bInstance, fRx ? "<" : ">", bEndpoint,
+		request_name(bEndpoint, abFrame[POS_REQUEST]), dwFrameLength - ANALYZER_FRAME_OVERHEAD);
+
+	if ((bEndpoint == CCID_COMM_CONTROL_TO_RDR) || (bEndpoint == CCID_COMM_CONTROL_TO_PC))
+		printf(" value=%02X%02X index=%02X%02X", abFrame[POS_SLOT + 1], abFrame[POS_SLOT], abFrame[POS_SLOT + 3], abFrame[POS_SLOT + 2]);
+	else if (bEndpoint == CCID_COMM_BULK_PC_TO_RDR)
+		printf(" slot=%u seq=%u", abFrame[POS_SLOT], abFrame[POS_SEQUENCE]);
+	else if (bEndpoint == CCID_COMM_BULK_RDR_TO_PC)
+		printf(" slot=%u seq=%u status=%02X error=%02X", abFrame[POS_SLOT], abFrame[POS_SEQUENCE], abFrame[POS_STATUS], abFrame[POS_ERROR]);
+
+	printf("\n");
+}
+
+/**
+ * @brief A complete frame: pair the commands with their responses
+ */
+static void on_frame(BYTE bInstance, BOOL fRx, const BYTE abFrame[], DWORD dwFrameLength, DWORD dwFirstUs, DWORD dwLastUs)
+{
+	BYTE bEndpoint = abFrame[POS_ENDPOINT];
+	ANALYZER_PENDING_ST* pending = NULL;
+
+	adwFrames[fRx ? 1 : 0]++;
+
+	if (fListFrames)
+		list_frame(bInstance, fRx, abFrame, dwFrameLength, fRx ? dwLastUs : dwFirstUs);
+
+	switch (bEndpoint)
+	{
+		case CCID_COMM_CONTROL_TO_RDR:
+		case CCID_COMM_BULK_PC_TO_RDR:
+			if (bEndpoint == CCID_COMM_CONTROL_TO_RDR)
+				pending = &aPendingControl[bInstance];
+			else
+				pending = &aPendingBulk[bInstance][abFrame[POS_SEQUENCE]];
+			if (pending->fPending)
+				dwUnexpected++; /* The previous one has never been answered */
+			memset(pending, 0, sizeof(ANALYZER_PENDING_ST));
+			pending->fPending = TRUE;
+			pending->bEndpoint = bEndpoint;
+			pending->bRequest = abFrame[POS_REQUEST];
+			pending->bSlot = abFrame[POS_SLOT];
+			pending->dwStartUs = dwFirstUs;
+			pending->dwCommandBytes = dwFrameLength;
+			pending->dwCommandPayload = dwFrameLength - ANALYZER_FRAME_OVERHEAD;
+		break;
+
+		case CCID_COMM_CONTROL_TO_PC:
+			pending = &aPendingControl[bInstance];
+			if (!pending->fPending)
+				dwUnexpected++;
+			else
+				exchange_done(bInstance, pending, abFrame, dwFrameLength, dwLastUs);
+		break;
+
+		case CCID_COMM_BULK_RDR_TO_PC:
+			pending = &aPendingBulk[bInstance][abFrame[POS_SEQUENCE]];
+			if (!pending->fPending)
+			{
+				dwUnexpected++;
+			}
+			else if ((abFrame[POS_STATUS] & ANALYZER_STATUS_COMMAND_MASK) == ANALYZER_STATUS_TIME_EXTENSION)
+			{
+				pending->dwExtensions++;
+				pending->dwExtensionBytes += dwFrameLength;
+				dwTimeExtensions++;
+			}
+			else
+			{
+				exchange_done(bInstance, pending, abFrame, dwFrameLength, dwLastUs);
+			}
+		break;
+
+		case CCID_COMM_INTERRUPT_RDR_TO_PC:
+			dwInterrupts++;
+		break;
+
+		default:
+			dwUnexpected++;
+	}
+}
+
+/**
+ * @brief Rebuild the frames from the bytes of a record
+ */
+static void on_bytes(BYTE bInstance, BOOL fRx, const BYTE abData[], DWORD dwLength, DWORD dwTimeUs)
+{
+	ANALYZER_STREAM_ST* stream = &aStreams[bInstance][fRx ? 1 : 0];
+
+	for (DWORD i = 0; i < dwLength; i++)
+	{
+		BYTE bValue = abData[i];
+
+		if (stream->bState == STREAM_IDLE)
+		{
+			if (bValue != START_BYTE)
+			{
+				dwGarbageBytes++;
+				continue;
+			}
+			stream->bState = STREAM_FRAME;
+			stream->dwOffset = 0;
+			stream->dwLength = ANALYZER_FRAME_OVERHEAD;
+			stream->dwFirstUs = dwTimeUs;
+		}
+
+		stream->abFrame[stream->dwOffset++] = bValue;
+		stream->dwLastUs = dwTimeUs;
+
+		if (stream->dwOffset == POS_LENGTH + 4)
+		{
+			DWORD dwPayloadLength = get_dword(&stream->abFrame[POS_LENGTH]);
+
+			if (dwPayloadLength > ANALYZER_MAX_FRAME_LENGTH - ANALYZER_FRAME_OVERHEAD)
+			{
+				/* Not a frame */
+				dwGarbageBytes += stream->dwOffset;
+				stream->bState = STREAM_IDLE;
+				continue;
+			}
+			stream->dwLength = ANALYZER_FRAME_OVERHEAD + dwPayloadLength;
+		}
+
+		if (stream->dwOffset == stream->dwLength)
+		{
+			BYTE bChecksum = 0;
+
+			for (DWORD j = 1; j < stream->dwLength; j++)
+				bChecksum ^= stream->abFrame[j];
+
+			if (bChecksum)
+				dwChecksumErrors++;
+			else
+				on_frame(bInstance, fRx, stream->abFrame, stream->dwLength, stream->dwFirstUs, stream->dwLastUs);
+
+			stream->bState = STREAM_IDLE;
+		}
+	}
+}
+
+static void print_stats_header(const char* szWhat)
+{
+	printf("%-30s %7s %10s %10s %10s %10s %10s %6s %10s %8s\n", szWhat, "count", "rtt_mean", "rtt_p50", "rtt_max", "wire_mean", "dev_mean", "ext", "bytes/s", "link%");
+}
+
+/**
+ * @brief One line of statistics; bytes/s is the payload over the time spent in the exchanges, link% the share of that time the wire is busy
+ */
+static void print_stats(const char* szName, ANALYZER_STATS_ST* stats)
+{
+	if (stats->dwCount == 0)
+		return;
+
+	qsort(stats->adwRttUs, stats->dwCount, sizeof(DWORD), compare_dword);
+
+	printf("%-30s %7lu %8.3fms %8.3fms %8.3fms %8.3fms %8.3fms %6lu %10.0f %7.1f%%\n", szName, stats->dwCount,
+		stats->qwRttUs / 1000.0 / stats->dwCount,
+		stats->adwRttUs[stats->dwCount / 2] / 1000.0,
+		stats->adwRttUs[stats->dwCount - 1] / 1000.0,
+		stats->qwWireUs / 1000.0 / stats->dwCount,
+		stats->qwThinkUs / 1000.0 / stats->dwCount,
+		stats->dwExtensions,
+		stats->qwRttUs ? stats->qwPayloadBytes * 1000000.0 / stats->qwRttUs : 0.0,
+		stats->qwRttUs ? 100.0 * stats->qwWireUs / stats->qwRttUs : 0.0);
+}
+
+static void print_report(void)
+{
+	DWORD dwDurationUs = dwCaptureLastUs - dwCaptureFirstUs;
+	DWORD dwUnanswered = 0;
+	char szName[64];
+
+	for (BYTE bInstance = 0; bInstance < ANALYZER_MAX_INSTANCES; bInstance++)
+	{
+		if (aPendingControl[bInstance].fPending)
+			dwUnanswered++;
+		for (DWORD i = 0; i < 256; i++)
+			if (aPendingBulk[bInstance][i].fPending)
+				dwUnanswered++;
+	}
+
+	printf("\nCapture %s: %lu record(s) over %.3fs, bit rate %lu bps\n", szFileName, dwRecords, dwDurationUs / 1000000.0, dwBitRate);
+	printf("\tHost to device: %lu frame(s), %llu byte(s), wire busy %.1f%% of the time\n", adwFrames[0], (unsigned long long) aqwBytes[0],
+		dwDurationUs ? 100.0 * wire_us(aqwBytes[0]) / dwDurationUs : 0.0);
+	printf("\tDevice to host: %lu frame(s), %llu byte(s), wire busy %.1f%% of the time\n", adwFrames[1], (unsigned long long) aqwBytes[1],
+		dwDurationUs ? 100.0 * wire_us(aqwBytes[1]) / dwDurationUs : 0.0);
+	printf("\tTime extensions: %lu, interrupts: %lu\n", dwTimeExtensions, dwInterrupts);
+	printf("\tUnanswered commands: %lu, unexpected frames: %lu, bad checksums: %lu, garbage bytes: %lu, lost records: %lu\n",
+		dwUnanswered, dwUnexpected, dwChecksumErrors, dwGarbageBytes, dwLostRecords);
+
+	if (totalStats.dwCount == 0)
+		return;
+
+	printf("\n");
+	print_stats_header("Command");
+	for (DWORD i = 0; i < dwCommandStatsCount; i++)
+	{
+		snprintf(szName, sizeof(szName), "%s %s", (aCommandStats[i].bEndpoint == CCID_COMM_CONTROL_TO_RDR) ? "control" : "bulk", request_name(aCommandStats[i].bEndpoint, aCommandStats[i].bRequest));
+		print_stats(szName, &aCommandStats[i]);
+	}
+
+	printf("\n");
+	print_stats_header("Slot (bulk)");
+	for (DWORD i = 0; i < 256; i++)
+	{
+		snprintf(szName, sizeof(szName), "slot %lu", i);
+		print_stats(szName, &aSlotStats[i]);
+	}
+
+	printf("\n");
+	print_stats_header("");
+	print_stats("all", &totalStats);
+	printf("\nrtt: from the first byte of the command to the last byte of the response; wire: time the frames take at the bit rate; dev: the rest (device, host and UART latency)\n");
+}
+
+int main(int argc, char** argv)
+{
+	CCID_CAPTURE_READER_ST reader;
+	CCID_CAPTURE_RECORD_ST record;
+	BYTE* abCapture;
+	FILE* fp;
+	long size;
+
+	if (!parse_args(argc, argv))
+	{
+		fprintf(stderr, "Usage:\n");
+		fprintf(stderr, "\tccid-capture-analyzer [-r <BPS>] [-f] [-x] <FILE>\n");
+		fprintf(stderr, "\t\t<FILE>: a capture, e.g. written by the sample with -w <FILE>\n");
+		fprintf(stderr, "\t\t-r <BPS>: bit rate of the link (default %d)\n", ANALYZER_DEFAULT_BITRATE);
+		fprintf(stderr, "\t\t-f: list the frames\n");
+		fprintf(stderr, "\t\t-x: list the exchanges\n");
+		return -1;
+	}
+
+	fp = fopen(szFileName, "rb");
+	if (fp == NULL)
+	{
+		perror(szFileName);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	abCapture = (size > 0) ? malloc((size_t) size) : NULL;
+	if ((abCapture == NULL) || (fread(abCapture, 1, (size_t) size, fp) != (size_t) size))
+	{
+		fprintf(stderr, "%s: failed to read the file\n", szFileName);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	if (!CCID_LIB(CaptureReaderInit)(&reader, abCapture, (DWORD) size))
+	{
+		fprintf(stderr, "%s: not a capture\n", szFileName);
+		return -1;
+	}
+
+	while (CCID_LIB(CaptureReaderNext)(&reader, &record))
+	{
+		if (dwRecords++ == 0)
+			dwCaptureFirstUs = record.dwTimeUs;
+		dwCaptureLastUs = record.dwTimeUs;
+
+		if (record.bType == CCID_CAPTURE_LOST)
+		{
+			dwLostRecords += record.dwLength;
+			continue;
+		}
+		if ((record.bType != CCID_CAPTURE_TX) && (record.bType != CCID_CAPTURE_RX))
+			continue;
+
+		aqwBytes[(record.bType == CCID_CAPTURE_RX) ? 1 : 0] += record.dwLength;
+		on_bytes(record.bInstance, record.bType == CCID_CAPTURE_RX, record.abData, record.dwLength, record.dwTimeUs);
+	}
+
+	if (reader.dwOffset < reader.dwLength)
+		fprintf(stderr, "%s: truncated after %lu record(s)\n", szFileName, dwRecords);
+
+	print_report();
+	free(abCapture);
+	return 0;
+}
+
+static BOOL parse_args(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-r") && (i + 1 < argc))
+		{
+			dwBitRate = strtoul(argv[++i], NULL, 10);
+		}
+		else if (!strcmp(argv[i], "-f"))
+		{
+			fListFrames = TRUE;
+		}
+		else if (!strcmp(argv[i], "-x"))
+		{
+			fListExchanges = TRUE;
+		}
+		else if ((argv[i][0] != '-') && (szFileName == NULL))
+		{
+			szFileName = argv[i];
+		}
+		else
+		{
+			return FALSE;
+		}
+	}
+
+	return (szFileName != NULL);
+}
@@ -0,0 +1,525 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid-fault-bench.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Benchmark: time to detect and to recover from every class of fault on the wire (see ccid_faults.h), and the transactions lost meanwhile, for several recovery strategies
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include <project.h>
+
+#include "../pcsc-serial.h"
+#include "../scard/scard.h"
+#include "../ccid/ccid.h"
+#include "../ccid/ccid_hal.h"
+#include "../hal/faults/ccid_faults.h"
+
+#include <time.h>
+
+#define sleep_ms(x) usleep(1000 * x)
+
+#define BENCH_MAX_TRANSACTIONS 10000
+/* A strategy that has failed that many times in a row gives up: the rest of the run is lost */
+#define BENCH_MAX_ATTEMPTS 20
+/* Length of the ECHO data, both ways */
+#define BENCH_ECHO_LENGTH 16
+/* The sample waits that long before it reopens a port where the device did not answer */
+#define BENCH_REOPEN_DELAY_MS 1200
+
+#define BENCH_STRATEGY_RECONNECT 0
+#define BENCH_STRATEGY_RECOVER 1
+#define BENCH_STRATEGY_COUNT 2
+
+static const char* aszStrategyNames[BENCH_STRATEGY_COUNT] = { "reconnect", "recover" };
+
+BOOL fVerbose = FALSE;
+
+static const char* szConfig = "emu:38400";
+static BOOL afClasses[CCID_FAULT_CLASS_COUNT];
+static BOOL afStrategies[BENCH_STRATEGY_COUNT] = { TRUE, TRUE };
+static CCID_FAULT_CONFIG_ST faultConfig = { CCID_FAULT_NONE, CCID_FAULT_TX | CCID_FAULT_RX, 20000, 1500, 1 };
+static DWORD dwTransactions = 200;
+static BOOL fJson = FALSE;
+static BOOL fFirstRow = TRUE;
+/* The results; stdout is left to the messages of the library */
+static FILE* out;
+
+static BYTE abSendBuffer[5 + BENCH_ECHO_LENGTH + 1];
+static BYTE abRecvBuffer[CCID_MAX_PAYLOAD_LENGTH];
+static DWORD adwDetectUs[BENCH_MAX_TRANSACTIONS];
+static DWORD adwRecoveryUs[BENCH_MAX_TRANSACTIONS];
+static DWORD adwTtrUs[BENCH_MAX_TRANSACTIONS];
+
+static BOOL parse_args(int argc, char** argv);
+
+/**
+ * @brief The benchmark never cancels anything
+ */
+BOOL SCARD_LIB(IsCancelledHook)(void)
+{
+	return FALSE;
+}
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int compare_dword(const void* a, const void* b)
+{
+	DWORD x = *(const DWORD*) a;
+	DWORD y = *(const DWORD*) b;
+	return (x > y) - (x < y);
+}
+
+static DWORD percentile(DWORD adwValues[], DWORD dwCount, DWORD dwPercent)
+{
+	if (dwCount == 0)
+		return 0;
+	qsort(adwValues, dwCount, sizeof(DWORD), compare_dword);
+	return adwValues[(dwCount * dwPercent - 1) / 100];
+}
+
+static double mean(const DWORD adwValues[], DWORD dwCount)
+{
+	uint64_t qwTotal = 0;
+
+	if (dwCount == 0)
+		return 0;
+	for (DWORD i = 0; i < dwCount; i++)
+		qwTotal += adwValues[i];
+	return (double) qwTotal / dwCount;
+}
+
+/**
+ * @brief Build the ECHO instruction, with data that changes with every transaction, so that a stale response is not taken for a good one
+ */
+static DWORD build_echo(DWORD dwTransaction)
+{
+	DWORD dwLength = 0;
+
+	abSendBuffer[dwLength++] = 0xFF; /* CLA */
+	abSendBuffer[dwLength++] = 0xFD; /* INS */
+	abSendBuffer[dwLength++] = 0x00; /* P1 */
+	abSendBuffer[dwLength++] = 0x80; /* P2: no delay */
+	abSendBuffer[dwLength++] = BENCH_ECHO_LENGTH; /* Lc */
+	for (DWORD i = 0; i < BENCH_ECHO_LENGTH; i++)
+		abSendBuffer[dwLength++] = (BYTE) (dwTransaction + i);
+	abSendBuffer[dwLength++] = BENCH_ECHO_LENGTH; /* Le */
+
+	return dwLength;
+}
+
+/**
+ * @brief The path before CCID_Recover: close the port, open it again, and start over (CCID, PC/SC-Like, card)
+ * @note A device that does not answer the Ping is left alone for 1200ms, the port closed, so it may reset its state machine by itself. There is no BREAK here, that is the baseline for strategy_recover
+ */
+static BOOL strategy_reconnect(void)
+{
+	BYTE abAtr[33];
+	DWORD dwAtrLength = sizeof(abAtr);
+	LONG rc;
+
+	CCID_LIB(SerialClose)();
+	if (!CCID_LIB(SerialOpen)())
+		return FALSE;
+
+	CCID_LIB(Init)();
+	rc = CCID_LIB(Ping)();
+	if (rc != SCARD_ERR(S_SUCCESS))
+	{
+		CCID_LIB(SerialClose)();
+		sleep_ms(BENCH_REOPEN_DELAY_MS);
+		return FALSE;
+	}
+
+	rc = CCID_LIB(Start)(FALSE);
+	if (rc != SCARD_ERR(S_SUCCESS))
+		return FALSE;
+	SCARD_LIB(Init)();
+	rc = SCARD_LIB(Connect)(0, abAtr, &dwAtrLength);
+
+	return (rc == SCARD_ERR(S_SUCCESS));
+}
+
+/**
+ * @brief Resynchronize the link in place (BREAK, then Ping), and keep the session and the card as they are
+ */
+static BOOL strategy_recover(void)
+{
+	if (CCID_LIB(Recover)() != SCARD_ERR(S_SUCCESS))
+		return FALSE;
+	SCARD_LIB(Init)();
+	return TRUE;
+}
+
+static BOOL run_strategy(BYTE bStrategy)
+{
+	switch (bStrategy)
+	{
+		case BENCH_STRATEGY_RECOVER:
+			return strategy_recover();
+		case BENCH_STRATEGY_RECONNECT:
+		default:
+			return strategy_reconnect();
+	}
+}
+
+static void print_header(void)
+{
+	if (fJson)
+		fprintf(out, "[\n");
+	else
+		fprintf(out, "config,class,directions,rate_ppm,seed,strategy,transactions,ok,lost,silent,faults,incidents,unrecovered,"
+			"detect_p50_us,detect_max_us,recovery_p50_us,recovery_max_us,ttr_p50_us,ttr_p99_us,ttr_max_us,ttr_mean_us,elapsed_s\n");
+}
+
+static void print_footer(void)
+{
+	if (fJson)
+		fprintf(out, "\n]\n");
+}
+
+/**
+ * @brief Run the transactions of a class with a strategy, and print its row
+ * @return FALSE if the device could not be opened
+ */
+static BOOL bench_run(BYTE bClass, BYTE bStrategy)
+{
+	CCID_FAULT_CONFIG_ST config = faultConfig;
+	CCID_FAULT_CONFIG_ST clean = faultConfig;
+	CCID_FAULT_STATS_ST stats;
+	DWORD dwOk = 0, dwLost = 0, dwSilent = 0, dwIncidents = 0, dwUnrecovered = 0;
+	DWORD dwDetectCount = 0, dwRecoveryCount = 0, dwTtrCount = 0;
+	uint64_t qwRunStart, qwFailStart = 0;
+	BOOL fPending = FALSE;
+	const char* szDirections;
+	double dTtrMean;
+
+	fprintf(stderr, "Class %s, strategy %s\n", CCID_LIB(FaultClassName)(bClass), aszStrategyNames[bStrategy]);
+
+	/* Same seed for every strategy: same faults at the same places */
+	clean.bClass = CCID_FAULT_NONE;
+	CCID_LIB(FaultConfigure)(&clean);
+	CCID_LIB(SerialInit)(szConfig);
+	if (!strategy_reconnect())
+	{
+		fprintf(stderr, "No device on %s\n", szConfig);
+		CCID_LIB(SerialClose)();
+		return FALSE;
+	}
+
+	config.bClass = bClass;
+	CCID_LIB(FaultConfigure)(&config);
+
+	qwRunStart = now_us();
+	for (DWORD t = 0; t < dwTransactions; t++)
+	{
+		DWORD dwSendLength = build_echo(t);
+		DWORD dwRecvLength = sizeof(abRecvBuffer);
+		uint64_t qwStart = now_us();
+		BOOL fRecovered = FALSE;
+		LONG rc;
+
+		rc = SCARD_LIB(Transmit)(0, abSendBuffer, dwSendLength, abRecvBuffer, &dwRecvLength);
+
+		if ((rc == SCARD_ERR(S_SUCCESS)) && (dwRecvLength == BENCH_ECHO_LENGTH + 2))
+		{
+			if (!memcmp(abRecvBuffer, &abSendBuffer[5], BENCH_ECHO_LENGTH) && (abRecvBuffer[BENCH_ECHO_LENGTH] == 0x90) && (abRecvBuffer[BENCH_ECHO_LENGTH + 1] == 0x00))
+			{
+				dwOk++;
+				if (fPending)
+				{
+					adwTtrUs[dwTtrCount++] = (DWORD) (now_us() - qwFailStart);
+					fPending = FALSE;
+				}
+				continue;
+			}
+			/* The driver has taken a wrong response for a good one: nobody knows, nothing to recover from */
+			D(fprintf(stderr, "Transaction %lu: wrong data\n", t));
+			dwSilent++;
+			continue;
+		}
+
+		D(fprintf(stderr, "Transaction %lu: rc=%lX, %lu bytes\n", t, rc, dwRecvLength));
+		dwLost++;
+		if (!fPending)
+		{
+			/* Start of an incident: until a transaction goes through again */
+			fPending = TRUE;
+			qwFailStart = qwStart;
+			dwIncidents++;
+			adwDetectUs[dwDetectCount++] = (DWORD) (now_us() - qwStart);
+		}
+
+		for (DWORD dwAttempt = 0; dwAttempt < BENCH_MAX_ATTEMPTS; dwAttempt++)
+		{
+			uint64_t qwRecoveryStart = now_us();
+
+			fRecovered = run_strategy(bStrategy);
+			adwRecoveryUs[dwRecoveryCount] = (DWORD) (now_us() - qwRecoveryStart);
+			if (dwRecoveryCount < BENCH_MAX_TRANSACTIONS - 1)
+				dwRecoveryCount++;
+			if (fRecovered)
+				break;
+		}
+
+		if (!fRecovered)
+		{
+			fprintf(stderr, "Class %s, strategy %s: not recovered after %d attempts, the run is over\n", CCID_LIB(FaultClassName)(bClass), aszStrategyNames[bStrategy], BENCH_MAX_ATTEMPTS);
+			dwUnrecovered++;
+			dwLost += dwTransactions - t - 1;
+			break;
+		}
+	}
+
+	CCID_LIB(FaultGetStats)(&stats);
+	clean.bClass = CCID_FAULT_NONE;
+	CCID_LIB(FaultConfigure)(&clean);
+	SCARD_LIB(Disconnect)(0);
+	CCID_LIB(Stop)();
+	CCID_LIB(SerialClose)();
+
+	/* An incident that has not ended counts for the whole rest of the run */
+	if (fPending)
+		adwTtrUs[dwTtrCount++] = (DWORD) (now_us() - qwFailStart);
+
+	switch (config.bDirections)
+	{
+		case CCID_FAULT_TX: szDirections = "tx"; break;
+		case CCID_FAULT_RX: szDirections = "rx"; break;
+		default: szDirections = "both"; break;
+	}
+
+	dTtrMean = mean(adwTtrUs, dwTtrCount);
+
+	if (fJson)
+	{
+		fprintf(out, "%s  {\"config\": \"%s\", \"class\": \"%s\", \"directions\": \"%s\", \"rate_ppm\": %lu, \"seed\": %lu, \"strategy\": \"%s\", "
+			"\"transactions\": %lu, \"ok\": %lu, \"lost\": %lu, \"silent\": %lu, \"faults\": %lu, \"incidents\": %lu, \"unrecovered\": %lu, "
+			"\"detect_p50_us\": %lu, \"detect_max_us\": %lu, \"recovery_p50_us\": %lu, \"recovery_max_us\": %lu, "
+			"\"ttr_p50_us\": %lu, \"ttr_p99_us\": %lu, \"ttr_max_us\": %lu, \"ttr_mean_us\": %.1f, \"elapsed_s\": %.3f}",
+			fFirstRow ? "" : ",\n", szConfig, CCID_LIB(FaultClassName)(bClass), szDirections, config.dwRatePpm, config.dwSeed, aszStrategyNames[bStrategy],
+			dwTransactions, dwOk, dwLost, dwSilent, stats.dwInjected, dwIncidents, dwUnrecovered,
+			percentile(adwDetectUs, dwDetectCount, 50), percentile(adwDetectUs, dwDetectCount, 100),
+			percentile(adwRecoveryUs, dwRecoveryCount, 50), percentile(adwRecoveryUs, dwRecoveryCount, 100),
+			percentile(adwTtrUs, dwTtrCount, 50), percentile(adwTtrUs, dwTtrCount, 99), percentile(adwTtrUs, dwTtrCount, 100), dTtrMean,
+			(now_us() - qwRunStart) / 1e6);
+	}
+	else
+	{
+		fprintf(out, "\"%s\",%s,%s,%lu,%lu,%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.1f,%.3f\n",
+			szConfig, CCID_LIB(FaultClassName)(bClass), szDirections, config.dwRatePpm, config.dwSeed, aszStrategyNames[bStrategy],
+			dwTransactions, dwOk, dwLost, dwSilent, stats.dwInjected, dwIncidents, dwUnrecovered,
+			percentile(adwDetectUs, dwDetectCount, 50), percentile(adwDetectUs, dwDetectCount, 100),
+			percentile(adwRecoveryUs, dwRecoveryCount, 50), percentile(adwRecoveryUs, dwRecoveryCount, 100),
+			percentile(adwTtrUs, dwTtrCount, 50), percentile(adwTtrUs, dwTtrCount, 99), percentile(adwTtrUs, dwTtrCount, 100), dTtrMean,
+			(now_us() - qwRunStart) / 1e6);
+	}
+	fflush(out);
+	fFirstRow = FALSE;
+
+	return TRUE;
+}
+
+int main(int argc, char** argv)
+{
+	BOOL fResult = TRUE;
+
+	for (BYTE bClass = CCID_FAULT_NONE + 1; bClass < CCID_FAULT_CLASS_COUNT; bClass++)
+		afClasses[bClass] = TRUE;
+
+	if (!parse_args(argc, argv))
+	{
+		fprintf(stderr, "Usage:\n");
+		fprintf(stderr, "\tccid-fault-bench [-d <COMM PORT>] [-c <class,...>] [-S <strategy,...>] [-x tx|rx|both] [-p <ppm>] [-w <ms>] [-s <seed>] [-n <N>] [-j] [-v]\n");
+		fprintf(stderr, "\t\t-d <COMM PORT>: device to measure (default %s)\n", szConfig);
+		fprintf(stderr, "\t\t-c: fault classes, among");
+		for (BYTE bClass = 0; bClass < CCID_FAULT_CLASS_COUNT; bClass++)
+			fprintf(stderr, " %s", CCID_LIB(FaultClassName)(bClass));
+		fprintf(stderr, " (default all but none)\n");
+		fprintf(stderr, "\t\t-S: recovery strategies, among reconnect (close, reopen and start over, without BREAK) and recover (CCID_Recover in place) (default both)\n");
+		fprintf(stderr, "\t\t-x: direction(s) where the faults are injected (default both)\n");
+		fprintf(stderr, "\t\t-p <ppm>: probability that a frame is hit, in parts per million (default 20000)\n");
+		fprintf(stderr, "\t\t-w <ms>: stall of the delay-frame class (default 1500)\n");
+		fprintf(stderr, "\t\t-s <seed>: seed of the faults (default 1)\n");
+		fprintf(stderr, "\t\t-n <N>: transactions per run (default 200, max %d)\n", BENCH_MAX_TRANSACTIONS);
+		fprintf(stderr, "\t\t-j: JSON output (CSV otherwise)\n");
+		fprintf(stderr, "\t\t-v: verbose output\n");
+		return -1;
+	}
+
+	/* The library reports the errors on stdout: send them to stderr, and keep stdout for the results */
+	out = fdopen(dup(STDOUT_FILENO), "w");
+	if (out == NULL)
+		return -1;
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+
+	print_header();
+	for (BYTE bClass = 0; bClass < CCID_FAULT_CLASS_COUNT; bClass++)
+	{
+		if (!afClasses[bClass])
+			continue;
+		for (BYTE bStrategy = 0; bStrategy < BENCH_STRATEGY_COUNT; bStrategy++)
+		{
+			if (!afStrategies[bStrategy])
+				continue;
+			if (!bench_run(bClass, bStrategy))
+				fResult = FALSE;
+		}
+	}
+	print_footer();
+	fclose(out);
+
+	return fResult ? 0 : 1;
+}
+
+/**
+ * @brief Parse a comma-separated list of names into flags
+ */
+static BOOL parse_names(const char* szValues, BOOL afFlags[], BYTE bCount, BYTE (*lookup)(const char*))
+{
+	char szName[32];
+
+	memset(afFlags, 0, bCount * sizeof(BOOL));
+	while (*szValues != '\0')
+	{
+		size_t len = strcspn(szValues, ",");
+		BYTE bIndex;
+
+		if (len >= sizeof(szName))
+			return FALSE;
+		memcpy(szName, szValues, len);
+		szName[len] = '\0';
+		bIndex = lookup(szName);
+		if (bIndex >= bCount)
+			return FALSE;
+		afFlags[bIndex] = TRUE;
+		szValues += len;
+		if (*szValues == ',')
+			szValues++;
+	}
+	return TRUE;
+}
+
+static BYTE strategy_from_name(const char* szName)
+{
+	BYTE bStrategy;
+
+	for (bStrategy = 0; bStrategy < BENCH_STRATEGY_COUNT; bStrategy++)
+		if (!strcmp(szName, aszStrategyNames[bStrategy]))
+			break;
+	return bStrategy;
+}
+
+static BOOL parse_args(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-d") && (i + 1 < argc))
+		{
+			szConfig = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-c") && (i + 1 < argc))
+		{
+			if (!parse_names(argv[++i], afClasses, CCID_FAULT_CLASS_COUNT, CCID_LIB(FaultClassFromName)))
+				return FALSE;
+		}
+		else if (!strcmp(argv[i], "-S") && (i + 1 < argc))
+		{
+			if (!parse_names(argv[++i], afStrategies, BENCH_STRATEGY_COUNT, strategy_from_name))
+				return FALSE;
+		}
+		else if (!strcmp(argv[i], "-x") && (i + 1 < argc))
+		{
+			i++;
+			if (!strcmp(argv[i], "tx"))
+				faultConfig.bDirections = CCID_FAULT_TX;
+			else if (!strcmp(argv[i], "rx"))
+				faultConfig.bDirections = CCID_FAULT_RX;
+			else if (!strcmp(argv[i], "both"))
+				faultConfig.bDirections = CCID_FAULT_TX | CCID_FAULT_RX;
+			else
+				return FALSE;
+		}
+		else if (!strcmp(argv[i], "-p") && (i + 1 < argc))
+		{
+			faultConfig.dwRatePpm = strtoul(argv[++i], NULL, 10);
+			if (faultConfig.dwRatePpm > 1000000)
+				return FALSE;
+		}
+		else if (!strcmp(argv[i], "-w") && (i + 1 < argc))
+		{
+			faultConfig.dwDelayMs = strtoul(argv[++i], NULL, 10);
+		}
+		else if (!strcmp(argv[i], "-s") && (i + 1 < argc))
+		{
+			faultConfig.dwSeed = strtoul(argv[++i], NULL, 0);
+		}
+		else if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+		{
+			dwTransactions = strtoul(argv[++i], NULL, 10);
+			if ((dwTransactions == 0) || (dwTransactions > BENCH_MAX_TRANSACTIONS))
+				return FALSE;
+		}
+		else if (!strcmp(argv[i], "-j"))
+		{
+			fJson = TRUE;
+		}
+		else if (!strcmp(argv[i], "-v"))
+		{
+			fVerbose = TRUE;
+		}
+		else
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
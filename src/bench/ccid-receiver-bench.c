@@ -0,0 +1,367 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid-receiver-bench.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Microbenchmark of the receiver (CCID_SerialRecvByteFromISR and CCID_SerialRecvBytesFromISR): time per byte, per frame, and worst case per byte
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include <project.h>
+
+#include "../pcsc-serial.h"
+#include "../scard/scard.h"
+#include "../ccid/ccid.h"
+#include "../ccid/ccid_hal.h"
+
+#include <time.h>
+#if (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define BENCH_HAS_TSC
+#endif
+
+#define BENCH_MAX_STREAM_LENGTH (4 * (2 + CCID_HEADER_LENGTH + CCID_MAX_PAYLOAD_LENGTH + 1))
+#define BENCH_DEFAULT_ROUNDS 20000
+/* The worst case is the slowest byte position, by its median over that many rounds (the max would be the host's preemptions) */
+#define BENCH_WORST_ROUNDS 301
+
+/* Where a byte falls in the frame, to tell which path of the state machine is the slowest */
+typedef enum
+{
+	BYTE_START,
+	BYTE_ENDPOINT,
+	BYTE_HEADER,
+	BYTE_LENGTH_DONE,
+	BYTE_PAYLOAD,
+	BYTE_CHECKSUM,
+	BYTE_IGNORED,
+	BYTE_KIND_COUNT
+} BENCH_BYTE_KIND_E;
+
+static const char* aszByteKinds[BYTE_KIND_COUNT] = { "start", "endpoint", "header", "end-of-header", "payload", "checksum", "ignored" };
+
+typedef struct
+{
+	const char* szName;
+	BYTE abBytes[BENCH_MAX_STREAM_LENGTH];
+	BYTE abKinds[BENCH_MAX_STREAM_LENGTH];
+	DWORD dwLength;
+	/* Messages (or errors) the application retrieves after the stream */
+	DWORD dwFrames;
+} BENCH_STREAM_ST;
+
+BOOL fVerbose = FALSE;
+
+static DWORD dwRounds = BENCH_DEFAULT_ROUNDS;
+static BENCH_STREAM_ST streams[5];
+static DWORD dwStreamCount;
+static BYTE abPayload[CCID_MAX_PAYLOAD_LENGTH];
+static uint32_t adwSamples[BENCH_MAX_STREAM_LENGTH][BENCH_WORST_ROUNDS];
+
+/**
+ * @brief The benchmark never cancels anything
+ */
+BOOL SCARD_LIB(IsCancelledHook)(void)
+{
+	return FALSE;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t now_ticks(void)
+{
+#if (defined(BENCH_HAS_TSC))
+	return __rdtsc();
+#else
+	return now_ns();
+#endif
+}
+
+/**
+ * @brief Append a frame (RDR_to_PC_DataBlock, or a slot change on the interrupt endpoint) to a stream
+ */
+static void add_frame(BENCH_STREAM_ST* stream, BYTE bEndpoint, DWORD dwPayloadLength, BOOL fBadChecksum)
+{
+	BYTE* p = &stream->abBytes[stream->dwLength];
+	BYTE* k = &stream->abKinds[stream->dwLength];
+	DWORD n = 0;
+	BYTE bChecksum;
+
+	p[n] = START_BYTE; k[n++] = BYTE_START;
+	p[n] = bEndpoint; k[n++] = BYTE_ENDPOINT;
+	p[n] = (bEndpoint == CCID_COMM_INTERRUPT_RDR_TO_PC) ? RDR_TO_PC_INTERRUPT : RDR_TO_PC_DATABLOCK; k[n++] = BYTE_HEADER;
+	for (DWORD i = 0; i < 4; i++)
+	{
+		p[n] = (BYTE) (dwPayloadLength >> (8 * i));
+		k[n++] = BYTE_HEADER;
+	}
+	for (DWORD i = 0; i < 5; i++)
+	{
+		p[n] = 0x00;
+		k[n++] = BYTE_HEADER;
+	}
+	k[n - 1] = BYTE_LENGTH_DONE;
+	for (DWORD i = 0; i < dwPayloadLength; i++)
+	{
+		p[n] = (BYTE) i;
+		k[n++] = BYTE_PAYLOAD;
+	}
+
+	bChecksum = 0;
+	for (DWORD i = 1; i < n; i++)
+		bChecksum ^= p[i];
+	p[n] = fBadChecksum ? ~bChecksum : bChecksum;
+	k[n++] = BYTE_CHECKSUM;
+
+	stream->dwLength += n;
+	stream->dwFrames++;
+}
+
+static BENCH_STREAM_ST* new_stream(const char* szName)
+{
+	BENCH_STREAM_ST* stream = &streams[dwStreamCount++];
+	stream->szName = szName;
+	return stream;
+}
+
+static void build_streams(void)
+{
+	BENCH_STREAM_ST* stream;
+
+	/* A typical R-APDU: SW only */
+	stream = new_stream("clean");
+	add_frame(stream, CCID_COMM_BULK_RDR_TO_PC, 2, FALSE);
+
+	stream = new_stream("max-length");
+	add_frame(stream, CCID_COMM_BULK_RDR_TO_PC, CCID_MAX_PAYLOAD_LENGTH, FALSE);
+
+	/* A notification that arrives right before the response */
+	stream = new_stream("back-to-back");
+	add_frame(stream, CCID_COMM_INTERRUPT_RDR_TO_PC, 1, FALSE);
+	add_frame(stream, CCID_COMM_BULK_RDR_TO_PC, 64, FALSE);
+
+	/* Line noise in front of a frame: the receiver stops at the first byte, the rest is ignored */
+	stream = new_stream("noisy");
+	stream->abBytes[0] = 0xFF; stream->abKinds[0] = BYTE_START;
+	stream->abBytes[1] = 0x00; stream->abKinds[1] = BYTE_IGNORED;
+	stream->dwLength = 2;
+	add_frame(stream, CCID_COMM_BULK_RDR_TO_PC, 64, FALSE);
+	for (DWORD i = 2; i < stream->dwLength; i++)
+		stream->abKinds[i] = BYTE_IGNORED;
+
+	stream = new_stream("bad-checksum");
+	add_frame(stream, CCID_COMM_BULK_RDR_TO_PC, 64, TRUE);
+}
+
+/**
+ * @brief Let the application retrieve what the stream has produced, so the receiver is ready for the next round
+ */
+static void drain(const BENCH_STREAM_ST* stream)
+{
+	CCID_PACKET_ST packet;
+
+	for (DWORD i = 0; i < stream->dwFrames; i++)
+	{
+		memset(&packet, 0, sizeof(packet));
+		packet.abRecvPayload = abPayload;
+		packet.dwRecvPayloadMaxLen = sizeof(abPayload);
+		if (CCID_LIB(SerialRecv)(&packet, 0) != SCARD_ERR(S_SUCCESS))
+		{
+			D(fprintf(stderr, "%s: frame %lu is rejected\n", stream->szName, i));
+			break; /* The error has reset the receiver */
+		}
+		D(fprintf(stderr, "%s: frame %lu, endpoint %02X, %lu bytes\n", stream->szName, i, packet.bEndpoint, packet.Header.p.Length.dw));
+	}
+}
+
+static int compare_u32(const void* a, const void* b)
+{
+	uint32_t x = *(const uint32_t*) a;
+	uint32_t y = *(const uint32_t*) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Minimal cost of reading the clock twice, subtracted from the per-byte measurements
+ */
+static uint64_t clock_overhead(void)
+{
+	uint64_t qwMin = (uint64_t) -1;
+
+	for (DWORD i = 0; i < 10000; i++)
+	{
+		uint64_t t0 = now_ticks();
+		uint64_t t1 = now_ticks();
+		if (t1 - t0 < qwMin)
+			qwMin = t1 - t0;
+	}
+	return qwMin;
+}
+
+static void bench_stream(const BENCH_STREAM_ST* stream, BOOL fBulk, uint64_t qwOverhead)
+{
+	uint64_t qwTotalNs = 0, qwTotalTicks = 0;
+	uint64_t qwWorst = 0;
+	DWORD dwWorstKind = 0;
+
+	for (DWORD r = 0; r < dwRounds; r++)
+	{
+		uint64_t t0 = now_ns();
+		uint64_t c0 = now_ticks();
+
+		if (fBulk)
+		{
+			CCID_LIB(SerialRecvBytesFromISR)(stream->abBytes, stream->dwLength);
+		}
+		else
+		{
+			for (DWORD i = 0; i < stream->dwLength; i++)
+				CCID_LIB(SerialRecvByteFromISR)(stream->abBytes[i]);
+		}
+
+		qwTotalTicks += now_ticks() - c0;
+		qwTotalNs += now_ns() - t0;
+		drain(stream);
+	}
+
+	/* Worst case: time every call by itself (with the bulk variant, a call is the whole stream) */
+	for (DWORD r = 0; r < BENCH_WORST_ROUNDS; r++)
+	{
+		if (fBulk)
+		{
+			uint64_t c0 = now_ticks();
+			CCID_LIB(SerialRecvBytesFromISR)(stream->abBytes, stream->dwLength);
+			adwSamples[0][r] = (uint32_t) (now_ticks() - c0);
+		}
+		else
+		{
+			for (DWORD i = 0; i < stream->dwLength; i++)
+			{
+				uint64_t c0 = now_ticks();
+				CCID_LIB(SerialRecvByteFromISR)(stream->abBytes[i]);
+				adwSamples[i][r] = (uint32_t) (now_ticks() - c0);
+			}
+		}
+		drain(stream);
+	}
+
+	for (DWORD i = 0; i < (fBulk ? 1 : stream->dwLength); i++)
+	{
+		qsort(adwSamples[i], BENCH_WORST_ROUNDS, sizeof(uint32_t), compare_u32);
+		if (adwSamples[i][BENCH_WORST_ROUNDS / 2] > qwWorst)
+		{
+			qwWorst = adwSamples[i][BENCH_WORST_ROUNDS / 2];
+			dwWorstKind = stream->abKinds[i];
+		}
+	}
+	qwWorst = (qwWorst > qwOverhead) ? qwWorst - qwOverhead : 0;
+
+	double dNsPerByte = (double) qwTotalNs / ((double) dwRounds * stream->dwLength);
+	double dTicksPerByte = (double) qwTotalTicks / ((double) dwRounds * stream->dwLength);
+	double dNsPerFrame = (double) qwTotalNs / ((double) dwRounds * stream->dwFrames);
+	double dWorstNs = qwWorst * dNsPerByte / dTicksPerByte;
+
+	printf("%s,%s,%lu,%lu,%.2f,%.1f,%.1f,%lu,%.0f,%s,%.0f\n",
+		stream->szName, fBulk ? "bulk" : "byte", stream->dwLength, stream->dwFrames,
+		dNsPerByte, dTicksPerByte, dNsPerFrame,
+		(DWORD) qwWorst, dWorstNs, fBulk ? "call" : aszByteKinds[dwWorstKind],
+		/* An ISR that costs the worst case for every byte (every chunk with the bulk variant) caps the bit rate, 10 bits per byte */
+		(dWorstNs > 0) ? 1e10 * (fBulk ? stream->dwLength : 1) / dWorstNs : 0);
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t qwOverhead;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+		{
+			dwRounds = strtoul(argv[++i], NULL, 10);
+		}
+		else if (!strcmp(argv[i], "-v"))
+		{
+			fVerbose = TRUE;
+		}
+		else
+		{
+			fprintf(stderr, "Usage:\n");
+			fprintf(stderr, "\tccid-receiver-bench [-n <ROUNDS>] [-v]\n");
+			fprintf(stderr, "\t\t-n <ROUNDS>: times every stream is received (default %d)\n", BENCH_DEFAULT_ROUNDS);
+			fprintf(stderr, "\t\t-v: verbose output\n");
+			return -1;
+		}
+	}
+	if (dwRounds == 0)
+		dwRounds = 1;
+
+	/* The wakeups are part of the cost, they need the HAL (but no comm port) */
+	CCID_LIB(SerialInit)("receiver-bench");
+	CCID_LIB(Init)();
+
+	build_streams();
+	qwOverhead = clock_overhead();
+
+#if (defined(BENCH_HAS_TSC))
+	fprintf(stderr, "Ticks are TSC cycles (reference clock), the clock overhead is %lu cycles\n", (DWORD) qwOverhead);
+#else
+	fprintf(stderr, "Ticks are nanoseconds, the clock overhead is %lu ns\n", (DWORD) qwOverhead);
+#endif
+
+	printf("stream,api,bytes,frames,ns_per_byte,ticks_per_byte,ns_per_frame,worst_ticks,worst_ns,worst_path,max_bit_rate\n");
+	for (DWORD i = 0; i < dwStreamCount; i++)
+	{
+		bench_stream(&streams[i], FALSE, qwOverhead);
+		bench_stream(&streams[i], TRUE, qwOverhead);
+	}
+
+	return 0;
+}
@@ -0,0 +1,496 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid-serial-bench.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Benchmark: latency and throughput of SCARD_Transmit and SCARD_Control, swept over Lc, Le, delay and device configurations, with CSV or JSON output
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include <project.h>
+
+#include "../pcsc-serial.h"
+#include "../scard/scard.h"
+#include "../ccid/ccid.h"
+#include "../ccid/ccid_hal.h"
+
+#include <sys/resource.h>
+#include <time.h>
+
+#define BENCH_MAX_CONFIGS 16
+#define BENCH_MAX_VALUES 32
+#define BENCH_MAX_ITERATIONS 10000
+/* Exchanges that are not measured, before each cell */
+#define BENCH_WARMUP 3
+/* Framing of a message on the wire: START_BYTE, endpoint, header, checksum */
+#define BENCH_FRAME_OVERHEAD (2 + CCID_HEADER_LENGTH + 1)
+/* Bit rate of a genuine coupler */
+#define BENCH_DEFAULT_BITRATE 38400
+
+typedef struct
+{
+	DWORD adwValues[BENCH_MAX_VALUES];
+	DWORD dwCount;
+} BENCH_LIST_ST;
+
+BOOL fVerbose = FALSE;
+
+static const char* aszConfigs[BENCH_MAX_CONFIGS];
+static DWORD dwConfigCount;
+static BENCH_LIST_ST lcList = { { 0, 16, 64, 128, 255 }, 5 };
+static BENCH_LIST_ST leList = { { 0, 16, 64, 128, 256 }, 5 };
+static BENCH_LIST_ST delayList = { { 0 }, 1 };
+static DWORD dwIterations = 50;
+static DWORD dwDefaultBitRate = BENCH_DEFAULT_BITRATE;
+static BOOL fTransmit = TRUE;
+static BOOL fControl = TRUE;
+static BOOL fJson = FALSE;
+static BOOL fFirstRow = TRUE;
+#if (CCID_TIMELINE)
+static BOOL fTimeline = FALSE;
+/* The stages of CCID_EXCHANGE_TIMELINE_ST, in the order of the structure */
+static const char* aszStages[] = { "queue", "encode", "tx", "device", "rx", "wakeup", "return" };
+#define BENCH_STAGE_COUNT (sizeof(aszStages) / sizeof(aszStages[0]))
+#endif
+
+static BYTE abSendBuffer[CCID_MAX_PAYLOAD_LENGTH];
+static BYTE abRecvBuffer[CCID_MAX_PAYLOAD_LENGTH];
+static DWORD adwLatencyUs[BENCH_MAX_ITERATIONS];
+
+static BOOL parse_args(int argc, char** argv);
+
+/**
+ * @brief The benchmark never cancels anything
+ */
+BOOL SCARD_LIB(IsCancelledHook)(void)
+{
+	return FALSE;
+}
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t cpu_us(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (uint64_t) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static int compare_dword(const void* a, const void* b)
+{
+	DWORD x = *(const DWORD*) a;
+	DWORD y = *(const DWORD*) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Bit rate of the wire: taken from the configuration of the virtual coupler ("emu:<bps>"), the default (-r) otherwise
+ */
+static DWORD config_bit_rate(const char* szConfig)
+{
+	if (!strncmp(szConfig, "emu:", 4) && (szConfig[4] >= '0') && (szConfig[4] <= '9'))
+		return strtoul(&szConfig[4], NULL, 10);
+	if (!strncmp(szConfig, "emu", 3))
+		return BENCH_DEFAULT_BITRATE;
+	return dwDefaultBitRate;
+}
+
+/**
+ * @brief Build the ECHO instruction (see test_echo_transmit_ex in the sample)
+ * @return length of the APDU
+ */
+static DWORD build_echo(DWORD dwDelay, DWORD dwLc, DWORD dwLe)
+{
+	DWORD dwLength = 0;
+
+	abSendBuffer[dwLength++] = 0xFF; /* CLA */
+	abSendBuffer[dwLength++] = 0xFD; /* INS */
+	abSendBuffer[dwLength++] = 0x00; /* P1 */
+	abSendBuffer[dwLength++] = 0x80 | (dwDelay & 0x3F); /* P2 */
+
+	if (dwLc > 0)
+	{
+		abSendBuffer[dwLength++] = (BYTE) dwLc;
+		for (DWORD i = 0; i < dwLc; i++)
+			abSendBuffer[dwLength++] = (BYTE) i;
+	}
+	if (dwLe > 0)
+		abSendBuffer[dwLength++] = (BYTE) dwLe; /* 256 --> 0 is correct */
+
+	return dwLength;
+}
+
+static void print_header(void)
+{
+	if (fJson)
+		printf("[\n");
+	else
+	{
+		printf("config,slots,bit_rate,api,lc,le,delay_s,iterations,errors,p50_us,p99_us,max_us,mean_us,wire_bytes,wire_bytes_per_s,wire_efficiency,payload_bytes_per_s,cpu_us_per_exchange");
+#if (CCID_TIMELINE)
+		if (fTimeline)
+			for (DWORD i = 0; i < BENCH_STAGE_COUNT; i++)
+				printf(",%s_us", aszStages[i]);
+#endif
+		printf("\n");
+	}
+}
+
+static void print_footer(void)
+{
+	if (fJson)
+		printf("\n]\n");
+}
+
+/**
+ * @brief Run one cell of the matrix, and print its row
+ */
+static void bench_cell(const char* szConfig, BYTE bSlotCount, BOOL fIsTransmit, DWORD dwLc, DWORD dwLe, DWORD dwDelay)
+{
+	DWORD dwSendLength = build_echo(dwDelay, dwLc, dwLe);
+	DWORD dwBitRate = config_bit_rate(szConfig);
+	/* Command and response, with their framing; Control carries the APDU as is, Transmit too (short APDU level) */
+	DWORD dwWireBytes = BENCH_FRAME_OVERHEAD + dwSendLength + BENCH_FRAME_OVERHEAD + dwLe + 2;
+	DWORD dwErrors = 0, dwDone = 0;
+	uint64_t qwTotalUs = 0, qwCpuStart, qwCpuUs;
+	double dMeanUs, dWireRate, dPayloadRate, dEfficiency;
+#if (CCID_TIMELINE)
+	/* Sums of the stages of the last exchange of every call */
+	uint64_t aqwStagesUs[BENCH_STAGE_COUNT] = { 0 };
+#endif
+
+	for (DWORD i = 0; i < BENCH_WARMUP + dwIterations; i++)
+	{
+		DWORD dwRecvLength = sizeof(abRecvBuffer);
+		BYTE bSlot = (BYTE) (i % bSlotCount);
+		uint64_t qwStart;
+		LONG rc;
+
+		if (i == BENCH_WARMUP)
+			qwCpuStart = cpu_us();
+
+		qwStart = now_us();
+		if (fIsTransmit)
+			rc = SCARD_LIB(Transmit)(bSlot, abSendBuffer, dwSendLength, abRecvBuffer, &dwRecvLength);
+		else
+			rc = SCARD_LIB(Control)(abSendBuffer, dwSendLength, abRecvBuffer, &dwRecvLength);
+
+		if (i < BENCH_WARMUP)
+			continue;
+
+		if ((rc != SCARD_ERR(S_SUCCESS)) || (dwRecvLength != dwLe + 2))
+		{
+			D(fprintf(stderr, "%s Lc=%lu Le=%lu: rc=%lX, %lu bytes\n", fIsTransmit ? "Transmit" : "Control", dwLc, dwLe, rc, dwRecvLength));
+			dwErrors++;
+			if (!SCARD_LIB(IsValidContext)())
+				break;
+			continue;
+		}
+
+		adwLatencyUs[dwDone] = (DWORD) (now_us() - qwStart);
+#if (CCID_TIMELINE)
+		if (fTimeline)
+		{
+			CCID_EXCHANGE_TIMELINE_ST timeline;
+			CCID_LIB(GetLastTimeline)(&timeline);
+			aqwStagesUs[0] += timeline.dwQueueUs;
+			aqwStagesUs[1] += timeline.dwEncodeUs;
+			aqwStagesUs[2] += timeline.dwTxUs;
+			aqwStagesUs[3] += timeline.dwDeviceUs;
+			aqwStagesUs[4] += timeline.dwRxUs;
+			aqwStagesUs[5] += timeline.dwWakeupUs;
+			aqwStagesUs[6] += timeline.dwReturnUs;
+		}
+#endif
+		qwTotalUs += adwLatencyUs[dwDone];
+		dwDone++;
+	}
+
+	qwCpuUs = cpu_us() - qwCpuStart;
+
+	if (dwDone == 0)
+	{
+		fprintf(stderr, "%s: %s Lc=%lu Le=%lu delay=%lu: all exchanges have failed\n", szConfig, fIsTransmit ? "Transmit" : "Control", dwLc, dwLe, dwDelay);
+		return;
+	}
+
+	qsort(adwLatencyUs, dwDone, sizeof(DWORD), compare_dword);
+	dMeanUs = (double) qwTotalUs / dwDone;
+	dWireRate = dwWireBytes * 1e6 / dMeanUs;
+	dPayloadRate = (dwLc + dwLe) * 1e6 / dMeanUs;
+	dEfficiency = dwBitRate ? dWireRate / (dwBitRate / 10.0) : 0;
+
+	if (fJson)
+	{
+		printf("%s  {\"config\": \"%s\", \"slots\": %u, \"bit_rate\": %lu, \"api\": \"%s\", \"lc\": %lu, \"le\": %lu, \"delay_s\": %lu, "
+			"\"iterations\": %lu, \"errors\": %lu, \"p50_us\": %lu, \"p99_us\": %lu, \"max_us\": %lu, \"mean_us\": %.1f, "
+			"\"wire_bytes\": %lu, \"wire_bytes_per_s\": %.1f, \"wire_efficiency\": %.3f, \"payload_bytes_per_s\": %.1f, \"cpu_us_per_exchange\": %.1f",
+			fFirstRow ? "" : ",\n", szConfig, bSlotCount, dwBitRate, fIsTransmit ? "transmit" : "control", dwLc, dwLe, dwDelay,
+			dwDone, dwErrors, adwLatencyUs[(dwDone - 1) / 2], adwLatencyUs[(dwDone * 99 - 1) / 100], adwLatencyUs[dwDone - 1], dMeanUs,
+			dwWireBytes, dWireRate, dEfficiency, dPayloadRate, (double) qwCpuUs / (dwDone + dwErrors));
+	}
+	else
+	{
+		printf("\"%s\",%u,%lu,%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.1f,%lu,%.1f,%.3f,%.1f,%.1f",
+			szConfig, bSlotCount, dwBitRate, fIsTransmit ? "transmit" : "control", dwLc, dwLe, dwDelay,
+			dwDone, dwErrors, adwLatencyUs[(dwDone - 1) / 2], adwLatencyUs[(dwDone * 99 - 1) / 100], adwLatencyUs[dwDone - 1], dMeanUs,
+			dwWireBytes, dWireRate, dEfficiency, dPayloadRate, (double) qwCpuUs / (dwDone + dwErrors));
+	}
+#if (CCID_TIMELINE)
+	/* Mean of every stage: tells whether the time goes to the wire, the coupler or the scheduling of the host */
+	if (fTimeline)
+		for (DWORD i = 0; i < BENCH_STAGE_COUNT; i++)
+		{
+			if (fJson)
+				printf(", \"%s_us\": %.1f", aszStages[i], (double) aqwStagesUs[i] / dwDone);
+			else
+				printf(",%.1f", (double) aqwStagesUs[i] / dwDone);
+		}
+#endif
+	printf(fJson ? "}" : "\n");
+	fflush(stdout);
+	fFirstRow = FALSE;
+}
+
+/**
+ * @brief Open the device of a configuration, run the whole matrix, close the device
+ */
+static BOOL bench_config(const char* szConfig)
+{
+	BYTE abAtr[33];
+	BYTE bSlotCount = 0, bConnected = 0;
+	LONG rc;
+
+	fprintf(stderr, "Configuration %s\n", szConfig);
+
+	CCID_LIB(SerialInit)(szConfig);
+	if (!CCID_LIB(SerialOpen)())
+	{
+		fprintf(stderr, "Failed to open %s\n", szConfig);
+		return FALSE;
+	}
+
+	CCID_LIB(Init)();
+	rc = CCID_LIB(Ping)();
+	if (rc != SCARD_ERR(S_SUCCESS))
+		rc = CCID_LIB(Recover)();
+	if (rc == SCARD_ERR(S_SUCCESS))
+		rc = CCID_LIB(Start)(FALSE);
+	if (rc == SCARD_ERR(S_SUCCESS))
+	{
+		SCARD_LIB(Init)();
+		rc = CCID_LIB(GetSlotCount)(&bSlotCount);
+	}
+	if (rc != SCARD_ERR(S_SUCCESS))
+	{
+		fprintf(stderr, "No device on %s (rc=%lX)\n", szConfig, rc);
+		CCID_LIB(SerialClose)();
+		return FALSE;
+	}
+
+	/* Transmit goes round all the slots where a card answers */
+	if (fTransmit)
+	{
+		for (BYTE bSlot = 0; bSlot < bSlotCount; bSlot++)
+		{
+			DWORD dwAtrLength = sizeof(abAtr);
+			if (SCARD_LIB(Connect)(bSlot, abAtr, &dwAtrLength) != SCARD_ERR(S_SUCCESS))
+				break;
+			bConnected++;
+		}
+		if (bConnected == 0)
+			fprintf(stderr, "No card in slot 0, SCardTransmit is not measured\n");
+	}
+
+	for (DWORD d = 0; d < delayList.dwCount; d++)
+	{
+		for (DWORD c = 0; c < lcList.dwCount; c++)
+		{
+			for (DWORD e = 0; e < leList.dwCount; e++)
+			{
+				DWORD dwLc = lcList.adwValues[c];
+				DWORD dwLe = leList.adwValues[e];
+
+				/* The ECHO instruction is a short APDU */
+				if ((dwLc > 255) || (dwLe > 256))
+					continue;
+				/* And it shall fit in a CCID message */
+				if ((6 + dwLc > CCID_LIB(MaxPayloadLength)()) || (dwLe + 2 > CCID_LIB(MaxPayloadLength)()))
+					continue;
+
+				if (bConnected)
+					bench_cell(szConfig, bConnected, TRUE, dwLc, dwLe, delayList.adwValues[d]);
+				if (fControl)
+					bench_cell(szConfig, bSlotCount, FALSE, dwLc, dwLe, delayList.adwValues[d]);
+			}
+		}
+	}
+
+	for (BYTE bSlot = 0; bSlot < bConnected; bSlot++)
+		SCARD_LIB(Disconnect)(bSlot);
+	CCID_LIB(Stop)();
+	CCID_LIB(SerialClose)();
+
+	return TRUE;
+}
+
+int main(int argc, char** argv)
+{
+	BOOL fResult = TRUE;
+
+	if (!parse_args(argc, argv) || (dwConfigCount == 0))
+	{
+		fprintf(stderr, "Usage:\n");
+		fprintf(stderr, "\tccid-serial-bench -d <COMM PORT> [-d <COMM PORT>...] [-L <Lc,...>] [-E <Le,...>] [-D <delay,...>] [-n <N>] [-a transmit|control] [-r <bps>] [-t] [-j] [-v]\n");
+		fprintf(stderr, "\t\t-d <COMM PORT>: device to measure; with the virtual coupler, its configuration (e.g. emu:38400,slots=2), may be repeated\n");
+		fprintf(stderr, "\t\t-L, -E: lists of Lc and Le values (default 0,16,64,128,255 and 0,16,64,128,256)\n");
+		fprintf(stderr, "\t\t-D: list of ECHO delays, in seconds (default 0)\n");
+		fprintf(stderr, "\t\t-n <N>: exchanges per cell (default 50, max %d)\n", BENCH_MAX_ITERATIONS);
+		fprintf(stderr, "\t\t-a: only measure SCardTransmit or SCardControl\n");
+		fprintf(stderr, "\t\t-r <bps>: bit rate of the comm port, for the theoretical wire rate (default %d)\n", BENCH_DEFAULT_BITRATE);
+#if (CCID_TIMELINE)
+		fprintf(stderr, "\t\t-t: add the mean time of every stage of the exchange (queue, encode, tx, device, rx, wakeup, return)\n");
+#endif
+		fprintf(stderr, "\t\t-j: JSON output (CSV otherwise)\n");
+		fprintf(stderr, "\t\t-v: verbose output\n");
+		return -1;
+	}
+
+	print_header();
+	for (DWORD i = 0; i < dwConfigCount; i++)
+		if (!bench_config(aszConfigs[i]))
+			fResult = FALSE;
+	print_footer();
+
+	return fResult ? 0 : 1;
+}
+
+static BOOL parse_list(BENCH_LIST_ST* list, const char* szValues)
+{
+	char* szEnd;
+
+	list->dwCount = 0;
+	while (*szValues != '\0')
+	{
+		if (list->dwCount >= BENCH_MAX_VALUES)
+			return FALSE;
+		list->adwValues[list->dwCount++] = strtoul(szValues, &szEnd, 10);
+		if (szEnd == szValues)
+			return FALSE;
+		szValues = (*szEnd == ',') ? szEnd + 1 : szEnd;
+	}
+	return (list->dwCount > 0);
+}
+
+static BOOL parse_args(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-d") && (i + 1 < argc))
+		{
+			if (dwConfigCount >= BENCH_MAX_CONFIGS)
+				return FALSE;
+			aszConfigs[dwConfigCount++] = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-L") && (i + 1 < argc))
+		{
+			if (!parse_list(&lcList, argv[++i]))
+				return FALSE;
+		}
+		else if (!strcmp(argv[i], "-E") && (i + 1 < argc))
+		{
+			if (!parse_list(&leList, argv[++i]))
+				return FALSE;
+		}
+		else if (!strcmp(argv[i], "-D") && (i + 1 < argc))
+		{
+			if (!parse_list(&delayList, argv[++i]))
+				return FALSE;
+		}
+		else if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+		{
+			dwIterations = strtoul(argv[++i], NULL, 10);
+			if ((dwIterations == 0) || (dwIterations > BENCH_MAX_ITERATIONS))
+				return FALSE;
+		}
+		else if (!strcmp(argv[i], "-a") && (i + 1 < argc))
+		{
+			i++;
+			fTransmit = !strcmp(argv[i], "transmit");
+			fControl = !strcmp(argv[i], "control");
+			if (!fTransmit && !fControl)
+				return FALSE;
+		}
+		else if (!strcmp(argv[i], "-r") && (i + 1 < argc))
+		{
+			dwDefaultBitRate = strtoul(argv[++i], NULL, 10);
+		}
+#if (CCID_TIMELINE)
+		else if (!strcmp(argv[i], "-t"))
+		{
+			fTimeline = TRUE;
+		}
+#endif
+		else if (!strcmp(argv[i], "-j"))
+		{
+			fJson = TRUE;
+		}
+		else if (!strcmp(argv[i], "-v"))
+		{
+			fVerbose = TRUE;
+		}
+		else
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
@@ -0,0 +1,154 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_capture_file.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Capture of the serial traffic into a file, by a background thread (POSIX hosts)
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_capture_file.h"
+
+#if (CCID_CAPTURE)
+
+#include <pthread.h>
+
+static FILE* ccid_capture_file;
+static pthread_t ccid_capture_thread;
+static volatile BOOL ccid_capture_stop;
+static BYTE ccid_capture_buffer[CCID_CAPTURE_RING_SIZE * 4];
+
+/**
+ * @internal
+ * @brief Move what the tap has recorded to the file
+ */
+static void ccid_capture_flush(void)
+{
+	BOOL fWritten = FALSE;
+	DWORD dwLength;
+
+	while ((dwLength = CCID_LIB(CaptureRead)(ccid_capture_buffer, sizeof(ccid_capture_buffer))) != 0)
+	{
+		if (fwrite(ccid_capture_buffer, 1, dwLength, ccid_capture_file) != dwLength)
+		{
+			perror("Capture");
+			break;
+		}
+		fWritten = TRUE;
+	}
+
+	if (fWritten)
+		fflush(ccid_capture_file);
+}
+
+/**
+ * @internal
+ * @brief Background thread: the driver and its ISR only copy the bytes to the rings, the file is written here
+ */
+static void* ccid_capture_task(void* arg)
+{
+	(void) arg;
+
+	while (!ccid_capture_stop)
+	{
+		ccid_capture_flush();
+		usleep(CCID_CAPTURE_FILE_POLL_MS * 1000);
+	}
+
+	/* What has been recorded before CCID_CaptureFileStop */
+	ccid_capture_flush();
+	return NULL;
+}
+
+/**
+ * @brief Record the serial traffic of all the instances into a file, until CCID_CaptureFileStop
+ * @return FALSE if the file can not be created, or if a capture is already running
+ * @note The file may be read back with CCID_CaptureReaderInit and CCID_CaptureReaderNext, or played back by the "replay:" virtual coupler (see ccid_emulator.h)
+ */
+BOOL CCID_LIB(CaptureFileStart)(const char* szFileName)
+{
+	if ((szFileName == NULL) || (ccid_capture_file != NULL))
+		return FALSE;
+
+	ccid_capture_file = fopen(szFileName, "wb");
+	if (ccid_capture_file == NULL)
+	{
+		perror(szFileName);
+		return FALSE;
+	}
+
+	ccid_capture_stop = FALSE;
+	CCID_LIB(CaptureEnable)(TRUE);
+
+	if (pthread_create(&ccid_capture_thread, NULL, ccid_capture_task, NULL) != 0)
+	{
+		perror("pthread_create");
+		CCID_LIB(CaptureEnable)(FALSE);
+		fclose(ccid_capture_file);
+		ccid_capture_file = NULL;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * @brief Stop recording, write what remains and close the file
+ */
+void CCID_LIB(CaptureFileStop)(void)
+{
+	if (ccid_capture_file == NULL)
+		return;
+
+	CCID_LIB(CaptureEnable)(FALSE);
+	ccid_capture_stop = TRUE;
+	pthread_join(ccid_capture_thread, NULL);
+
+	fclose(ccid_capture_file);
+	ccid_capture_file = NULL;
+}
+
+#endif
@@ -63,18 +63,49 @@
 
 void CCID_LIB(Init)(void);
 
+BOOL CCID_LIB(SelectInstance)(BYTE bInstance);
+BYTE CCID_LIB(GetInstance)(void);
+
 LONG CCID_LIB(Ping)(void);
+LONG CCID_LIB(Recover)(void);
 LONG CCID_LIB(Start)(BOOL fUseNotifications);
 LONG CCID_LIB(Stop)(void);
 LONG CCID_LIB(GetDescriptor)(BYTE bType, BYTE bIndex, BYTE abDescriptor[], DWORD *pdwDescriptorLength);
 LONG CCID_LIB(GetSlotCount)(BYTE *bSlotCount);
+BYTE CCID_LIB(SlotCount)(void);
+
+LONG CCID_LIB(ParseClassDescriptor)(const BYTE abDescriptor[], DWORD dwDescriptorLength, CCID_CLASS_DESCRIPTOR_ST* pDescriptor);
+LONG CCID_LIB(ReadClassDescriptor)(void);
+LONG CCID_LIB(GetClassDescriptor)(CCID_CLASS_DESCRIPTOR_ST* pDescriptor);
+DWORD CCID_LIB(GetFeatures)(void);
+DWORD CCID_LIB(MaxPayloadLength)(void);
+DWORD CCID_LIB(BulkTimeout)(DWORD dwCardBytes);
+
+LONG CCID_LIB(LoadProfile)(CCID_PROFILE_ST* pProfile);
+LONG CCID_LIB(CreateProfile)(CCID_PROFILE_ST* pProfile);
+LONG CCID_LIB(SaveProfile)(CCID_PROFILE_ST* pProfile);
+void CCID_LIB(ForgetProfile)(void);
+
+#if (CCID_MAX_INSTANCE_COUNT > 1)
+LONG CCID_LIB(Discover)(CCID_DISCOVERY_ST aCandidates[], DWORD dwCandidateCount, DWORD dwTimeoutMs);
+#endif
 
 BOOL CCID_LIB(IsValidDriver)(void);
 
 void CCID_LIB(PacketInit)(CCID_PACKET_ST *packet);
 
 LONG CCID_LIB(Exchange)(CCID_PACKET_ST* packet, DWORD timeout_ms);
+#if (CCID_TIMELINE)
+LONG CCID_LIB(ExchangeEx)(CCID_PACKET_ST* packet, DWORD timeout_ms, CCID_EXCHANGE_TIMELINE_ST* pTimeline);
+void CCID_LIB(GetLastTimeline)(CCID_EXCHANGE_TIMELINE_ST* pTimeline);
+#endif
 LONG CCID_LIB(WaitInterrupt)(CCID_PACKET_ST* packet, DWORD timeout_ms);
+BOOL CCID_LIB(InterruptPending)(void);
+
+LONG CCID_LIB(GetParameters)(BYTE bSlot, BYTE* pbProtocol, BYTE abParameters[], DWORD* pdwParametersLength);
+LONG CCID_LIB(SetParameters)(BYTE bSlot, BYTE bProtocol, const BYTE abParameters[], DWORD dwParametersLength);
+LONG CCID_LIB(ResetParameters)(BYTE bSlot);
+LONG CCID_LIB(SetDataRateAndClockFrequency)(BYTE bSlot, DWORD* pdwClockFrequency, DWORD* pdwDataRate);
 
 LONG CCID_LIB(SerialSend)(CCID_PACKET_ST *packet);
 LONG CCID_LIB(SerialRecv)(CCID_PACKET_ST* packet, DWORD timeout_ms);
@@ -83,4 +114,53 @@ BYTE CCID_LIB(GetSequence)(BYTE bSlot);
 void CCID_LIB(NextSequence)(BYTE bSlot);
 void CCID_LIB(ResetSequences)(void);
 
+void CCID_LIB(SlotSetClear)(CCID_SLOT_SET_ST* set);
+void CCID_LIB(SlotSetAdd)(CCID_SLOT_SET_ST* set, BYTE bSlot);
+void CCID_LIB(SlotSetRemove)(CCID_SLOT_SET_ST* set, BYTE bSlot);
+BOOL CCID_LIB(SlotSetContains)(const CCID_SLOT_SET_ST* set, BYTE bSlot);
+BOOL CCID_LIB(SlotSetIsEmpty)(const CCID_SLOT_SET_ST* set);
+
+void CCID_LIB(TicketLock)(CCID_TICKET_LOCK_ST* lock);
+BOOL CCID_LIB(TicketUnlock)(CCID_TICKET_LOCK_ST* lock);
+DWORD CCID_LIB(TicketDepth)(CCID_TICKET_LOCK_ST* lock);
+
+BOOL CCID_LIB(GetSlotChanges)(CCID_SLOT_SET_ST* pPresent, CCID_SLOT_SET_ST* pChanged);
+BOOL CCID_LIB(TakeSlotChange)(BYTE bSlot);
+void CCID_LIB(DecodeInterrupt)(const BYTE abPayload[], DWORD dwLength, CCID_SLOT_SET_ST* pCovered, CCID_SLOT_SET_ST* pPresent, CCID_SLOT_SET_ST* pChanged);
+
+#if (CCID_CAPTURE)
+void CCID_LIB(CaptureEnable)(BOOL fEnable);
+DWORD CCID_LIB(CaptureRead)(BYTE abBuffer[], DWORD dwMaxLength);
+#endif
+BOOL CCID_LIB(CaptureReaderInit)(CCID_CAPTURE_READER_ST* reader, const BYTE abCapture[], DWORD dwLength);
+BOOL CCID_LIB(CaptureReaderNext)(CCID_CAPTURE_READER_ST* reader, CCID_CAPTURE_RECORD_ST* pRecord);
+
+#if (CCID_STATS)
+void CCID_LIB(GetStats)(CCID_STATS_ST* pStats);
+void CCID_LIB(GetInstanceStats)(BYTE bInstance, CCID_STATS_ST* pStats);
+void CCID_LIB(ResetStats)(void);
+#endif
+
+#if (CCID_TRACE)
+void CCID_LIB(TraceEnable)(BOOL fEnable);
+void CCID_LIB(Trace)(WORD wEvent, DWORD dwArg0, DWORD dwArg1, DWORD dwArg2);
+DWORD CCID_LIB(TraceRead)(CCID_TRACE_RECORD_ST aRecords[], DWORD dwMaxCount, DWORD* pdwLost);
+void CCID_LIB(TracePrint)(void);
+#endif
+DWORD CCID_LIB(TraceFormat)(const CCID_TRACE_RECORD_ST* pRecord, char szBuffer[], DWORD dwMaxLength);
+void CCID_LIB(TracePrintEvent)(WORD wEvent, DWORD dwArg0, DWORD dwArg1, DWORD dwArg2);
+
+#if (CCID_HISTOGRAMS)
+void CCID_LIB(GetHistograms)(CCID_HISTOGRAMS_ST* pHistograms, BOOL fReset);
+void CCID_LIB(GetInstanceHistograms)(BYTE bInstance, CCID_HISTOGRAMS_ST* pHistograms, BOOL fReset);
+void CCID_LIB(ResetHistograms)(void);
+#endif
+BYTE CCID_LIB(HistogramBucket)(DWORD dwValueUs);
+DWORD CCID_LIB(HistogramBucketLowUs)(BYTE bBucket);
+DWORD CCID_LIB(HistogramBucketHighUs)(BYTE bBucket);
+DWORD CCID_LIB(HistogramPercentile)(const CCID_HISTOGRAM_ST* pHistogram, DWORD dwPerMille);
+void CCID_LIB(HistogramMerge)(CCID_HISTOGRAM_ST* pTo, const CCID_HISTOGRAM_ST* pFrom);
+void CCID_LIB(HistogramsMerge)(CCID_HISTOGRAMS_ST* pTo, const CCID_HISTOGRAMS_ST* pFrom);
+const char* CCID_LIB(HistogramCommandName)(BYTE bCommand);
+
 #endif
@@ -0,0 +1,495 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_capture.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Implementation of the CCID driver, capture of the serial traffic (tap, lock-free rings, and reader of the capture format)
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_i.h"
+
+#if (CCID_CAPTURE)
+
+#if ((CCID_CAPTURE_RING_SIZE & (CCID_CAPTURE_RING_SIZE - 1)) != 0)
+#error CCID_CAPTURE_RING_SIZE must be a power of 2
+#endif
+
+/* In the ring, every chunk is its length (2 bytes) and its time (4 bytes), then the bytes */
+#define CCID_CAPTURE_CHUNK_HEADER_LENGTH 6
+/* Longer chunks are split, so that one of them always fits in an empty ring */
+#define CCID_CAPTURE_MAX_CHUNK_LENGTH (CCID_CAPTURE_RING_SIZE / 4)
+/* Chunks of the same ring closer than this make one record (e.g. the bytes of a frame received one by one), that has the time of the last one */
+#define CCID_CAPTURE_MERGE_US 1000
+/* Longest header of a record: type, time and length */
+#define CCID_CAPTURE_MAX_RECORD_HEADER_LENGTH 11
+
+/**
+ * @brief A ring with a single producer (the driver, or the ISR) and a single consumer (CCID_CaptureRead)
+ * @note The indexes run freely, only their difference matters
+ */
+typedef struct
+{
+	BYTE abData[CCID_CAPTURE_RING_SIZE];
+	volatile DWORD dwHead; /* Written by the producer only */
+	volatile DWORD dwTail; /* Written by the consumer only */
+	volatile DWORD dwLost; /* Written by the producer only */
+	DWORD dwLostReported; /* Consumer */
+	DWORD dwWrite; /* Producer: where the chunk that has begun goes on */
+	BOOL fOpen; /* Producer: a chunk has begun */
+} CCID_CAPTURE_RING_ST;
+
+static CCID_CAPTURE_RING_ST ccid_capture_rings[CCID_MAX_INSTANCE_COUNT][2];
+static volatile BOOL ccid_capture_enabled;
+static BOOL ccid_capture_header_done;
+static DWORD ccid_capture_last_us;
+
+static CCID_CAPTURE_RING_ST* ccid_capture_ring(BYTE bInstance, BYTE bType)
+{
+	return &ccid_capture_rings[bInstance][(bType == CCID_CAPTURE_RX) ? 1 : 0];
+}
+
+/* Is a time stamp older than another one (the clock wraps around) */
+static BOOL time_before(DWORD dwTimeUs, DWORD dwOtherUs)
+{
+	return (dwTimeUs - dwOtherUs) >= 0x80000000UL;
+}
+
+static void ring_write(CCID_CAPTURE_RING_ST* ring, DWORD dwIndex, const BYTE abData[], DWORD dwLength)
+{
+	DWORD dwOffset = dwIndex & (CCID_CAPTURE_RING_SIZE - 1);
+	DWORD dwFirst = CCID_CAPTURE_RING_SIZE - dwOffset;
+
+	if (dwFirst > dwLength)
+		dwFirst = dwLength;
+	memcpy(&ring->abData[dwOffset], abData, dwFirst);
+	memcpy(&ring->abData[0], &abData[dwFirst], dwLength - dwFirst);
+}
+
+static void ring_read(const CCID_CAPTURE_RING_ST* ring, DWORD dwIndex, BYTE abData[], DWORD dwLength)
+{
+	DWORD dwOffset = dwIndex & (CCID_CAPTURE_RING_SIZE - 1);
+	DWORD dwFirst = CCID_CAPTURE_RING_SIZE - dwOffset;
+
+	if (dwFirst > dwLength)
+		dwFirst = dwLength;
+	memcpy(abData, &ring->abData[dwOffset], dwFirst);
+	memcpy(&abData[dwFirst], &ring->abData[0], dwLength - dwFirst);
+}
+
+static void ring_read_chunk_header(const CCID_CAPTURE_RING_ST* ring, DWORD dwIndex, DWORD* pdwLength, DWORD* pdwTimeUs)
+{
+	BYTE abHeader[CCID_CAPTURE_CHUNK_HEADER_LENGTH];
+
+	ring_read(ring, dwIndex, abHeader, sizeof(abHeader));
+	*pdwLength = utohs(&abHeader[0]);
+	*pdwTimeUs = utohl(&abHeader[2]);
+}
+
+/**
+ * @brief Begin a chunk of bytes in the ring of the given instance and direction
+ * @return FALSE if the capture is not enabled, or if the ring is full (the chunk is counted as lost)
+ * @note Only one caller per instance and direction (the one that sends, the ISR that receives)
+ */
+BOOL ccid_capture_begin(BYTE bInstance, BYTE bType, DWORD dwLength)
+{
+	CCID_CAPTURE_RING_ST* ring;
+	BYTE abHeader[CCID_CAPTURE_CHUNK_HEADER_LENGTH];
+	DWORD dwHead;
+
+	if (!ccid_capture_enabled || (bInstance >= CCID_MAX_INSTANCE_COUNT))
+		return FALSE;
+
+	ring = ccid_capture_ring(bInstance, bType);
+	ring->fOpen = FALSE;
+
+	dwHead = ring->dwHead;
+	if ((dwLength > CCID_CAPTURE_MAX_CHUNK_LENGTH) || (CCID_CAPTURE_CHUNK_HEADER_LENGTH + dwLength > CCID_CAPTURE_RING_SIZE - (dwHead - ring->dwTail)))
+	{
+		ring->dwLost++;
+		return FALSE;
+	}
+
+	htous(&abHeader[0], (WORD) dwLength);
+	htoul(&abHeader[2], CCID_LIB(GetTimeUs)());
+	ring_write(ring, dwHead, abHeader, sizeof(abHeader));
+	ring->dwWrite = dwHead + CCID_CAPTURE_CHUNK_HEADER_LENGTH;
+	ring->fOpen = TRUE;
+
+	return TRUE;
+}
+
+/**
+ * @brief Add bytes to the chunk that has begun (the total must be the length given to ccid_capture_begin)
+ */
+void ccid_capture_append(BYTE bInstance, BYTE bType, const BYTE abData[], DWORD dwLength)
+{
+	CCID_CAPTURE_RING_ST* ring = ccid_capture_ring(bInstance, bType);
+
+	if (!ring->fOpen)
+		return;
+
+	ring_write(ring, ring->dwWrite, abData, dwLength);
+	ring->dwWrite += dwLength;
+}
+
+/**
+ * @brief Publish the chunk that has begun
+ */
+void ccid_capture_commit(BYTE bInstance, BYTE bType)
+{
+	CCID_CAPTURE_RING_ST* ring = ccid_capture_ring(bInstance, bType);
+
+	if (!ring->fOpen)
+		return;
+
+	ccid_barrier();
+	ring->dwHead = ring->dwWrite;
+	ring->fOpen = FALSE;
+}
+
+/**
+ * @brief Record bytes in the ring of the given instance and direction, as one or more chunks
+ */
+void ccid_capture_bytes(BYTE bInstance, BYTE bType, const BYTE abData[], DWORD dwLength)
+{
+	while (dwLength)
+	{
+		DWORD dwCount = (dwLength > CCID_CAPTURE_MAX_CHUNK_LENGTH) ? CCID_CAPTURE_MAX_CHUNK_LENGTH : dwLength;
+
+		if (ccid_capture_begin(bInstance, bType, dwCount))
+		{
+			ccid_capture_append(bInstance, bType, abData, dwCount);
+			ccid_capture_commit(bInstance, bType);
+		}
+		abData += dwCount;
+		dwLength -= dwCount;
+	}
+}
+
+/**
+ * @brief Start or stop recording the serial traffic of all the instances
+ * @note Starting begins a new capture: what has not been read by CCID_CaptureRead yet is dropped, and the next call to CCID_CaptureRead returns the header first
+ */
+void CCID_LIB(CaptureEnable)(BOOL fEnable)
+{
+	if (!fEnable)
+	{
+		ccid_capture_enabled = FALSE;
+		return;
+	}
+
+	ccid_capture_enabled = FALSE;
+	ccid_barrier();
+
+	for (BYTE bInstance = 0; bInstance < CCID_MAX_INSTANCE_COUNT; bInstance++)
+	{
+		for (BYTE i = 0; i < 2; i++)
+		{
+			CCID_CAPTURE_RING_ST* ring = &ccid_capture_rings[bInstance][i];
+			ring->dwTail = ring->dwHead;
+			ring->dwLostReported = ring->dwLost;
+		}
+	}
+
+	ccid_capture_header_done = FALSE;
+	ccid_capture_last_us = CCID_LIB(GetTimeUs)();
+
+	ccid_barrier();
+	ccid_capture_enabled = TRUE;
+}
+
+static DWORD put_varint(BYTE abBuffer[], DWORD dwValue)
+{
+	DWORD dwLength = 0;
+
+	while (dwValue >= 0x80)
+	{
+		abBuffer[dwLength++] = (BYTE) (dwValue | 0x80);
+		dwValue >>= 7;
+	}
+	abBuffer[dwLength++] = (BYTE) dwValue;
+
+	return dwLength;
+}
+
+static DWORD put_record_header(BYTE abBuffer[], BYTE bType, BYTE bInstance, DWORD dwTimeUs, DWORD dwLength)
+{
+	DWORD dwOffset = 0;
+	DWORD dwDelayUs = 0;
+
+	/* A chunk of another ring may have been stamped a little before the previous record, but published after it */
+	if (time_before(ccid_capture_last_us, dwTimeUs))
+		dwDelayUs = dwTimeUs - ccid_capture_last_us;
+	ccid_capture_last_us += dwDelayUs;
+
+	abBuffer[dwOffset++] = bType | bInstance;
+	dwOffset += put_varint(&abBuffer[dwOffset], dwDelayUs);
+	dwOffset += put_varint(&abBuffer[dwOffset], dwLength);
+
+	return dwOffset;
+}
+
+/**
+ * @brief Retrieve what the tap has recorded, in the capture format, oldest first, all instances and directions merged
+ * @param abBuffer the buffer; at least CCID_CAPTURE_RING_SIZE + 16 bytes, so that any record fits
+ * @param dwMaxLength size of the buffer
+ * @return the number of bytes written into the buffer (0 if nothing new has been recorded)
+ * @note This function does not block, and does not depend on the instance selected by CCID_SelectInstance. Only one caller at a time (typically a background thread that writes a file, see CCID_CaptureFileStart).
+ * Concatenating what it returns after CCID_CaptureEnable(TRUE) gives a complete capture, that CCID_CaptureReaderInit/CCID_CaptureReaderNext read back.
+ */
+DWORD CCID_LIB(CaptureRead)(BYTE abBuffer[], DWORD dwMaxLength)
+{
+	DWORD dwOffset = 0;
+
+	if (abBuffer == NULL)
+		return 0;
+
+	if (!ccid_capture_header_done)
+	{
+		if (dwMaxLength < CCID_CAPTURE_HEADER_LENGTH)
+			return 0;
+		memcpy(abBuffer, CCID_CAPTURE_MAGIC, 4);
+		abBuffer[4] = CCID_CAPTURE_VERSION;
+		abBuffer[5] = abBuffer[6] = abBuffer[7] = 0;
+		dwOffset = CCID_CAPTURE_HEADER_LENGTH;
+		ccid_capture_header_done = TRUE;
+	}
+
+	for (;;)
+	{
+		CCID_CAPTURE_RING_ST* best = NULL;
+		BYTE bBestInstance = 0, bBestType = 0;
+		DWORD dwBestHead = 0, dwBestUs = 0;
+		BOOL fOther = FALSE;
+		DWORD dwOtherUs = 0;
+		DWORD dwIndex, dwTotal, dwPrevUs;
+
+		/* The ring whose oldest chunk is the oldest of all, and the time of the next one in any other ring */
+		for (BYTE bInstance = 0; bInstance < CCID_MAX_INSTANCE_COUNT; bInstance++)
+		{
+			for (BYTE i = 0; i < 2; i++)
+			{
+				CCID_CAPTURE_RING_ST* ring = &ccid_capture_rings[bInstance][i];
+				DWORD dwHead = ring->dwHead;
+				DWORD dwLength, dwTimeUs;
+
+				ccid_barrier();
+
+				if (ring->dwTail != dwHead)
+					ring_read_chunk_header(ring, ring->dwTail, &dwLength, &dwTimeUs);
+				else if (ring->dwLost != ring->dwLostReported)
+					dwTimeUs = CCID_LIB(GetTimeUs)();
+				else
+					continue;
+
+				if ((best == NULL) || time_before(dwTimeUs, dwBestUs))
+				{
+					if (best != NULL)
+					{
+						if (!fOther || time_before(dwBestUs, dwOtherUs))
+							dwOtherUs = dwBestUs;
+						fOther = TRUE;
+					}
+					best = ring;
+					bBestInstance = bInstance;
+					bBestType = i ? CCID_CAPTURE_RX : CCID_CAPTURE_TX;
+					dwBestHead = dwHead;
+					dwBestUs = dwTimeUs;
+				}
+				else if (!fOther || time_before(dwTimeUs, dwOtherUs))
+				{
+					dwOtherUs = dwTimeUs;
+					fOther = TRUE;
+				}
+			}
+		}
+
+		if (best == NULL)
+			break;
+
+		if (best->dwLost != best->dwLostReported)
+		{
+			/* Say that chunks are missing before the ones that follow */
+			DWORD dwLost = best->dwLost;
+
+			if (dwOffset + CCID_CAPTURE_MAX_RECORD_HEADER_LENGTH > dwMaxLength)
+				break;
+			dwOffset += put_record_header(&abBuffer[dwOffset], CCID_CAPTURE_LOST, bBestInstance, dwBestUs, dwLost - best->dwLostReported);
+			best->dwLostReported = dwLost;
+			continue;
+		}
+
+		/* Merge the chunks that follow closely, as long as no other ring has something older */
+		dwIndex = best->dwTail;
+		dwTotal = 0;
+		dwPrevUs = dwBestUs;
+		while (dwIndex != dwBestHead)
+		{
+			DWORD dwLength, dwTimeUs;
+
+			ring_read_chunk_header(best, dwIndex, &dwLength, &dwTimeUs);
+			if (dwIndex != best->dwTail)
+			{
+				if ((dwTimeUs - dwPrevUs) > CCID_CAPTURE_MERGE_US)
+					break;
+				if (fOther && !time_before(dwTimeUs, dwOtherUs))
+					break;
+			}
+			if (dwOffset + CCID_CAPTURE_MAX_RECORD_HEADER_LENGTH + dwTotal + dwLength > dwMaxLength)
+				break;
+			dwTotal += dwLength;
+			dwPrevUs = dwTimeUs;
+			dwIndex += CCID_CAPTURE_CHUNK_HEADER_LENGTH + dwLength;
+		}
+
+		if (dwIndex == best->dwTail)
+			break; /* The buffer is full */
+
+		dwOffset += put_record_header(&abBuffer[dwOffset], bBestType, bBestInstance, dwPrevUs, dwTotal);
+		while (best->dwTail != dwIndex)
+		{
+			DWORD dwLength, dwTimeUs;
+
+			ring_read_chunk_header(best, best->dwTail, &dwLength, &dwTimeUs);
+			ring_read(best, best->dwTail + CCID_CAPTURE_CHUNK_HEADER_LENGTH, &abBuffer[dwOffset], dwLength);
+			dwOffset += dwLength;
+
+			ccid_barrier();
+			best->dwTail += CCID_CAPTURE_CHUNK_HEADER_LENGTH + dwLength;
+		}
+	}
+
+	return dwOffset;
+}
+
+#endif
+
+static BOOL get_varint(CCID_CAPTURE_READER_ST* reader, DWORD* pdwValue)
+{
+	DWORD dwValue = 0;
+
+	for (BYTE bShift = 0; bShift < 35; bShift += 7)
+	{
+		BYTE bValue;
+
+		if (reader->dwOffset >= reader->dwLength)
+			return FALSE;
+		bValue = reader->abCapture[reader->dwOffset++];
+		dwValue |= (DWORD) (bValue & 0x7F) << bShift;
+		if (!(bValue & 0x80))
+		{
+			*pdwValue = dwValue;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * @brief Start reading a capture (e.g. the content of a file written by CCID_CaptureFileStart)
+ * @return FALSE if it does not begin with a valid header
+ * @note This function and CCID_CaptureReaderNext are available even when CCID_CAPTURE is not set
+ */
+BOOL CCID_LIB(CaptureReaderInit)(CCID_CAPTURE_READER_ST* reader, const BYTE abCapture[], DWORD dwLength)
+{
+	if ((reader == NULL) || (abCapture == NULL))
+		return FALSE;
+
+	if ((dwLength < CCID_CAPTURE_HEADER_LENGTH) || memcmp(abCapture, CCID_CAPTURE_MAGIC, 4) || (abCapture[4] != CCID_CAPTURE_VERSION))
+		return FALSE;
+
+	reader->abCapture = abCapture;
+	reader->dwLength = dwLength;
+	reader->dwOffset = CCID_CAPTURE_HEADER_LENGTH;
+	reader->dwTimeUs = 0;
+
+	return TRUE;
+}
+
+/**
+ * @brief Read the next record of a capture
+ * @return FALSE at the end of the capture, or if the record is truncated (then reader->dwOffset < reader->dwLength)
+ */
+BOOL CCID_LIB(CaptureReaderNext)(CCID_CAPTURE_READER_ST* reader, CCID_CAPTURE_RECORD_ST* pRecord)
+{
+	DWORD dwStart, dwDelayUs, dwLength;
+	BYTE bType;
+
+	if ((reader == NULL) || (pRecord == NULL) || (reader->dwOffset >= reader->dwLength))
+		return FALSE;
+
+	dwStart = reader->dwOffset;
+	bType = reader->abCapture[reader->dwOffset++];
+
+	if (!get_varint(reader, &dwDelayUs) || !get_varint(reader, &dwLength))
+	{
+		reader->dwOffset = dwStart;
+		return FALSE;
+	}
+
+	pRecord->bType = bType & CCID_CAPTURE_TYPE_MASK;
+	pRecord->bInstance = bType & CCID_CAPTURE_INSTANCE_MASK;
+	pRecord->dwLength = dwLength;
+	pRecord->abData = NULL;
+
+	if (pRecord->bType != CCID_CAPTURE_LOST)
+	{
+		if (dwLength > reader->dwLength - reader->dwOffset)
+		{
+			reader->dwOffset = dwStart;
+			return FALSE;
+		}
+		pRecord->abData = &reader->abCapture[reader->dwOffset];
+		reader->dwOffset += dwLength;
+	}
+
+	reader->dwTimeUs += dwDelayUs;
+	pRecord->dwTimeUs = reader->dwTimeUs;
+
+	return TRUE;
+}
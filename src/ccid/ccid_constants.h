@@ -65,20 +65,53 @@
 #define GET_DESCRIPTOR           0x06
 #define SET_CONFIGURATION        0x09
 
+#define PC_TO_RDR_SETPARAMETERS  0x61
 #define PC_TO_RDR_ICCPOWERON     0x62
 #define PC_TO_RDR_ICCPOWEROFF    0x63
 #define PC_TO_RDR_GETSLOTSTATUS  0x65
 #define PC_TO_RDR_ESCAPE         0x6B
+#define PC_TO_RDR_GETPARAMETERS  0x6C
+#define PC_TO_RDR_RESETPARAMETERS 0x6D
 #define PC_TO_RDR_XFRBLOCK       0x6F
+#define PC_TO_RDR_SETDATARATEANDCLOCKFREQUENCY 0x73
 
 #define RDR_TO_PC_INTERRUPT      0x50
 #define RDR_TO_PC_DATABLOCK      0x80
 #define RDR_TO_PC_SLOTSTATUS     0x81
+#define RDR_TO_PC_PARAMETERS     0x82
 #define RDR_TO_PC_ESCAPE         0x83
+#define RDR_TO_PC_DATARATEANDCLOCKFREQUENCY 0x84
+
+/* Length of the abProtocolDataStructure of PC_to_RDR_SetParameters / RDR_to_PC_Parameters */
+#define CCID_PARAMETERS_T0_LENGTH 5
+#define CCID_PARAMETERS_T1_LENGTH 7
+
+/* USB descriptors */
+#define CCID_DESCRIPTOR_TYPE_INTERFACE 0x04
+#define CCID_DESCRIPTOR_TYPE_CLASS     0x21
+#define CCID_CLASS_DESCRIPTOR_LENGTH   54
+
+/* dwFeatures of the CCID class descriptor */
+#define CCID_FEATURE_AUTO_PARAMETERS   0x00000002 /* Automatic parameter configuration based on the ATR */
+#define CCID_FEATURE_AUTO_NEGOTIATION  0x00000040 /* Automatic parameters negotiation (PPS) made by the device */
+#define CCID_FEATURE_AUTO_PPS          0x00000080 /* Automatic PPS made by the device according to the active parameters */
+#define CCID_FEATURE_LEVEL_MASK        0x00070000
+#define CCID_FEATURE_LEVEL_TPDU        0x00010000
+#define CCID_FEATURE_LEVEL_SHORT_APDU  0x00020000
+#define CCID_FEATURE_LEVEL_EXT_APDU    0x00040000
+
+/* wLevelParameter of PC_to_RDR_XfrBlock and bChainParameter of RDR_to_PC_DataBlock (APDU level, extended) */
+#define CCID_CHAIN_NONE     0x00 /* The command (or the response) is complete */
+#define CCID_CHAIN_BEGIN    0x01 /* Begins, and continues in the next block */
+#define CCID_CHAIN_END      0x02 /* Ends in this block */
+#define CCID_CHAIN_CONTINUE 0x03 /* Neither begins nor ends in this block */
+#define CCID_CHAIN_EMPTY    0x10 /* Empty block, the next one is expected */
 
 #define CONTROL_TIMEOUT 200
 #define BULK_TIMEOUT    1200
 
+#define RECOVER_PING_COUNT 3
+
 #define START_BYTE 0xCD
 
 
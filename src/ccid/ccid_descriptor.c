@@ -0,0 +1,239 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_descriptor.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief The CCID class descriptor of the device, and the settings that derive from it
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_i.h"
+
+/* Interface descriptor (9), CCID class descriptor (54) and up to 3 endpoint descriptors (7 each) */
+#define CCID_INTERFACE_DESCRIPTOR_MAX_LENGTH 96
+
+static CCID_CLASS_DESCRIPTOR_ST ccid_descriptor[CCID_MAX_INSTANCE_COUNT];
+static BOOL ccid_descriptor_valid[CCID_MAX_INSTANCE_COUNT];
+
+/**
+ * @internal
+ * @brief Forget the descriptor of the selected instance (the defaults apply until CCID_ReadClassDescriptor is called again)
+ */
+void ccid_reset_descriptor(void)
+{
+	ccid_descriptor_valid[CCID_LIB(GetInstance)()] = FALSE;
+}
+
+/**
+ * @internal
+ * @brief Use the given descriptor for the selected instance (e.g. taken from a profile), instead of reading it from the device
+ */
+void ccid_set_descriptor(const CCID_CLASS_DESCRIPTOR_ST* pDescriptor)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+
+	memcpy(&ccid_descriptor[bInstance], pDescriptor, sizeof(CCID_CLASS_DESCRIPTOR_ST));
+	ccid_descriptor_valid[bInstance] = TRUE;
+}
+
+/**
+ * @brief Find and decode the CCID class descriptor in a buffer that holds one or more USB descriptors (e.g. the interface descriptor and its followers)
+ * @param abDescriptor the descriptor(s), as returned by CCID_GetDescriptor
+ * @param dwDescriptorLength length of the buffer
+ * @param pDescriptor the decoded CCID class descriptor
+ * @return SCARD_S_SUCCESS success
+ * @return SCARD_E_READER_UNSUPPORTED the buffer does not contain a (valid) CCID class descriptor
+ */
+LONG CCID_LIB(ParseClassDescriptor)(const BYTE abDescriptor[], DWORD dwDescriptorLength, CCID_CLASS_DESCRIPTOR_ST* pDescriptor)
+{
+	DWORD dwOffset = 0;
+
+	if ((abDescriptor == NULL) || (pDescriptor == NULL))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	/* Walk through the descriptors, using their bLength */
+	while (dwOffset + 2 <= dwDescriptorLength)
+	{
+		const BYTE* p = &abDescriptor[dwOffset];
+
+		if (p[0] < 2)
+			break; /* Invalid bLength, we would loop forever */
+
+		if (p[1] == CCID_DESCRIPTOR_TYPE_CLASS)
+		{
+			if ((p[0] < CCID_CLASS_DESCRIPTOR_LENGTH) || (dwOffset + CCID_CLASS_DESCRIPTOR_LENGTH > dwDescriptorLength))
+				break; /* Truncated */
+
+			pDescriptor->wVersion = utohs(&p[2]);
+			pDescriptor->bMaxSlotIndex = p[4];
+			pDescriptor->bVoltageSupport = p[5];
+			pDescriptor->dwProtocols = utohl(&p[6]);
+			pDescriptor->dwDefaultClock = utohl(&p[10]);
+			pDescriptor->dwMaximumClock = utohl(&p[14]);
+			pDescriptor->bNumClockSupported = p[18];
+			pDescriptor->dwDataRate = utohl(&p[19]);
+			pDescriptor->dwMaxDataRate = utohl(&p[23]);
+			pDescriptor->bNumDataRatesSupported = p[27];
+			pDescriptor->dwMaxIFSD = utohl(&p[28]);
+			pDescriptor->dwSynchProtocols = utohl(&p[32]);
+			pDescriptor->dwMechanical = utohl(&p[36]);
+			pDescriptor->dwFeatures = utohl(&p[40]);
+			pDescriptor->dwMaxCCIDMessageLength = utohl(&p[44]);
+			pDescriptor->bClassGetResponse = p[48];
+			pDescriptor->bClassEnvelope = p[49];
+			pDescriptor->wLcdLayout = utohs(&p[50]);
+			pDescriptor->bPINSupport = p[52];
+			pDescriptor->bMaxCCIDBusySlots = p[53];
+
+			return SCARD_ERR(S_SUCCESS);
+		}
+
+		dwOffset += p[0];
+	}
+
+	return SCARD_ERR(E_READER_UNSUPPORTED);
+}
+
+/**
+ * @brief Read the CCID class descriptor from the device, and keep it for the selected instance
+ * @note CCID_Start calls this function when the descriptor is not known yet (see CCID_LoadProfile), there is no need to call it again unless the device has changed
+ * @return SCARD_S_SUCCESS success
+ * @return Other code if the device has no (valid) CCID class descriptor, or if a communication error has occured
+ */
+LONG CCID_LIB(ReadClassDescriptor)(void)
+{
+	BYTE abDescriptor[CCID_INTERFACE_DESCRIPTOR_MAX_LENGTH];
+	DWORD dwDescriptorLength = sizeof(abDescriptor);
+	BYTE bInstance = CCID_LIB(GetInstance)();
+	LONG rc;
+
+	ccid_descriptor_valid[bInstance] = FALSE;
+
+	/* The CCID class descriptor follows the interface descriptor */
+	rc = CCID_LIB(GetDescriptor)(CCID_DESCRIPTOR_TYPE_INTERFACE, 0, abDescriptor, &dwDescriptorLength);
+	if (rc != SCARD_ERR(S_SUCCESS))
+		return rc;
+
+	rc = CCID_LIB(ParseClassDescriptor)(abDescriptor, dwDescriptorLength, &ccid_descriptor[bInstance]);
+	if (rc != SCARD_ERR(S_SUCCESS))
+		return rc;
+
+	D(printf("CCID: dwFeatures=%08lX, dwMaxCCIDMessageLength=%lu, dwMaxIFSD=%lu, dwDataRate=%lu\n",
+		ccid_descriptor[bInstance].dwFeatures,
+		ccid_descriptor[bInstance].dwMaxCCIDMessageLength,
+		ccid_descriptor[bInstance].dwMaxIFSD,
+		ccid_descriptor[bInstance].dwDataRate));
+
+	ccid_descriptor_valid[bInstance] = TRUE;
+	return rc;
+}
+
+/**
+ * @brief Get the CCID class descriptor of the selected instance, as read by CCID_ReadClassDescriptor
+ * @return SCARD_S_SUCCESS success
+ * @return SCARD_E_NOT_READY the descriptor has not been read (successfully) yet
+ */
+LONG CCID_LIB(GetClassDescriptor)(CCID_CLASS_DESCRIPTOR_ST* pDescriptor)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+
+	if (pDescriptor == NULL)
+		return SCARD_ERR(E_INVALID_PARAMETER);
+	if (!ccid_descriptor_valid[bInstance])
+		return SCARD_ERR(E_NOT_READY);
+
+	memcpy(pDescriptor, &ccid_descriptor[bInstance], sizeof(CCID_CLASS_DESCRIPTOR_ST));
+	return SCARD_ERR(S_SUCCESS);
+}
+
+/**
+ * @brief Return the dwFeatures of the device (see the CCID_FEATURE_xxx constants)
+ * @return 0 if the descriptor has not been read
+ */
+DWORD CCID_LIB(GetFeatures)(void)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+
+	if (!ccid_descriptor_valid[bInstance])
+		return 0;
+	return ccid_descriptor[bInstance].dwFeatures;
+}
+
+/**
+ * @brief Max length of the payload of a single CCID message, for both the device (dwMaxCCIDMessageLength) and our buffers (CCID_MAX_PAYLOAD_LENGTH)
+ * @note Longer APDUs must be chained (see SCARD_Transmit)
+ */
+DWORD CCID_LIB(MaxPayloadLength)(void)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+	DWORD dwMaxMessageLength;
+
+	if (!ccid_descriptor_valid[bInstance])
+		return CCID_MAX_PAYLOAD_LENGTH;
+
+	dwMaxMessageLength = ccid_descriptor[bInstance].dwMaxCCIDMessageLength;
+	if (dwMaxMessageLength <= CCID_HEADER_LENGTH)
+		return CCID_MAX_PAYLOAD_LENGTH; /* Not a sensible value */
+	if (dwMaxMessageLength - CCID_HEADER_LENGTH < CCID_MAX_PAYLOAD_LENGTH)
+		return dwMaxMessageLength - CCID_HEADER_LENGTH;
+
+	return CCID_MAX_PAYLOAD_LENGTH;
+}
+
+/**
+ * @brief Timeout for a BULK exchange that carries the given number of bytes to and from the card
+ * @note The device sends time extensions when the card is slow to answer; this only accounts for the transfer of the bytes at the default data rate (dwDataRate), about 10 bits per byte
+ */
+DWORD CCID_LIB(BulkTimeout)(DWORD dwCardBytes)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+	DWORD dwDataRate = 9600; /* ISO/IEC 7816-3 default, F=372 and D=1 at 3.57MHz */
+
+	if (ccid_descriptor_valid[bInstance] && (ccid_descriptor[bInstance].dwDataRate != 0))
+		dwDataRate = ccid_descriptor[bInstance].dwDataRate;
+
+	return BULK_TIMEOUT + (dwCardBytes * 10 * 1000) / dwDataRate;
+}
@@ -0,0 +1,230 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_discovery.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Discovery of the devices on a list of candidate ports, all probed at once
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_i.h"
+
+#if (CCID_MAX_INSTANCE_COUNT > 1)
+
+/* Once a device has answered, the others have this many times its response time to answer too... */
+#define CCID_DISCOVERY_RESPONSE_FACTOR 4
+/* ...but never less than this */
+#define CCID_DISCOVERY_MIN_TIMEOUT 50
+
+/**
+ * @internal
+ * @brief Probe up to CCID_MAX_INSTANCE_COUNT ports at once, one instance per port
+ * @note Every batch waits up to dwTimeoutMs for its first response: a device that has answered fast in a batch does not shorten the wait of the next one.
+ */
+static void ccid_discover_batch(CCID_DISCOVERY_ST aCandidates[], BYTE bCount, DWORD dwTimeoutMs)
+{
+	BYTE abPending[CCID_MAX_INSTANCE_COUNT];
+	BYTE bPendingCount = 0;
+	DWORD adwSentAt[CCID_MAX_INSTANCE_COUNT];
+	DWORD dwStart, dwWindow;
+	CCID_PACKET_ST packet;
+	LONG rc;
+
+	/* Send a Ping on every port */
+	for (BYTE i = 0; i < bCount; i++)
+	{
+		CCID_DISCOVERY_ST* candidate = &aCandidates[i];
+
+		candidate->fFound = FALSE;
+		candidate->fHasProfile = FALSE;
+		candidate->dwResponseTimeMs = 0;
+
+		CCID_LIB(SelectInstance)(i);
+		CCID_LIB(SerialInit)(candidate->szCommName);
+		if (!CCID_LIB(SerialOpen)())
+		{
+			candidate->lResult = SCARD_ERR(E_READER_UNAVAILABLE);
+			continue;
+		}
+
+		CCID_LIB(Init)();
+		CCID_LIB(PacketInit)(&packet);
+		packet.bEndpoint = CCID_COMM_CONTROL_TO_RDR;
+		packet.Header.p.bRequest = GET_STATUS;
+
+		adwSentAt[i] = CCID_LIB(GetTimeMs)();
+		rc = CCID_LIB(SerialSend)(&packet);
+		if (rc != SCARD_ERR(S_SUCCESS))
+		{
+			candidate->lResult = rc;
+			CCID_LIB(SerialClose)();
+			continue;
+		}
+
+		candidate->lResult = SCARD_ERR(E_TIMEOUT);
+		abPending[bPendingCount++] = i;
+	}
+
+	/* Collect the responses, in whatever order they come */
+	dwStart = CCID_LIB(GetTimeMs)();
+	dwWindow = dwTimeoutMs;
+
+	while (bPendingCount != 0)
+	{
+		DWORD dwElapsed = CCID_LIB(GetTimeMs)() - dwStart;
+		BYTE bInstance;
+		BYTE j;
+
+		if (dwElapsed >= dwWindow)
+			break;
+		if (!CCID_LIB(WaitWakeupMulti)(abPending, bPendingCount, dwWindow - dwElapsed, &bInstance))
+			break;
+
+		CCID_LIB(SelectInstance)(bInstance);
+		CCID_LIB(PacketInit)(&packet);
+		rc = CCID_LIB(SerialRecv)(&packet, 0);
+		while ((rc == SCARD_ERR(S_SUCCESS)) && (packet.bEndpoint == CCID_COMM_INTERRUPT_RDR_TO_PC))
+		{
+			/* A genuine coupler may notify a card that is already there before it answers: the response may be right behind */
+			CCID_LIB(PacketInit)(&packet);
+			rc = CCID_LIB(SerialRecv)(&packet, 0);
+		}
+		if ((rc == SCARD_ERR(E_TIMEOUT)) || (rc == SCARD_ERR(E_SERVICE_STOPPED)))
+			continue; /* Nothing complete yet */
+
+		if (rc == SCARD_ERR(S_SUCCESS))
+		{
+			if ((packet.bEndpoint == CCID_COMM_CONTROL_TO_PC) && (packet.Header.p.bRequest == GET_STATUS))
+			{
+				DWORD dwResponseTime = CCID_LIB(GetTimeMs)() - adwSentAt[bInstance];
+
+				aCandidates[bInstance].fFound = TRUE;
+				aCandidates[bInstance].dwResponseTimeMs = dwResponseTime;
+
+				/* Don't wait much longer for the others of this batch */
+				dwResponseTime *= CCID_DISCOVERY_RESPONSE_FACTOR;
+				if (dwResponseTime < CCID_DISCOVERY_MIN_TIMEOUT)
+					dwResponseTime = CCID_DISCOVERY_MIN_TIMEOUT;
+				dwElapsed = CCID_LIB(GetTimeMs)() - dwStart;
+				if (dwElapsed + dwResponseTime < dwWindow)
+					dwWindow = dwElapsed + dwResponseTime;
+			}
+			else
+			{
+				/* Something has answered, but not what we expect (neither the response nor a notification) */
+				rc = SCARD_ERR(E_READER_UNSUPPORTED);
+			}
+		}
+
+		aCandidates[bInstance].lResult = rc;
+
+		/* Done with this one */
+		for (j = 0; j < bPendingCount; j++)
+			if (abPending[j] == bInstance)
+				break;
+		abPending[j] = abPending[--bPendingCount];
+	}
+
+	/* What the profile cache knows about the devices we've found */
+	for (BYTE i = 0; i < bCount; i++)
+	{
+		CCID_LIB(SelectInstance)(i);
+		if (aCandidates[i].fFound)
+			aCandidates[i].fHasProfile = (CCID_LIB(LoadProfile)(&aCandidates[i].Profile) == SCARD_ERR(S_SUCCESS));
+		CCID_LIB(SerialClose)();
+	}
+}
+
+/**
+ * @brief Find the devices that answer on a list of candidate ports
+ * @note The ports are probed at once (CCID_MAX_INSTANCE_COUNT at a time): they are all opened, a Ping is sent to all of them, and the responses are collected as they come.
+ * Once a device has answered, the others of the batch are given CCID_DISCOVERY_RESPONSE_FACTOR times its response time to answer too, so the silent ports do not cost the whole timeout.
+ * @note This function uses the instances 0 to min(dwCandidateCount, CCID_MAX_INSTANCE_COUNT) - 1, and leaves their ports closed: it refuses to run if one of them has its port open. Instance 0 is selected on return.
+ * @param aCandidates IN: the ports (szCommName); OUT: what has been found on each of them
+ * @param dwCandidateCount number of candidates
+ * @param dwTimeoutMs how long to wait for the first device of each batch to answer
+ * @return SCARD_S_SUCCESS at least one device has been found
+ * @return SCARD_E_NO_READERS_AVAILABLE no device has been found
+ * @return SCARD_E_SHARING_VIOLATION an instance that discovery needs is in use (its port is open)
+ */
+LONG CCID_LIB(Discover)(CCID_DISCOVERY_ST aCandidates[], DWORD dwCandidateCount, DWORD dwTimeoutMs)
+{
+	BYTE bSelected = CCID_LIB(GetInstance)();
+	BOOL fFound = FALSE;
+
+	if ((aCandidates == NULL) && (dwCandidateCount != 0))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	/* Don't take the port of an instance from under its feet */
+	for (DWORD i = 0; (i < dwCandidateCount) && (i < CCID_MAX_INSTANCE_COUNT); i++)
+	{
+		CCID_LIB(SelectInstance)((BYTE) i);
+		if (CCID_LIB(SerialIsOpen)())
+		{
+			D(printf("Discovery: instance %lu is in use\n", i));
+			CCID_LIB(SelectInstance)(bSelected);
+			return SCARD_ERR(E_SHARING_VIOLATION);
+		}
+	}
+
+	for (DWORD dwOffset = 0; dwOffset < dwCandidateCount; dwOffset += CCID_MAX_INSTANCE_COUNT)
+	{
+		DWORD dwCount = dwCandidateCount - dwOffset;
+		if (dwCount > CCID_MAX_INSTANCE_COUNT)
+			dwCount = CCID_MAX_INSTANCE_COUNT;
+		ccid_discover_batch(&aCandidates[dwOffset], (BYTE) dwCount, dwTimeoutMs);
+	}
+
+	CCID_LIB(SelectInstance)(0);
+
+	for (DWORD i = 0; i < dwCandidateCount; i++)
+		if (aCandidates[i].fFound)
+			fFound = TRUE;
+
+	return fFound ? SCARD_ERR(S_SUCCESS) : SCARD_ERR(E_NO_READERS_AVAILABLE);
+}
+
+#endif
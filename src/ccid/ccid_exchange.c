@@ -59,7 +59,15 @@ typedef struct
 	BYTE bSequence;
 } CCID_SLOT_ST;
 
-static CCID_SLOT_ST ccid_slot[CCID_MAX_SLOT_COUNT];
+static CCID_SLOT_ST ccid_slot[CCID_MAX_INSTANCE_COUNT][CCID_MAX_SLOT_COUNT];
+
+/* Only one exchange at a time over the serial link of a device */
+static CCID_TICKET_LOCK_ST ccid_exchange_lock[CCID_MAX_INSTANCE_COUNT];
+
+#if (CCID_TIMELINE)
+CCID_TIMELINE_STAMPS_ST ccid_timeline_stamps[CCID_MAX_INSTANCE_COUNT];
+static CCID_EXCHANGE_TIMELINE_ST ccid_last_timeline[CCID_MAX_INSTANCE_COUNT];
+#endif
 
 /**
  * @brief Return the current sequence number for the given slot
@@ -67,7 +75,7 @@ static CCID_SLOT_ST ccid_slot[CCID_MAX_SLOT_COUNT];
 BYTE CCID_LIB(GetSequence)(BYTE bSlot)
 {
 	if (bSlot < CCID_MAX_SLOT_COUNT)
-		return ccid_slot[bSlot].bSequence;
+		return ccid_slot[CCID_LIB(GetInstance)()][bSlot].bSequence;
 	return (BYTE)-1;
 }
 
@@ -77,7 +85,7 @@ BYTE CCID_LIB(GetSequence)(BYTE bSlot)
 void CCID_LIB(NextSequence)(BYTE bSlot)
 {
 	if (bSlot < CCID_MAX_SLOT_COUNT)
-		ccid_slot[bSlot].bSequence++;
+		ccid_slot[CCID_LIB(GetInstance)()][bSlot].bSequence++;
 }
 
 /**
@@ -86,7 +94,7 @@ void CCID_LIB(NextSequence)(BYTE bSlot)
 void CCID_LIB(ResetSequences)(void)
 {
 	for (BYTE i = 0; i < CCID_MAX_SLOT_COUNT; i++)
-		ccid_slot[i].bSequence = 0;
+		ccid_slot[CCID_LIB(GetInstance)()][i].bSequence = 0;
 }
 
 /**
@@ -190,15 +198,21 @@ static LONG ccid_recv_to_slot_status(CCID_PACKET_ST* packet)
 }
 
 /**
+ * @internal
  * @brief Send a packet to the device, and expect a packet in response, within the given timeout
  */
-LONG CCID_LIB(Exchange)(CCID_PACKET_ST* packet, DWORD timeout_ms)
+static LONG ccid_exchange(CCID_PACKET_ST* packet, DWORD timeout_ms)
 {
 	LONG rc;
 	BYTE bEndpoint;
 	BYTE bSlot, bSequence;
 	WORD wIndex, wValue;
 	WORD wTimeExtension = 0;
+	DWORD dwWaitStartMs, dwElapsedMs;
+#if (CCID_HISTOGRAMS)
+	BYTE bRequest;
+	DWORD dwStartUs;
+#endif
 
 	if (packet == NULL)
 	{
@@ -212,6 +226,19 @@ LONG CCID_LIB(Exchange)(CCID_PACKET_ST* packet, DWORD timeout_ms)
 	bSlot = packet->Header.p.Data.BulkOut.bSlot;
 	bSequence = packet->Header.p.Data.BulkOut.bSequence;
 
+#if (CCID_HISTOGRAMS)
+	bRequest = packet->Header.p.bRequest;
+	dwStartUs = CCID_LIB(GetTimeUs)();
+#endif
+#if (CCID_TRACE)
+	/* Too many for a debug message, hence in the trace ring only */
+	CCID_LIB(Trace)(CCID_TRACE_EXCHANGE_BEGIN, (bEndpoint << 8) | packet->Header.p.bRequest, (bSlot << 8) | bSequence, packet->Header.p.Length.dw);
+#endif
+
+	ccid_stats_inc(CCID_LIB(GetInstance)(), dwExchanges);
+	if (bEndpoint == CCID_COMM_BULK_PC_TO_RDR)
+		ccid_stats_slot(CCID_LIB(GetInstance)(), bSlot, dwExchanges);
+
 	rc = CCID_LIB(SerialSend)(packet);
 	if (rc != SCARD_ERR(S_SUCCESS))
 	{
@@ -219,19 +246,26 @@ LONG CCID_LIB(Exchange)(CCID_PACKET_ST* packet, DWORD timeout_ms)
 		return rc;
 	}
 
+	/* The interrupts that come meanwhile do not restart the wait, only the time extensions do */
+	dwWaitStartMs = CCID_LIB(GetTimeMs)();
+
 again:
 
-	rc = CCID_LIB(SerialRecv)(packet, timeout_ms);
+	dwElapsedMs = CCID_LIB(GetTimeMs)() - dwWaitStartMs;
+	rc = CCID_LIB(SerialRecv)(packet, (dwElapsedMs < timeout_ms) ? (timeout_ms - dwElapsedMs) : 0);
 	if (rc != SCARD_ERR(S_SUCCESS))
-	{		
+	{
+		if ((rc == SCARD_ERR(E_TIMEOUT)) && (bEndpoint == CCID_COMM_BULK_PC_TO_RDR))
+			ccid_stats_slot(CCID_LIB(GetInstance)(), bSlot, dwTimeouts);
 		ccid_raise_error("Failed to receive packet from device");
 		return rc;
 	}
 
 	if (packet->bEndpoint == CCID_COMM_INTERRUPT_RDR_TO_PC)
 	{
-		/* This is not a response but an interrupt. We can discard it safely if we are in the middle of an exchange */
-		D(printf("Incoming Interrupt\n"));
+		/* This is not a response but an interrupt. We can discard it safely if we are in the middle of an exchange, SerialRecv has already kept track of the slot changes */
+		ccid_trace(CCID_TRACE_INTERRUPT_DROPPED, 0, 0, 0);
+		ccid_stats_inc(CCID_LIB(GetInstance)(), dwInterruptsDropped);
 		goto again;
 	}
 
@@ -248,6 +282,12 @@ again:
 				ccid_raise_error("Wrong index/value in response");
 				rc = SCARD_ERR(E_READER_UNSUPPORTED);
 			}
+#if (CCID_HISTOGRAMS)
+			else
+			{
+				ccid_histogram_record(CCID_LIB(GetInstance)(), bEndpoint, bRequest, bSlot, dwStartUs);
+			}
+#endif
 		break;
 
 		case CCID_COMM_BULK_PC_TO_RDR:
@@ -268,12 +308,29 @@ again:
 				{
 					/* This is a time extension */
 					wTimeExtension++;
-					D(printf("Time extension %d...\n", wTimeExtension));
+					ccid_stats_inc(CCID_LIB(GetInstance)(), dwTimeExtensions);
+					ccid_stats_slot(CCID_LIB(GetInstance)(), bSlot, dwTimeExtensions);
+					ccid_trace(CCID_TRACE_TIME_EXTENSION, bSlot, wTimeExtension, 0);
+					ccid_probe3(time_extension, CCID_LIB(GetInstance)(), bSlot, wTimeExtension);
+#if (CCID_TIMELINE)
+					ccid_timeline_stamps[CCID_LIB(GetInstance)()].dwTimeExtensions = wTimeExtension;
+#endif
 					if (wTimeExtension <= 120)
-						goto again;						
+					{
+						dwWaitStartMs = CCID_LIB(GetTimeMs)();
+						goto again;
+					}						
 					/* More than 2 minutes seems too much... */
 					rc = SCARD_ERR(F_WAITED_TOO_LONG);
 				}
+				else if ((packet->Header.p.Data.BulkIn.bSlotStatus & 0xC0) == 0x40)
+				{
+					ccid_stats_slot(CCID_LIB(GetInstance)(), bSlot, dwErrors);
+				}
+#if (CCID_HISTOGRAMS)
+				/* Once the command is over, after its time extensions */
+				ccid_histogram_record(CCID_LIB(GetInstance)(), bEndpoint, bRequest, bSlot, dwStartUs);
+#endif
 				CCID_LIB(NextSequence)(bSlot);				
 			}
 		break;
@@ -293,20 +350,137 @@ again:
 	return rc;
 }
 
+#if (CCID_TIMELINE)
 /**
- * @brief Wait and receive an interrupt (notification) packet from the device, within the given timeout
+ * @internal
+ * @brief Turn the moments of the exchange that has just ended into the durations of its stages
  */
-LONG CCID_LIB(WaitInterrupt)(CCID_PACKET_ST* packet, DWORD timeout_ms)
+static void ccid_timeline_breakdown(const CCID_TIMELINE_STAMPS_ST* pStamps, CCID_EXCHANGE_TIMELINE_ST* pTimeline)
 {
-	LONG rc;
-
-	if (packet == NULL)
+	const DWORD adwStamps[] =
 	{
-		ccid_raise_error("NULL packet in CCID_WaitInterrupt");
-		return SCARD_ERR(F_INTERNAL_ERROR);
+		pStamps->dwStartUs, pStamps->dwLockedUs, pStamps->dwTxBeginUs, pStamps->dwTxEndUs,
+		pStamps->dwRxFirstUs, pStamps->dwRxLastUs, pStamps->dwWokenUs, pStamps->dwReturnUs
+	};
+	DWORD adwStages[7];
+	DWORD dwPrevious = adwStamps[0];
+	BOOL fReached = TRUE;
+
+	/* A stage that has not been reached ends the timeline: it and the next ones are 0, only dwTotalUs covers the whole exchange */
+	for (BYTE i = 0; i < 7; i++)
+	{
+		DWORD dwDelta = adwStamps[i + 1] - dwPrevious;
+
+		if (fReached && (adwStamps[i + 1] == 0))
+			fReached = FALSE;
+		/* A moment before the previous one (e.g. the HAL has received the response before CCID_SerialSendBytes has returned) makes an empty stage, not a negative one */
+		adwStages[i] = 0;
+		if (fReached && (dwDelta != 0) && (dwDelta < 0x80000000UL))
+		{
+			adwStages[i] = dwDelta;
+			dwPrevious = adwStamps[i + 1];
+		}
 	}
 
-	rc = CCID_LIB(SerialRecv)(packet, timeout_ms);
+	pTimeline->dwStartUs = pStamps->dwStartUs;
+	pTimeline->dwQueueUs = adwStages[0];
+	pTimeline->dwEncodeUs = adwStages[1];
+	pTimeline->dwTxUs = adwStages[2];
+	pTimeline->dwDeviceUs = adwStages[3];
+	pTimeline->dwRxUs = adwStages[4];
+	pTimeline->dwWakeupUs = adwStages[5];
+	pTimeline->dwReturnUs = adwStages[6];
+	pTimeline->dwTotalUs = pStamps->dwReturnUs - pStamps->dwStartUs;
+	pTimeline->dwTimeExtensions = pStamps->dwTimeExtensions;
+}
+#endif
+
+/**
+ * @internal
+ * @brief Serialize the exchanges of concurrent callers, and keep the timeline of every one
+ */
+static LONG ccid_exchange_serialized(CCID_PACKET_ST* packet, DWORD timeout_ms, CCID_EXCHANGE_TIMELINE_ST* pTimeline)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+	CCID_TICKET_LOCK_ST* lock = &ccid_exchange_lock[bInstance];
+	LONG rc;
+#if (CCID_TIMELINE)
+	DWORD dwStartUs = CCID_LIB(GetTimeUs)();
+#else
+	(void) pTimeline;
+#endif
+
+	CCID_LIB(TicketLock)(lock);
+#if (CCID_TIMELINE)
+	memset(&ccid_timeline_stamps[bInstance], 0, sizeof(ccid_timeline_stamps[bInstance]));
+	ccid_timeline_stamps[bInstance].dwStartUs = dwStartUs;
+	ccid_timeline_stamp(bInstance, dwLockedUs);
+#endif
+	rc = ccid_exchange(packet, timeout_ms);
+	ccid_probe3(exchange_done, bInstance, packet->Header.p.bRequest, rc);
+	/* The exchange has cleared the wakeup: a notification it has received meanwhile must still end the wait of CCID_WaitInterrupt or CCID_WaitWakeupMulti */
+	if (ccid_peek_slot_changes(NULL))
+		ccid_wakeup(bInstance);
+#if (CCID_TRACE)
+	CCID_LIB(Trace)(CCID_TRACE_EXCHANGE_END, (DWORD) rc, 0, 0);
+#endif
+#if (CCID_TIMELINE)
+	ccid_timeline_stamp(bInstance, dwReturnUs);
+	ccid_timeline_breakdown(&ccid_timeline_stamps[bInstance], &ccid_last_timeline[bInstance]);
+	if (pTimeline != NULL)
+		*pTimeline = ccid_last_timeline[bInstance];
+#endif
+	CCID_LIB(TicketUnlock)(lock);
+
+	return rc;
+}
+
+/**
+ * @brief Send a packet to the device, and expect a packet in response, within the given timeout
+ * @note The exchanges requested by concurrent callers are serialized, in their order of arrival
+ */
+LONG CCID_LIB(Exchange)(CCID_PACKET_ST* packet, DWORD timeout_ms)
+{
+	return ccid_exchange_serialized(packet, timeout_ms, NULL);
+}
+
+#if (CCID_TIMELINE)
+/**
+ * @brief Same as CCID_Exchange, and tell where the time has gone: queue, encoding, TX, coupler and card, RX, wakeup of the caller, return
+ * @note The time that the exchange waits for the concurrent callers is in pTimeline->dwQueueUs. pTimeline may be NULL.
+ */
+LONG CCID_LIB(ExchangeEx)(CCID_PACKET_ST* packet, DWORD timeout_ms, CCID_EXCHANGE_TIMELINE_ST* pTimeline)
+{
+	return ccid_exchange_serialized(packet, timeout_ms, pTimeline);
+}
+
+/**
+ * @brief Get the timeline of the last exchange of the selected instance, whoever has called it (e.g. SCARD_Transmit)
+ * @note When several tasks share the instance, it may be the exchange of another task; use CCID_ExchangeEx then.
+ */
+void CCID_LIB(GetLastTimeline)(CCID_EXCHANGE_TIMELINE_ST* pTimeline)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+	CCID_TICKET_LOCK_ST* lock = &ccid_exchange_lock[bInstance];
+
+	if (pTimeline == NULL)
+		return;
+
+	CCID_LIB(TicketLock)(lock);
+	*pTimeline = ccid_last_timeline[bInstance];
+	CCID_LIB(TicketUnlock)(lock);
+}
+#endif
+
+/**
+ * @internal
+ * @brief Retrieve the interrupt packet that the receiver holds, between two exchanges
+ */
+static LONG ccid_recv_interrupt(CCID_PACKET_ST* packet)
+{
+	LONG rc;
+
+	rc = CCID_LIB(SerialRecv)(packet, 0);
 	if (rc != SCARD_ERR(S_SUCCESS))
 	{
 		ccid_raise_error("Failed to receive Interrupt packet from device");
@@ -327,3 +501,78 @@ LONG CCID_LIB(WaitInterrupt)(CCID_PACKET_ST* packet, DWORD timeout_ms)
 	return rc;
 }
 
+/**
+ * @internal
+ * @brief Process the notification that the receiver holds between two exchanges, if any, so the slot changes are up to date without waiting for CCID_WaitInterrupt
+ */
+void ccid_drain_interrupt(void)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+	CCID_TICKET_LOCK_ST* lock = &ccid_exchange_lock[bInstance];
+	CCID_PACKET_ST packet;
+
+	if (!CCID_LIB(InterruptPending)())
+		return;
+
+	CCID_LIB(PacketInit)(&packet);
+
+	CCID_LIB(TicketLock)(lock);
+	if (CCID_LIB(InterruptPending)())
+		ccid_recv_interrupt(&packet);
+	/* The receiver has cleared the wakeup: a task in CCID_WaitInterrupt must still see the change */
+	if (ccid_peek_slot_changes(NULL))
+		ccid_wakeup(bInstance);
+	CCID_LIB(TicketUnlock)(lock);
+}
+
+/**
+ * @brief Wait and receive an interrupt (notification) packet from the device, within the given timeout
+ * @note The receiver is only read between the exchanges, under their lock, so that a concurrent exchange (e.g. SCARD_Transmit in another thread) never loses its response.
+ * A notification that such an exchange has received meanwhile ends the wait as well.
+ * @note The packet tells every slot change since the last report (it is rebuilt from the slot changes), and these changes are consumed: the next call waits for new ones, and CCID_GetSlotChanges does not report them again.
+ * Use CCID_DecodeInterrupt to read the packet.
+ * @param timeout_ms the timeout, in milliseconds ((DWORD) -1 for INFINITE); with 0, a notification that is still being received is not lost
+ */
+LONG CCID_LIB(WaitInterrupt)(CCID_PACKET_ST* packet, DWORD timeout_ms)
+{
+	CCID_TICKET_LOCK_ST* lock = &ccid_exchange_lock[CCID_LIB(GetInstance)()];
+	DWORD dwStartMs = CCID_LIB(GetTimeMs)();
+	DWORD dwElapsedMs;
+	LONG rc;
+
+	if (packet == NULL)
+	{
+		ccid_raise_error("NULL packet in CCID_WaitInterrupt");
+		return SCARD_ERR(F_INTERNAL_ERROR);
+	}
+
+	for (;;)
+	{
+		CCID_LIB(TicketLock)(lock);
+		/* Nobody waits for a response, what the receiver holds is for us. Clear the wakeup before looking, so a message that ends meanwhile is not missed */
+		CCID_LIB(ClearWakeup)();
+		rc = SCARD_ERR(E_TIMEOUT);
+		if (ccid_receiver_has_message())
+			rc = ccid_recv_interrupt(packet);
+		/* The changes received here and during the exchanges go out together, once */
+		if (((rc == SCARD_ERR(S_SUCCESS)) || (rc == SCARD_ERR(E_TIMEOUT))) && ccid_take_slot_changes(packet))
+			rc = SCARD_ERR(S_SUCCESS);
+		CCID_LIB(TicketUnlock)(lock);
+
+		if (rc != SCARD_ERR(E_TIMEOUT))
+			return rc;
+
+		/* No notification within the timeout is not an error of the driver */
+		dwElapsedMs = CCID_LIB(GetTimeMs)() - dwStartMs;
+		if ((timeout_ms != (DWORD) -1) && (dwElapsedMs >= timeout_ms))
+			return SCARD_ERR(E_TIMEOUT);
+
+		/* Woken by the receiver, or by the end of an exchange that has received a notification */
+		if (!CCID_LIB(WaitWakeup)((timeout_ms == (DWORD) -1) ? timeout_ms : (timeout_ms - dwElapsedMs)))
+		{
+			if (!SCARD_LIB(IsValidContext)())
+				return SCARD_ERR(E_SERVICE_STOPPED);
+		}
+	}
+}
+
@@ -58,6 +58,8 @@
 /* UART functions */
 /* -------------- */
 
+/* When the HAL supports several instances, these functions (and the synchronization functions) work on the instance selected by CCID_SelectInstance */
+
 /* Functions to be provided by the implementation */
 void CCID_LIB(SerialInit)(const char* szCommName);
 BOOL CCID_LIB(SerialIsOpen)(void);
@@ -66,8 +68,20 @@ void CCID_LIB(SerialClose)(void);
 BOOL CCID_LIB(SerialSendBytes)(const BYTE* abValue, DWORD dwLength);
 BOOL CCID_LIB(SerialSendByte)(BYTE bValue);
 
-/* Callback provided by the driver itself */
+/* Optional function, for the hosts where the comm port comes and goes (USB-serial adapters) */
+BOOL CCID_LIB(SerialWaitPort)(DWORD timeout_ms);
+
+/* Optional function, to put the link in a known state after a communication error (BREAK, DTR/RTS pulse if CCID_SERIAL_RESET_DTR, flush) */
+BOOL CCID_LIB(SerialReset)(void);
+
+/* Duration of the BREAK condition, long enough for any bit rate down to 9600bps */
+#define CCID_SERIAL_BREAK_MS 2
+
+/* Callbacks provided by the driver itself */
 void CCID_LIB(SerialRecvByteFromISR)(BYTE bValue);
+void CCID_LIB(InstanceRecvByteFromISR)(BYTE bInstance, BYTE bValue);
+void CCID_LIB(SerialRecvBytesFromISR)(const BYTE abValues[], DWORD dwLength);
+void CCID_LIB(InstanceRecvBytesFromISR)(BYTE bInstance, const BYTE abValues[], DWORD dwLength);
 
 /* Synchronization functions */
 /* ------------------------- */
@@ -79,4 +93,36 @@ void CCID_LIB(ClearWakeup)(void);
 /* Callback to be provide by the implementation */
 void CCID_LIB(WakeupFromISR)(void);
 
+#if (CCID_MAX_INSTANCE_COUNT > 1)
+/* Multi-instance functions, to be provided by the implementation when CCID_MAX_INSTANCE_COUNT > 1 */
+void CCID_LIB(InstanceWakeupFromISR)(BYTE bInstance);
+BOOL CCID_LIB(WaitWakeupMulti)(const BYTE abInstances[], BYTE bInstanceCount, DWORD timeout_ms, BYTE* pbInstance);
+#endif
+
+/* Time function */
+/* ------------- */
+
+/* Function to be provided by the implementation (milliseconds of a monotonic clock, wrapping around is OK) */
+DWORD CCID_LIB(GetTimeMs)(void);
+
+/* Optional function, needed only when CCID_CAPTURE, CCID_HISTOGRAMS, CCID_TRACE or CCID_TIMELINE is set (microseconds of a monotonic clock, wrapping around is OK) */
+DWORD CCID_LIB(GetTimeUs)(void);
+
+/* Locking functions */
+/* ----------------- */
+
+/* Functions to be provided by the implementation (a mutex and a condition, on a target without threads they do nothing) */
+void CCID_LIB(LockEnter)(void);
+void CCID_LIB(LockLeave)(void);
+void CCID_LIB(LockWait)(void);
+void CCID_LIB(LockNotifyAll)(void);
+DWORD CCID_LIB(GetCallerId)(void);
+
+/* Persistence functions */
+/* --------------------- */
+
+/* Functions to be provided by the implementation (keep the data of the selected instance, i.e. of its port, across restarts; return FALSE if there is no storage) */
+BOOL CCID_LIB(ProfileRead)(BYTE abData[], DWORD* pdwLength);
+BOOL CCID_LIB(ProfileWrite)(const BYTE abData[], DWORD dwLength);
+
 #endif
@@ -52,7 +52,11 @@
 
 #include "ccid_i.h"
 
-static BOOL ccid_valid;
+/* Selected by every thread for itself (see CCID_THREAD_LOCAL) */
+static CCID_THREAD_LOCAL BYTE ccid_instance;
+static BOOL ccid_valid[CCID_MAX_INSTANCE_COUNT];
+static BYTE ccid_slot_count[CCID_MAX_INSTANCE_COUNT];
+static BOOL ccid_initialized[CCID_MAX_INSTANCE_COUNT];
 
 /**
  * @internal
@@ -61,7 +65,34 @@ static BOOL ccid_valid;
 void ccid_raise_error(const char* msg)
 {
 	printf("\nError in CCID driver: %s\n", msg);
-	ccid_valid = FALSE;
+	ccid_stats_inc(ccid_instance, dwDriverErrors);
+	ccid_probe1(driver_error, ccid_instance);
+#if (CCID_TRACE)
+	/* The message is printed anyway */
+	CCID_LIB(Trace)(CCID_TRACE_DRIVER_ERROR, 0, 0, 0);
+#endif
+	ccid_valid[ccid_instance] = FALSE;
+}
+
+/**
+ * @brief Select the instance of the driver (i.e. the device) that the next calls of the calling thread will work with
+ * @note All the CCID_xxx and SCARD_xxx functions work with the selected instance. Every thread has its own selection (see CCID_THREAD_LOCAL), instance 0 is selected when a thread starts.
+ * @return FALSE if bInstance is not below CCID_MAX_INSTANCE_COUNT
+ */
+BOOL CCID_LIB(SelectInstance)(BYTE bInstance)
+{
+	if (bInstance >= CCID_MAX_INSTANCE_COUNT)
+		return FALSE;
+	ccid_instance = bInstance;
+	return TRUE;
+}
+
+/**
+ * @brief Return the instance of the driver that is currently selected by the calling thread
+ */
+BYTE CCID_LIB(GetInstance)(void)
+{
+	return ccid_instance;
 }
 
 /**
@@ -69,12 +100,12 @@ void ccid_raise_error(const char* msg)
  */
 BOOL CCID_LIB(IsValidDriver)(void)
 {
-	if (ccid_valid)
+	if (ccid_valid[ccid_instance])
 	{
 		if (!CCID_LIB(SerialIsOpen)())
-			ccid_valid = FALSE;
+			ccid_valid[ccid_instance] = FALSE;
 	}
-	return ccid_valid;
+	return ccid_valid[ccid_instance];
 }
 
 /**
@@ -83,7 +114,16 @@ BOOL CCID_LIB(IsValidDriver)(void)
 void CCID_LIB(Init)(void)
 {
 	ccid_reset_receiver();
-	ccid_valid = TRUE;
+	ccid_reset_slots();
+	ccid_reset_descriptor();
+	for (BYTE bSlot = 0; bSlot < CCID_MAX_SLOT_COUNT; bSlot++)
+		ccid_set_rejected_di(bSlot, 0);
+	ccid_slot_count[ccid_instance] = 0;
+	ccid_valid[ccid_instance] = TRUE;
+	/* The first Init is a connection, the next ones are reconnections */
+	if (ccid_initialized[ccid_instance])
+		ccid_stats_inc(ccid_instance, dwReconnects);
+	ccid_initialized[ccid_instance] = TRUE;
 }
 
 /**
@@ -104,12 +144,51 @@ LONG CCID_LIB(Ping)(void)
 	return rc;
 }
 
+/**
+ * @brief Bring the communication with the device back to a clean state after an error, and check that the device answers
+ * @note The HAL resets the link (CCID_SerialReset), so the framing state machine of the device restarts at once.
+ * If this function fails, the device must be left alone for at least 1200ms so it may reset its state machine by itself.
+ */
+LONG CCID_LIB(Recover)(void)
+{
+	LONG rc = SCARD_ERR(F_COMM_ERROR);
+
+	if (!CCID_LIB(SerialIsOpen)())
+		return SCARD_ERR(E_READER_UNAVAILABLE);
+
+	if (!CCID_LIB(SerialReset)())
+		return SCARD_ERR(E_UNSUPPORTED_FEATURE);
+
+	ccid_stats_inc(ccid_instance, dwRecoveries);
+
+	/* Whatever has been received before the reset is garbage */
+	ccid_reset_receiver();
+	CCID_LIB(ClearWakeup)();
+	ccid_valid[ccid_instance] = TRUE;
+
+	/* A response that was on its way during the reset may still arrive and fail the first exchange */
+	for (BYTE bRetry = 0; bRetry < RECOVER_PING_COUNT; bRetry++)
+	{
+		rc = CCID_LIB(Ping)();
+		if (rc == SCARD_ERR(S_SUCCESS))
+			break;
+
+		ccid_trace(CCID_TRACE_RECOVER_PING_FAILED, bRetry, rc, 0);
+		ccid_reset_receiver();
+		CCID_LIB(ClearWakeup)();
+		ccid_valid[ccid_instance] = TRUE;
+	}
+
+	return rc;
+}
+
 /**
  * @brief Start CCID (activate PC/SC operation in the device)
  */
 LONG CCID_LIB(Start)(BOOL fUseNotifications)
 {
 	CCID_PACKET_ST packet;
+	CCID_CLASS_DESCRIPTOR_ST descriptor;
 	LONG rc;
 
 	CCID_LIB(PacketInit)(&packet);
@@ -136,6 +215,18 @@ LONG CCID_LIB(Start)(BOOL fUseNotifications)
 	/* Reset the sequence numbers */
 	CCID_LIB(ResetSequences)();
 
+	if ((rc == SCARD_ERR(S_SUCCESS)) && (CCID_LIB(GetClassDescriptor)(&descriptor) != SCARD_ERR(S_SUCCESS)))
+	{
+		/* Learn what the device is able to do (unless a profile has told us already). Without the descriptor, we keep on with the defaults */
+		LONG rc2 = CCID_LIB(ReadClassDescriptor)();
+		if (rc2 != SCARD_ERR(S_SUCCESS))
+		{
+			D(printf("Failed to read the CCID class descriptor (rc=%lX), using the defaults\n", rc2));
+			if (!CCID_LIB(IsValidDriver)())
+				rc = rc2;
+		}
+	}
+
 	return rc;
 }
 
@@ -210,6 +301,7 @@ LONG CCID_LIB(GetDescriptor)(BYTE bType, BYTE bIndex, BYTE abDescriptor[], DWORD
 
 /**
  * @brief Read the number of slots that a device has
+ * @note Within the limit of CCID_MAX_SLOT_COUNT: the slots of a larger device above it are ignored
  */
 LONG CCID_LIB(GetSlotCount)(BYTE* bSlotCount)
 {
@@ -237,10 +329,47 @@ LONG CCID_LIB(GetSlotCount)(BYTE* bSlotCount)
 		}
 		else
 		{
+			/* Remember the slot count, it drives the size of everything that is slot-related */
+			ccid_slot_count[ccid_instance] = ccid_clamp_slot_count(abRecvBuffer[1]);
 			if (bSlotCount != NULL)
-				*bSlotCount = abRecvBuffer[1];
+				*bSlotCount = ccid_slot_count[ccid_instance];
 		}
 	}
 
 	return rc;
 }
+
+/**
+ * @internal
+ * @brief Limit the slot count of a device to what the static buffers hold (CCID_MAX_SLOT_COUNT)
+ * @note The slots above the limit are ignored: they can be neither used nor watched, the others work as usual
+ */
+BYTE ccid_clamp_slot_count(DWORD dwSlotCount)
+{
+	if (dwSlotCount > CCID_MAX_SLOT_COUNT)
+	{
+		D(printf("The device has %lu slots, this build of the driver uses the first %d (see CCID_MAX_SLOT_COUNT)\n", dwSlotCount, CCID_MAX_SLOT_COUNT));
+		return CCID_MAX_SLOT_COUNT;
+	}
+	return (BYTE) dwSlotCount;
+}
+
+/**
+ * @internal
+ * @brief Set the number of slots of the device (e.g. taken from a profile), instead of reading it from the device
+ */
+void ccid_set_slot_count(BYTE bSlotCount)
+{
+	ccid_slot_count[ccid_instance] = ccid_clamp_slot_count(bSlotCount);
+}
+
+/**
+ * @brief Return the number of slots of the device, as read by CCID_GetSlotCount, within the limit of CCID_MAX_SLOT_COUNT
+ * @return 0 if CCID_GetSlotCount has not been called (successfully) yet, and no profile has been loaded
+ */
+BYTE CCID_LIB(SlotCount)(void)
+{
+	if (ccid_slot_count[ccid_instance] > CCID_MAX_SLOT_COUNT)
+		return CCID_MAX_SLOT_COUNT;
+	return ccid_slot_count[ccid_instance];
+}
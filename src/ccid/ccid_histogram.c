@@ -0,0 +1,291 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_histogram.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Implementation of the CCID driver, latency histograms of the commands and of the slots
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_i.h"
+
+#define SUB_BUCKET_COUNT (1 << CCID_HISTOGRAM_SUB_BUCKET_BITS)
+
+static const char* ccid_histogram_command_names[CCID_HISTOGRAM_COMMAND_COUNT] =
+{
+	"GET_STATUS", "GET_DESCRIPTOR", "SET_CONFIGURATION", "OTHER_CONTROL",
+	"PC_TO_RDR_SETPARAMETERS", "PC_TO_RDR_ICCPOWERON", "PC_TO_RDR_ICCPOWEROFF", "PC_TO_RDR_GETSLOTSTATUS",
+	"PC_TO_RDR_ESCAPE", "PC_TO_RDR_GETPARAMETERS", "PC_TO_RDR_RESETPARAMETERS", "PC_TO_RDR_XFRBLOCK",
+	"PC_TO_RDR_SETDATARATEANDCLOCKFREQUENCY", "OTHER_BULK"
+};
+
+/**
+ * @brief Bucket of a latency, in microseconds
+ */
+BYTE CCID_LIB(HistogramBucket)(DWORD dwValueUs)
+{
+	BYTE bExponent = 0;
+
+	if (dwValueUs < SUB_BUCKET_COUNT)
+		return (BYTE) dwValueUs;
+
+	/* Position of the most significant bit */
+	for (DWORD x = dwValueUs; x > 1; x >>= 1)
+		bExponent++;
+
+	if (bExponent > CCID_HISTOGRAM_MAX_EXPONENT)
+		return CCID_HISTOGRAM_BUCKET_COUNT - 1;
+
+	/* The bits that follow the most significant one select the sub-bucket */
+	return (BYTE) (SUB_BUCKET_COUNT * (bExponent - CCID_HISTOGRAM_SUB_BUCKET_BITS + 1) + ((dwValueUs >> (bExponent - CCID_HISTOGRAM_SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1)));
+}
+
+/**
+ * @brief Lowest latency of a bucket, in microseconds
+ */
+DWORD CCID_LIB(HistogramBucketLowUs)(BYTE bBucket)
+{
+	BYTE bExponent;
+
+	if (bBucket < SUB_BUCKET_COUNT)
+		return bBucket;
+	if (bBucket >= CCID_HISTOGRAM_BUCKET_COUNT)
+		bBucket = CCID_HISTOGRAM_BUCKET_COUNT - 1;
+
+	bExponent = bBucket / SUB_BUCKET_COUNT + CCID_HISTOGRAM_SUB_BUCKET_BITS - 1;
+	return (DWORD) (SUB_BUCKET_COUNT + bBucket % SUB_BUCKET_COUNT) << (bExponent - CCID_HISTOGRAM_SUB_BUCKET_BITS);
+}
+
+/**
+ * @brief Highest latency of a bucket, in microseconds (the last bucket also holds everything that is longer)
+ */
+DWORD CCID_LIB(HistogramBucketHighUs)(BYTE bBucket)
+{
+	BYTE bExponent;
+
+	if (bBucket < SUB_BUCKET_COUNT)
+		return bBucket;
+	if (bBucket >= CCID_HISTOGRAM_BUCKET_COUNT)
+		bBucket = CCID_HISTOGRAM_BUCKET_COUNT - 1;
+
+	bExponent = bBucket / SUB_BUCKET_COUNT + CCID_HISTOGRAM_SUB_BUCKET_BITS - 1;
+	return CCID_LIB(HistogramBucketLowUs)(bBucket) + (1UL << (bExponent - CCID_HISTOGRAM_SUB_BUCKET_BITS)) - 1;
+}
+
+/**
+ * @brief Latency under which the given share of the samples are, in microseconds (e.g. 500 for the median, 999 for p99.9)
+ * @note The result is the upper bound of a bucket, but never more than the max
+ */
+DWORD CCID_LIB(HistogramPercentile)(const CCID_HISTOGRAM_ST* pHistogram, DWORD dwPerMille)
+{
+	DWORD dwRank, dwSeen = 0;
+
+	if ((pHistogram == NULL) || (pHistogram->dwCount == 0))
+		return 0;
+
+	if (dwPerMille > 1000)
+		dwPerMille = 1000;
+	/* The rank of the sample, 1-based, rounded up (in two parts, so that it does not overflow) */
+	dwRank = (pHistogram->dwCount / 1000) * dwPerMille + ((pHistogram->dwCount % 1000) * dwPerMille + 999) / 1000;
+	if (dwRank == 0)
+		dwRank = 1;
+
+	for (BYTE bBucket = 0; bBucket < CCID_HISTOGRAM_BUCKET_COUNT; bBucket++)
+	{
+		dwSeen += pHistogram->adwBuckets[bBucket];
+		if (dwSeen >= dwRank)
+		{
+			DWORD dwHighUs = CCID_LIB(HistogramBucketHighUs)(bBucket);
+			return (dwHighUs < pHistogram->dwMaxUs) ? dwHighUs : pHistogram->dwMaxUs;
+		}
+	}
+
+	return pHistogram->dwMaxUs;
+}
+
+/**
+ * @brief Add a histogram into another one (e.g. the same command over several instances, or over several intervals)
+ */
+void CCID_LIB(HistogramMerge)(CCID_HISTOGRAM_ST* pTo, const CCID_HISTOGRAM_ST* pFrom)
+{
+	if ((pTo == NULL) || (pFrom == NULL))
+		return;
+
+	pTo->dwCount += pFrom->dwCount;
+	if (pTo->dwMaxUs < pFrom->dwMaxUs)
+		pTo->dwMaxUs = pFrom->dwMaxUs;
+	for (BYTE bBucket = 0; bBucket < CCID_HISTOGRAM_BUCKET_COUNT; bBucket++)
+		pTo->adwBuckets[bBucket] += pFrom->adwBuckets[bBucket];
+}
+
+/**
+ * @brief Add all the histograms of an instance into those of another one
+ */
+void CCID_LIB(HistogramsMerge)(CCID_HISTOGRAMS_ST* pTo, const CCID_HISTOGRAMS_ST* pFrom)
+{
+	if ((pTo == NULL) || (pFrom == NULL))
+		return;
+
+	for (BYTE bCommand = 0; bCommand < CCID_HISTOGRAM_COMMAND_COUNT; bCommand++)
+		CCID_LIB(HistogramMerge)(&pTo->aCommands[bCommand], &pFrom->aCommands[bCommand]);
+	for (BYTE bSlot = 0; bSlot < CCID_MAX_SLOT_COUNT; bSlot++)
+		CCID_LIB(HistogramMerge)(&pTo->aSlots[bSlot], &pFrom->aSlots[bSlot]);
+}
+
+/**
+ * @brief Name of a command of the histograms (CCID_HISTOGRAM_COMMAND_xxx)
+ */
+const char* CCID_LIB(HistogramCommandName)(BYTE bCommand)
+{
+	if (bCommand >= CCID_HISTOGRAM_COMMAND_COUNT)
+		return "?";
+	return ccid_histogram_command_names[bCommand];
+}
+
+#if (CCID_HISTOGRAMS)
+
+static CCID_HISTOGRAMS_ST ccid_histograms[CCID_MAX_INSTANCE_COUNT];
+
+/**
+ * @internal
+ * @brief The histogram of a command
+ */
+static BYTE ccid_histogram_command(BYTE bEndpoint, BYTE bRequest)
+{
+	if (bEndpoint == CCID_COMM_CONTROL_TO_RDR)
+	{
+		switch (bRequest)
+		{
+			case GET_STATUS: return CCID_HISTOGRAM_COMMAND_GET_STATUS;
+			case GET_DESCRIPTOR: return CCID_HISTOGRAM_COMMAND_GET_DESCRIPTOR;
+			case SET_CONFIGURATION: return CCID_HISTOGRAM_COMMAND_SET_CONFIGURATION;
+			default: return CCID_HISTOGRAM_COMMAND_OTHER_CONTROL;
+		}
+	}
+
+	switch (bRequest)
+	{
+		case PC_TO_RDR_SETPARAMETERS: return CCID_HISTOGRAM_COMMAND_SETPARAMETERS;
+		case PC_TO_RDR_ICCPOWERON: return CCID_HISTOGRAM_COMMAND_ICCPOWERON;
+		case PC_TO_RDR_ICCPOWEROFF: return CCID_HISTOGRAM_COMMAND_ICCPOWEROFF;
+		case PC_TO_RDR_GETSLOTSTATUS: return CCID_HISTOGRAM_COMMAND_GETSLOTSTATUS;
+		case PC_TO_RDR_ESCAPE: return CCID_HISTOGRAM_COMMAND_ESCAPE;
+		case PC_TO_RDR_GETPARAMETERS: return CCID_HISTOGRAM_COMMAND_GETPARAMETERS;
+		case PC_TO_RDR_RESETPARAMETERS: return CCID_HISTOGRAM_COMMAND_RESETPARAMETERS;
+		case PC_TO_RDR_XFRBLOCK: return CCID_HISTOGRAM_COMMAND_XFRBLOCK;
+		case PC_TO_RDR_SETDATARATEANDCLOCKFREQUENCY: return CCID_HISTOGRAM_COMMAND_SETDATARATEANDCLOCKFREQUENCY;
+		default: return CCID_HISTOGRAM_COMMAND_OTHER_BULK;
+	}
+}
+
+/**
+ * @internal
+ * @brief Add a sample to a histogram
+ * @note The exchanges of an instance are serialized, so there is a single writer; the atomics are for the readers
+ */
+static void ccid_histogram_add(CCID_HISTOGRAM_ST* pHistogram, DWORD dwValueUs)
+{
+	ccid_atomic_add(&pHistogram->adwBuckets[CCID_LIB(HistogramBucket)(dwValueUs)], 1);
+	if (ccid_atomic_load(&pHistogram->dwMaxUs) < dwValueUs)
+		ccid_atomic_exchange(&pHistogram->dwMaxUs, dwValueUs);
+	ccid_atomic_add(&pHistogram->dwCount, 1);
+}
+
+/**
+ * @internal
+ * @brief A command has got its response: record the time since it has begun to be sent
+ */
+void ccid_histogram_record(BYTE bInstance, BYTE bEndpoint, BYTE bRequest, BYTE bSlot, DWORD dwStartUs)
+{
+	DWORD dwValueUs = CCID_LIB(GetTimeUs)() - dwStartUs;
+	CCID_HISTOGRAMS_ST* pHistograms = &ccid_histograms[bInstance];
+
+	ccid_histogram_add(&pHistograms->aCommands[ccid_histogram_command(bEndpoint, bRequest)], dwValueUs);
+	if ((bEndpoint == CCID_COMM_BULK_PC_TO_RDR) && (bSlot < CCID_MAX_SLOT_COUNT))
+		ccid_histogram_add(&pHistograms->aSlots[bSlot], dwValueUs);
+}
+
+/**
+ * @brief Snapshot of the latency histograms of the selected instance
+ * @param fReset TRUE to clear them meanwhile, so that the next snapshot covers the next interval only (no sample is lost nor counted twice)
+ * @note The count of a histogram may be behind its buckets by the sample that is being recorded
+ */
+void CCID_LIB(GetHistograms)(CCID_HISTOGRAMS_ST* pHistograms, BOOL fReset)
+{
+	CCID_LIB(GetInstanceHistograms)(CCID_LIB(GetInstance)(), pHistograms, fReset);
+}
+
+/**
+ * @brief Snapshot of the latency histograms of the given instance, whatever the selected one (e.g. from a monitoring thread)
+ * @note Takes no lock, see CCID_GetHistograms
+ */
+void CCID_LIB(GetInstanceHistograms)(BYTE bInstance, CCID_HISTOGRAMS_ST* pHistograms, BOOL fReset)
+{
+	DWORD* pdwFrom;
+	DWORD* pdwTo = (DWORD*) pHistograms;
+
+	if ((pHistograms == NULL) || (bInstance >= CCID_MAX_INSTANCE_COUNT))
+		return;
+
+	pdwFrom = (DWORD*) &ccid_histograms[bInstance];
+
+	/* The structure is nothing but DWORDs */
+	for (DWORD i = 0; i < sizeof(CCID_HISTOGRAMS_ST) / sizeof(DWORD); i++)
+		pdwTo[i] = fReset ? ccid_atomic_exchange(&pdwFrom[i], 0) : ccid_atomic_load(&pdwFrom[i]);
+}
+
+/**
+ * @brief Clear the latency histograms of the selected instance
+ */
+void CCID_LIB(ResetHistograms)(void)
+{
+	DWORD* pdwCounters = (DWORD*) &ccid_histograms[CCID_LIB(GetInstance)()];
+
+	for (DWORD i = 0; i < sizeof(CCID_HISTOGRAMS_ST) / sizeof(DWORD); i++)
+		ccid_atomic_exchange(&pdwCounters[i], 0);
+}
+
+#endif
@@ -60,10 +60,163 @@
 #include "../pcsc-serial.h"
 #include "ccid.h"
 #include "ccid_hal.h"
+#include "ccid_probes.h"
 #include "../scard/scard.h"
 
 void ccid_raise_error(const char* msg);
 void ccid_reset_receiver(void);
+BOOL ccid_receiver_has_message(void);
+
+void ccid_store_interrupt(const BYTE abPayload[], DWORD dwLength);
+BOOL ccid_peek_slot_changes(CCID_PACKET_ST* packet);
+BOOL ccid_take_slot_changes(CCID_PACKET_ST* packet);
+void ccid_drain_interrupt(void);
+void ccid_reset_slots(void);
+
+/* The HAL knows which instance to wake up only if it supports several of them */
+#if (CCID_MAX_INSTANCE_COUNT > 1)
+#define ccid_wakeup(bInstance) CCID_LIB(InstanceWakeupFromISR)(bInstance)
+#else
+#define ccid_wakeup(bInstance) CCID_LIB(WakeupFromISR)()
+#endif
+
+void ccid_reset_descriptor(void);
+void ccid_set_descriptor(const CCID_CLASS_DESCRIPTOR_ST* pDescriptor);
+void ccid_set_slot_count(BYTE bSlotCount);
+BYTE ccid_clamp_slot_count(DWORD dwSlotCount);
+WORD ccid_get_rejected_di(BYTE bSlot);
+void ccid_set_rejected_di(BYTE bSlot, WORD wRejectedDi);
+
+#if (CCID_CAPTURE)
+BOOL ccid_capture_begin(BYTE bInstance, BYTE bType, DWORD dwLength);
+void ccid_capture_append(BYTE bInstance, BYTE bType, const BYTE abData[], DWORD dwLength);
+void ccid_capture_commit(BYTE bInstance, BYTE bType);
+void ccid_capture_bytes(BYTE bInstance, BYTE bType, const BYTE abData[], DWORD dwLength);
+#endif
+
+/* The rings of the capture and of the trace are written by one side and read by the other, the barrier makes sure the data are there before the index says so */
+#if (defined(__GNUC__) || defined(__clang__))
+#define ccid_barrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#elif (defined(_MSC_VER))
+#define ccid_barrier() MemoryBarrier()
+#else
+#define ccid_barrier() do { } while (0)
+#endif
+
+/* The counters and the histograms are written by the ISR and by the callers, and read at any time; ccid_atomic_add returns the value before the add */
+#if (defined(__ARM_ARCH_6M__))
+/* No atomic read-modify-write on Cortex-M0: the fallback below masks the interrupts */
+#define ccid_atomic_add(p, n) ccid_fetch_add_dword((volatile DWORD*) (p), (n))
+#define ccid_atomic_load(p) (*(volatile const DWORD*) (p))
+#define ccid_atomic_exchange(p, n) ccid_exchange_dword((volatile DWORD*) (p), (n))
+#elif (defined(__GNUC__) || defined(__clang__))
+#define ccid_atomic_add(p, n) __atomic_fetch_add((p), (n), __ATOMIC_RELAXED)
+#define ccid_atomic_load(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define ccid_atomic_exchange(p, n) __atomic_exchange_n((p), (n), __ATOMIC_RELAXED)
+#elif (defined(_MSC_VER))
+#define ccid_atomic_add(p, n) InterlockedExchangeAdd((volatile LONG*) (p), (LONG) (n))
+#define ccid_atomic_load(p) (*(volatile const DWORD*) (p))
+#define ccid_atomic_exchange(p, n) ((DWORD) InterlockedExchange((volatile LONG*) (p), (LONG) (n)))
+#else
+#define ccid_atomic_add(p, n) ccid_fetch_add_dword((volatile DWORD*) (p), (n))
+#define ccid_atomic_load(p) (*(volatile const DWORD*) (p))
+#define ccid_atomic_exchange(p, n) ccid_exchange_dword((volatile DWORD*) (p), (n))
+#endif
+
+#if (defined(__ARM_ARCH_6M__) || !(defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)))
+#if (!defined(CCID_IRQ_SAVE))
+#if (defined(__ARM_ARCH_6M__) && (defined(__GNUC__) || defined(__clang__)))
+/* Same as save_and_disable_interrupts and restore_interrupts of the Pico SDK */
+static inline DWORD ccid_irq_save(void)
+{
+	DWORD dwPrimask;
+	__asm volatile ("mrs %0, primask\n\tcpsid i" : "=r" (dwPrimask) : : "memory");
+	return dwPrimask;
+}
+
+static inline void ccid_irq_restore(DWORD dwPrimask)
+{
+	__asm volatile ("msr primask, %0" : : "r" (dwPrimask) : "memory");
+}
+
+#define CCID_IRQ_SAVE() ccid_irq_save()
+#define CCID_IRQ_RESTORE(s) ccid_irq_restore(s)
+#else
+/* No way to mask the interrupts: every counter and the trace ring must have a single writer (see CCID_IRQ_SAVE in pcsc-serial.h) */
+#define CCID_IRQ_SAVE() 0
+#define CCID_IRQ_RESTORE(s) ((void) (s))
+#endif
+#endif
+
+/**
+ * @internal
+ * @brief Add n to *p and return the value before the add, with the interrupts masked (CCID_IRQ_SAVE), so an ISR may not slip between the read and the write
+ */
+static inline DWORD ccid_fetch_add_dword(volatile DWORD* p, DWORD n)
+{
+	DWORD dwState = CCID_IRQ_SAVE();
+	DWORD dwValue = *p;
+	*p = dwValue + n;
+	CCID_IRQ_RESTORE(dwState);
+	return dwValue;
+}
+
+/**
+ * @internal
+ * @brief Store n into *p and return the previous value, with the interrupts masked (CCID_IRQ_SAVE)
+ */
+static inline DWORD ccid_exchange_dword(volatile DWORD* p, DWORD n)
+{
+	DWORD dwState = CCID_IRQ_SAVE();
+	DWORD dwValue = *p;
+	*p = n;
+	CCID_IRQ_RESTORE(dwState);
+	return dwValue;
+}
+#endif
+
+#if (CCID_STATS)
+extern CCID_STATS_ST ccid_stats[CCID_MAX_INSTANCE_COUNT];
+#define ccid_stats_add(bInstance, counter, n) ccid_atomic_add(&ccid_stats[bInstance].Link.counter, (n))
+#define ccid_stats_inc(bInstance, counter) ccid_stats_add(bInstance, counter, 1)
+#define ccid_stats_slot(bInstance, bSlot, counter) do { if ((bSlot) < CCID_MAX_SLOT_COUNT) ccid_atomic_add(&ccid_stats[bInstance].aSlots[bSlot].counter, 1); } while (0)
+#else
+#define ccid_stats_add(bInstance, counter, n) do { } while (0)
+#define ccid_stats_inc(bInstance, counter) do { } while (0)
+#define ccid_stats_slot(bInstance, bSlot, counter) do { } while (0)
+#endif
+
+#if (CCID_TRACE)
+#define ccid_trace(wEvent, a0, a1, a2) CCID_LIB(Trace)((wEvent), (DWORD) (a0), (DWORD) (a1), (DWORD) (a2))
+#else
+/* Without the trace ring, the events are debug messages */
+#define ccid_trace(wEvent, a0, a1, a2) D(CCID_LIB(TracePrintEvent)((wEvent), (DWORD) (a0), (DWORD) (a1), (DWORD) (a2)))
+#endif
+
+#if (CCID_TIMELINE)
+/* The moments of the exchange in progress (see CCID_ExchangeEx), written by the caller (the RX ones come from the receiver that has held the response) */
+typedef struct
+{
+	DWORD dwStartUs;
+	DWORD dwLockedUs;
+	DWORD dwTxBeginUs;
+	DWORD dwTxEndUs;
+	DWORD dwRxFirstUs;
+	DWORD dwRxLastUs;
+	DWORD dwWokenUs;
+	DWORD dwReturnUs;
+	DWORD dwTimeExtensions;
+} CCID_TIMELINE_STAMPS_ST;
+
+extern CCID_TIMELINE_STAMPS_ST ccid_timeline_stamps[CCID_MAX_INSTANCE_COUNT];
+#define ccid_timeline_stamp(bInstance, field) (ccid_timeline_stamps[bInstance].field = CCID_LIB(GetTimeUs)())
+#else
+#define ccid_timeline_stamp(bInstance, field) do { } while (0)
+#endif
+
+#if (CCID_HISTOGRAMS)
+void ccid_histogram_record(BYTE bInstance, BYTE bEndpoint, BYTE bRequest, BYTE bSlot, DWORD dwStartUs);
+#endif
 
 void htoul(BYTE abBuffer[], DWORD dwValue);
 void htous(BYTE abBuffer[], WORD wValue);
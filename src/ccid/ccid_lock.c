@@ -0,0 +1,136 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_lock.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Fair locks, used to serialize the exchanges with a device and the transactions on a slot
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_i.h"
+
+/**
+ * @brief Take the lock, waiting behind the callers that have asked for it before (first come, first served)
+ * @note The owner may take the lock again; it must then call CCID_TicketUnlock as many times
+ */
+void CCID_LIB(TicketLock)(CCID_TICKET_LOCK_ST* lock)
+{
+	DWORD dwCaller = CCID_LIB(GetCallerId)();
+	DWORD dwTicket;
+
+	if (lock == NULL)
+		return;
+
+	CCID_LIB(LockEnter)();
+
+	if ((lock->dwDepth != 0) && (lock->dwOwner == dwCaller))
+	{
+		/* Already ours */
+		lock->dwDepth++;
+	}
+	else
+	{
+		/* Take a ticket and wait for our turn */
+		dwTicket = lock->dwNextTicket++;
+		while (lock->dwNowServing != dwTicket)
+			CCID_LIB(LockWait)();
+
+		lock->dwOwner = dwCaller;
+		lock->dwDepth = 1;
+	}
+
+	CCID_LIB(LockLeave)();
+}
+
+/**
+ * @brief Release the lock; when the owner releases it for the last time, it goes to the next caller in the queue
+ * @return FALSE if the caller does not own the lock
+ */
+BOOL CCID_LIB(TicketUnlock)(CCID_TICKET_LOCK_ST* lock)
+{
+	DWORD dwCaller = CCID_LIB(GetCallerId)();
+	BOOL fResult = FALSE;
+
+	if (lock == NULL)
+		return FALSE;
+
+	CCID_LIB(LockEnter)();
+
+	if ((lock->dwDepth != 0) && (lock->dwOwner == dwCaller))
+	{
+		fResult = TRUE;
+		if (--lock->dwDepth == 0)
+		{
+			/* Hand over to the next ticket */
+			lock->dwOwner = 0;
+			lock->dwNowServing++;
+			CCID_LIB(LockNotifyAll)();
+		}
+	}
+
+	CCID_LIB(LockLeave)();
+
+	return fResult;
+}
+
+/**
+ * @brief Return how many times the caller has taken the lock (0 if the caller is not the owner)
+ */
+DWORD CCID_LIB(TicketDepth)(CCID_TICKET_LOCK_ST* lock)
+{
+	DWORD dwCaller = CCID_LIB(GetCallerId)();
+	DWORD dwResult = 0;
+
+	if (lock == NULL)
+		return 0;
+
+	CCID_LIB(LockEnter)();
+	if (lock->dwOwner == dwCaller)
+		dwResult = lock->dwDepth;
+	CCID_LIB(LockLeave)();
+
+	return dwResult;
+}
@@ -0,0 +1,260 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_parameters.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Protocol parameters of a slot (CCID SetParameters, GetParameters, ResetParameters, SetDataRateAndClockFrequency)
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_i.h"
+
+/* The values of Di that the device has refused, one bit per value, for every slot */
+static WORD ccid_rejected_di[CCID_MAX_INSTANCE_COUNT][CCID_MAX_SLOT_COUNT];
+
+/**
+ * @internal
+ * @brief The values of Di that the device has refused for the given slot (one bit per value)
+ */
+WORD ccid_get_rejected_di(BYTE bSlot)
+{
+	if (bSlot >= CCID_MAX_SLOT_COUNT)
+		return 0;
+	return ccid_rejected_di[CCID_LIB(GetInstance)()][bSlot];
+}
+
+/**
+ * @internal
+ * @brief Set the values of Di that the device refuses for the given slot (e.g. taken from a profile)
+ */
+void ccid_set_rejected_di(BYTE bSlot, WORD wRejectedDi)
+{
+	if (bSlot < CCID_MAX_SLOT_COUNT)
+		ccid_rejected_di[CCID_LIB(GetInstance)()][bSlot] = wRejectedDi;
+}
+
+/**
+ * @internal
+ * @brief Prepare a BULK OUT packet for the given slot
+ */
+static void ccid_parameters_packet(CCID_PACKET_ST* packet, BYTE bRequest, BYTE bSlot)
+{
+	CCID_LIB(PacketInit)(packet);
+
+	packet->bEndpoint = CCID_COMM_BULK_PC_TO_RDR;
+	packet->Header.p.bRequest = bRequest;
+	packet->Header.p.Data.BulkOut.bSlot = bSlot;
+	packet->Header.p.Data.BulkOut.bSequence = CCID_LIB(GetSequence)(bSlot);
+}
+
+/**
+ * @internal
+ * @brief Process the RDR_to_PC_Parameters response
+ */
+static LONG ccid_parameters_response(CCID_PACKET_ST* packet, LONG rc, BYTE* pbProtocol, DWORD* pdwParametersLength)
+{
+	if (rc != SCARD_ERR(S_SUCCESS))
+		return rc;
+
+	if (packet->Header.p.bRequest != RDR_TO_PC_PARAMETERS)
+		return SCARD_ERR(E_READER_UNSUPPORTED);
+
+	if (pbProtocol != NULL)
+		*pbProtocol = packet->Header.p.Data.BulkIn.bStatusOrRfu;
+	if (pdwParametersLength != NULL)
+		*pdwParametersLength = packet->Header.p.Length.dw;
+
+	return rc;
+}
+
+/**
+ * @brief Read the protocol parameters that the device uses with the card in the given slot
+ * @param bSlot slot number
+ * @param pbProtocol OUT: the protocol (0 for T=0, 1 for T=1)
+ * @param abParameters buffer to receive the protocol data structure (bmFindexDindex, bmTCCKSTx, ...), at least CCID_PARAMETERS_T1_LENGTH bytes
+ * @param pdwParametersLength IN: the size of abParameters; OUT: the length of the protocol data structure
+ * @note This function is based on CCID PC_TO_RDR_GetParameters
+ */
+LONG CCID_LIB(GetParameters)(BYTE bSlot, BYTE* pbProtocol, BYTE abParameters[], DWORD* pdwParametersLength)
+{
+	CCID_PACKET_ST packet;
+	LONG rc;
+
+	if ((abParameters == NULL) || (pdwParametersLength == NULL))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	ccid_parameters_packet(&packet, PC_TO_RDR_GETPARAMETERS, bSlot);
+
+	packet.abRecvPayload = abParameters;
+	packet.dwRecvPayloadMaxLen = *pdwParametersLength;
+
+	rc = CCID_LIB(Exchange)(&packet, BULK_TIMEOUT);
+
+	return ccid_parameters_response(&packet, rc, pbProtocol, pdwParametersLength);
+}
+
+/**
+ * @brief Change the protocol parameters that the device uses with the card in the given slot
+ * @param bSlot slot number
+ * @param bProtocol the protocol (0 for T=0, 1 for T=1)
+ * @param abParameters the protocol data structure (CCID_PARAMETERS_T0_LENGTH or CCID_PARAMETERS_T1_LENGTH bytes)
+ * @param dwParametersLength length of abParameters
+ * @note If the device negotiates the parameters with the card by itself, changing bmFindexDindex triggers a PPS exchange with the card.
+ * @note A value of Di that the device has already refused (CCID_ERR_BAD_FIDI) is refused again without asking the device. This is kept in the profile (see CCID_SaveProfile).
+ * @note This function is based on CCID PC_TO_RDR_SetParameters
+ */
+LONG CCID_LIB(SetParameters)(BYTE bSlot, BYTE bProtocol, const BYTE abParameters[], DWORD dwParametersLength)
+{
+	CCID_PACKET_ST packet;
+	BYTE abRecvBuffer[CCID_PARAMETERS_T1_LENGTH];
+	WORD wDiBit;
+	LONG rc;
+
+	if (abParameters == NULL)
+		return SCARD_ERR(E_INVALID_PARAMETER);
+	if ((bProtocol == 0) && (dwParametersLength != CCID_PARAMETERS_T0_LENGTH))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+	if ((bProtocol == 1) && (dwParametersLength != CCID_PARAMETERS_T1_LENGTH))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+	if (bProtocol > 1)
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	wDiBit = 1 << (abParameters[0] & 0x0F);
+	if (ccid_get_rejected_di(bSlot) & wDiBit)
+		return SCARD_ERR(E_UNEXPECTED); /* We know the answer already */
+
+	ccid_parameters_packet(&packet, PC_TO_RDR_SETPARAMETERS, bSlot);
+	packet.Header.p.Data.BulkOut.bParam1 = bProtocol;
+
+	packet.abSendPayload = abParameters;
+	packet.Header.p.Length.dw = dwParametersLength;
+
+	/* The device returns the parameters actually in use */
+	packet.abRecvPayload = abRecvBuffer;
+	packet.dwRecvPayloadMaxLen = sizeof(abRecvBuffer);
+
+	rc = CCID_LIB(Exchange)(&packet, BULK_TIMEOUT);
+
+	if ((rc == SCARD_ERR(E_UNEXPECTED)) &&
+		((packet.Header.p.Data.BulkIn.bSlotStatus & 0xC0) == 0x40) &&
+		(packet.Header.p.Data.BulkIn.bSlotError == CCID_ERR_BAD_FIDI))
+	{
+		/* Remember that this Di is not supported by the device */
+		ccid_set_rejected_di(bSlot, ccid_get_rejected_di(bSlot) | wDiBit);
+	}
+
+	return ccid_parameters_response(&packet, rc, NULL, NULL);
+}
+
+/**
+ * @brief Restore the default protocol parameters (those of the ATR, with the default Fi/Di) for the card in the given slot
+ * @note This function is based on CCID PC_TO_RDR_ResetParameters
+ */
+LONG CCID_LIB(ResetParameters)(BYTE bSlot)
+{
+	CCID_PACKET_ST packet;
+	BYTE abRecvBuffer[CCID_PARAMETERS_T1_LENGTH];
+	LONG rc;
+
+	ccid_parameters_packet(&packet, PC_TO_RDR_RESETPARAMETERS, bSlot);
+
+	packet.abRecvPayload = abRecvBuffer;
+	packet.dwRecvPayloadMaxLen = sizeof(abRecvBuffer);
+
+	rc = CCID_LIB(Exchange)(&packet, BULK_TIMEOUT);
+
+	return ccid_parameters_response(&packet, rc, NULL, NULL);
+}
+
+/**
+ * @brief Set the clock frequency and the data rate of the card in the given slot
+ * @param bSlot slot number
+ * @param pdwClockFrequency IN: the requested clock frequency, in kHz; OUT: the clock frequency actually used
+ * @param pdwDataRate IN: the requested data rate, in bps; OUT: the data rate actually used
+ * @note This function is based on CCID PC_TO_RDR_SetDataRateAndClockFrequency
+ */
+LONG CCID_LIB(SetDataRateAndClockFrequency)(BYTE bSlot, DWORD* pdwClockFrequency, DWORD* pdwDataRate)
+{
+	CCID_PACKET_ST packet;
+	BYTE abSendBuffer[8];
+	BYTE abRecvBuffer[8];
+	LONG rc;
+
+	if ((pdwClockFrequency == NULL) || (pdwDataRate == NULL))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	htoul(&abSendBuffer[0], *pdwClockFrequency);
+	htoul(&abSendBuffer[4], *pdwDataRate);
+
+	ccid_parameters_packet(&packet, PC_TO_RDR_SETDATARATEANDCLOCKFREQUENCY, bSlot);
+
+	packet.abSendPayload = abSendBuffer;
+	packet.Header.p.Length.dw = sizeof(abSendBuffer);
+
+	packet.abRecvPayload = abRecvBuffer;
+	packet.dwRecvPayloadMaxLen = sizeof(abRecvBuffer);
+
+	rc = CCID_LIB(Exchange)(&packet, BULK_TIMEOUT);
+
+	if (rc == SCARD_ERR(S_SUCCESS))
+	{
+		if (packet.Header.p.bRequest != RDR_TO_PC_DATARATEANDCLOCKFREQUENCY)
+		{
+			rc = SCARD_ERR(E_READER_UNSUPPORTED);
+		}
+		else if (packet.Header.p.Length.dw != sizeof(abRecvBuffer))
+		{
+			rc = SCARD_ERR(E_READER_UNSUPPORTED);
+		}
+		else
+		{
+			*pdwClockFrequency = utohl(&abRecvBuffer[0]);
+			*pdwDataRate = utohl(&abRecvBuffer[4]);
+		}
+	}
+
+	return rc;
+}
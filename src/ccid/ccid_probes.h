@@ -0,0 +1,87 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_probes.h
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Static probes (USDT) of the CCID driver
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#ifndef __CCID_PROBES_H__
+#define __CCID_PROBES_H__
+
+/*
+ * With CCID_PROBES set, every stage of the protocol is a USDT probe of the 'ccid_serial' provider:
+ *
+ *   tx_begin(instance, endpoint, length)         the frame begins to go to the serial port
+ *   tx_end(instance, endpoint, length)           the frame has been handed to the serial port
+ *   rx_first(instance)                           the START byte of a frame has been received (ISR)
+ *   rx_frame(instance, endpoint, length)         a frame has been received, checksum OK (ISR)
+ *   rx_error(instance, status)                   the receiver has stopped on an error (ISR)
+ *   wakeup_signal(instance)                      the receiver wakes the waiting task up (ISR)
+ *   wakeup_observed(instance, woken)             the waiting task is back (woken is 0 on timeout)
+ *   time_extension(instance, slot, count)        the card asks for more time
+ *   interrupt(instance, length)                  a notification has been received
+ *   exchange_done(instance, message_type, rc)    the exchange is over, message_type is the one of the response
+ *   driver_error(instance)                       the driver has marked the instance invalid
+ *
+ * A probe that no tool is attached to is a single NOP, so they may stay in production builds. For instance:
+ *   bpftrace -e 'usdt:./ccid-serial:ccid_serial:tx_begin { @t[arg0] = nsecs; }
+ *                usdt:./ccid-serial:ccid_serial:rx_frame /@t[arg0]/ { @us = hist((nsecs - @t[arg0]) / 1000); }'
+ */
+
+#if (CCID_PROBES)
+#include <sys/sdt.h>
+#define ccid_probe1(name, a0) DTRACE_PROBE1(ccid_serial, name, a0)
+#define ccid_probe2(name, a0, a1) DTRACE_PROBE2(ccid_serial, name, a0, a1)
+#define ccid_probe3(name, a0, a1, a2) DTRACE_PROBE3(ccid_serial, name, a0, a1, a2)
+#else
+#define ccid_probe1(name, a0) do { } while (0)
+#define ccid_probe2(name, a0, a1) do { } while (0)
+#define ccid_probe3(name, a0, a1, a2) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,280 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_profile.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Device profile: what the driver has learnt about a device, kept across restarts to make the startup faster
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_i.h"
+
+/* 'CCPF', followed by the size of the structure, identifies a profile written by this version of the driver */
+#define CCID_PROFILE_MAGIC 0x43435046
+
+/* The string descriptors are UNICODE strings; keep one byte out of two (and skip the header) */
+static void ccid_profile_string(const BYTE abDescriptor[], DWORD dwLength, char szString[], DWORD dwMaxLength)
+{
+	DWORD j = 0;
+
+	for (DWORD i = 2; (i < dwLength) && (j < dwMaxLength); i += 2)
+		szString[j++] = (char) abDescriptor[i];
+	szString[j] = '\0';
+}
+
+/**
+ * @internal
+ * @brief Read what identifies the device: its device descriptor (VID, PID, firmware version), and its serial number if it has one
+ * @param abDeviceDescriptor OUT: the device descriptor (CCID_DEVICE_DESCRIPTOR_LENGTH bytes)
+ * @param szSerialNumber OUT: the serial number (CCID_PROFILE_SERIAL_NUMBER_LENGTH + 1 bytes), empty if the device has none
+ */
+static LONG ccid_profile_read_identity(BYTE abDeviceDescriptor[], char szSerialNumber[])
+{
+	BYTE abBuffer[2 + 2 * CCID_PROFILE_SERIAL_NUMBER_LENGTH];
+	DWORD dwLength;
+	LONG rc;
+
+	szSerialNumber[0] = '\0';
+
+	dwLength = CCID_DEVICE_DESCRIPTOR_LENGTH;
+	rc = CCID_LIB(GetDescriptor)(1, 0, abDeviceDescriptor, &dwLength);
+	if (rc != SCARD_ERR(S_SUCCESS))
+		return rc;
+	if (dwLength != CCID_DEVICE_DESCRIPTOR_LENGTH)
+		return SCARD_ERR(E_READER_UNSUPPORTED);
+
+	if (abDeviceDescriptor[16] != 0)
+	{
+		dwLength = sizeof(abBuffer);
+		rc = CCID_LIB(GetDescriptor)(3, abDeviceDescriptor[16], abBuffer, &dwLength);
+		if (rc == SCARD_ERR(S_SUCCESS))
+			ccid_profile_string(abBuffer, dwLength, szSerialNumber, CCID_PROFILE_SERIAL_NUMBER_LENGTH);
+		else if (!CCID_LIB(IsValidDriver)())
+			return rc;
+	}
+
+	return SCARD_ERR(S_SUCCESS);
+}
+
+/**
+ * @brief Load the profile of the device on the selected instance, and use it instead of asking the device
+ * @note Call this function after CCID_Init and before CCID_Start. When it succeeds, neither CCID_GetSlotCount nor the device and string descriptors are needed: Ping + Start are enough.
+ * @note The profile is stored per port, so it is checked against the device that is there now. This reads the CCID class descriptor, that CCID_Start then does not read again: a warm start costs no more exchanges than Ping + Start.
+ * If it differs from the stored one, another device (or another firmware, or configuration) is on the port now: the profile is removed, and the caller creates a new one.
+ * Only when there is no class descriptor to compare are the device descriptor and the serial number read and compared instead.
+ * A device of the same model and firmware that replaces the previous one on the port keeps its profile (what it holds is the same for both), but szSerialNumber is the one of the device that has created it.
+ * @param pProfile OUT: the profile (may be NULL)
+ * @return SCARD_S_SUCCESS success
+ * @return SCARD_E_NOT_READY there is no (valid) profile for this port, or it belongs to another device
+ * @return Other code if a communication error has occured
+ */
+LONG CCID_LIB(LoadProfile)(CCID_PROFILE_ST* pProfile)
+{
+	CCID_PROFILE_ST profile;
+	CCID_CLASS_DESCRIPTOR_ST descriptor;
+	BYTE abDeviceDescriptor[CCID_DEVICE_DESCRIPTOR_LENGTH];
+	char szSerialNumber[CCID_PROFILE_SERIAL_NUMBER_LENGTH + 1];
+	DWORD dwLength = sizeof(profile);
+	BOOL fHasDescriptor;
+	LONG rc;
+
+	if (!CCID_LIB(ProfileRead)((BYTE*) &profile, &dwLength))
+		return SCARD_ERR(E_NOT_READY);
+
+	if ((dwLength != sizeof(profile)) || (profile.dwMagic != CCID_PROFILE_MAGIC) || (profile.dwSize != sizeof(profile)))
+	{
+		D(printf("Profile: ignoring an invalid or outdated profile\n"));
+		return SCARD_ERR(E_NOT_READY);
+	}
+
+	profile.szSerialNumber[CCID_PROFILE_SERIAL_NUMBER_LENGTH] = '\0';
+
+	/* Is it still the same device? The class descriptor is the one CCID_Start would read anyway (both copies come from zeroed memory, so memcmp is fine) */
+	rc = CCID_LIB(ReadClassDescriptor)();
+	if ((rc != SCARD_ERR(S_SUCCESS)) && !CCID_LIB(IsValidDriver)())
+		return rc;
+	fHasDescriptor = (CCID_LIB(GetClassDescriptor)(&descriptor) == SCARD_ERR(S_SUCCESS));
+
+	if (fHasDescriptor && profile.fHasClassDescriptor)
+	{
+		if (memcmp(&descriptor, &profile.ClassDescriptor, sizeof(descriptor)))
+		{
+			D(printf("Profile: the device has changed (CCID class descriptor), forgetting the profile of device %s\n", profile.szSerialNumber));
+			CCID_LIB(ForgetProfile)();
+			return SCARD_ERR(E_NOT_READY);
+		}
+	}
+	else
+	{
+		/* Nothing to compare: only the full identity tells whether this is another device */
+		rc = ccid_profile_read_identity(abDeviceDescriptor, szSerialNumber);
+		if (rc != SCARD_ERR(S_SUCCESS))
+			return rc;
+
+		if (memcmp(abDeviceDescriptor, profile.abDeviceDescriptor, CCID_DEVICE_DESCRIPTOR_LENGTH) || strcmp(szSerialNumber, profile.szSerialNumber))
+		{
+			D(printf("Profile: device %s has replaced device %s, forgetting its profile\n", szSerialNumber, profile.szSerialNumber));
+			CCID_LIB(ForgetProfile)();
+			return SCARD_ERR(E_NOT_READY);
+		}
+
+		if (!fHasDescriptor && profile.fHasClassDescriptor)
+			ccid_set_descriptor(&profile.ClassDescriptor);
+	}
+
+	ccid_set_slot_count(profile.bSlotCount);
+	for (BYTE bSlot = 0; bSlot < CCID_MAX_SLOT_COUNT; bSlot++)
+		ccid_set_rejected_di(bSlot, profile.awRejectedDi[bSlot]);
+
+	D(printf("Profile: serial number %s, %d slot(s)\n", profile.szSerialNumber, profile.bSlotCount));
+
+	if (pProfile != NULL)
+		memcpy(pProfile, &profile, sizeof(profile));
+
+	return SCARD_ERR(S_SUCCESS);
+}
+
+/**
+ * @brief Build the profile of the device on the selected instance, asking the device what the driver does not know yet
+ * @note Call this function after CCID_Start (the slot count is read through SCARD_Control), then CCID_SaveProfile
+ * @param pProfile OUT: the profile
+ * @return SCARD_S_SUCCESS success
+ * @return Other code if a communication error has occured
+ */
+LONG CCID_LIB(CreateProfile)(CCID_PROFILE_ST* pProfile)
+{
+	BYTE bSlotCount;
+	LONG rc;
+
+	if (pProfile == NULL)
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	/* Not a valid profile until we are done */
+	memset(pProfile, 0, sizeof(CCID_PROFILE_ST));
+
+	/* Device descriptor (VID, PID, firmware version) and serial number: what LoadProfile checks */
+	rc = ccid_profile_read_identity(pProfile->abDeviceDescriptor, pProfile->szSerialNumber);
+	if (rc != SCARD_ERR(S_SUCCESS))
+		return rc;
+
+	/* CCID class descriptor */
+	if (CCID_LIB(GetClassDescriptor)(&pProfile->ClassDescriptor) != SCARD_ERR(S_SUCCESS))
+	{
+		CCID_LIB(ReadClassDescriptor)();
+		if (!CCID_LIB(IsValidDriver)())
+			return SCARD_ERR(F_COMM_ERROR);
+	}
+	pProfile->fHasClassDescriptor = (CCID_LIB(GetClassDescriptor)(&pProfile->ClassDescriptor) == SCARD_ERR(S_SUCCESS));
+
+	/* Slot count */
+	bSlotCount = CCID_LIB(SlotCount)();
+	if (bSlotCount == 0)
+	{
+		rc = CCID_LIB(GetSlotCount)(&bSlotCount);
+		if (rc != SCARD_ERR(S_SUCCESS))
+			return rc;
+	}
+	pProfile->bSlotCount = bSlotCount;
+
+	/* What the device has refused so far */
+	for (BYTE bSlot = 0; bSlot < CCID_MAX_SLOT_COUNT; bSlot++)
+		pProfile->awRejectedDi[bSlot] = ccid_get_rejected_di(bSlot);
+
+	pProfile->dwMagic = CCID_PROFILE_MAGIC;
+	pProfile->dwSize = sizeof(CCID_PROFILE_ST);
+
+	return SCARD_ERR(S_SUCCESS);
+}
+
+/**
+ * @brief Store the profile of the device on the selected instance, for the next startup
+ * @note What the driver has learnt since the profile has been created or loaded (e.g. the Fi/Di refused by the device) is added first. Nothing is written if the profile has not changed.
+ * @param pProfile IN/OUT: the profile, as returned by CCID_CreateProfile or CCID_LoadProfile
+ * @return SCARD_S_SUCCESS success
+ * @return SCARD_E_NOT_READY the profile could not be stored (e.g. no storage on this target)
+ */
+LONG CCID_LIB(SaveProfile)(CCID_PROFILE_ST* pProfile)
+{
+	BOOL fChanged = FALSE;
+
+	if (pProfile == NULL)
+		return SCARD_ERR(E_INVALID_PARAMETER);
+	if ((pProfile->dwMagic != CCID_PROFILE_MAGIC) || (pProfile->dwSize != sizeof(CCID_PROFILE_ST)))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	for (BYTE bSlot = 0; bSlot < CCID_MAX_SLOT_COUNT; bSlot++)
+	{
+		WORD wRejectedDi = ccid_get_rejected_di(bSlot);
+		if (pProfile->awRejectedDi[bSlot] != wRejectedDi)
+		{
+			pProfile->awRejectedDi[bSlot] = wRejectedDi;
+			fChanged = TRUE;
+		}
+	}
+
+	if (!fChanged)
+	{
+		/* Make sure it has been written at least once */
+		CCID_PROFILE_ST stored;
+		DWORD dwLength = sizeof(stored);
+
+		if (CCID_LIB(ProfileRead)((BYTE*) &stored, &dwLength) && (dwLength == sizeof(stored)) && !memcmp(&stored, pProfile, sizeof(stored)))
+			return SCARD_ERR(S_SUCCESS);
+	}
+
+	if (!CCID_LIB(ProfileWrite)((const BYTE*) pProfile, sizeof(CCID_PROFILE_ST)))
+		return SCARD_ERR(E_NOT_READY);
+
+	return SCARD_ERR(S_SUCCESS);
+}
+
+/**
+ * @brief Remove the profile of the device on the selected instance (e.g. the device has been replaced, or its firmware has been upgraded)
+ */
+void CCID_LIB(ForgetProfile)(void)
+{
+	CCID_LIB(ProfileWrite)(NULL, 0);
+}
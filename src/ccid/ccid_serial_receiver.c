@@ -72,19 +72,78 @@ typedef struct
 	DWORD dwOffset;
 	BYTE bChecksum;
 	BYTE abBuffer[CCID_HEADER_LENGTH + CCID_MAX_PAYLOAD_LENGTH];
+#if (CCID_TIMELINE)
+	DWORD dwFirstUs; /* START_BYTE of this message */
+	DWORD dwLastUs; /* Checksum of this message */
+#endif
 } CCID_RECEIVER_ST;
 
-static volatile BOOL ccid_receiver_error;
-static volatile BYTE ccid_receiver_push_index;
-static volatile BYTE ccid_receiver_pop_index;
-static CCID_RECEIVER_ST ccid_receivers[2];
+static volatile BOOL ccid_receiver_error[CCID_MAX_INSTANCE_COUNT];
+static volatile BYTE ccid_receiver_push_index[CCID_MAX_INSTANCE_COUNT];
+static volatile BYTE ccid_receiver_pop_index[CCID_MAX_INSTANCE_COUNT];
+static CCID_RECEIVER_ST ccid_receivers[CCID_MAX_INSTANCE_COUNT][2];
+/* The receivers are written by the ISR (or by the thread that reads the port): the task does not clear them, it asks the ISR to do so before its next byte */
+static volatile BYTE ccid_receiver_reset_request[CCID_MAX_INSTANCE_COUNT];
+static volatile BYTE ccid_receiver_reset_done[CCID_MAX_INSTANCE_COUNT];
+
+#define ccid_wakeup_from_isr(bInstance) do { ccid_probe1(wakeup_signal, bInstance); ccid_wakeup(bInstance); } while (0)
+
+/* Every message carries its own moments: the task decides whether they belong to the timeline of the exchange (see CCID_SerialRecv) */
+#if (CCID_TIMELINE)
+#define ccid_receiver_stamp(receiver, field) ((receiver)->field = CCID_LIB(GetTimeUs)())
+#else
+#define ccid_receiver_stamp(receiver, field) do { } while (0)
+#endif
 
+/**
+ * @internal
+ * @brief Drop whatever the receiver holds, and the error if some
+ * @note Safe while the ISR (or the thread that reads the port) is running: the receiver looks empty to the task at once, and is actually cleared by the ISR, before it processes its next byte
+ */
 void ccid_reset_receiver(void)
 {
-	ccid_receiver_error = FALSE;
-	ccid_receiver_push_index = 0;
-	ccid_receiver_pop_index = 0;
-	memset(ccid_receivers, 0, sizeof(ccid_receivers));
+	BYTE bInstance = CCID_LIB(GetInstance)();
+
+	ccid_receiver_pop_index[bInstance] = 0;
+	ccid_receiver_reset_request[bInstance]++;
+}
+
+/**
+ * @internal
+ * @brief Has the task asked for a reset that the ISR has not done yet? Then nothing in the receiver is worth anything
+ */
+static BOOL ccid_receiver_reset_pending(BYTE bInstance)
+{
+	return (ccid_receiver_reset_request[bInstance] != ccid_receiver_reset_done[bInstance]);
+}
+
+/**
+ * @internal
+ * @brief Do the reset that the task has asked for, if any (ISR side)
+ */
+static void ccid_receiver_apply_reset(BYTE bInstance)
+{
+	BYTE bRequest = ccid_receiver_reset_request[bInstance];
+
+	if (bRequest == ccid_receiver_reset_done[bInstance])
+		return;
+
+	ccid_receiver_error[bInstance] = FALSE;
+	ccid_receiver_push_index[bInstance] = 0;
+	memset(ccid_receivers[bInstance], 0, sizeof(ccid_receivers[bInstance]));
+	/* The task may look at the receiver again */
+	ccid_receiver_reset_done[bInstance] = bRequest;
+}
+
+/**
+ * @internal
+ * @brief Status of the receiver at the pop index, as the task sees it
+ */
+static BYTE ccid_receiver_status(BYTE bInstance)
+{
+	if (ccid_receiver_reset_pending(bInstance))
+		return STATUS_IDLE;
+	return ccid_receivers[bInstance][ccid_receiver_pop_index[bInstance] % 2].bStatus;
 }
 
 #if 0
@@ -100,48 +159,51 @@ static void dump_receiver(CCID_RECEIVER_ST* receiver)
 		printf("\tOffset is %lu, expected length is %lu\n", receiver->dwOffset, receiver->dwLength);
 }
 
-static void dump(void)
+static void dump(BYTE bInstance)
 {
-	printf("fError: %d\n", ccid_receiver_error);
-	printf("bPushIndex: %d\n", ccid_receiver_push_index);
-	printf("bPopIndex: %d\n", ccid_receiver_pop_index);
+	printf("fError: %d\n", ccid_receiver_error[bInstance]);
+	printf("bPushIndex: %d\n", ccid_receiver_push_index[bInstance]);
+	printf("bPopIndex: %d\n", ccid_receiver_pop_index[bInstance]);
 	printf("Receiver 0:\n");
-	dump_receiver(&ccid_receivers[0]);
+	dump_receiver(&ccid_receivers[bInstance][0]);
 	printf("Receiver 1:\n");
-	dump_receiver(&ccid_receivers[1]);
+	dump_receiver(&ccid_receivers[bInstance][1]);
 }
 #endif
 
 /**
- * @brief Callback invoked by the UART interrupt when a byte has been received
- * @note As the name says, this function is executed in the context of an ISR
+ * @internal
+ * @brief The state machine of the receiver, one byte at a time
  */
-void CCID_LIB(SerialRecvByteFromISR)(BYTE bValue)
+static void ccid_recv_byte(BYTE bInstance, BYTE bValue)
 {
 	CCID_RECEIVER_ST* receiver;
 
-	if (ccid_receiver_error)	
+	if (ccid_receiver_error[bInstance])
 		return; /* Stop receiving until the error is cleared */
 
 	/* Make sure we have a valid receiver */
-	ccid_receiver_push_index %= 2;
-	receiver = &ccid_receivers[ccid_receiver_push_index];
+	ccid_receiver_push_index[bInstance] %= 2;
+	receiver = &ccid_receivers[bInstance][ccid_receiver_push_index[bInstance]];
 
 	switch (receiver->bStatus)
 	{
 		case STATUS_IDLE:
 			if (bValue == START_BYTE)
 			{
-				/* This is the beginning of a serial CCID message */
-				memset(receiver, 0, sizeof(CCID_RECEIVER_ST));
+				/* This is the beginning of a serial CCID message (the next state initializes the receiver, and the buffer is written before it is read) */
 				receiver->bStatus = STATUS_RECV_ENDPOINT;
+				ccid_probe1(rx_first, bInstance);
+				ccid_receiver_stamp(receiver, dwFirstUs);
 			}
 			else
 			{
 				/* Invalid byte */
-				ccid_receiver_error = TRUE;
+				ccid_receiver_error[bInstance] = TRUE;
 				receiver->bStatus = STATUS_ERROR_PROTOCOL;
-				CCID_LIB(WakeupFromISR)();				
+				ccid_stats_inc(bInstance, dwErrorProtocol);
+				ccid_probe2(rx_error, bInstance, STATUS_ERROR_PROTOCOL);
+				ccid_wakeup_from_isr(bInstance);				
 			}
 		break;
 
@@ -165,9 +227,11 @@ void CCID_LIB(SerialRecvByteFromISR)(BYTE bValue)
 				if (dwLength > CCID_MAX_PAYLOAD_LENGTH)
 				{
 					/* Payload will not fit in our buffer */
-					ccid_receiver_error = TRUE;
+					ccid_receiver_error[bInstance] = TRUE;
 					receiver->bStatus = STATUS_ERROR_OVERFLOW;
-					CCID_LIB(WakeupFromISR)();
+					ccid_stats_inc(bInstance, dwErrorOverflow);
+					ccid_probe2(rx_error, bInstance, STATUS_ERROR_OVERFLOW);
+					ccid_wakeup_from_isr(bInstance);
 				}
 				else if (dwLength)
 				{
@@ -199,31 +263,156 @@ void CCID_LIB(SerialRecvByteFromISR)(BYTE bValue)
 			{
 				/* Checkum is OK */
 				receiver->bStatus = STATUS_READY;
+				ccid_stats_inc(bInstance, dwRxFrames);
+				ccid_probe3(rx_frame, bInstance, receiver->bEndpoint, receiver->dwLength - CCID_HEADER_LENGTH);
+				ccid_receiver_stamp(receiver, dwLastUs);
 				/* Toggle */
-				ccid_receiver_push_index = 1 - ccid_receiver_push_index;
+				ccid_receiver_push_index[bInstance] = 1 - ccid_receiver_push_index[bInstance];
 				/* Wakeup the application */
-				CCID_LIB(WakeupFromISR)();
+				ccid_wakeup_from_isr(bInstance);
 			}
 			else
 			{
-				ccid_receiver_error = TRUE;
+				ccid_receiver_error[bInstance] = TRUE;
 				receiver->bStatus = STATUS_ERROR_CHECKSUM;
-				CCID_LIB(WakeupFromISR)();
+				ccid_stats_inc(bInstance, dwErrorChecksum);
+				ccid_probe2(rx_error, bInstance, STATUS_ERROR_CHECKSUM);
+				ccid_wakeup_from_isr(bInstance);
 			}
 		break;
 
 		case STATUS_READY:
-			ccid_receiver_error = TRUE;			
+			ccid_receiver_error[bInstance] = TRUE;			
 			receiver->bStatus = STATUS_ERROR_OVERRUN;
-			CCID_LIB(WakeupFromISR)();
+			ccid_stats_inc(bInstance, dwErrorOverrun);
+			ccid_probe2(rx_error, bInstance, STATUS_ERROR_OVERRUN);
+			ccid_wakeup_from_isr(bInstance);
 		break;
 
 		default:
 			receiver->bStatus = STATUS_ERROR_UNEXPECTED;
-			CCID_LIB(WakeupFromISR)();
+			ccid_stats_inc(bInstance, dwErrorUnexpected);
+			ccid_probe2(rx_error, bInstance, STATUS_ERROR_UNEXPECTED);
+			ccid_wakeup_from_isr(bInstance);
 	}
 }
 
+/**
+ * @brief Callback invoked by the UART interrupt when a byte has been received
+ * @note As the name says, this function is executed in the context of an ISR
+ */
+void CCID_LIB(SerialRecvByteFromISR)(BYTE bValue)
+{
+	CCID_LIB(InstanceRecvByteFromISR)(0, bValue);
+}
+
+/**
+ * @brief Callback invoked by the UART interrupt of the given instance when a byte has been received
+ * @note As the name says, this function is executed in the context of an ISR. It does not depend on the instance selected by CCID_SelectInstance.
+ */
+void CCID_LIB(InstanceRecvByteFromISR)(BYTE bInstance, BYTE bValue)
+{
+	if (bInstance >= CCID_MAX_INSTANCE_COUNT)
+		return;
+
+#if (CCID_CAPTURE)
+	ccid_capture_bytes(bInstance, CCID_CAPTURE_RX, &bValue, 1);
+#endif
+	ccid_stats_inc(bInstance, dwRxBytes);
+
+	ccid_receiver_apply_reset(bInstance);
+	ccid_recv_byte(bInstance, bValue);
+}
+
+/**
+ * @brief Callback invoked by the UART interrupt when several bytes have been received (FIFO or DMA)
+ * @note As the name says, this function is executed in the context of an ISR
+ */
+void CCID_LIB(SerialRecvBytesFromISR)(const BYTE abValues[], DWORD dwLength)
+{
+	CCID_LIB(InstanceRecvBytesFromISR)(0, abValues, dwLength);
+}
+
+/**
+ * @brief Callback invoked by the UART interrupt of the given instance when several bytes have been received (FIFO or DMA)
+ * @note Same as calling CCID_InstanceRecvByteFromISR for every byte, but the header and the payload are copied at once
+ */
+void CCID_LIB(InstanceRecvBytesFromISR)(BYTE bInstance, const BYTE abValues[], DWORD dwLength)
+{
+	if (bInstance >= CCID_MAX_INSTANCE_COUNT)
+		return;
+
+#if (CCID_CAPTURE)
+	/* The tap records what is on the wire, even what the receiver drops */
+	ccid_capture_bytes(bInstance, CCID_CAPTURE_RX, abValues, dwLength);
+#endif
+	ccid_stats_add(bInstance, dwRxBytes, dwLength);
+
+	ccid_receiver_apply_reset(bInstance);
+
+	while (dwLength)
+	{
+		CCID_RECEIVER_ST* receiver;
+		DWORD dwCount;
+
+		if (ccid_receiver_error[bInstance])
+			return; /* Stop receiving until the error is cleared */
+
+		ccid_receiver_push_index[bInstance] %= 2;
+		receiver = &ccid_receivers[bInstance][ccid_receiver_push_index[bInstance]];
+
+		if ((receiver->bStatus == STATUS_RECV_HEADER) || (receiver->bStatus == STATUS_RECV_PAYLOAD))
+		{
+			/* Copy all the bytes but the last one of the header or of the payload, that changes the state */
+			dwCount = receiver->dwLength - receiver->dwOffset - 1;
+			if (dwCount > dwLength)
+				dwCount = dwLength;
+			if (dwCount)
+			{
+				BYTE bChecksum = receiver->bChecksum;
+				memcpy(&receiver->abBuffer[receiver->dwOffset], abValues, dwCount);
+				for (DWORD i = 0; i < dwCount; i++)
+					bChecksum ^= abValues[i];
+				receiver->bChecksum = bChecksum;
+				receiver->dwOffset += dwCount;
+				abValues += dwCount;
+				dwLength -= dwCount;
+				continue;
+			}
+		}
+
+		ccid_recv_byte(bInstance, *abValues++);
+		dwLength--;
+	}
+}
+
+/**
+ * @brief Is there a whole notification in the receiver, that CCID_WaitInterrupt would return at once?
+ * @note A cheap test, that neither waits nor takes the lock of the exchanges
+ */
+BOOL CCID_LIB(InterruptPending)(void)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+	CCID_RECEIVER_ST* receiver = &ccid_receivers[bInstance][ccid_receiver_pop_index[bInstance] % 2];
+
+	return (ccid_receiver_status(bInstance) == STATUS_READY) && (receiver->bEndpoint == CCID_COMM_INTERRUPT_RDR_TO_PC);
+}
+
+/**
+ * @internal
+ * @brief Is there a whole message, or an error, that CCID_SerialRecv would return at once (a message that is still being received is not)?
+ */
+BOOL ccid_receiver_has_message(void)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+
+	if (ccid_receiver_reset_pending(bInstance))
+		return FALSE;
+	if (ccid_receiver_error[bInstance])
+		return TRUE;
+	return (ccid_receiver_status(bInstance) >= STATUS_READY);
+}
+
 /**
  * @brief Retrieve the last packet received from the coupler.
  * @note This function blocks until a message is available are a timeout occurs.
@@ -231,31 +420,42 @@ void CCID_LIB(SerialRecvByteFromISR)(BYTE bValue)
 LONG CCID_LIB(SerialRecv)(CCID_PACKET_ST* packet, DWORD timeout_ms)
 {
 	LONG rc = SCARD_ERR(S_SUCCESS);
+	BYTE bInstance = CCID_LIB(GetInstance)();
 	CCID_RECEIVER_ST* receiver;
+	BYTE bStatus;
 
 	if (packet == NULL)
 		return SCARD_ERR(E_INVALID_PARAMETER);
 
-	ccid_receiver_pop_index %= 2;
-	receiver = &ccid_receivers[ccid_receiver_pop_index];
+	ccid_receiver_pop_index[bInstance] %= 2;
+	receiver = &ccid_receivers[bInstance][ccid_receiver_pop_index[bInstance]];
 
 	CCID_LIB(ClearWakeup)();
 		
-	if (receiver->bStatus != STATUS_READY)
+	bStatus = ccid_receiver_status(bInstance);
+	if (bStatus != STATUS_READY)
 	{
-		/* Wait until a message arrives */
-		if (!CCID_LIB(WaitWakeup)(timeout_ms))
+		/* Wait until a message arrives (it may have been completed right at the timeout) */
+		BOOL fWoken = CCID_LIB(WaitWakeup)(timeout_ms);
+
+		ccid_probe2(wakeup_observed, bInstance, fWoken);
+		bStatus = ccid_receiver_status(bInstance);
+		if (!fWoken && (bStatus != STATUS_READY))
 		{
 			if (!SCARD_LIB(IsValidContext)())
 				rc = SCARD_ERR(E_SERVICE_STOPPED); /* Stopped */
 			else
+			{
 				rc = SCARD_ERR(E_TIMEOUT); /* Timeout */
+				ccid_stats_inc(bInstance, dwTimeouts);
+			}
 		}
 	}
+	ccid_timeline_stamp(bInstance, dwWokenUs);
 
 	if (rc == SCARD_ERR(S_SUCCESS))
 	{
-		switch (receiver->bStatus)
+		switch (bStatus)
 		{
 			case STATUS_READY:
 				/* This is the expected situation */
@@ -280,14 +480,23 @@ LONG CCID_LIB(SerialRecv)(CCID_PACKET_ST* packet, DWORD timeout_ms)
 		}
 	}
 
-	if (ccid_receiver_error)
+	if (ccid_receiver_error[bInstance] && !ccid_receiver_reset_pending(bInstance))
 	{
 		/* Make sure the application knows there is an error */
 		if (rc == SCARD_ERR(S_SUCCESS))
 			rc = SCARD_ERR(F_UNKNOWN_ERROR);
 
-		/* Cleanup */
+		/* Cleanup (both receivers are idle, and the indexes are back to the first one) */
 		ccid_reset_receiver();
+		return rc;
+	}
+
+	if (bStatus != STATUS_READY)
+	{
+		/* Nothing to retrieve. A message that has begun but has not been completed in time is lost: drop it, otherwise the next one would land behind it */
+		if (bStatus != STATUS_IDLE)
+			ccid_reset_receiver();
+		return rc;
 	}
 
 	if (rc == SCARD_ERR(S_SUCCESS))
@@ -302,7 +511,27 @@ LONG CCID_LIB(SerialRecv)(CCID_PACKET_ST* packet, DWORD timeout_ms)
 			packet->Header.p.Data.Control.Index.w = utohs(packet->Header.p.Data.Control.Index.ab);
 		}
 
-		if (packet->Header.p.Length.dw)
+#if (CCID_TIMELINE)
+		if (packet->bEndpoint != CCID_COMM_INTERRUPT_RDR_TO_PC)
+		{
+			/* A response: the last one of the exchange (after its time extensions) is the one that stays in the timeline. A notification is not part of it */
+			ccid_timeline_stamps[bInstance].dwRxFirstUs = receiver->dwFirstUs;
+			ccid_timeline_stamps[bInstance].dwRxLastUs = receiver->dwLastUs;
+		}
+#endif
+
+		if (packet->bEndpoint == CCID_COMM_INTERRUPT_RDR_TO_PC)
+		{
+			/* Keep track of the slot changes whoever the caller is, so none is lost */
+			ccid_stats_inc(bInstance, dwInterrupts);
+			ccid_probe2(interrupt, bInstance, packet->Header.p.Length.dw);
+			ccid_store_interrupt(&receiver->abBuffer[CCID_HEADER_LENGTH], packet->Header.p.Length.dw);
+
+			/* The caller may not be interested in the payload (e.g. the interrupt arrives during an exchange) */
+			if ((packet->abRecvPayload != NULL) && (packet->dwRecvPayloadMaxLen >= packet->Header.p.Length.dw))
+				memcpy(packet->abRecvPayload, &receiver->abBuffer[CCID_HEADER_LENGTH], packet->Header.p.Length.dw);
+		}
+		else if (packet->Header.p.Length.dw)
 		{
 			if ((packet->abRecvPayload == NULL) || (packet->dwRecvPayloadMaxLen < packet->Header.p.Length.dw))
 			{
@@ -318,7 +547,7 @@ LONG CCID_LIB(SerialRecv)(CCID_PACKET_ST* packet, DWORD timeout_ms)
 	/* This receiver is ready to receive again */
 	receiver->bStatus = STATUS_IDLE;
 	/* And next time we'll read the other */
-	ccid_receiver_pop_index = 1 - ccid_receiver_pop_index;
+	ccid_receiver_pop_index[bInstance] = 1 - ccid_receiver_pop_index[bInstance];
 
 	return rc;
 }
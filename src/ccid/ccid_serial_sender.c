@@ -83,6 +83,27 @@ LONG CCID_LIB(SerialSend)(CCID_PACKET_ST* packet)
 		for (i = 0; i < dwSendPayloadLength; i++)
 			bChecksum ^= packet->abSendPayload[i];
 
+#if (CCID_CAPTURE)
+	/* The tap records the frame once, stamped when it begins to go on the wire */
+	if (ccid_capture_begin(CCID_LIB(GetInstance)(), CCID_CAPTURE_TX, 2 + CCID_HEADER_LENGTH + dwSendPayloadLength + 1))
+	{
+		BYTE bInstance = CCID_LIB(GetInstance)();
+		BYTE abPrefix[2];
+
+		abPrefix[0] = START_BYTE;
+		abPrefix[1] = packet->bEndpoint;
+		ccid_capture_append(bInstance, CCID_CAPTURE_TX, abPrefix, 2);
+		ccid_capture_append(bInstance, CCID_CAPTURE_TX, packet->Header.u, CCID_HEADER_LENGTH);
+		if (packet->abSendPayload != NULL)
+			ccid_capture_append(bInstance, CCID_CAPTURE_TX, packet->abSendPayload, dwSendPayloadLength);
+		ccid_capture_append(bInstance, CCID_CAPTURE_TX, &bChecksum, 1);
+		ccid_capture_commit(bInstance, CCID_CAPTURE_TX);
+	}
+#endif
+
+	ccid_probe3(tx_begin, CCID_LIB(GetInstance)(), packet->bEndpoint, dwSendPayloadLength);
+	ccid_timeline_stamp(CCID_LIB(GetInstance)(), dwTxBeginUs);
+
 	if (!CCID_LIB(SerialSendByte)(START_BYTE))
 		return SCARD_ERR(F_COMM_ERROR);
 	if (!CCID_LIB(SerialSendByte)(packet->bEndpoint))
@@ -95,5 +116,10 @@ LONG CCID_LIB(SerialSend)(CCID_PACKET_ST* packet)
 	if (!CCID_LIB(SerialSendByte)(bChecksum))
 		return SCARD_ERR(F_COMM_ERROR);
 
+	ccid_probe3(tx_end, CCID_LIB(GetInstance)(), packet->bEndpoint, dwSendPayloadLength);
+	ccid_timeline_stamp(CCID_LIB(GetInstance)(), dwTxEndUs);
+	ccid_stats_inc(CCID_LIB(GetInstance)(), dwTxFrames);
+	ccid_stats_add(CCID_LIB(GetInstance)(), dwTxBytes, 2 + CCID_HEADER_LENGTH + dwSendPayloadLength + 1);
+
 	return SCARD_ERR(S_SUCCESS);
 }
@@ -0,0 +1,315 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_slots.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Slot sets, decoding of the CCID interrupt (NotifySlotChange) payload
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_i.h"
+
+/* Present slots, as last reported by the device */
+static CCID_SLOT_SET_ST ccid_slots_present[CCID_MAX_INSTANCE_COUNT];
+/* Slots that have changed since the last call to CCID_GetSlotChanges */
+static CCID_SLOT_SET_ST ccid_slots_changed[CCID_MAX_INSTANCE_COUNT];
+/* Slots where the card has been removed or replaced since the last call to CCID_TakeSlotChange for them */
+static CCID_SLOT_SET_ST ccid_slots_stale[CCID_MAX_INSTANCE_COUNT];
+
+/**
+ * @brief Empty a slot set
+ */
+void CCID_LIB(SlotSetClear)(CCID_SLOT_SET_ST* set)
+{
+	if (set != NULL)
+		memset(set, 0, sizeof(CCID_SLOT_SET_ST));
+}
+
+/**
+ * @brief Add a slot into a slot set
+ */
+void CCID_LIB(SlotSetAdd)(CCID_SLOT_SET_ST* set, BYTE bSlot)
+{
+	if ((set != NULL) && (bSlot < CCID_MAX_SLOT_COUNT))
+		set->adwSlots[bSlot / 32] |= 1UL << (bSlot % 32);
+}
+
+/**
+ * @brief Remove a slot from a slot set
+ */
+void CCID_LIB(SlotSetRemove)(CCID_SLOT_SET_ST* set, BYTE bSlot)
+{
+	if ((set != NULL) && (bSlot < CCID_MAX_SLOT_COUNT))
+		set->adwSlots[bSlot / 32] &= ~(1UL << (bSlot % 32));
+}
+
+/**
+ * @brief Return TRUE if the slot belongs to the slot set
+ */
+BOOL CCID_LIB(SlotSetContains)(const CCID_SLOT_SET_ST* set, BYTE bSlot)
+{
+	if ((set == NULL) || (bSlot >= CCID_MAX_SLOT_COUNT))
+		return FALSE;
+	return (set->adwSlots[bSlot / 32] & (1UL << (bSlot % 32))) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Return TRUE if the slot set is empty
+ */
+BOOL CCID_LIB(SlotSetIsEmpty)(const CCID_SLOT_SET_ST* set)
+{
+	if (set == NULL)
+		return TRUE;
+	for (DWORD i = 0; i < CCID_SLOT_SET_LENGTH; i++)
+		if (set->adwSlots[i])
+			return FALSE;
+	return TRUE;
+}
+
+/**
+ * @internal
+ * @brief Gather the even bits of a DWORD into its lower 16 bits (bit 2n goes to bit n)
+ * The bmSlotICCState has 2 bits per slot, so this extracts 16 slots at once without any loop.
+ */
+static DWORD ccid_gather_even_bits(DWORD v)
+{
+	v &= 0x55555555;
+	v = (v | (v >> 1)) & 0x33333333;
+	v = (v | (v >> 2)) & 0x0F0F0F0F;
+	v = (v | (v >> 4)) & 0x00FF00FF;
+	v = (v | (v >> 8)) & 0x0000FFFF;
+	return v;
+}
+
+/**
+ * @brief Decode the payload of a RDR_to_PC_NotifySlotChange message (bmSlotICCState, 2 bits per slot)
+ * @param abPayload the payload of the interrupt message
+ * @param dwLength length of the payload; 4 slots are described by each byte
+ * @param pCovered OUT: the slots actually described by the payload (may be NULL)
+ * @param pPresent OUT: the slots where a card is present (may be NULL)
+ * @param pChanged OUT: the slots where the status has changed (may be NULL)
+ * @note The payload is processed 4 bytes (16 slots) at a time, so the cost only depends on its length
+ */
+void CCID_LIB(DecodeInterrupt)(const BYTE abPayload[], DWORD dwLength, CCID_SLOT_SET_ST* pCovered, CCID_SLOT_SET_ST* pPresent, CCID_SLOT_SET_ST* pChanged)
+{
+	DWORD dwSlotCount;
+
+	CCID_LIB(SlotSetClear)(pCovered);
+	CCID_LIB(SlotSetClear)(pPresent);
+	CCID_LIB(SlotSetClear)(pChanged);
+
+	if (abPayload == NULL)
+		return;
+
+	/* Slots actually described by the payload, within the limits of the device and of our buffers */
+	dwSlotCount = 4 * dwLength;
+	if ((CCID_LIB(SlotCount)() != 0) && (dwSlotCount > CCID_LIB(SlotCount)()))
+		dwSlotCount = CCID_LIB(SlotCount)();
+	if (dwSlotCount > CCID_MAX_SLOT_COUNT)
+		dwSlotCount = CCID_MAX_SLOT_COUNT;
+
+	for (DWORD dwFirstSlot = 0; dwFirstSlot < dwSlotCount; dwFirstSlot += 16)
+	{
+		BYTE abChunk[4] = { 0 };
+		DWORD dwChunk, dwMask;
+		DWORD dwWord = dwFirstSlot / 32;
+		DWORD dwShift = dwFirstSlot % 32;
+
+		/* 4 bytes of payload = 16 slots */
+		for (DWORD i = 0; (i < 4) && ((dwFirstSlot / 4) + i < dwLength); i++)
+			abChunk[i] = abPayload[(dwFirstSlot / 4) + i];
+		dwChunk = utohl(abChunk);
+
+		if (dwSlotCount - dwFirstSlot >= 16)
+			dwMask = 0x0000FFFF;
+		else
+			dwMask = (1UL << (dwSlotCount - dwFirstSlot)) - 1;
+
+		if (pCovered != NULL)
+			pCovered->adwSlots[dwWord] |= dwMask << dwShift;
+		if (pPresent != NULL)
+			pPresent->adwSlots[dwWord] |= (ccid_gather_even_bits(dwChunk) & dwMask) << dwShift;
+		if (pChanged != NULL)
+			pChanged->adwSlots[dwWord] |= (ccid_gather_even_bits(dwChunk >> 1) & dwMask) << dwShift;
+	}
+}
+
+/**
+ * @internal
+ * @brief Remember the content of an interrupt message, so no change is lost even if the message has been received in the middle of an exchange
+ */
+void ccid_store_interrupt(const BYTE abPayload[], DWORD dwLength)
+{
+	CCID_SLOT_SET_ST covered, present, changed;
+	CCID_SLOT_SET_ST* pPresent = &ccid_slots_present[CCID_LIB(GetInstance)()];
+	CCID_SLOT_SET_ST* pChanged = &ccid_slots_changed[CCID_LIB(GetInstance)()];
+	CCID_SLOT_SET_ST* pStale = &ccid_slots_stale[CCID_LIB(GetInstance)()];
+
+	CCID_LIB(DecodeInterrupt)(abPayload, dwLength, &covered, &present, &changed);
+
+#if (CCID_STATS)
+	for (BYTE bSlot = 0; bSlot < CCID_MAX_SLOT_COUNT; bSlot++)
+		if (CCID_LIB(SlotSetContains)(&changed, bSlot))
+			ccid_stats_slot(CCID_LIB(GetInstance)(), bSlot, dwChanges);
+#endif
+
+	for (DWORD i = 0; i < CCID_SLOT_SET_LENGTH; i++)
+	{
+		pPresent->adwSlots[i] = (pPresent->adwSlots[i] & ~covered.adwSlots[i]) | present.adwSlots[i];
+		pChanged->adwSlots[i] |= changed.adwSlots[i];
+		/* A slot that is reported empty has lost its card, even if the device does not flag it as changed */
+		pStale->adwSlots[i] |= changed.adwSlots[i] | (covered.adwSlots[i] & ~present.adwSlots[i]);
+	}
+}
+
+/**
+ * @brief Retrieve the slots that are present and the slots that have changed since the last call, as reported by the interrupts received so far
+ * @note This function does not communicate with the device. The changes that CCID_WaitInterrupt has reported are not reported again
+ * @return TRUE if at least one slot has changed
+ */
+BOOL CCID_LIB(GetSlotChanges)(CCID_SLOT_SET_ST* pPresent, CCID_SLOT_SET_ST* pChanged)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+	BOOL fChanged = !CCID_LIB(SlotSetIsEmpty)(&ccid_slots_changed[bInstance]);
+
+	if (pPresent != NULL)
+		*pPresent = ccid_slots_present[bInstance];
+	if (pChanged != NULL)
+		*pChanged = ccid_slots_changed[bInstance];
+
+	CCID_LIB(SlotSetClear)(&ccid_slots_changed[bInstance]);
+
+	return fChanged;
+}
+
+/**
+ * @brief Tell whether an interrupt has reported that the card in the slot has been removed or replaced since the last call for this slot
+ * @note The notification that the receiver holds between two exchanges, if any, is processed first.
+ * The changes are kept for CCID_GetSlotChanges and CCID_WaitInterrupt, so this does not hide anything from the application.
+ * @return TRUE if the card that was in the slot at the time of the last call may not be there anymore
+ */
+BOOL CCID_LIB(TakeSlotChange)(BYTE bSlot)
+{
+	CCID_SLOT_SET_ST* pStale = &ccid_slots_stale[CCID_LIB(GetInstance)()];
+	BOOL fChanged;
+
+	if (bSlot >= CCID_MAX_SLOT_COUNT)
+		return FALSE;
+
+	ccid_drain_interrupt();
+
+	fChanged = CCID_LIB(SlotSetContains)(pStale, bSlot);
+	CCID_LIB(SlotSetRemove)(pStale, bSlot);
+
+	return fChanged;
+}
+
+/**
+ * @internal
+ * @brief Same as ccid_peek_slot_changes, but the changes are consumed (for CCID_WaitInterrupt): CCID_GetSlotChanges will not report them again
+ */
+BOOL ccid_take_slot_changes(CCID_PACKET_ST* packet)
+{
+	if (!ccid_peek_slot_changes(packet))
+		return FALSE;
+
+	CCID_LIB(SlotSetClear)(&ccid_slots_changed[CCID_LIB(GetInstance)()]);
+	return TRUE;
+}
+
+/**
+ * @internal
+ * @brief If some slot has changed since the last call to CCID_GetSlotChanges, build the interrupt packet that tells so, as the device would have sent it
+ * @note The changes are kept for CCID_GetSlotChanges
+ * @param packet OUT: the interrupt packet (may be NULL, to only know whether some slot has changed)
+ * @return FALSE if no slot has changed
+ */
+BOOL ccid_peek_slot_changes(CCID_PACKET_ST* packet)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+	DWORD dwSlotCount = CCID_LIB(SlotCount)();
+	DWORD dwLength;
+
+	if (CCID_LIB(SlotSetIsEmpty)(&ccid_slots_changed[bInstance]))
+		return FALSE;
+	if (packet == NULL)
+		return TRUE;
+
+	if (dwSlotCount == 0)
+		dwSlotCount = CCID_MAX_SLOT_COUNT;
+	dwLength = (dwSlotCount + 3) / 4;
+
+	packet->bEndpoint = CCID_COMM_INTERRUPT_RDR_TO_PC;
+	packet->Header.p.bRequest = RDR_TO_PC_INTERRUPT;
+	packet->Header.p.Length.dw = dwLength;
+
+	if ((packet->abRecvPayload != NULL) && (packet->dwRecvPayloadMaxLen >= dwLength))
+	{
+		/* bmSlotICCState: 2 bits per slot, present then changed */
+		memset(packet->abRecvPayload, 0, dwLength);
+		for (BYTE bSlot = 0; bSlot < dwSlotCount; bSlot++)
+		{
+			if (CCID_LIB(SlotSetContains)(&ccid_slots_present[bInstance], bSlot))
+				packet->abRecvPayload[bSlot / 4] |= 0x01 << (2 * (bSlot % 4));
+			if (CCID_LIB(SlotSetContains)(&ccid_slots_changed[bInstance], bSlot))
+				packet->abRecvPayload[bSlot / 4] |= 0x02 << (2 * (bSlot % 4));
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * @internal
+ * @brief Forget everything we know about the slots
+ */
+void ccid_reset_slots(void)
+{
+	CCID_LIB(SlotSetClear)(&ccid_slots_present[CCID_LIB(GetInstance)()]);
+	CCID_LIB(SlotSetClear)(&ccid_slots_changed[CCID_LIB(GetInstance)()]);
+	/* The cards may have been reset or replaced while we were not listening */
+	memset(&ccid_slots_stale[CCID_LIB(GetInstance)()], 0xFF, sizeof(CCID_SLOT_SET_ST));
+}
@@ -0,0 +1,99 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_stats.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Implementation of the CCID driver, counters of the links and of the slots
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_i.h"
+
+#if (CCID_STATS)
+
+CCID_STATS_ST ccid_stats[CCID_MAX_INSTANCE_COUNT];
+
+/**
+ * @brief Snapshot of the counters of the selected instance (link and slots)
+ * @note Every counter is read atomically, but they are not all read at the same instant: a frame that is being received may already be in dwRxBytes and not yet in dwRxFrames
+ */
+void CCID_LIB(GetStats)(CCID_STATS_ST* pStats)
+{
+	CCID_LIB(GetInstanceStats)(CCID_LIB(GetInstance)(), pStats);
+}
+
+/**
+ * @brief Snapshot of the counters of the given instance, whatever the selected one (e.g. from a monitoring thread)
+ * @note Takes no lock, see CCID_GetStats
+ */
+void CCID_LIB(GetInstanceStats)(BYTE bInstance, CCID_STATS_ST* pStats)
+{
+	const DWORD* pdwFrom;
+	DWORD* pdwTo = (DWORD*) pStats;
+
+	if ((pStats == NULL) || (bInstance >= CCID_MAX_INSTANCE_COUNT))
+		return;
+
+	pdwFrom = (const DWORD*) &ccid_stats[bInstance];
+
+	/* The structure is nothing but DWORDs */
+	for (DWORD i = 0; i < sizeof(CCID_STATS_ST) / sizeof(DWORD); i++)
+		pdwTo[i] = ccid_atomic_load(&pdwFrom[i]);
+}
+
+/**
+ * @brief Clear the counters of the selected instance
+ * @note A count that happens meanwhile may be lost
+ */
+void CCID_LIB(ResetStats)(void)
+{
+	DWORD* pdwCounters = (DWORD*) &ccid_stats[CCID_LIB(GetInstance)()];
+
+	for (DWORD i = 0; i < sizeof(CCID_STATS_ST) / sizeof(DWORD); i++)
+		pdwCounters[i] = 0;
+}
+
+#endif
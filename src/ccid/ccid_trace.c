@@ -0,0 +1,254 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_trace.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Implementation of the CCID driver, binary trace of the events (a lock-free ring of fixed-size records, decoded on demand)
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_i.h"
+
+/**
+ * @internal
+ * @brief How to print the arguments of an event
+ */
+typedef struct
+{
+	WORD wEvent;
+	const char* szFormat; /* Always 3 unsigned long arguments */
+} CCID_TRACE_FORMAT_ST;
+
+static const CCID_TRACE_FORMAT_ST ccid_trace_formats[] =
+{
+	{ CCID_TRACE_EXCHANGE_BEGIN, "Exchange: endpoint/request %04lX, slot/sequence %04lX, %lu byte(s)" },
+	{ CCID_TRACE_EXCHANGE_END, "Exchange done: rc=%lX" },
+	{ CCID_TRACE_TIME_EXTENSION, "Time extension in slot %lu, %lu so far" },
+	{ CCID_TRACE_INTERRUPT_DROPPED, "Incoming Interrupt" },
+	{ CCID_TRACE_DRIVER_ERROR, "Error in CCID driver" },
+	{ CCID_TRACE_RECOVER_PING_FAILED, "CCID_Recover: ping %lu failed (rc=%lX)" },
+	{ CCID_TRACE_STATUS_CHANGE, "Interrupt, slots present: %08lX, slots changed: %08lX" },
+	{ CCID_TRACE_NO_WARM_RESET, "Warm reset not supported in slot %lu, using cold reset" }
+};
+
+/**
+ * @internal
+ * @brief Decode the event of a record, and its arguments
+ */
+static int ccid_trace_format_event(WORD wEvent, const DWORD adwArgs[], char szBuffer[], DWORD dwMaxLength)
+{
+	for (DWORD i = 0; i < sizeof(ccid_trace_formats) / sizeof(ccid_trace_formats[0]); i++)
+		if (ccid_trace_formats[i].wEvent == wEvent)
+			return snprintf(szBuffer, dwMaxLength, ccid_trace_formats[i].szFormat,
+				(unsigned long) adwArgs[0], (unsigned long) adwArgs[1], (unsigned long) adwArgs[2]);
+
+	return snprintf(szBuffer, dwMaxLength, "Event %04X: %08lX %08lX %08lX", wEvent,
+		(unsigned long) adwArgs[0], (unsigned long) adwArgs[1], (unsigned long) adwArgs[2]);
+}
+
+/**
+ * @brief Decode a record of the trace into a line of text (time, instance, event; without end of line)
+ * @return length of the text
+ */
+DWORD CCID_LIB(TraceFormat)(const CCID_TRACE_RECORD_ST* pRecord, char szBuffer[], DWORD dwMaxLength)
+{
+	int length, more;
+
+	if ((pRecord == NULL) || (szBuffer == NULL) || (dwMaxLength == 0))
+		return 0;
+
+	length = snprintf(szBuffer, dwMaxLength, "%10lu [%u] ", (unsigned long) pRecord->dwTimeUs, pRecord->bInstance);
+	if ((length < 0) || ((DWORD) length >= dwMaxLength))
+		return dwMaxLength - 1;
+
+	more = ccid_trace_format_event(pRecord->wEvent, pRecord->adwArgs, &szBuffer[length], dwMaxLength - length);
+	if ((more < 0) || ((DWORD) (length + more) >= dwMaxLength))
+		return dwMaxLength - 1;
+	return (DWORD) (length + more);
+}
+
+/**
+ * @brief Print an event right away (this is what the driver does with its events when there is no trace ring, and fVerbose is set)
+ */
+void CCID_LIB(TracePrintEvent)(WORD wEvent, DWORD dwArg0, DWORD dwArg1, DWORD dwArg2)
+{
+	DWORD adwArgs[CCID_TRACE_ARG_COUNT];
+	char szLine[128];
+
+	adwArgs[0] = dwArg0;
+	adwArgs[1] = dwArg1;
+	adwArgs[2] = dwArg2;
+
+	ccid_trace_format_event(wEvent, adwArgs, szLine, sizeof(szLine));
+	printf("%s\n", szLine);
+}
+
+#if (CCID_TRACE)
+
+#if (CCID_TRACE_RING_SIZE & (CCID_TRACE_RING_SIZE - 1))
+#error CCID_TRACE_RING_SIZE must be a power of 2
+#endif
+
+static CCID_TRACE_RECORD_ST ccid_trace_ring[CCID_TRACE_RING_SIZE];
+/* Next record to write: the writers take their place with an atomic increment, so they never wait for each other */
+static volatile DWORD ccid_trace_write_index;
+/* Next record to read (a single reader) */
+static DWORD ccid_trace_read_index;
+static volatile BOOL ccid_trace_enabled = TRUE;
+
+/**
+ * @brief Start or stop recording the events (they are recorded by default)
+ */
+void CCID_LIB(TraceEnable)(BOOL fEnable)
+{
+	ccid_trace_enabled = fEnable;
+}
+
+/**
+ * @brief Record an event into the trace ring (the oldest record is overwritten if the ring is full)
+ * @note Any thread may call it at any time, it never blocks. The application may record its own events, from CCID_TRACE_USER.
+ */
+void CCID_LIB(Trace)(WORD wEvent, DWORD dwArg0, DWORD dwArg1, DWORD dwArg2)
+{
+	CCID_TRACE_RECORD_ST* pRecord;
+	DWORD dwIndex;
+
+	if (!ccid_trace_enabled)
+		return;
+
+	dwIndex = ccid_atomic_add(&ccid_trace_write_index, 1);
+	pRecord = &ccid_trace_ring[dwIndex & (CCID_TRACE_RING_SIZE - 1)];
+
+	/* The reader ignores the record until its sequence says that it is complete */
+	ccid_atomic_exchange(&pRecord->dwSequence, 0);
+	ccid_barrier();
+	pRecord->dwTimeUs = CCID_LIB(GetTimeUs)();
+	pRecord->wEvent = wEvent;
+	pRecord->bInstance = CCID_LIB(GetInstance)();
+	pRecord->bRfu = 0;
+	pRecord->adwArgs[0] = dwArg0;
+	pRecord->adwArgs[1] = dwArg1;
+	pRecord->adwArgs[2] = dwArg2;
+	ccid_barrier();
+	ccid_atomic_exchange(&pRecord->dwSequence, dwIndex + 1);
+}
+
+/**
+ * @brief Retrieve the records of the trace that have not been read yet, oldest first
+ * @param pdwLost OUT: number of records that have been overwritten before they could be read (may be NULL)
+ * @return number of records copied into aRecords
+ * @note A single reader at a time. A record that is still being written is left for the next call.
+ */
+DWORD CCID_LIB(TraceRead)(CCID_TRACE_RECORD_ST aRecords[], DWORD dwMaxCount, DWORD* pdwLost)
+{
+	DWORD dwWriteIndex = ccid_atomic_load(&ccid_trace_write_index);
+	DWORD dwCount = 0, dwLost = 0;
+
+	if (aRecords == NULL)
+		dwMaxCount = 0;
+
+	/* The writers have gone round the ring */
+	if (dwWriteIndex - ccid_trace_read_index > CCID_TRACE_RING_SIZE)
+	{
+		dwLost += dwWriteIndex - ccid_trace_read_index - CCID_TRACE_RING_SIZE;
+		ccid_trace_read_index = dwWriteIndex - CCID_TRACE_RING_SIZE;
+	}
+
+	while ((ccid_trace_read_index != dwWriteIndex) && (dwCount < dwMaxCount))
+	{
+		CCID_TRACE_RECORD_ST* pRecord = &ccid_trace_ring[ccid_trace_read_index & (CCID_TRACE_RING_SIZE - 1)];
+		DWORD dwSequence = ccid_atomic_load(&pRecord->dwSequence);
+
+		if (dwSequence == 0)
+			break; /* Being written, try again later */
+
+		if (dwSequence == ccid_trace_read_index + 1)
+		{
+			ccid_barrier();
+			aRecords[dwCount] = *pRecord;
+			ccid_barrier();
+			/* Still the same record once copied? */
+			if (ccid_atomic_load(&pRecord->dwSequence) == dwSequence)
+				dwCount++;
+			else
+				dwLost++;
+		}
+		else
+		{
+			/* Overwritten meanwhile */
+			dwLost++;
+		}
+		ccid_trace_read_index++;
+	}
+
+	if (pdwLost != NULL)
+		*pdwLost = dwLost;
+	return dwCount;
+}
+
+/**
+ * @brief Print the records of the trace that have not been read yet (decoded)
+ */
+void CCID_LIB(TracePrint)(void)
+{
+	CCID_TRACE_RECORD_ST aRecords[16];
+	char szLine[160];
+	DWORD dwCount, dwLost;
+
+	do
+	{
+		dwCount = CCID_LIB(TraceRead)(aRecords, sizeof(aRecords) / sizeof(aRecords[0]), &dwLost);
+		if (dwLost)
+			printf("(%lu event(s) lost)\n", (unsigned long) dwLost);
+		for (DWORD i = 0; i < dwCount; i++)
+		{
+			CCID_LIB(TraceFormat)(&aRecords[i], szLine, sizeof(szLine));
+			printf("%s\n", szLine);
+		}
+	} while (dwCount == sizeof(aRecords) / sizeof(aRecords[0]));
+}
+
+#endif
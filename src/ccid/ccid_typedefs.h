@@ -121,4 +121,266 @@ typedef struct
 } CCID_PACKET_ST;
 #pragma pack()
 
+/**
+ * @brief Number of DWORDs in a CCID_SLOT_SET_ST (one bit per slot)
+ */
+#define CCID_SLOT_SET_LENGTH ((CCID_MAX_SLOT_COUNT + 31) / 32)
+
+/**
+ * @brief A set of slots, one bit per slot: slot n is bit (n % 32) of adwSlots[n / 32]
+ */
+typedef struct
+{
+	DWORD adwSlots[CCID_SLOT_SET_LENGTH];
+} CCID_SLOT_SET_ST;
+
+/**
+ * @brief A fair (first come, first served) lock, that the owner may take again (see CCID_TicketLock)
+ */
+typedef struct
+{
+	DWORD dwOwner;
+	DWORD dwDepth;
+	DWORD dwNextTicket;
+	DWORD dwNowServing;
+} CCID_TICKET_LOCK_ST;
+
+/**
+ * @brief The CCID class descriptor of the device (CCID specification, section 5.1), decoded (see CCID_GetClassDescriptor)
+ */
+typedef struct
+{
+	WORD wVersion;
+	BYTE bMaxSlotIndex;
+	BYTE bVoltageSupport;
+	DWORD dwProtocols;
+	DWORD dwDefaultClock;
+	DWORD dwMaximumClock;
+	BYTE bNumClockSupported;
+	DWORD dwDataRate;
+	DWORD dwMaxDataRate;
+	BYTE bNumDataRatesSupported;
+	DWORD dwMaxIFSD;
+	DWORD dwSynchProtocols;
+	DWORD dwMechanical;
+	DWORD dwFeatures;
+	DWORD dwMaxCCIDMessageLength;
+	BYTE bClassGetResponse;
+	BYTE bClassEnvelope;
+	WORD wLcdLayout;
+	BYTE bPINSupport;
+	BYTE bMaxCCIDBusySlots;
+} CCID_CLASS_DESCRIPTOR_ST;
+
+/**
+ * @brief Length of the USB device descriptor
+ */
+#define CCID_DEVICE_DESCRIPTOR_LENGTH 18
+
+/**
+ * @brief Max length of the serial number kept in a CCID_PROFILE_ST (ASCII, not including the terminating 0)
+ */
+#define CCID_PROFILE_SERIAL_NUMBER_LENGTH 32
+
+/**
+ * @brief What the driver has learnt about a device, so the next startup does not have to learn it again (see CCID_LoadProfile)
+ */
+typedef struct
+{
+	DWORD dwMagic;
+	DWORD dwSize;
+	BYTE abDeviceDescriptor[CCID_DEVICE_DESCRIPTOR_LENGTH]; /*!< Holds idVendor, idProduct and bcdDevice (the firmware version) */
+	char szSerialNumber[CCID_PROFILE_SERIAL_NUMBER_LENGTH + 1];
+	BYTE bSlotCount;
+	BOOL fHasClassDescriptor;
+	CCID_CLASS_DESCRIPTOR_ST ClassDescriptor;
+	WORD awRejectedDi[CCID_MAX_SLOT_COUNT]; /*!< One bit per value of Di that the device has refused in PC_TO_RDR_SetParameters */
+} CCID_PROFILE_ST;
+
+/**
+ * @brief A candidate port for CCID_Discover, and what has been found there
+ */
+typedef struct
+{
+	const char* szCommName; /*!< IN: the port */
+	BOOL fFound; /*!< OUT: a device has answered the Ping */
+	LONG lResult; /*!< OUT: SCARD_S_SUCCESS if found, why not otherwise */
+	DWORD dwResponseTimeMs; /*!< OUT: the time the device has taken to answer */
+	BOOL fHasProfile; /*!< OUT: Profile is valid (the device has already been seen on this port) */
+	CCID_PROFILE_ST Profile;
+} CCID_DISCOVERY_ST;
+
+/**
+ * @brief Capture of the serial traffic (see CCID_CaptureRead): a header of 8 bytes ("CCAP", the version, 3 bytes set to 0), then the records.
+ * A record is the type and the instance (1 byte), the time since the previous record in microseconds, the length, and the data; the time and the length are LEB128 varints.
+ */
+#define CCID_CAPTURE_MAGIC "CCAP"
+#define CCID_CAPTURE_VERSION 1
+#define CCID_CAPTURE_HEADER_LENGTH 8
+
+#define CCID_CAPTURE_TX   0x00 /*!< Bytes from the host to the device */
+#define CCID_CAPTURE_RX   0x10 /*!< Bytes from the device to the host */
+#define CCID_CAPTURE_LOST 0x20 /*!< The tap has lost records (its ring was full): the length is their count, there is no data */
+#define CCID_CAPTURE_TYPE_MASK     0xF0
+#define CCID_CAPTURE_INSTANCE_MASK 0x0F
+
+/**
+ * @brief A record of a capture (see CCID_CaptureReaderNext)
+ */
+typedef struct
+{
+	BYTE bType; /*!< CCID_CAPTURE_TX, CCID_CAPTURE_RX or CCID_CAPTURE_LOST */
+	BYTE bInstance;
+	DWORD dwTimeUs; /*!< Since the beginning of the capture (wraps around after 71 minutes): when the last bytes of the record were sent (TX, as they begin) or received (RX, once they are there) */
+	DWORD dwLength;
+	const BYTE* abData; /*!< Points into the capture, NULL for CCID_CAPTURE_LOST */
+} CCID_CAPTURE_RECORD_ST;
+
+/**
+ * @brief Position in a capture that is being read (see CCID_CaptureReaderInit)
+ */
+typedef struct
+{
+	const BYTE* abCapture;
+	DWORD dwLength;
+	DWORD dwOffset;
+	DWORD dwTimeUs;
+} CCID_CAPTURE_READER_ST;
+
+/**
+ * @brief Counters of the serial link of an instance (see CCID_GetStats)
+ * @note They count since the program has started, or since CCID_ResetStats; CCID_Init does not clear them
+ */
+typedef struct
+{
+	DWORD dwTxFrames; /*!< Messages sent to the device */
+	DWORD dwTxBytes; /*!< Bytes sent, framing included */
+	DWORD dwRxFrames; /*!< Messages received from the device, with a good checksum */
+	DWORD dwRxBytes; /*!< Bytes received, all of them (even those the receiver has dropped) */
+	DWORD dwErrorProtocol; /*!< A byte was not the START_BYTE of a message */
+	DWORD dwErrorOverflow; /*!< The length of a message was too large for the receiver */
+	DWORD dwErrorChecksum; /*!< Wrong checksum */
+	DWORD dwErrorOverrun; /*!< A message has come before the previous one has been read */
+	DWORD dwErrorUnexpected; /*!< The receiver was in an unexpected state */
+	DWORD dwTimeouts; /*!< No message within the timeout of an exchange or of a wait */
+	DWORD dwTimeExtensions; /*!< Time extensions received, all slots */
+	DWORD dwInterrupts; /*!< Notifications received */
+	DWORD dwInterruptsDropped; /*!< Notifications received in the middle of an exchange, and dropped there (the slot changes are kept anyway) */
+	DWORD dwExchanges; /*!< Commands sent, control and bulk */
+	DWORD dwDriverErrors; /*!< Errors that have invalidated the driver (see CCID_IsValidDriver) */
+	DWORD dwRecoveries; /*!< Calls to CCID_Recover */
+	DWORD dwReconnects; /*!< Calls to CCID_Init, but the first one */
+} CCID_LINK_STATS_ST;
+
+/**
+ * @brief Counters of a slot (see CCID_GetStats)
+ */
+typedef struct
+{
+	DWORD dwExchanges; /*!< Bulk commands sent to the slot */
+	DWORD dwErrors; /*!< Responses where the command has failed (bmCommandStatus) */
+	DWORD dwTimeouts; /*!< No response within the timeout */
+	DWORD dwTimeExtensions;
+	DWORD dwChanges; /*!< Card insertions and removals notified by the device */
+} CCID_SLOT_STATS_ST;
+
+/**
+ * @brief Counters of an instance of the driver: the link, and every slot
+ */
+typedef struct
+{
+	CCID_LINK_STATS_ST Link;
+	CCID_SLOT_STATS_ST aSlots[CCID_MAX_SLOT_COUNT];
+} CCID_STATS_ST;
+
+/* Events of the trace (see CCID_TraceRead); the arguments follow the name */
+#define CCID_TRACE_EXCHANGE_BEGIN 0x0001 /*!< endpoint << 8 | request, slot << 8 | sequence, payload length */
+#define CCID_TRACE_EXCHANGE_END 0x0002 /*!< rc (the duration is the time since CCID_TRACE_EXCHANGE_BEGIN) */
+#define CCID_TRACE_TIME_EXTENSION 0x0003 /*!< slot, count so far */
+#define CCID_TRACE_INTERRUPT_DROPPED 0x0004 /*!< A notification has come during an exchange */
+#define CCID_TRACE_DRIVER_ERROR 0x0005 /*!< See CCID_IsValidDriver */
+#define CCID_TRACE_RECOVER_PING_FAILED 0x0006 /*!< attempt, rc */
+#define CCID_TRACE_STATUS_CHANGE 0x0101 /*!< slots present, slots changed (the first 32 slots) */
+#define CCID_TRACE_NO_WARM_RESET 0x0102 /*!< slot (the device refused a warm reset, SCardReconnect uses cold resets from now on) */
+#define CCID_TRACE_USER 0x8000 /*!< The application may record its own events from here */
+#define CCID_TRACE_ARG_COUNT 3
+
+/**
+ * @brief A record of the trace (see CCID_Trace and CCID_TraceRead): fixed size, 6 DWORDs
+ */
+typedef struct
+{
+	DWORD dwSequence; /*!< Position of the record since the trace has started, plus one (0 while it is written) */
+	DWORD dwTimeUs; /*!< CCID_GetTimeUs (wraps around after 71 minutes) */
+	WORD wEvent; /*!< CCID_TRACE_xxx */
+	BYTE bInstance; /*!< Instance that was selected */
+	BYTE bRfu;
+	DWORD adwArgs[CCID_TRACE_ARG_COUNT];
+} CCID_TRACE_RECORD_ST;
+
+/*
+ * Latency histograms: 4 buckets per power of 2 (the upper bound of a bucket is at most 25% above its lower bound),
+ * from 1us to 2^28us (4.5 minutes), exact below 4us; what is longer lands in the last bucket
+ */
+#define CCID_HISTOGRAM_SUB_BUCKET_BITS 2
+#define CCID_HISTOGRAM_MAX_EXPONENT 27
+#define CCID_HISTOGRAM_BUCKET_COUNT ((1 << CCID_HISTOGRAM_SUB_BUCKET_BITS) * CCID_HISTOGRAM_MAX_EXPONENT)
+
+/* The commands that have their own histogram */
+#define CCID_HISTOGRAM_COMMAND_GET_STATUS 0
+#define CCID_HISTOGRAM_COMMAND_GET_DESCRIPTOR 1
+#define CCID_HISTOGRAM_COMMAND_SET_CONFIGURATION 2
+#define CCID_HISTOGRAM_COMMAND_OTHER_CONTROL 3
+#define CCID_HISTOGRAM_COMMAND_SETPARAMETERS 4
+#define CCID_HISTOGRAM_COMMAND_ICCPOWERON 5
+#define CCID_HISTOGRAM_COMMAND_ICCPOWEROFF 6
+#define CCID_HISTOGRAM_COMMAND_GETSLOTSTATUS 7
+#define CCID_HISTOGRAM_COMMAND_ESCAPE 8
+#define CCID_HISTOGRAM_COMMAND_GETPARAMETERS 9
+#define CCID_HISTOGRAM_COMMAND_RESETPARAMETERS 10
+#define CCID_HISTOGRAM_COMMAND_XFRBLOCK 11
+#define CCID_HISTOGRAM_COMMAND_SETDATARATEANDCLOCKFREQUENCY 12
+#define CCID_HISTOGRAM_COMMAND_OTHER_BULK 13
+#define CCID_HISTOGRAM_COMMAND_COUNT 14
+
+/**
+ * @brief A latency histogram, from the beginning of a command to the end of its response (time extensions included)
+ * @note Histograms of the same size can be merged (see CCID_HistogramMerge)
+ */
+typedef struct
+{
+	DWORD dwCount;
+	DWORD dwMaxUs;
+	DWORD adwBuckets[CCID_HISTOGRAM_BUCKET_COUNT];
+} CCID_HISTOGRAM_ST;
+
+/**
+ * @brief The latency histograms of an instance of the driver: every command, and every slot (bulk commands only)
+ */
+typedef struct
+{
+	CCID_HISTOGRAM_ST aCommands[CCID_HISTOGRAM_COMMAND_COUNT];
+	CCID_HISTOGRAM_ST aSlots[CCID_MAX_SLOT_COUNT];
+} CCID_HISTOGRAMS_ST;
+
+/**
+ * @brief Where the time of an exchange has gone (see CCID_ExchangeEx): every stage begins where the previous one ends
+ * @note A stage that has not been reached (e.g. no response) is 0, and so are the following ones. The HAL may return from CCID_SerialSendBytes before the bytes are on the wire; the wire time is then in dwDeviceUs.
+ * @note A stage that would end before it begins (e.g. the HAL has received the response before CCID_SerialSendBytes returns) is 0 as well, so the stages never overlap, and add up to dwTotalUs once the exchange has returned.
+ * Only the response counts: the notifications received meanwhile do not, and the time extensions are in dwDeviceUs.
+ */
+typedef struct
+{
+	DWORD dwStartUs; /*!< CCID_GetTimeUs when the exchange has been called */
+	DWORD dwQueueUs; /*!< Waiting for the exchanges of the other callers */
+	DWORD dwEncodeUs; /*!< Until the first byte is handed to the HAL (framing, checksum, capture) */
+	DWORD dwTxUs; /*!< Until the last byte is handed to the HAL (the TX wire time if sending blocks) */
+	DWORD dwDeviceUs; /*!< Until the first byte of the response: the coupler and the card, time extensions included */
+	DWORD dwRxUs; /*!< Until the last byte of the response, when the receiver calls CCID_WakeupFromISR (the RX wire time) */
+	DWORD dwWakeupUs; /*!< Until the caller runs again (the scheduling delay of the HAL) */
+	DWORD dwReturnUs; /*!< Until the exchange returns (decoding, copies) */
+	DWORD dwTotalUs; /*!< The whole exchange */
+	DWORD dwTimeExtensions; /*!< Number of time extensions asked by the card */
+} CCID_EXCHANGE_TIMELINE_ST;
+
 #endif
@@ -0,0 +1,603 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_exporter.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Export of the counters and of the histograms in the Prometheus text format, by a background thread (POSIX hosts)
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_exporter.h"
+
+#if (CCID_STATS)
+
+#include <stdarg.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define EXPORTER_UNIX 1
+#define EXPORTER_TCP 2
+#define EXPORTER_FILE 3
+
+/**
+ * @internal
+ * @brief A counter of the link, and where it is in CCID_LINK_STATS_ST
+ */
+typedef struct
+{
+	const char* szName;
+	const char* szHelp;
+	size_t offset;
+} EXPORTER_COUNTER_ST;
+
+/**
+ * @internal
+ * @brief The text that is being written into the buffer of the caller; what does not fit is counted anyway
+ */
+typedef struct
+{
+	char* szBuffer;
+	DWORD dwMaxLength;
+	DWORD dwLength;
+} EXPORTER_TEXT_ST;
+
+static const EXPORTER_COUNTER_ST exporter_link_counters[] =
+{
+	{ "tx_frames", "Messages sent to the device", offsetof(CCID_LINK_STATS_ST, dwTxFrames) },
+	{ "tx_bytes", "Bytes sent to the device, framing included", offsetof(CCID_LINK_STATS_ST, dwTxBytes) },
+	{ "rx_frames", "Messages received from the device, with a good checksum", offsetof(CCID_LINK_STATS_ST, dwRxFrames) },
+	{ "rx_bytes", "Bytes received from the device", offsetof(CCID_LINK_STATS_ST, dwRxBytes) },
+	{ "rx_protocol_errors", "Bytes that were not the beginning of a message", offsetof(CCID_LINK_STATS_ST, dwErrorProtocol) },
+	{ "rx_overflow_errors", "Messages too long for the receiver", offsetof(CCID_LINK_STATS_ST, dwErrorOverflow) },
+	{ "rx_checksum_errors", "Messages with a wrong checksum", offsetof(CCID_LINK_STATS_ST, dwErrorChecksum) },
+	{ "rx_overrun_errors", "Messages received before the previous one has been read", offsetof(CCID_LINK_STATS_ST, dwErrorOverrun) },
+	{ "rx_unexpected_errors", "Receiver found in an unexpected state", offsetof(CCID_LINK_STATS_ST, dwErrorUnexpected) },
+	{ "timeouts", "Exchanges or waits without a message in time", offsetof(CCID_LINK_STATS_ST, dwTimeouts) },
+	{ "time_extensions", "Time extensions asked by the cards", offsetof(CCID_LINK_STATS_ST, dwTimeExtensions) },
+	{ "interrupts", "Notifications received", offsetof(CCID_LINK_STATS_ST, dwInterrupts) },
+	{ "interrupts_dropped", "Notifications received in the middle of an exchange", offsetof(CCID_LINK_STATS_ST, dwInterruptsDropped) },
+	{ "exchanges", "Commands sent, control and bulk", offsetof(CCID_LINK_STATS_ST, dwExchanges) },
+	{ "driver_errors", "Errors that have invalidated the driver", offsetof(CCID_LINK_STATS_ST, dwDriverErrors) },
+	{ "recoveries", "Calls to CCID_Recover", offsetof(CCID_LINK_STATS_ST, dwRecoveries) },
+	{ "reconnects", "Calls to CCID_Init, but the first one", offsetof(CCID_LINK_STATS_ST, dwReconnects) }
+};
+
+static const EXPORTER_COUNTER_ST exporter_slot_counters[] =
+{
+	{ "slot_exchanges", "Bulk commands sent to the slot", offsetof(CCID_SLOT_STATS_ST, dwExchanges) },
+	{ "slot_errors", "Commands that have failed in the slot", offsetof(CCID_SLOT_STATS_ST, dwErrors) },
+	{ "slot_timeouts", "Commands of the slot without a response in time", offsetof(CCID_SLOT_STATS_ST, dwTimeouts) },
+	{ "slot_time_extensions", "Time extensions asked by the card of the slot", offsetof(CCID_SLOT_STATS_ST, dwTimeExtensions) },
+	{ "slot_changes", "Card insertions and removals in the slot", offsetof(CCID_SLOT_STATS_ST, dwChanges) }
+};
+
+static BYTE exporter_mode;
+static char exporter_path[108]; /* Size of sun_path */
+static int exporter_socket = -1;
+static pthread_t exporter_thread;
+static volatile BOOL exporter_running;
+static volatile BOOL exporter_stop;
+
+/* The snapshots are large, hence static; the mutex is the exporter's only, never the driver's */
+static pthread_mutex_t exporter_mutex = PTHREAD_MUTEX_INITIALIZER;
+static CCID_STATS_ST exporter_stats[CCID_MAX_INSTANCE_COUNT];
+#if (CCID_HISTOGRAMS)
+static CCID_HISTOGRAMS_ST exporter_histograms[CCID_MAX_INSTANCE_COUNT];
+#endif
+
+/**
+ * @internal
+ * @brief Append to the text, as printf does
+ */
+static void exporter_printf(EXPORTER_TEXT_ST* text, const char* szFormat, ...)
+{
+	DWORD dwRemaining = (text->dwLength < text->dwMaxLength) ? text->dwMaxLength - text->dwLength : 0;
+	va_list args;
+	int length;
+
+	va_start(args, szFormat);
+	length = vsnprintf(dwRemaining ? &text->szBuffer[text->dwLength] : NULL, dwRemaining, szFormat, args);
+	va_end(args);
+
+	if (length > 0)
+		text->dwLength += (DWORD) length;
+}
+
+/**
+ * @internal
+ * @brief Has the instance ever been used?
+ */
+static BOOL exporter_instance_used(BYTE bInstance)
+{
+	return (exporter_stats[bInstance].Link.dwTxFrames != 0) || (exporter_stats[bInstance].Link.dwRxBytes != 0);
+}
+
+/**
+ * @internal
+ * @brief Has the slot of the instance ever been used?
+ */
+static BOOL exporter_slot_used(BYTE bInstance, BYTE bSlot)
+{
+	return (exporter_stats[bInstance].aSlots[bSlot].dwExchanges != 0) || (exporter_stats[bInstance].aSlots[bSlot].dwChanges != 0);
+}
+
+#if (CCID_HISTOGRAMS)
+/**
+ * @internal
+ * @brief One latency histogram, with a bucket at every power of 2 (the driver keeps 4 of them per power of 2)
+ * @note The driver does not keep the sum of the samples, so there is no _sum; the quantiles come from the buckets anyway
+ */
+static void exporter_histogram(EXPORTER_TEXT_ST* text, const char* szName, const char* szLabels, const CCID_HISTOGRAM_ST* pHistogram)
+{
+	DWORD dwCumulated = 0;
+
+	for (BYTE bBucket = 0; bBucket < CCID_HISTOGRAM_BUCKET_COUNT - 1; bBucket++)
+	{
+		dwCumulated += pHistogram->adwBuckets[bBucket];
+		if ((bBucket % (1 << CCID_HISTOGRAM_SUB_BUCKET_BITS)) == (1 << CCID_HISTOGRAM_SUB_BUCKET_BITS) - 1)
+		{
+			DWORD dwHighUs = CCID_LIB(HistogramBucketHighUs)(bBucket);
+			exporter_printf(text, "ccid_serial_%s_bucket{%s,le=\"%lu.%06lu\"} %lu\n", szName, szLabels, dwHighUs / 1000000, dwHighUs % 1000000, dwCumulated);
+		}
+	}
+
+	/* The count is the one of the buckets, so that +Inf and _count agree even if a sample was being recorded */
+	dwCumulated += pHistogram->adwBuckets[CCID_HISTOGRAM_BUCKET_COUNT - 1];
+	exporter_printf(text, "ccid_serial_%s_bucket{%s,le=\"+Inf\"} %lu\n", szName, szLabels, dwCumulated);
+	exporter_printf(text, "ccid_serial_%s_count{%s} %lu\n", szName, szLabels, dwCumulated);
+}
+#endif
+
+/**
+ * @brief Write the counters (and the latency histograms, with CCID_HISTOGRAMS) of all the instances that have been used, in the Prometheus text format
+ * @return The length of the whole text; if it is dwMaxLength or more, the text has been truncated (as snprintf does)
+ * @note Reads the counters without any lock (see CCID_GetInstanceStats), so it does not slow the exchanges down
+ */
+DWORD CCID_LIB(ExporterFormat)(char szBuffer[], DWORD dwMaxLength)
+{
+	EXPORTER_TEXT_ST text = { szBuffer, dwMaxLength, 0 };
+	char szLabels[64];
+
+	pthread_mutex_lock(&exporter_mutex);
+
+	for (BYTE bInstance = 0; bInstance < CCID_MAX_INSTANCE_COUNT; bInstance++)
+	{
+		CCID_LIB(GetInstanceStats)(bInstance, &exporter_stats[bInstance]);
+#if (CCID_HISTOGRAMS)
+		CCID_LIB(GetInstanceHistograms)(bInstance, &exporter_histograms[bInstance], FALSE);
+#endif
+	}
+
+	for (DWORD i = 0; i < sizeof(exporter_link_counters) / sizeof(exporter_link_counters[0]); i++)
+	{
+		const EXPORTER_COUNTER_ST* counter = &exporter_link_counters[i];
+
+		exporter_printf(&text, "# HELP ccid_serial_%s_total %s\n# TYPE ccid_serial_%s_total counter\n", counter->szName, counter->szHelp, counter->szName);
+		for (BYTE bInstance = 0; bInstance < CCID_MAX_INSTANCE_COUNT; bInstance++)
+			if (exporter_instance_used(bInstance))
+				exporter_printf(&text, "ccid_serial_%s_total{device=\"%u\"} %lu\n", counter->szName, bInstance,
+					*(const DWORD*) ((const BYTE*) &exporter_stats[bInstance].Link + counter->offset));
+	}
+
+	for (DWORD i = 0; i < sizeof(exporter_slot_counters) / sizeof(exporter_slot_counters[0]); i++)
+	{
+		const EXPORTER_COUNTER_ST* counter = &exporter_slot_counters[i];
+
+		exporter_printf(&text, "# HELP ccid_serial_%s_total %s\n# TYPE ccid_serial_%s_total counter\n", counter->szName, counter->szHelp, counter->szName);
+		for (BYTE bInstance = 0; bInstance < CCID_MAX_INSTANCE_COUNT; bInstance++)
+			for (BYTE bSlot = 0; bSlot < CCID_MAX_SLOT_COUNT; bSlot++)
+				if (exporter_slot_used(bInstance, bSlot))
+					exporter_printf(&text, "ccid_serial_%s_total{device=\"%u\",slot=\"%u\"} %lu\n", counter->szName, bInstance, bSlot,
+						*(const DWORD*) ((const BYTE*) &exporter_stats[bInstance].aSlots[bSlot] + counter->offset));
+	}
+
+#if (CCID_HISTOGRAMS)
+	exporter_printf(&text, "# HELP ccid_serial_command_duration_seconds From the beginning of a command to the end of its response, time extensions included\n");
+	exporter_printf(&text, "# TYPE ccid_serial_command_duration_seconds histogram\n");
+	for (BYTE bInstance = 0; bInstance < CCID_MAX_INSTANCE_COUNT; bInstance++)
+		for (BYTE bCommand = 0; bCommand < CCID_HISTOGRAM_COMMAND_COUNT; bCommand++)
+			if (exporter_histograms[bInstance].aCommands[bCommand].dwCount)
+			{
+				snprintf(szLabels, sizeof(szLabels), "device=\"%u\",command=\"%s\"", bInstance, CCID_LIB(HistogramCommandName)(bCommand));
+				exporter_histogram(&text, "command_duration_seconds", szLabels, &exporter_histograms[bInstance].aCommands[bCommand]);
+			}
+
+	exporter_printf(&text, "# HELP ccid_serial_slot_duration_seconds Same as ccid_serial_command_duration_seconds, bulk commands of a slot\n");
+	exporter_printf(&text, "# TYPE ccid_serial_slot_duration_seconds histogram\n");
+	for (BYTE bInstance = 0; bInstance < CCID_MAX_INSTANCE_COUNT; bInstance++)
+		for (BYTE bSlot = 0; bSlot < CCID_MAX_SLOT_COUNT; bSlot++)
+			if (exporter_histograms[bInstance].aSlots[bSlot].dwCount)
+			{
+				snprintf(szLabels, sizeof(szLabels), "device=\"%u\",slot=\"%u\"", bInstance, bSlot);
+				exporter_histogram(&text, "slot_duration_seconds", szLabels, &exporter_histograms[bInstance].aSlots[bSlot]);
+			}
+#else
+	(void) szLabels;
+#endif
+
+	pthread_mutex_unlock(&exporter_mutex);
+
+	return text.dwLength;
+}
+
+/**
+ * @internal
+ * @brief The whole text, in a buffer that grows as needed
+ * @return NULL if the memory is exhausted
+ */
+static char* exporter_format(DWORD* pdwLength)
+{
+	static char* szBuffer = NULL;
+	static DWORD dwSize = 0;
+
+	for (;;)
+	{
+		DWORD dwLength = CCID_LIB(ExporterFormat)(szBuffer, dwSize);
+		char* szLarger;
+
+		if ((szBuffer != NULL) && (dwLength < dwSize))
+		{
+			*pdwLength = dwLength;
+			return szBuffer;
+		}
+
+		/* Some room for the counters that appear meanwhile */
+		dwSize = dwLength + 1024;
+		szLarger = realloc(szBuffer, dwSize);
+		if (szLarger == NULL)
+		{
+			free(szBuffer);
+			szBuffer = NULL;
+			dwSize = 0;
+			return NULL;
+		}
+		szBuffer = szLarger;
+	}
+}
+
+/**
+ * @internal
+ * @brief Write the text into a temporary file, and rename it, so that the reader never sees half of it
+ */
+static void exporter_write_file(void)
+{
+	char szTemporary[sizeof(exporter_path) + 4];
+	DWORD dwLength;
+	char* szText = exporter_format(&dwLength);
+	FILE* file;
+	BOOL fWritten;
+
+	if (szText == NULL)
+		return;
+
+	snprintf(szTemporary, sizeof(szTemporary), "%s.tmp", exporter_path);
+	file = fopen(szTemporary, "w");
+	if (file == NULL)
+	{
+		perror(szTemporary);
+		return;
+	}
+
+	fWritten = (fwrite(szText, 1, dwLength, file) == dwLength);
+	if (fclose(file) != 0)
+		fWritten = FALSE;
+	if (!fWritten)
+	{
+		perror(szTemporary);
+		unlink(szTemporary);
+		return;
+	}
+
+	if (rename(szTemporary, exporter_path) != 0)
+		perror(exporter_path);
+}
+
+/**
+ * @internal
+ * @brief Send the whole buffer to the client, that may be slow
+ */
+static BOOL exporter_send(int client, const char* pbData, DWORD dwLength)
+{
+	while (dwLength)
+	{
+		ssize_t sent = send(client, pbData, dwLength, MSG_NOSIGNAL);
+		if (sent <= 0)
+		{
+			if ((sent < 0) && (errno == EINTR))
+				continue;
+			return FALSE;
+		}
+		pbData += sent;
+		dwLength -= (DWORD) sent;
+	}
+	return TRUE;
+}
+
+/**
+ * @internal
+ * @brief Answer a scraper: read its HTTP request (whatever the path is), and send the text
+ */
+static void exporter_serve(int client)
+{
+	struct timeval timeout = { CCID_EXPORTER_REQUEST_TIMEOUT_MS / 1000, (CCID_EXPORTER_REQUEST_TIMEOUT_MS % 1000) * 1000 };
+	char szRequest[2048];
+	char szHeader[160];
+	DWORD dwReceived = 0, dwLength;
+	char* szText;
+
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	/* Until the end of the headers; a request that does not fit is answered anyway */
+	while (dwReceived < sizeof(szRequest) - 1)
+	{
+		ssize_t received = recv(client, &szRequest[dwReceived], sizeof(szRequest) - 1 - dwReceived, 0);
+		if (received <= 0)
+			return;
+		dwReceived += (DWORD) received;
+		szRequest[dwReceived] = '\0';
+		if (strstr(szRequest, "\r\n\r\n") || strstr(szRequest, "\n\n"))
+			break;
+	}
+
+	szText = exporter_format(&dwLength);
+	if (szText == NULL)
+	{
+		const char* szError = "HTTP/1.0 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		exporter_send(client, szError, (DWORD) strlen(szError));
+		return;
+	}
+
+	snprintf(szHeader, sizeof(szHeader), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n", dwLength);
+	if (exporter_send(client, szHeader, (DWORD) strlen(szHeader)))
+		exporter_send(client, szText, dwLength);
+}
+
+/**
+ * @internal
+ * @brief Background thread: answers the scrapers one after the other, or writes the file from time to time
+ */
+static void* exporter_task(void* arg)
+{
+	DWORD dwSinceWrittenMs = CCID_EXPORTER_FILE_PERIOD_MS;
+	(void) arg;
+
+	while (!exporter_stop)
+	{
+		if (exporter_mode == EXPORTER_FILE)
+		{
+			if (dwSinceWrittenMs >= CCID_EXPORTER_FILE_PERIOD_MS)
+			{
+				exporter_write_file();
+				dwSinceWrittenMs = 0;
+			}
+			usleep(CCID_EXPORTER_POLL_MS * 1000);
+			dwSinceWrittenMs += CCID_EXPORTER_POLL_MS;
+		}
+		else
+		{
+			struct pollfd pfd = { exporter_socket, POLLIN, 0 };
+
+			if (poll(&pfd, 1, CCID_EXPORTER_POLL_MS) > 0)
+			{
+				int client = accept(exporter_socket, NULL, NULL);
+				if (client >= 0)
+				{
+					exporter_serve(client);
+					close(client);
+				}
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @internal
+ * @brief Listen on a Unix-domain socket, or on a TCP port of the loopback interface
+ */
+static BOOL exporter_listen(const char* szAddress)
+{
+	int s;
+
+	if (exporter_mode == EXPORTER_UNIX)
+	{
+		struct sockaddr_un address;
+		struct stat info;
+
+		/* What a previous run has left may be removed, but only if it is a socket: never a file the address points to by mistake */
+		if (lstat(exporter_path, &info) == 0)
+		{
+			if (!S_ISSOCK(info.st_mode))
+			{
+				printf("%s exists and is not a socket, not removing it\n", exporter_path);
+				return FALSE;
+			}
+			unlink(exporter_path);
+		}
+
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		strncpy(address.sun_path, exporter_path, sizeof(address.sun_path) - 1);
+
+		s = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (s < 0)
+		{
+			perror("socket");
+			return FALSE;
+		}
+		if (bind(s, (struct sockaddr*) &address, sizeof(address)) != 0)
+		{
+			perror(exporter_path);
+			close(s);
+			return FALSE;
+		}
+	}
+	else
+	{
+		struct sockaddr_in address;
+		char* szEnd;
+		unsigned long port = strtoul(szAddress, &szEnd, 10);
+		int reuse = 1;
+
+		if ((szEnd == szAddress) || (*szEnd != '\0') || (port == 0) || (port > 65535))
+		{
+			printf("Invalid port: %s\n", szAddress);
+			return FALSE;
+		}
+
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons((uint16_t) port);
+		/* Local only: a reverse proxy or the node agent exposes it, if needed */
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		s = socket(AF_INET, SOCK_STREAM, 0);
+		if (s < 0)
+		{
+			perror("socket");
+			return FALSE;
+		}
+		setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		if (bind(s, (struct sockaddr*) &address, sizeof(address)) != 0)
+		{
+			perror(szAddress);
+			close(s);
+			return FALSE;
+		}
+	}
+
+	if (listen(s, 4) != 0)
+	{
+		perror("listen");
+		close(s);
+		return FALSE;
+	}
+
+	exporter_socket = s;
+	return TRUE;
+}
+
+/**
+ * @brief Export the counters and the histograms of all the instances, until CCID_ExporterStop
+ * @param szAddress "unix:<path>" or "tcp:<port>" (loopback interface only) to be scraped over HTTP, or "file:<path>" to write the file every CCID_EXPORTER_FILE_PERIOD_MS (e.g. for the textfile collector of the node exporter)
+ * @return FALSE if the address is invalid or can not be used, or if the exporter is already running
+ */
+BOOL CCID_LIB(ExporterStart)(const char* szAddress)
+{
+	const char* szValue;
+
+	if ((szAddress == NULL) || exporter_running)
+		return FALSE;
+
+	if (!strncmp(szAddress, "unix:", 5))
+		exporter_mode = EXPORTER_UNIX;
+	else if (!strncmp(szAddress, "tcp:", 4))
+		exporter_mode = EXPORTER_TCP;
+	else if (!strncmp(szAddress, "file:", 5))
+		exporter_mode = EXPORTER_FILE;
+	else
+	{
+		printf("Invalid exporter address: %s (unix:<path>, tcp:<port> or file:<path>)\n", szAddress);
+		return FALSE;
+	}
+
+	szValue = strchr(szAddress, ':') + 1;
+	if ((*szValue == '\0') || (strlen(szValue) >= sizeof(exporter_path)))
+	{
+		printf("Invalid exporter address: %s\n", szAddress);
+		return FALSE;
+	}
+	strcpy(exporter_path, szValue);
+
+	if ((exporter_mode != EXPORTER_FILE) && !exporter_listen(szValue))
+		return FALSE;
+
+	exporter_stop = FALSE;
+	if (pthread_create(&exporter_thread, NULL, exporter_task, NULL) != 0)
+	{
+		perror("pthread_create");
+		if (exporter_socket >= 0)
+		{
+			close(exporter_socket);
+			exporter_socket = -1;
+		}
+		return FALSE;
+	}
+
+	exporter_running = TRUE;
+	return TRUE;
+}
+
+/**
+ * @brief Stop the exporter (the file, if any, is left as it is)
+ */
+void CCID_LIB(ExporterStop)(void)
+{
+	if (!exporter_running)
+		return;
+
+	exporter_stop = TRUE;
+	pthread_join(exporter_thread, NULL);
+	exporter_running = FALSE;
+
+	if (exporter_socket >= 0)
+	{
+		close(exporter_socket);
+		exporter_socket = -1;
+		if (exporter_mode == EXPORTER_UNIX)
+			unlink(exporter_path);
+	}
+}
+
+#endif
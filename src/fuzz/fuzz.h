@@ -0,0 +1,83 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file fuzz.h
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Fuzz harnesses: the deterministic HAL they share
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#ifndef __FUZZ_H__
+#define __FUZZ_H__
+
+#include <project.h>
+
+#include "../pcsc-serial.h"
+#include "../scard/scard.h"
+#include "../ccid/ccid.h"
+#include "../ccid/ccid_hal.h"
+
+/* Entry point of every harness (libFuzzer convention, fuzz_main.c provides main for AFL and for the replay of the corpus) */
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+/* Wire time of a chunk in virtual ms: 38400bps, 10 bits per byte, and 1ms for the silence that ends it */
+#define FUZZ_WIRE_MS(length) ((length) / 4 + 1)
+
+/* The input that the virtual device sends: chunks of [length][bytes], a length of 0 is a silence (the wait times out) */
+void fuzz_hal_set_input(const BYTE* data, size_t size);
+/* Hand the next chunk to the receiver; FALSE at the end of the input or on a silence */
+BOOL fuzz_hal_feed(void);
+/* Is there anything left in the input */
+BOOL fuzz_hal_has_input(void);
+/* Reset the virtual time and the wakeups */
+void fuzz_hal_reset(void);
+/* Bytes that the driver has sent */
+DWORD fuzz_hal_sent_bytes(void);
+
+/* Stop with a message when an invariant does not hold (the fuzzer records the input) */
+#define FUZZ_ASSERT(x) do { if (!(x)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #x); abort(); } } while (0)
+
+#endif
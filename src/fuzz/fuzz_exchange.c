@@ -0,0 +1,174 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file fuzz_exchange.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Fuzz harness: CCID_Exchange against a device that answers anything
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include "fuzz.h"
+
+/*
+ * Input: a sequence of [command][count][chunks...], the count chunks being [length][data] from the device
+ * - command & 0x03: 0 = GetStatus (control), 1 = PC_to_RDR_GetSlotStatus, 2 = PC_to_RDR_XfrBlock, 3 = PC_to_RDR_XfrBlock with a short buffer
+ * An exchange must never last longer than its timeout, once more per time extension (a flood of interrupts must not keep it waiting), and once it has returned, the next genuine response must be received.
+ */
+
+static BYTE abRecvBuffer[CCID_MAX_PAYLOAD_LENGTH];
+
+/* Response to GetStatus: RDR_to_PC control header (bRequest, length, wValue, wIndex, status) */
+static const BYTE abGenuine[] = { START_BYTE, CCID_COMM_CONTROL_TO_PC, GET_STATUS, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+/**
+ * @brief Upper bound of the number of time extensions in the chunks: all that looks like a bulk response with bmCommandStatus = 2
+ */
+static DWORD count_time_extensions(const BYTE* data, size_t size)
+{
+	DWORD dwCount = 0;
+
+	for (size_t i = 0; i + 9 < size; i++)
+		if ((data[i] == START_BYTE) && (data[i + 1] == CCID_COMM_BULK_RDR_TO_PC) && ((data[i + 9] & 0xC0) == 0x80))
+			dwCount++;
+	return dwCount;
+}
+
+static void exchange(BYTE bCommand, const BYTE* data, size_t size)
+{
+	static const BYTE abApdu[] = { 0x00, 0xA4, 0x04, 0x00, 0x00 };
+	CCID_PACKET_ST packet;
+	DWORD dwTimeoutMs, dwStartMs, dwElapsedMs;
+	LONG rc;
+
+	CCID_LIB(PacketInit)(&packet);
+
+	switch (bCommand & 0x03)
+	{
+		case 0:
+			packet.bEndpoint = CCID_COMM_CONTROL_TO_RDR;
+			packet.Header.p.bRequest = GET_STATUS;
+			dwTimeoutMs = CONTROL_TIMEOUT;
+		break;
+
+		case 1:
+			packet.bEndpoint = CCID_COMM_BULK_PC_TO_RDR;
+			packet.Header.p.bRequest = PC_TO_RDR_GETSLOTSTATUS;
+			packet.Header.p.Data.BulkOut.bSequence = CCID_LIB(GetSequence)(0);
+			dwTimeoutMs = BULK_TIMEOUT;
+		break;
+
+		default:
+			packet.bEndpoint = CCID_COMM_BULK_PC_TO_RDR;
+			packet.Header.p.bRequest = PC_TO_RDR_XFRBLOCK;
+			packet.Header.p.Data.BulkOut.bSequence = CCID_LIB(GetSequence)(0);
+			packet.abSendPayload = abApdu;
+			packet.Header.p.Length.dw = sizeof(abApdu);
+			packet.abRecvPayload = abRecvBuffer;
+			packet.dwRecvPayloadMaxLen = ((bCommand & 0x03) == 3) ? 2 : sizeof(abRecvBuffer);
+			dwTimeoutMs = BULK_TIMEOUT;
+	}
+
+	fuzz_hal_set_input(data, size);
+	dwStartMs = CCID_LIB(GetTimeMs)();
+	rc = CCID_LIB(Exchange)(&packet, dwTimeoutMs);
+	dwElapsedMs = CCID_LIB(GetTimeMs)() - dwStartMs;
+
+	/* Never wait for more than the timeout, restarted by every time extension (the chunk that ends the wait may be a long one) */
+	FUZZ_ASSERT(dwElapsedMs <= (1 + count_time_extensions(data, size)) * dwTimeoutMs + FUZZ_WIRE_MS(255));
+
+	if (rc == SCARD_ERR(S_SUCCESS))
+		FUZZ_ASSERT(packet.Header.p.Length.dw <= CCID_MAX_PAYLOAD_LENGTH);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	BYTE abFrame[sizeof(abGenuine)];
+	size_t offset = 0;
+	LONG rc;
+
+	fuzz_hal_reset();
+	CCID_LIB(SelectInstance)(0);
+	CCID_LIB(SerialOpen)();
+	CCID_LIB(Init)();
+
+	while (offset + 1 < size)
+	{
+		BYTE bCommand = data[offset++];
+		BYTE bCount = data[offset++];
+		size_t length = 0;
+
+		/* The chunks that belong to this command */
+		for (BYTE i = 0; (i < bCount) && (offset + length < size); i++)
+			length += 1 + data[offset + length];
+		if (offset + length > size)
+			length = size - offset;
+
+		exchange(bCommand, &data[offset], length);
+		offset += length;
+	}
+
+	/* Whatever has happened, a genuine device is found again at once */
+	memcpy(abFrame, abGenuine, sizeof(abFrame));
+	for (DWORD i = 1; i < sizeof(abFrame) - 1; i++)
+		abFrame[sizeof(abFrame) - 1] ^= abFrame[i];
+
+	/* Leftovers of the previous exchanges are retrieved by the next one (as the Ping of CCID_Recover would) */
+	fuzz_hal_set_input(NULL, 0);
+	for (int i = 0; i < 3; i++)
+		if (CCID_LIB(Ping)() == SCARD_ERR(E_TIMEOUT))
+			break;
+
+	{
+		BYTE abChunk[1 + sizeof(abFrame)];
+		abChunk[0] = sizeof(abFrame);
+		memcpy(&abChunk[1], abFrame, sizeof(abFrame));
+		fuzz_hal_set_input(abChunk, sizeof(abChunk));
+		rc = CCID_LIB(Ping)();
+	}
+	FUZZ_ASSERT(rc == SCARD_ERR(S_SUCCESS));
+
+	return 0;
+}
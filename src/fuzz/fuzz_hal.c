@@ -0,0 +1,253 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file fuzz_hal.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Fuzz harnesses: HAL without any comm port nor thread, the bytes come from the input, the time is virtual
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include "fuzz.h"
+
+BOOL fVerbose = FALSE;
+
+static const BYTE* fuzz_data;
+static size_t fuzz_size;
+static DWORD fuzz_time_ms;
+static DWORD fuzz_sent;
+static BOOL fuzz_open[CCID_MAX_INSTANCE_COUNT];
+static BOOL fuzz_wakeup[CCID_MAX_INSTANCE_COUNT];
+
+void fuzz_hal_set_input(const BYTE* data, size_t size)
+{
+	fuzz_data = data;
+	fuzz_size = size;
+}
+
+void fuzz_hal_reset(void)
+{
+	fuzz_time_ms = 0;
+	fuzz_sent = 0;
+	memset(fuzz_wakeup, 0, sizeof(fuzz_wakeup));
+}
+
+DWORD fuzz_hal_sent_bytes(void)
+{
+	return fuzz_sent;
+}
+
+BOOL fuzz_hal_has_input(void)
+{
+	return (fuzz_size > 0);
+}
+
+BOOL fuzz_hal_feed(void)
+{
+	size_t length;
+
+	if (fuzz_size == 0)
+		return FALSE;
+
+	length = *fuzz_data++;
+	fuzz_size--;
+	if (length > fuzz_size)
+		length = fuzz_size;
+
+	fuzz_time_ms += FUZZ_WIRE_MS(length);
+	if (length == 0)
+		return FALSE;
+
+	CCID_LIB(InstanceRecvBytesFromISR)(CCID_LIB(GetInstance)(), fuzz_data, (DWORD) length);
+	fuzz_data += length;
+	fuzz_size -= length;
+	return TRUE;
+}
+
+BOOL SCARD_LIB(IsCancelledHook)(void)
+{
+	return FALSE;
+}
+
+void CCID_LIB(SerialInit)(const char* szCommName)
+{
+	(void) szCommName;
+}
+
+BOOL CCID_LIB(SerialIsOpen)(void)
+{
+	return fuzz_open[CCID_LIB(GetInstance)()];
+}
+
+BOOL CCID_LIB(SerialOpen)(void)
+{
+	fuzz_open[CCID_LIB(GetInstance)()] = TRUE;
+	return TRUE;
+}
+
+void CCID_LIB(SerialClose)(void)
+{
+	fuzz_open[CCID_LIB(GetInstance)()] = FALSE;
+}
+
+BOOL CCID_LIB(SerialSendBytes)(const BYTE* abValue, DWORD dwLength)
+{
+	(void) abValue;
+	fuzz_sent += dwLength;
+	return TRUE;
+}
+
+BOOL CCID_LIB(SerialSendByte)(BYTE bValue)
+{
+	return CCID_LIB(SerialSendBytes)(&bValue, 1);
+}
+
+BOOL CCID_LIB(SerialWaitPort)(DWORD timeout_ms)
+{
+	fuzz_time_ms += timeout_ms;
+	return FALSE;
+}
+
+BOOL CCID_LIB(SerialReset)(void)
+{
+	return TRUE;
+}
+
+/**
+ * @internal
+ * @brief Let the next chunk arrive, unless the wait that has begun at dwStartMs is over; at the end of the input or on a silence, the virtual time jumps to the timeout
+ */
+static BOOL fuzz_hal_wait(DWORD dwStartMs, DWORD timeout_ms)
+{
+	if ((fuzz_time_ms - dwStartMs < timeout_ms) && fuzz_hal_feed())
+		return TRUE;
+	if (fuzz_time_ms - dwStartMs < timeout_ms)
+		fuzz_time_ms = dwStartMs + timeout_ms;
+	return FALSE;
+}
+
+/**
+ * @brief The device "answers" while the driver waits: chunks are handed over until a message is complete, a silence or the end of the input times out at once
+ */
+BOOL CCID_LIB(WaitWakeup)(DWORD timeout_ms)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+	DWORD dwStartMs = fuzz_time_ms;
+
+	while (!fuzz_wakeup[bInstance])
+	{
+		if (!fuzz_hal_wait(dwStartMs, timeout_ms))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+void CCID_LIB(ClearWakeup)(void)
+{
+	fuzz_wakeup[CCID_LIB(GetInstance)()] = FALSE;
+}
+
+void CCID_LIB(WakeupFromISR)(void)
+{
+	fuzz_wakeup[CCID_LIB(GetInstance)()] = TRUE;
+}
+
+#if (CCID_MAX_INSTANCE_COUNT > 1)
+void CCID_LIB(InstanceWakeupFromISR)(BYTE bInstance)
+{
+	if (bInstance < CCID_MAX_INSTANCE_COUNT)
+		fuzz_wakeup[bInstance] = TRUE;
+}
+
+BOOL CCID_LIB(WaitWakeupMulti)(const BYTE abInstances[], BYTE bInstanceCount, DWORD timeout_ms, BYTE* pbInstance)
+{
+	DWORD dwStartMs = fuzz_time_ms;
+
+	for (;;)
+	{
+		for (BYTE i = 0; i < bInstanceCount; i++)
+		{
+			if ((abInstances[i] < CCID_MAX_INSTANCE_COUNT) && fuzz_wakeup[abInstances[i]])
+			{
+				if (pbInstance != NULL)
+					*pbInstance = abInstances[i];
+				return TRUE;
+			}
+		}
+		if (!fuzz_hal_wait(dwStartMs, timeout_ms))
+			return FALSE;
+	}
+}
+#endif
+
+DWORD CCID_LIB(GetTimeMs)(void)
+{
+	return fuzz_time_ms;
+}
+
+/* Single-threaded: nothing to lock */
+void CCID_LIB(LockEnter)(void) {}
+void CCID_LIB(LockLeave)(void) {}
+void CCID_LIB(LockWait)(void) {}
+void CCID_LIB(LockNotifyAll)(void) {}
+
+DWORD CCID_LIB(GetCallerId)(void)
+{
+	return 1;
+}
+
+BOOL CCID_LIB(ProfileRead)(BYTE abData[], DWORD* pdwLength)
+{
+	(void) abData;
+	(void) pdwLength;
+	return FALSE;
+}
+
+BOOL CCID_LIB(ProfileWrite)(const BYTE abData[], DWORD dwLength)
+{
+	(void) abData;
+	(void) dwLength;
+	return FALSE;
+}
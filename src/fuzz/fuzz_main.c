@@ -0,0 +1,140 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file fuzz_main.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Fuzz harnesses: main function for AFL and for the replay of a corpus, when libFuzzer is not linked
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include "fuzz.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define FUZZ_MAX_INPUT_LENGTH (1024 * 1024)
+
+static uint8_t abInput[FUZZ_MAX_INPUT_LENGTH];
+
+static int run_file(const char* szPath)
+{
+	FILE* f = fopen(szPath, "rb");
+	size_t size;
+
+	if (f == NULL)
+	{
+		perror(szPath);
+		return -1;
+	}
+	size = fread(abInput, 1, sizeof(abInput), f);
+	fclose(f);
+
+	LLVMFuzzerTestOneInput(abInput, size);
+	return 0;
+}
+
+static int run_path(const char* szPath)
+{
+	struct stat st;
+	DIR* dir;
+	struct dirent* entry;
+	int count = 0;
+
+	if (stat(szPath, &st) != 0)
+	{
+		perror(szPath);
+		return -1;
+	}
+	if (!S_ISDIR(st.st_mode))
+		return (run_file(szPath) == 0) ? 1 : -1;
+
+	dir = opendir(szPath);
+	if (dir == NULL)
+	{
+		perror(szPath);
+		return -1;
+	}
+	while ((entry = readdir(dir)) != NULL)
+	{
+		char szEntry[1024];
+		if (entry->d_name[0] == '.')
+			continue;
+		snprintf(szEntry, sizeof(szEntry), "%s/%s", szPath, entry->d_name);
+		if (run_file(szEntry) != 0)
+		{
+			closedir(dir);
+			return -1;
+		}
+		count++;
+	}
+	closedir(dir);
+	return count;
+}
+
+/**
+ * @brief Run every file given (directories: every file inside), or stdin if there is none (AFL: 'afl-fuzz ... -- <harness> @@' or without @@)
+ */
+int main(int argc, char** argv)
+{
+	int total = 0;
+
+	if (argc < 2)
+	{
+		size_t size = fread(abInput, 1, sizeof(abInput), stdin);
+		LLVMFuzzerTestOneInput(abInput, size);
+		return 0;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		int count = run_path(argv[i]);
+		if (count < 0)
+			return 1;
+		total += count;
+	}
+	fprintf(stderr, "%d input(s) run\n", total);
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file fuzz_receiver.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Fuzz harness: the receiver (CCID_SerialRecvByteFromISR, CCID_SerialRecvBytesFromISR) and CCID_SerialRecv
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include "fuzz.h"
+
+/*
+ * Input: [mode][bytes...]
+ * - mode bit 0 = 0: the bytes go one by one through CCID_SerialRecvByteFromISR
+ * - mode bit 0 = 1: the bytes are chunks of [length][data] for CCID_SerialRecvBytesFromISR
+ * The application retrieves the messages as they come. Whatever the input, once the application has seen a
+ * timeout, the next genuine message must be received at once: a receiver that is stuck on a message that never
+ * completes (or a receiver that looks at the wrong buffer) is a latency bug.
+ */
+
+static BYTE abPayload[CCID_MAX_PAYLOAD_LENGTH];
+
+/* RDR_to_PC_DataBlock, slot 0, sequence 0x5A, R-APDU 90 00 */
+static const BYTE abGenuine[] = { START_BYTE, CCID_COMM_BULK_RDR_TO_PC, RDR_TO_PC_DATABLOCK, 0x02, 0x00, 0x00, 0x00, 0x00, 0x5A, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00 };
+
+static LONG recv(CCID_PACKET_ST* packet)
+{
+	CCID_LIB(PacketInit)(packet);
+	packet->abRecvPayload = abPayload;
+	packet->dwRecvPayloadMaxLen = sizeof(abPayload);
+	return CCID_LIB(SerialRecv)(packet, 0);
+}
+
+/**
+ * @brief Retrieve what has arrived, until the receiver has nothing more (there are two buffers, so three calls always end with a timeout or an error)
+ */
+static void drain(void)
+{
+	CCID_PACKET_ST packet;
+
+	for (int i = 0; i < 3; i++)
+	{
+		LONG rc = recv(&packet);
+		if (rc == SCARD_ERR(S_SUCCESS))
+			FUZZ_ASSERT(packet.Header.p.Length.dw <= CCID_MAX_PAYLOAD_LENGTH);
+		else if ((rc == SCARD_ERR(E_TIMEOUT)) || (rc == SCARD_ERR(E_NOT_READY)))
+			return;
+	}
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	CCID_PACKET_ST packet;
+	BYTE abFrame[sizeof(abGenuine)];
+	LONG rc;
+
+	if (size < 1)
+		return 0;
+
+	fuzz_hal_reset();
+	CCID_LIB(SelectInstance)(0);
+	CCID_LIB(Init)();
+
+	if (data[0] & 0x01)
+	{
+		fuzz_hal_set_input(&data[1], size - 1);
+		while (fuzz_hal_feed() || fuzz_hal_has_input())
+			if (CCID_LIB(WaitWakeup)(0))
+				drain();
+	}
+	else
+	{
+		fuzz_hal_set_input(NULL, 0);
+		for (size_t i = 1; i < size; i++)
+		{
+			CCID_LIB(SerialRecvByteFromISR)(data[i]);
+			if (CCID_LIB(WaitWakeup)(0))
+				drain();
+		}
+	}
+
+	/* The application has waited long enough: whatever has not been completed is lost */
+	fuzz_hal_set_input(NULL, 0);
+	drain();
+
+	/* And the next message goes through */
+	memcpy(abFrame, abGenuine, sizeof(abFrame));
+	for (DWORD i = 1; i < sizeof(abFrame) - 1; i++)
+		abFrame[sizeof(abFrame) - 1] ^= abFrame[i];
+	for (DWORD i = 0; i < sizeof(abFrame); i++)
+		CCID_LIB(SerialRecvByteFromISR)(abFrame[i]);
+
+	rc = recv(&packet);
+	FUZZ_ASSERT(rc == SCARD_ERR(S_SUCCESS));
+	FUZZ_ASSERT(packet.bEndpoint == CCID_COMM_BULK_RDR_TO_PC);
+	FUZZ_ASSERT(packet.Header.p.Data.BulkIn.bSequence == 0x5A);
+	FUZZ_ASSERT(packet.Header.p.Length.dw == 2);
+	FUZZ_ASSERT((abPayload[0] == 0x90) && (abPayload[1] == 0x00));
+
+	return 0;
+}
@@ -0,0 +1,707 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_emulator.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Virtual coupler: software model of a SpringCard serial CCID device (framing, control requests, bulk commands, interrupts)
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_emulator.h"
+#include "../../ccid/ccid_i.h"
+
+#include <ctype.h>
+
+/* Receiver states */
+#define EMU_RECV_IDLE     0
+#define EMU_RECV_ENDPOINT 1
+#define EMU_RECV_HEADER   2
+#define EMU_RECV_PAYLOAD  3
+#define EMU_RECV_CHECKSUM 4
+
+/* Position of the fields in the received message (after the endpoint) */
+#define EMU_POS_REQUEST 1
+#define EMU_POS_LENGTH  2
+#define EMU_POS_SLOT    6
+#define EMU_POS_SEQ     7
+#define EMU_POS_PARAM   8
+#define EMU_POS_PAYLOAD (1 + CCID_HEADER_LENGTH)
+
+/* bStatus of the bulk responses */
+#define EMU_ICC_ACTIVE   0x00
+#define EMU_ICC_INACTIVE 0x01
+#define EMU_ICC_ABSENT   0x02
+#define EMU_CMD_FAILED   0x40
+#define EMU_CMD_TIME_EXT 0x80
+
+/* A PC/SC compliant ATR (contactless storage card, as seen through a SpringCard coupler) */
+static const BYTE emu_atr[] = { 0x3B, 0x8F, 0x80, 0x01, 0x80, 0x4F, 0x0C, 0xA0, 0x00, 0x00, 0x03, 0x06, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x6A };
+
+/* Device descriptor: SpringCard VID, iManufacturer=1, iProduct=2, iSerialNumber=3 */
+static const BYTE emu_device_descriptor[18] = { 18, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x40, 0x34, 0x1C, 0xFF, 0x7F, 0x00, 0x01, 0x01, 0x02, 0x03, 0x01 };
+
+/* Configuration descriptor, alone */
+static const BYTE emu_configuration_descriptor[9] = { 9, 0x02, 9 + 9 + CCID_CLASS_DESCRIPTOR_LENGTH, 0x00, 0x01, 0x01, 0x00, 0x80, 0x32 };
+
+/* Interface descriptor, followed by the CCID class descriptor (bMaxSlotIndex and dwMaxCCIDMessageLength are set at runtime) */
+static const BYTE emu_interface_descriptor[9] = { 9, 0x04, 0x00, 0x00, 0x03, 0x0B, 0x00, 0x00, 0x00 };
+
+static const char* const emu_strings[] = { NULL, "SpringCard", "Virtual CCID coupler", NULL, "Emulator" };
+
+/**
+ * @brief Default configuration: one slot with a card, at the bit rate of a genuine coupler
+ */
+void ccid_emulator_default_config(CCID_EMULATOR_CONFIG_ST* pConfig)
+{
+	memset(pConfig, 0, sizeof(CCID_EMULATOR_CONFIG_ST));
+	pConfig->dwBaudRate = CCID_EMULATOR_DEFAULT_BAUDRATE;
+	pConfig->bSlotCount = 1;
+	pConfig->fCardPresent = TRUE;
+	pConfig->fEchoDelay = TRUE;
+}
+
+/**
+ * @brief Read the configuration from a "comm name" such as "emu:38400", "emu:0,slots=3,nocard", "emu:115200,nodelay,processing=500" or "emu:0,sync"
+ * @note Everything up to the ':' is ignored. The bit rate 0 means memory speed.
+ * @return FALSE if an option is not understood (the ones before are applied)
+ */
+BOOL ccid_emulator_parse_config(CCID_EMULATOR_CONFIG_ST* pConfig, const char* szCommName)
+{
+	const char* p;
+
+	if (szCommName == NULL)
+		return TRUE;
+
+	p = strchr(szCommName, ':');
+	if (p == NULL)
+		return TRUE;
+	p++;
+
+	while (*p != '\0')
+	{
+		const char* szEnd = strchr(p, ',');
+		size_t len = (szEnd != NULL) ? (size_t) (szEnd - p) : strlen(p);
+
+		if ((len > 0) && isdigit((unsigned char) p[0]))
+			pConfig->dwBaudRate = strtoul(p, NULL, 10);
+		else if ((len > 6) && !strncmp(p, "slots=", 6))
+			pConfig->bSlotCount = (BYTE) strtoul(p + 6, NULL, 10);
+		else if ((len > 11) && !strncmp(p, "processing=", 11))
+			pConfig->dwProcessingUs = strtoul(p + 11, NULL, 10);
+		else if ((len == 6) && !strncmp(p, "nocard", 6))
+			pConfig->fCardPresent = FALSE;
+		else if ((len == 7) && !strncmp(p, "nodelay", 7))
+			pConfig->fEchoDelay = FALSE;
+		else if ((len == 4) && !strncmp(p, "sync", 4))
+			pConfig->fSynchronous = TRUE;
+		else if (len > 0)
+			return FALSE;
+
+		p += len;
+		if (*p == ',')
+			p++;
+	}
+
+	if (pConfig->bSlotCount == 0)
+		pConfig->bSlotCount = 1;
+	if (pConfig->bSlotCount > CCID_EMULATOR_MAX_SLOT_COUNT)
+		pConfig->bSlotCount = CCID_EMULATOR_MAX_SLOT_COUNT;
+
+	return TRUE;
+}
+
+/**
+ * @brief Power-on state of the virtual coupler: not started, receiver idle, cards as per the configuration
+ */
+void ccid_emulator_reset(CCID_EMULATOR_DEVICE_ST* device, const CCID_EMULATOR_CONFIG_ST* pConfig, BYTE bInstance)
+{
+	memset(device, 0, sizeof(CCID_EMULATOR_DEVICE_ST));
+	memcpy(&device->Config, pConfig, sizeof(CCID_EMULATOR_CONFIG_ST));
+	device->bInstance = bInstance;
+
+	for (BYTE bSlot = 0; bSlot < device->Config.bSlotCount; bSlot++)
+	{
+		device->aSlots[bSlot].fPresent = device->Config.fCardPresent;
+		device->aSlots[bSlot].bFiDi = 0x11;
+	}
+}
+
+/**
+ * @brief Drop the message being received (e.g. after a BREAK)
+ */
+void ccid_emulator_reset_receiver(CCID_EMULATOR_DEVICE_ST* device)
+{
+	device->bRecvStatus = EMU_RECV_IDLE;
+	device->dwRecvOffset = 0;
+}
+
+/**
+ * @brief Feed the receiver of the virtual coupler with one byte coming from the host
+ * @note Bytes outside of a message, too long messages and wrong checksums are dropped silently, as the genuine coupler does
+ * @return TRUE when a complete and valid message has been received, ccid_emulator_process shall be called
+ */
+BOOL ccid_emulator_recv_byte(CCID_EMULATOR_DEVICE_ST* device, BYTE bValue)
+{
+	switch (device->bRecvStatus)
+	{
+		case EMU_RECV_IDLE:
+			if (bValue == START_BYTE)
+				device->bRecvStatus = EMU_RECV_ENDPOINT;
+		break;
+
+		case EMU_RECV_ENDPOINT:
+			device->abRecvMessage[0] = bValue;
+			device->bRecvChecksum = bValue;
+			device->dwRecvOffset = 1;
+			device->dwRecvLength = 1 + CCID_HEADER_LENGTH;
+			device->bRecvStatus = EMU_RECV_HEADER;
+		break;
+
+		case EMU_RECV_HEADER:
+		case EMU_RECV_PAYLOAD:
+			device->abRecvMessage[device->dwRecvOffset++] = bValue;
+			device->bRecvChecksum ^= bValue;
+			if (device->dwRecvOffset < device->dwRecvLength)
+				break;
+
+			if (device->bRecvStatus == EMU_RECV_HEADER)
+			{
+				DWORD dwLength = utohl(&device->abRecvMessage[EMU_POS_LENGTH]);
+
+				if (dwLength > CCID_MAX_PAYLOAD_LENGTH)
+				{
+					ccid_emulator_reset_receiver(device);
+					break;
+				}
+				if (dwLength)
+				{
+					device->dwRecvLength += dwLength;
+					device->bRecvStatus = EMU_RECV_PAYLOAD;
+					break;
+				}
+			}
+			device->bRecvStatus = EMU_RECV_CHECKSUM;
+		break;
+
+		case EMU_RECV_CHECKSUM:
+			device->bRecvStatus = EMU_RECV_IDLE;
+			return (device->bRecvChecksum == bValue);
+
+		default:
+			ccid_emulator_reset_receiver(device);
+	}
+
+	return FALSE;
+}
+
+/**
+ * @internal
+ * @brief Wrap a message into a frame: START_BYTE, endpoint, header, payload, checksum
+ * @param abFrame the frame, whose header and payload are already in place at offset 2
+ * @return length of the frame
+ */
+static DWORD emu_frame(BYTE abFrame[], BYTE bEndpoint, BYTE bRequest, DWORD dwPayloadLength, BYTE abParams[5])
+{
+	DWORD dwLength = 2 + CCID_HEADER_LENGTH + dwPayloadLength;
+	BYTE bChecksum = 0;
+
+	abFrame[0] = START_BYTE;
+	abFrame[1] = bEndpoint;
+	abFrame[2] = bRequest;
+	htoul(&abFrame[3], dwPayloadLength);
+	memcpy(&abFrame[7], abParams, 5);
+
+	for (DWORD i = 1; i < dwLength; i++)
+		bChecksum ^= abFrame[i];
+	abFrame[dwLength] = bChecksum;
+
+	return dwLength + 1;
+}
+
+/**
+ * @internal
+ * @brief Where the payload of a response goes in the frame
+ */
+static BYTE* emu_payload(BYTE abFrame[])
+{
+	return &abFrame[2 + CCID_HEADER_LENGTH];
+}
+
+/**
+ * @internal
+ * @brief bStatus of a slot that has received a command
+ */
+static BYTE emu_icc_status(const CCID_EMULATOR_SLOT_ST* slot)
+{
+	if (!slot->fPresent)
+		return EMU_ICC_ABSENT;
+	if (!slot->fPowered)
+		return EMU_ICC_INACTIVE;
+	return EMU_ICC_ACTIVE;
+}
+
+/**
+ * @internal
+ * @brief Build a USB string descriptor (UTF-16LE)
+ */
+static DWORD emu_string_descriptor(BYTE abDescriptor[], const char* szValue)
+{
+	DWORD dwLength = 2;
+
+	while ((*szValue != '\0') && (dwLength < 64))
+	{
+		abDescriptor[dwLength++] = (BYTE) *szValue++;
+		abDescriptor[dwLength++] = 0x00;
+	}
+	abDescriptor[0] = (BYTE) dwLength;
+	abDescriptor[1] = 0x03;
+
+	return dwLength;
+}
+
+/**
+ * @internal
+ * @brief Build the CCID class descriptor of the virtual coupler
+ */
+static DWORD emu_class_descriptor(const CCID_EMULATOR_DEVICE_ST* device, BYTE abDescriptor[])
+{
+	memset(abDescriptor, 0, CCID_CLASS_DESCRIPTOR_LENGTH);
+
+	abDescriptor[0] = CCID_CLASS_DESCRIPTOR_LENGTH;
+	abDescriptor[1] = CCID_DESCRIPTOR_TYPE_CLASS;
+	htous(&abDescriptor[2], 0x0110); /* bcdCCID */
+	abDescriptor[4] = device->Config.bSlotCount - 1; /* bMaxSlotIndex */
+	abDescriptor[5] = 0x07; /* bVoltageSupport */
+	htoul(&abDescriptor[6], 0x00000003); /* dwProtocols: T=0 and T=1 */
+	htoul(&abDescriptor[10], 4000); /* dwDefaultClock */
+	htoul(&abDescriptor[14], 4000); /* dwMaximumClock */
+	htoul(&abDescriptor[19], (device->Config.dwBaudRate != 0) ? device->Config.dwBaudRate : 10752); /* dwDataRate */
+	htoul(&abDescriptor[23], 344086); /* dwMaxDataRate */
+	htoul(&abDescriptor[28], 254); /* dwMaxIFSD */
+	htoul(&abDescriptor[40], CCID_FEATURE_AUTO_PARAMETERS | CCID_FEATURE_AUTO_NEGOTIATION | CCID_FEATURE_LEVEL_SHORT_APDU); /* dwFeatures */
+	htoul(&abDescriptor[44], CCID_EMULATOR_MAX_MESSAGE_LENGTH); /* dwMaxCCIDMessageLength */
+	abDescriptor[48] = 0xFF; /* bClassGetResponse */
+	abDescriptor[49] = 0xFF; /* bClassEnvelope */
+	abDescriptor[53] = 1; /* bMaxCCIDBusySlots */
+
+	return CCID_CLASS_DESCRIPTOR_LENGTH;
+}
+
+/**
+ * @internal
+ * @brief Answer a control request (GET_STATUS, GET_DESCRIPTOR, SET_CONFIGURATION)
+ */
+static DWORD emu_process_control(CCID_EMULATOR_DEVICE_ST* device, BYTE abFrame[])
+{
+	const BYTE* abMessage = device->abRecvMessage;
+	BYTE* abPayload = emu_payload(abFrame);
+	BYTE abParams[5];
+	DWORD dwLength = 0;
+
+	/* wValue and wIndex are echoed, the last byte is the status */
+	memcpy(abParams, &abMessage[EMU_POS_SLOT], 5);
+	abParams[4] = 0x00;
+
+	switch (abMessage[EMU_POS_REQUEST])
+	{
+		case GET_STATUS:
+		break;
+
+		case SET_CONFIGURATION:
+			device->fStarted = (abMessage[EMU_POS_SLOT] != 0);
+			device->fNotifications = device->fStarted && (abMessage[EMU_POS_PARAM + 2] != 0);
+			abParams[4] = device->fStarted ? 0x01 : 0x00;
+		break;
+
+		case GET_DESCRIPTOR:
+		{
+			BYTE bType = abMessage[EMU_POS_SLOT];
+			BYTE bIndex = abMessage[EMU_POS_SEQ];
+
+			switch (bType)
+			{
+				case 1:
+					memcpy(abPayload, emu_device_descriptor, sizeof(emu_device_descriptor));
+					dwLength = sizeof(emu_device_descriptor);
+				break;
+				case 2:
+					memcpy(abPayload, emu_configuration_descriptor, sizeof(emu_configuration_descriptor));
+					dwLength = sizeof(emu_configuration_descriptor);
+				break;
+				case 3:
+					if (bIndex == 0)
+					{
+						/* Supported languages: English (US) */
+						abPayload[0] = 4;
+						abPayload[1] = 0x03;
+						htous(&abPayload[2], 0x0409);
+						dwLength = 4;
+					}
+					else if (bIndex == 3)
+					{
+						/* Every instance has its own serial number */
+						char szSerialNumber[16];
+						snprintf(szSerialNumber, sizeof(szSerialNumber), "EMU%05u", device->bInstance);
+						dwLength = emu_string_descriptor(abPayload, szSerialNumber);
+					}
+					else if (bIndex < sizeof(emu_strings) / sizeof(emu_strings[0]))
+					{
+						dwLength = emu_string_descriptor(abPayload, emu_strings[bIndex]);
+					}
+					else
+					{
+						abParams[4] = 0xFF;
+					}
+				break;
+				case CCID_DESCRIPTOR_TYPE_INTERFACE:
+					memcpy(abPayload, emu_interface_descriptor, sizeof(emu_interface_descriptor));
+					dwLength = sizeof(emu_interface_descriptor);
+					dwLength += emu_class_descriptor(device, &abPayload[dwLength]);
+				break;
+				default:
+					abParams[4] = 0xFF;
+			}
+		}
+		break;
+
+		default:
+			abParams[4] = 0xFF;
+	}
+
+	return emu_frame(abFrame, CCID_COMM_CONTROL_TO_PC, abMessage[EMU_POS_REQUEST], dwLength, abParams);
+}
+
+/**
+ * @internal
+ * @brief Execute an APDU, either received through PC_to_RDR_XfrBlock or through PC_to_RDR_Escape
+ * Two instructions are implemented:
+ * - GET DATA (CLA=FF, INS=CA, P1=00): the UID of the card
+ * - the vendor ECHO instruction (CLA=FF, INS=FD, P2=0x80|delay in seconds): it returns Le bytes (the data sent, if Lc=Le), and 9000
+ * @return length of the response, status word included
+ */
+static DWORD emu_process_apdu(CCID_EMULATOR_DEVICE_ST* device, const BYTE abApdu[], DWORD dwApduLength, BYTE abResponse[])
+{
+	DWORD dwLc = 0, dwLe = 0;
+
+	if (dwApduLength < 4)
+	{
+		abResponse[0] = 0x67;
+		abResponse[1] = 0x00;
+		return 2;
+	}
+
+	if ((abApdu[0] == 0xFF) && (abApdu[1] == 0xCA) && (abApdu[2] == 0x00))
+	{
+		abResponse[0] = 0xE0;
+		abResponse[1] = 0x4D;
+		abResponse[2] = 0x55;
+		abResponse[3] = device->bInstance;
+		abResponse[4] = 0x90;
+		abResponse[5] = 0x00;
+		return 6;
+	}
+
+	if ((abApdu[0] != 0xFF) || (abApdu[1] != 0xFD))
+	{
+		abResponse[0] = 0x6D;
+		abResponse[1] = 0x00;
+		return 2;
+	}
+
+	if (dwApduLength == 5)
+	{
+		/* Case 2 */
+		dwLe = abApdu[4] ? abApdu[4] : 256;
+	}
+	else if (dwApduLength > 5)
+	{
+		dwLc = abApdu[4];
+		if (dwApduLength == 6 + dwLc)
+		{
+			/* Case 4 */
+			dwLe = abApdu[5 + dwLc] ? abApdu[5 + dwLc] : 256;
+		}
+		else if (dwApduLength != 5 + dwLc)
+		{
+			abResponse[0] = 0x67;
+			abResponse[1] = 0x00;
+			return 2;
+		}
+	}
+
+	/* Send back the data (if some), repeated to make Le */
+	for (DWORD i = 0; i < dwLe; i++)
+		abResponse[i] = dwLc ? abApdu[5 + (i % dwLc)] : (BYTE) i;
+	abResponse[dwLe] = 0x90;
+	abResponse[dwLe + 1] = 0x00;
+
+	if (device->Config.fEchoDelay && (abApdu[3] & 0x80))
+		device->dwDelayMs = 1000UL * (abApdu[3] & 0x3F);
+
+	return dwLe + 2;
+}
+
+/**
+ * @internal
+ * @brief Answer a PC_to_RDR_Escape: slot count (58 20 80), or an APDU for the coupler itself (e.g. ECHO)
+ */
+static DWORD emu_process_escape(CCID_EMULATOR_DEVICE_ST* device, const BYTE abCommand[], DWORD dwCommandLength, BYTE abResponse[], BYTE* pbError)
+{
+	if ((dwCommandLength == 3) && (abCommand[0] == 0x58) && (abCommand[1] == 0x20) && (abCommand[2] == 0x80))
+	{
+		abResponse[0] = 0x00;
+		abResponse[1] = device->Config.bSlotCount;
+		return 2;
+	}
+
+	if ((dwCommandLength >= 4) && (abCommand[0] == 0xFF))
+		return emu_process_apdu(device, abCommand, dwCommandLength, abResponse);
+
+	*pbError = CCID_ERR_CMD_NOT_SUPPORTED;
+	return 0;
+}
+
+/**
+ * @internal
+ * @brief Answer a bulk command
+ */
+static DWORD emu_process_bulk(CCID_EMULATOR_DEVICE_ST* device, BYTE abFrame[])
+{
+	const BYTE* abMessage = device->abRecvMessage;
+	const BYTE* abCommand = &abMessage[EMU_POS_PAYLOAD];
+	DWORD dwCommandLength = utohl(&abMessage[EMU_POS_LENGTH]);
+	BYTE bSlot = abMessage[EMU_POS_SLOT];
+	BYTE* abPayload = emu_payload(abFrame);
+	BYTE bResponse = RDR_TO_PC_SLOTSTATUS;
+	BYTE bError = 0;
+	DWORD dwLength = 0;
+	CCID_EMULATOR_SLOT_ST* slot;
+	BYTE abParams[5];
+
+	if (bSlot >= device->Config.bSlotCount)
+	{
+		abParams[0] = bSlot;
+		abParams[1] = abMessage[EMU_POS_SEQ];
+		abParams[2] = EMU_CMD_FAILED | EMU_ICC_ABSENT;
+		abParams[3] = CCID_ERR_BAD_SLOT;
+		abParams[4] = 0;
+		return emu_frame(abFrame, CCID_COMM_BULK_RDR_TO_PC, bResponse, 0, abParams);
+	}
+
+	slot = &device->aSlots[bSlot];
+
+	switch (abMessage[EMU_POS_REQUEST])
+	{
+		case PC_TO_RDR_GETSLOTSTATUS:
+		break;
+
+		case PC_TO_RDR_ICCPOWERON:
+			bResponse = RDR_TO_PC_DATABLOCK;
+			if (!slot->fPresent)
+			{
+				bError = CCID_ERR_ICC_MUTE;
+				break;
+			}
+			slot->fPowered = TRUE;
+			slot->bFiDi = 0x11;
+			memcpy(abPayload, emu_atr, sizeof(emu_atr));
+			dwLength = sizeof(emu_atr);
+		break;
+
+		case PC_TO_RDR_ICCPOWEROFF:
+			slot->fPowered = FALSE;
+		break;
+
+		case PC_TO_RDR_XFRBLOCK:
+			bResponse = RDR_TO_PC_DATABLOCK;
+			if (!slot->fPresent || !slot->fPowered)
+			{
+				bError = CCID_ERR_ICC_MUTE;
+				break;
+			}
+			dwLength = emu_process_apdu(device, abCommand, dwCommandLength, abPayload);
+		break;
+
+		case PC_TO_RDR_ESCAPE:
+			/* The coupler answers whatever the card is */
+			bResponse = RDR_TO_PC_ESCAPE;
+			dwLength = emu_process_escape(device, abCommand, dwCommandLength, abPayload, &bError);
+		break;
+
+		case PC_TO_RDR_SETPARAMETERS:
+		case PC_TO_RDR_GETPARAMETERS:
+		case PC_TO_RDR_RESETPARAMETERS:
+			bResponse = RDR_TO_PC_PARAMETERS;
+			if (!slot->fPresent)
+			{
+				bError = CCID_ERR_ICC_MUTE;
+				break;
+			}
+			if (abMessage[EMU_POS_REQUEST] == PC_TO_RDR_RESETPARAMETERS)
+				slot->bFiDi = 0x11;
+			else if ((abMessage[EMU_POS_REQUEST] == PC_TO_RDR_SETPARAMETERS) && (dwCommandLength >= 1))
+				slot->bFiDi = abCommand[0];
+			/* T=0: bmFindexDindex, bmTCCKST0, bGuardTimeT0, bWaitingIntegerT0, bClockStop */
+			abPayload[0] = slot->bFiDi;
+			abPayload[1] = 0x00;
+			abPayload[2] = 0x00;
+			abPayload[3] = 0x0A;
+			abPayload[4] = 0x00;
+			dwLength = 5;
+		break;
+
+		default:
+			bError = CCID_ERR_CMD_NOT_SUPPORTED;
+	}
+
+	abParams[0] = bSlot;
+	abParams[1] = abMessage[EMU_POS_SEQ];
+	abParams[2] = emu_icc_status(slot);
+	abParams[3] = bError;
+	abParams[4] = 0;
+
+	if (bError)
+	{
+		abParams[2] |= EMU_CMD_FAILED;
+		dwLength = 0;
+	}
+
+	return emu_frame(abFrame, CCID_COMM_BULK_RDR_TO_PC, bResponse, dwLength, abParams);
+}
+
+/**
+ * @brief Execute the message that has just been received, and build the response
+ * @param abFrame buffer for the response, CCID_EMULATOR_MAX_FRAME_LENGTH bytes
+ * @return length of the response frame, 0 if the message gets no response
+ * @note If device->dwDelayMs is not 0 afterwards, the response shall be sent after this delay, with time extensions meanwhile
+ */
+DWORD ccid_emulator_process(CCID_EMULATOR_DEVICE_ST* device, BYTE abFrame[])
+{
+	device->dwDelayMs = 0;
+
+	switch (device->abRecvMessage[0])
+	{
+		case CCID_COMM_CONTROL_TO_RDR:
+			return emu_process_control(device, abFrame);
+		case CCID_COMM_BULK_PC_TO_RDR:
+			return emu_process_bulk(device, abFrame);
+		default:
+			return 0;
+	}
+}
+
+/**
+ * @brief Build a time extension for the bulk command in progress
+ * @return length of the frame
+ */
+DWORD ccid_emulator_time_extension(CCID_EMULATOR_DEVICE_ST* device, BYTE abFrame[])
+{
+	const BYTE* abMessage = device->abRecvMessage;
+	BYTE bResponse = (abMessage[EMU_POS_REQUEST] == PC_TO_RDR_ESCAPE) ? RDR_TO_PC_ESCAPE : RDR_TO_PC_DATABLOCK;
+	BYTE abParams[5];
+
+	abParams[0] = abMessage[EMU_POS_SLOT];
+	abParams[1] = abMessage[EMU_POS_SEQ];
+	abParams[2] = EMU_CMD_TIME_EXT;
+	abParams[3] = 1; /* BWT multiplier */
+	abParams[4] = 0;
+
+	return emu_frame(abFrame, CCID_COMM_BULK_RDR_TO_PC, bResponse, 0, abParams);
+}
+
+/**
+ * @brief Build a RDR_to_PC_NotifySlotChange if some slot has changed and the host wants the notifications
+ * @return length of the frame, 0 if there is nothing to notify
+ */
+DWORD ccid_emulator_notify(CCID_EMULATOR_DEVICE_ST* device, BYTE abFrame[])
+{
+	BYTE* abPayload = emu_payload(abFrame);
+	DWORD dwLength = (device->Config.bSlotCount + 3) / 4;
+	BOOL fChanged = FALSE;
+	BYTE abParams[5] = { 0 };
+
+	if (!device->fNotifications)
+		return 0;
+
+	memset(abPayload, 0, dwLength);
+	for (BYTE bSlot = 0; bSlot < device->Config.bSlotCount; bSlot++)
+	{
+		CCID_EMULATOR_SLOT_ST* slot = &device->aSlots[bSlot];
+
+		if (slot->fPresent)
+			abPayload[bSlot / 4] |= 0x01 << (2 * (bSlot % 4));
+		if (slot->fChanged)
+		{
+			abPayload[bSlot / 4] |= 0x02 << (2 * (bSlot % 4));
+			slot->fChanged = FALSE;
+			fChanged = TRUE;
+		}
+	}
+
+	if (!fChanged)
+		return 0;
+
+	return emu_frame(abFrame, CCID_COMM_INTERRUPT_RDR_TO_PC, RDR_TO_PC_INTERRUPT, dwLength, abParams);
+}
+
+/**
+ * @brief Insert or remove the card of a slot
+ */
+void ccid_emulator_set_card_present(CCID_EMULATOR_DEVICE_ST* device, BYTE bSlot, BOOL fPresent)
+{
+	CCID_EMULATOR_SLOT_ST* slot;
+
+	if (bSlot >= device->Config.bSlotCount)
+		return;
+
+	slot = &device->aSlots[bSlot];
+	if (slot->fPresent == fPresent)
+		return;
+
+	slot->fPresent = fPresent;
+	slot->fPowered = FALSE;
+	slot->fChanged = TRUE;
+}
@@ -0,0 +1,160 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_emulator.h
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Virtual coupler: a software model of a SpringCard serial CCID device, and its configuration
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#ifndef __CCID_EMULATOR_H__
+#define __CCID_EMULATOR_H__
+
+#include <project.h>
+
+#include "../../pcsc-serial.h"
+#include "../../ccid/ccid.h"
+#include "../../ccid/ccid_constants.h"
+
+/* Bit rate of a genuine coupler */
+#define CCID_EMULATOR_DEFAULT_BAUDRATE 38400
+/* The longest message the virtual coupler accepts (CCID header included) */
+#define CCID_EMULATOR_MAX_MESSAGE_LENGTH (CCID_HEADER_LENGTH + CCID_MAX_PAYLOAD_LENGTH)
+/* The virtual coupler may have more slots than the driver supports (CCID_MAX_SLOT_COUNT), to check that it only uses the first ones */
+#define CCID_EMULATOR_MAX_SLOT_COUNT 16
+/* A time extension is sent this often while a command is running */
+#define CCID_EMULATOR_TIME_EXTENSION_MS 500
+
+/**
+ * @brief Configuration of the virtual coupler of an instance
+ */
+typedef struct
+{
+	DWORD dwBaudRate; /*!< Bit rate of the wire model, 0 to exchange at memory speed */
+	DWORD dwProcessingUs; /*!< Time the coupler takes to process every command, in microseconds */
+	BYTE bSlotCount; /*!< Number of slots, up to CCID_EMULATOR_MAX_SLOT_COUNT */
+	BOOL fCardPresent; /*!< Is there a card in every slot when the coupler starts? */
+	BOOL fEchoDelay; /*!< Does the ECHO instruction really wait for the delay given in P2? */
+	BOOL fSynchronous; /*!< Does the coupler answer within CCID_SerialSendBytes, before it returns (emulator HAL only)? */
+} CCID_EMULATOR_CONFIG_ST;
+
+/**
+ * @brief State of a slot of the virtual coupler
+ */
+typedef struct
+{
+	BOOL fPresent;
+	BOOL fPowered;
+	BOOL fChanged; /*!< Not notified to the host yet */
+	BYTE bFiDi;
+} CCID_EMULATOR_SLOT_ST;
+
+/**
+ * @brief State of the virtual coupler: its receiver (framing) and its slots
+ */
+typedef struct
+{
+	CCID_EMULATOR_CONFIG_ST Config;
+	BYTE bInstance;
+	BOOL fStarted; /*!< SET_CONFIGURATION(1) has been received */
+	BOOL fNotifications; /*!< The host wants the Interrupt messages */
+	CCID_EMULATOR_SLOT_ST aSlots[CCID_EMULATOR_MAX_SLOT_COUNT];
+	/* Receiver */
+	BYTE bRecvStatus;
+	BYTE bRecvChecksum;
+	DWORD dwRecvOffset;
+	DWORD dwRecvLength;
+	BYTE abRecvMessage[1 + CCID_EMULATOR_MAX_MESSAGE_LENGTH]; /*!< Endpoint, header and payload */
+	/* Command in progress */
+	DWORD dwDelayMs; /*!< Extra time the last command takes, time extensions are sent meanwhile */
+} CCID_EMULATOR_DEVICE_ST;
+
+/**
+ * @brief State of a virtual coupler that plays a capture back (comm name "replay:<file>", see ccid_replay_load)
+ * @note The bytes the host sends are compared with the TX records; every RX record is sent at the time it has in the capture, counted from the beginning of the last TX record
+ */
+typedef struct
+{
+	BYTE* abCapture; /*!< The whole file */
+	DWORD dwCaptureLength;
+	BYTE bInstance; /*!< The instance of the capture that is played */
+	double dSpeed; /*!< 1 to play at the original timing, 10 ten times faster, 0 without waiting at all */
+	CCID_CAPTURE_READER_ST Reader;
+	CCID_CAPTURE_RECORD_ST Record; /*!< The next record to play */
+	BOOL fRecord; /*!< FALSE once the capture is over */
+	DWORD dwRecordIndex;
+	DWORD dwMatched; /*!< Bytes of the TX record that the host has sent already */
+	DWORD dwAnchorTimeUs; /*!< Time of the last TX record that the host has begun to send */
+	BOOL fDiverged; /*!< The host has not sent what the capture says (reported once) */
+} CCID_REPLAY_ST;
+
+/* Max length of a message sent by the virtual coupler, START_BYTE and checksum included */
+#define CCID_EMULATOR_MAX_FRAME_LENGTH (3 + CCID_EMULATOR_MAX_MESSAGE_LENGTH)
+
+/* Configuration of the virtual coupler of the selected instance, before CCID_SerialOpen */
+void CCID_LIB(EmulatorGetConfig)(CCID_EMULATOR_CONFIG_ST* pConfig);
+void CCID_LIB(EmulatorSetConfig)(const CCID_EMULATOR_CONFIG_ST* pConfig);
+/* Insert or remove the card of a slot of the virtual coupler of the selected instance */
+void CCID_LIB(EmulatorSetCardPresent)(BYTE bSlot, BOOL fPresent);
+
+/* The model itself, independent from the wire and from the threads */
+void ccid_emulator_default_config(CCID_EMULATOR_CONFIG_ST* pConfig);
+BOOL ccid_emulator_parse_config(CCID_EMULATOR_CONFIG_ST* pConfig, const char* szCommName);
+void ccid_emulator_reset(CCID_EMULATOR_DEVICE_ST* device, const CCID_EMULATOR_CONFIG_ST* pConfig, BYTE bInstance);
+void ccid_emulator_reset_receiver(CCID_EMULATOR_DEVICE_ST* device);
+BOOL ccid_emulator_recv_byte(CCID_EMULATOR_DEVICE_ST* device, BYTE bValue);
+DWORD ccid_emulator_process(CCID_EMULATOR_DEVICE_ST* device, BYTE abFrame[]);
+DWORD ccid_emulator_time_extension(CCID_EMULATOR_DEVICE_ST* device, BYTE abFrame[]);
+DWORD ccid_emulator_notify(CCID_EMULATOR_DEVICE_ST* device, BYTE abFrame[]);
+void ccid_emulator_set_card_present(CCID_EMULATOR_DEVICE_ST* device, BYTE bSlot, BOOL fPresent);
+
+/* Play a capture back instead of running the model */
+BOOL ccid_replay_load(CCID_REPLAY_ST* replay, const char* szCommName, BYTE bDefaultInstance);
+void ccid_replay_rewind(CCID_REPLAY_ST* replay);
+void ccid_replay_next(CCID_REPLAY_ST* replay);
+BOOL ccid_replay_host_byte(CCID_REPLAY_ST* replay, BYTE bValue);
+
+#endif
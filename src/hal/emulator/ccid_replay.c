@@ -0,0 +1,231 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_replay.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Virtual coupler that plays a capture of the serial traffic back (see CCID_CaptureFileStart)
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include "ccid_emulator.h"
+
+#include <ctype.h>
+
+/**
+ * @internal
+ * @brief Tell once that the host does not follow the capture
+ */
+static void ccid_replay_diverge(CCID_REPLAY_ST* replay, const char* szWhat)
+{
+	if (replay->fDiverged)
+		return;
+	replay->fDiverged = TRUE;
+	fprintf(stderr, "Replay: %s at record %lu, the responses may not make sense from now on\n", szWhat, replay->dwRecordIndex);
+}
+
+/**
+ * @brief Load the capture given by a "comm name" such as "replay:session.ccap", "replay:session.ccap,speed=10" or "replay:session.ccap,speed=0,instance=1"
+ * @note The speed multiplies the pace of the capture (0: do not wait at all). By default the instance of the capture is the one of the port.
+ * @return FALSE if the file can not be read, is not a capture, or if an option is not understood
+ */
+BOOL ccid_replay_load(CCID_REPLAY_ST* replay, const char* szCommName, BYTE bDefaultInstance)
+{
+	char szFileName[256];
+	const char* p;
+	size_t len;
+	FILE* fp;
+	long size;
+
+	free(replay->abCapture);
+	memset(replay, 0, sizeof(CCID_REPLAY_ST));
+	replay->bInstance = bDefaultInstance;
+	replay->dSpeed = 1;
+
+	if (szCommName == NULL)
+		return FALSE;
+
+	p = strchr(szCommName, ':');
+	if (p == NULL)
+		return FALSE;
+	p++;
+
+	len = strcspn(p, ",");
+	if ((len == 0) || (len >= sizeof(szFileName)))
+		return FALSE;
+	memcpy(szFileName, p, len);
+	szFileName[len] = '\0';
+	p += len;
+
+	while (*p == ',')
+	{
+		p++;
+		len = strcspn(p, ",");
+		if ((len > 6) && !strncmp(p, "speed=", 6) && (isdigit((unsigned char) p[6]) || (p[6] == '.')))
+			replay->dSpeed = strtod(p + 6, NULL);
+		else if ((len > 9) && !strncmp(p, "instance=", 9))
+			replay->bInstance = (BYTE) strtoul(p + 9, NULL, 10);
+		else if (len > 0)
+			return FALSE;
+		p += len;
+	}
+
+	fp = fopen(szFileName, "rb");
+	if (fp == NULL)
+	{
+		perror(szFileName);
+		return FALSE;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if (size > 0)
+		replay->abCapture = malloc((size_t) size);
+	if ((replay->abCapture == NULL) || (fread(replay->abCapture, 1, (size_t) size, fp) != (size_t) size))
+	{
+		fprintf(stderr, "%s: failed to read the capture\n", szFileName);
+		fclose(fp);
+		free(replay->abCapture);
+		replay->abCapture = NULL;
+		return FALSE;
+	}
+	fclose(fp);
+	replay->dwCaptureLength = (DWORD) size;
+
+	if (!CCID_LIB(CaptureReaderInit)(&replay->Reader, replay->abCapture, replay->dwCaptureLength))
+	{
+		fprintf(stderr, "%s: not a capture\n", szFileName);
+		free(replay->abCapture);
+		replay->abCapture = NULL;
+		return FALSE;
+	}
+
+	ccid_replay_rewind(replay);
+	return TRUE;
+}
+
+/**
+ * @brief Go back to the beginning of the capture (the port is opened again)
+ */
+void ccid_replay_rewind(CCID_REPLAY_ST* replay)
+{
+	if (replay->abCapture == NULL)
+		return;
+
+	CCID_LIB(CaptureReaderInit)(&replay->Reader, replay->abCapture, replay->dwCaptureLength);
+	replay->fRecord = TRUE;
+	replay->dwMatched = 0;
+	replay->dwAnchorTimeUs = 0;
+	replay->fDiverged = FALSE;
+	replay->Record.dwTimeUs = 0;
+
+	/* Position on the first record of our instance */
+	replay->dwRecordIndex = (DWORD) -1;
+	ccid_replay_next(replay);
+}
+
+/**
+ * @brief Go to the next TX or RX record of the instance
+ */
+void ccid_replay_next(CCID_REPLAY_ST* replay)
+{
+	replay->dwMatched = 0;
+
+	while (replay->fRecord)
+	{
+		replay->dwRecordIndex++;
+
+		if (!CCID_LIB(CaptureReaderNext)(&replay->Reader, &replay->Record))
+		{
+			if (replay->Reader.dwOffset < replay->Reader.dwLength)
+				fprintf(stderr, "Replay: the capture is truncated after record %lu\n", replay->dwRecordIndex);
+			replay->fRecord = FALSE;
+			break;
+		}
+
+		if (replay->Record.bInstance != replay->bInstance)
+			continue;
+
+		if (replay->Record.bType == CCID_CAPTURE_LOST)
+		{
+			fprintf(stderr, "Replay: the capture has lost %lu record(s) before record %lu\n", replay->Record.dwLength, replay->dwRecordIndex);
+			continue;
+		}
+
+		if ((replay->Record.bType == CCID_CAPTURE_TX) || (replay->Record.bType == CCID_CAPTURE_RX))
+			break;
+	}
+}
+
+/**
+ * @brief A byte the host has sent: compare it with the TX record
+ * @return TRUE if the byte begins a TX record; the time of the capture is then replay->dwAnchorTimeUs
+ */
+BOOL ccid_replay_host_byte(CCID_REPLAY_ST* replay, BYTE bValue)
+{
+	BOOL fBegin = FALSE;
+
+	if (!replay->fRecord || (replay->Record.bType != CCID_CAPTURE_TX))
+	{
+		ccid_replay_diverge(replay, replay->fRecord ? "the host sends before the coupler has answered" : "the host sends after the end of the capture");
+		return FALSE;
+	}
+
+	if (replay->dwMatched == 0)
+	{
+		replay->dwAnchorTimeUs = replay->Record.dwTimeUs;
+		fBegin = TRUE;
+	}
+
+	if (bValue != replay->Record.abData[replay->dwMatched])
+		ccid_replay_diverge(replay, "the host sends other bytes than the capture");
+
+	if (++replay->dwMatched >= replay->Record.dwLength)
+		ccid_replay_next(replay);
+
+	return fBegin;
+}
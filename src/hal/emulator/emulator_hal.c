@@ -0,0 +1,790 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file emulator_hal.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Hardware abstraction layer for the CCID serial driver, talking to a virtual coupler instead of a comm port (POSIX)
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include <project.h>
+
+#include "../../pcsc-serial.h"
+#include "../../ccid/ccid.h"
+#include "../../ccid/ccid_hal.h"
+#include "../../scard/scard_errors.h"
+#include "ccid_emulator.h"
+
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+
+/* Bytes sent by the host that the virtual coupler has not consumed yet */
+#define CCID_EMULATOR_QUEUE_SIZE 1024
+
+typedef struct
+{
+	BOOL fInitialized;
+	const char* szCommName;
+	volatile BOOL fCommOpen;
+	BOOL fThreadRunning;
+	BOOL fStop;
+	BYTE bInstance;
+	pthread_t threadId;
+	/* Protects everything below, and wakes up the coupler thread */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	CCID_EMULATOR_CONFIG_ST Config;
+	CCID_EMULATOR_DEVICE_ST Device;
+	/* Host to coupler: the bytes, and the time each one reaches the coupler */
+	BYTE abQueue[CCID_EMULATOR_QUEUE_SIZE];
+	uint64_t aqwQueueArrivalUs[CCID_EMULATOR_QUEUE_SIZE];
+	DWORD dwQueueHead;
+	DWORD dwQueueCount;
+	/* Each direction of the wire is busy until then */
+	uint64_t qwHostLineFreeUs;
+	uint64_t qwDeviceLineFreeUs;
+	BYTE abFrame[CCID_EMULATOR_MAX_FRAME_LENGTH];
+	BYTE abTimeExtension[3 + CCID_HEADER_LENGTH];
+	/* The coupler plays a capture back instead of running the model */
+	BOOL fReplay;
+	BOOL fReplayLoaded;
+	CCID_REPLAY_ST Replay;
+	uint64_t qwReplayAnchorUs; /* When the host has begun to send the last TX record */
+} CCID_EMULATOR_PORT_ST;
+
+static CCID_EMULATOR_PORT_ST ccid_ports[CCID_MAX_INSTANCE_COUNT];
+
+static pthread_mutex_t ccid_wakeup_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ccid_wakeup_cond; /* Uses CLOCK_MONOTONIC, see ccid_wakeup_init */
+static pthread_once_t ccid_wakeup_once = PTHREAD_ONCE_INIT;
+static BOOL ccid_wakeup[CCID_MAX_INSTANCE_COUNT];
+
+static pthread_mutex_t ccid_lock_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ccid_lock_cond = PTHREAD_COND_INITIALIZER;
+
+static void* ccid_emulator_task(void* arg);
+static void* ccid_replay_task(void* arg);
+
+/**
+ * @internal
+ * @brief Microseconds of a monotonic clock
+ */
+static uint64_t ccid_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @internal
+ * @brief Wait on a condition (CLOCK_MONOTONIC) until the given time
+ */
+static void ccid_cond_wait_until(pthread_cond_t* cond, pthread_mutex_t* mutex, uint64_t qwDeadlineUs)
+{
+	struct timespec ts;
+
+	ts.tv_sec = qwDeadlineUs / 1000000;
+	ts.tv_nsec = (qwDeadlineUs % 1000000) * 1000;
+	pthread_cond_timedwait(cond, mutex, &ts);
+}
+
+/**
+ * @internal
+ * @brief Create a condition whose timeouts use CLOCK_MONOTONIC
+ */
+static void ccid_cond_init(pthread_cond_t* cond)
+{
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+/**
+ * @internal
+ * @brief Create the condition of the wakeups, once
+ */
+static void ccid_wakeup_init(void)
+{
+	ccid_cond_init(&ccid_wakeup_cond);
+}
+
+/**
+ * @internal
+ * @brief Time the given number of bytes takes on the wire (start and stop bits included)
+ */
+static uint64_t ccid_wire_time_us(const CCID_EMULATOR_PORT_ST* port, DWORD dwLength)
+{
+	if (port->Config.dwBaudRate == 0)
+		return 0; /* Memory speed */
+	return (uint64_t) dwLength * 10 * 1000000 / port->Config.dwBaudRate;
+}
+
+/**
+ * @internal
+ * @brief The port of the instance selected by CCID_SelectInstance, created with the default configuration the first time
+ */
+static CCID_EMULATOR_PORT_ST* ccid_port(void)
+{
+	CCID_EMULATOR_PORT_ST* port = &ccid_ports[CCID_LIB(GetInstance)()];
+
+	if (!port->fInitialized)
+	{
+		ccid_cond_init(&port->cond);
+		pthread_mutex_init(&port->mutex, NULL);
+
+		port->bInstance = CCID_LIB(GetInstance)();
+		ccid_emulator_default_config(&port->Config);
+		ccid_emulator_reset(&port->Device, &port->Config, port->bInstance);
+		port->fInitialized = TRUE;
+	}
+
+	return port;
+}
+
+/**
+ * @brief Prepare the serial library, specifying the serial comm port
+ * @note Here the "comm name" is the configuration of the virtual coupler, e.g. "emu:38400" or "emu:0,slots=2" (see ccid_emulator_parse_config), or a capture to play back, e.g. "replay:session.ccap,speed=10" (see ccid_replay_load)
+ */
+void CCID_LIB(SerialInit)(const char* szCommName)
+{
+	CCID_EMULATOR_PORT_ST* port = ccid_port();
+
+	pthread_mutex_lock(&port->mutex);
+	port->szCommName = szCommName;
+	ccid_emulator_default_config(&port->Config);
+	port->fReplay = (szCommName != NULL) && !strncmp(szCommName, "replay:", 7);
+	if (port->fReplay)
+	{
+		/* The timing is the one of the capture, there is no wire model */
+		port->Config.dwBaudRate = 0;
+		port->fReplayLoaded = ccid_replay_load(&port->Replay, szCommName, port->bInstance);
+		if (!port->fReplayLoaded)
+			fprintf(stderr, "Virtual coupler: can't replay \"%s\"\n", szCommName);
+	}
+	else if (!ccid_emulator_parse_config(&port->Config, szCommName))
+		fprintf(stderr, "Virtual coupler: invalid option in \"%s\"\n", szCommName);
+	ccid_emulator_reset(&port->Device, &port->Config, port->bInstance);
+	pthread_mutex_unlock(&port->mutex);
+}
+
+/**
+ * @brief Return the configuration of the virtual coupler of the selected instance
+ */
+void CCID_LIB(EmulatorGetConfig)(CCID_EMULATOR_CONFIG_ST* pConfig)
+{
+	CCID_EMULATOR_PORT_ST* port = ccid_port();
+
+	if (pConfig == NULL)
+		return;
+
+	pthread_mutex_lock(&port->mutex);
+	memcpy(pConfig, &port->Config, sizeof(CCID_EMULATOR_CONFIG_ST));
+	pthread_mutex_unlock(&port->mutex);
+}
+
+/**
+ * @brief Change the configuration of the virtual coupler of the selected instance
+ * @note The virtual coupler is reset (as if it were unplugged and plugged again). Call this function after CCID_SerialInit, which applies the configuration found in the comm name
+ */
+void CCID_LIB(EmulatorSetConfig)(const CCID_EMULATOR_CONFIG_ST* pConfig)
+{
+	CCID_EMULATOR_PORT_ST* port = ccid_port();
+
+	if (pConfig == NULL)
+		return;
+
+	pthread_mutex_lock(&port->mutex);
+	memcpy(&port->Config, pConfig, sizeof(CCID_EMULATOR_CONFIG_ST));
+	if (port->Config.bSlotCount == 0)
+		port->Config.bSlotCount = 1;
+	if (port->Config.bSlotCount > CCID_EMULATOR_MAX_SLOT_COUNT)
+		port->Config.bSlotCount = CCID_EMULATOR_MAX_SLOT_COUNT;
+	ccid_emulator_reset(&port->Device, &port->Config, port->bInstance);
+	pthread_mutex_unlock(&port->mutex);
+}
+
+/**
+ * @brief Insert or remove the card in a slot of the virtual coupler of the selected instance
+ * @note If the host has activated the notifications, the virtual coupler sends a RDR_to_PC_NotifySlotChange
+ */
+void CCID_LIB(EmulatorSetCardPresent)(BYTE bSlot, BOOL fPresent)
+{
+	CCID_EMULATOR_PORT_ST* port = ccid_port();
+
+	pthread_mutex_lock(&port->mutex);
+	ccid_emulator_set_card_present(&port->Device, bSlot, fPresent);
+	pthread_cond_broadcast(&port->cond);
+	pthread_mutex_unlock(&port->mutex);
+}
+
+/**
+ * @brief Open the serial comm port and activate the RX interrupt
+ * @note Here the thread of the virtual coupler is started. The coupler keeps its state (e.g. its cards) from one opening to the next, as a genuine one does
+ */
+BOOL CCID_LIB(SerialOpen)(void)
+{
+	CCID_EMULATOR_PORT_ST* port = ccid_port();
+
+	if (port->fCommOpen)
+		return TRUE;
+
+	if (port->fReplay && !port->fReplayLoaded)
+		return FALSE;
+
+	pthread_mutex_lock(&port->mutex);
+	port->dwQueueHead = 0;
+	port->dwQueueCount = 0;
+	port->qwHostLineFreeUs = 0;
+	port->qwDeviceLineFreeUs = 0;
+	port->fStop = FALSE;
+	ccid_emulator_reset_receiver(&port->Device);
+	if (port->fReplay)
+	{
+		/* As if the coupler were plugged again: the capture starts over */
+		ccid_replay_rewind(&port->Replay);
+		port->qwReplayAnchorUs = ccid_now_us();
+	}
+	pthread_mutex_unlock(&port->mutex);
+
+	if (pthread_create(&port->threadId, NULL, port->fReplay ? ccid_replay_task : ccid_emulator_task, port) != 0)
+	{
+		perror("pthread_create");
+		return FALSE;
+	}
+	port->fThreadRunning = TRUE;
+	port->fCommOpen = TRUE;
+
+	return TRUE;
+}
+
+/**
+ * @brief Close the serial comm port
+ */
+void CCID_LIB(SerialClose)(void)
+{
+	CCID_EMULATOR_PORT_ST* port = ccid_port();
+
+	port->fCommOpen = FALSE;
+
+	if (port->fThreadRunning)
+	{
+		pthread_mutex_lock(&port->mutex);
+		port->fStop = TRUE;
+		pthread_cond_broadcast(&port->cond);
+		pthread_mutex_unlock(&port->mutex);
+
+		pthread_join(port->threadId, NULL);
+		port->fThreadRunning = FALSE;
+	}
+}
+
+/**
+ * @brief Reset the link with the virtual coupler: what is on the wire is lost, and the coupler waits for a new message
+ */
+BOOL CCID_LIB(SerialReset)(void)
+{
+	CCID_EMULATOR_PORT_ST* port = ccid_port();
+
+	if (!port->fCommOpen)
+		return FALSE;
+
+	pthread_mutex_lock(&port->mutex);
+	port->dwQueueHead = 0;
+	port->dwQueueCount = 0;
+	port->qwHostLineFreeUs = ccid_now_us() + CCID_SERIAL_BREAK_MS * 1000;
+	ccid_emulator_reset_receiver(&port->Device);
+	pthread_mutex_unlock(&port->mutex);
+
+	return TRUE;
+}
+
+/**
+ * @brief Wait until the comm port exists
+ * @note The virtual coupler is always there
+ */
+BOOL CCID_LIB(SerialWaitPort)(DWORD timeout_ms)
+{
+	(void) timeout_ms;
+	return TRUE;
+}
+
+/**
+ * @brief Returns TRUE if the serial comm port is open, FALSE otherwise
+ */
+BOOL CCID_LIB(SerialIsOpen)(void)
+{
+	return ccid_port()->fCommOpen;
+}
+
+/**
+ * @internal
+ * @brief Execute the message the virtual coupler has just received, and send the response at once, in the context of the caller ("sync" option)
+ * @note The receiver of the driver holds two messages: a long command gets a single time extension, whatever its duration
+ */
+static void ccid_emulator_execute_now(CCID_EMULATOR_PORT_ST* port)
+{
+	DWORD dwLength = ccid_emulator_process(&port->Device, port->abFrame);
+
+	if (dwLength == 0)
+		return;
+
+	if (port->Device.dwDelayMs)
+	{
+		DWORD dwExtLength = ccid_emulator_time_extension(&port->Device, port->abTimeExtension);
+		CCID_LIB(InstanceRecvBytesFromISR)(port->bInstance, port->abTimeExtension, dwExtLength);
+	}
+
+	CCID_LIB(InstanceRecvBytesFromISR)(port->bInstance, port->abFrame, dwLength);
+}
+
+/**
+ * @brief Send a buffer to the virtual coupler
+ * @note The bytes reach the coupler when the wire model says so, but the caller is not blocked (as with a real UART and its buffer).
+ * With the "sync" option, the coupler gets them at once, and its response is received before this function returns.
+ */
+BOOL CCID_LIB(SerialSendBytes)(const BYTE* abValue, DWORD dwLength)
+{
+	CCID_EMULATOR_PORT_ST* port = ccid_port();
+	uint64_t qwByteUs;
+	uint64_t qwArrivalUs;
+
+	if (!port->fCommOpen)
+		return FALSE;
+
+	pthread_mutex_lock(&port->mutex);
+
+	if (port->Config.fSynchronous)
+	{
+		for (DWORD i = 0; i < dwLength; i++)
+			if (ccid_emulator_recv_byte(&port->Device, abValue[i]))
+				ccid_emulator_execute_now(port);
+		pthread_mutex_unlock(&port->mutex);
+		return TRUE;
+	}
+
+	qwByteUs = ccid_wire_time_us(port, 1);
+	qwArrivalUs = ccid_now_us();
+	if (qwArrivalUs < port->qwHostLineFreeUs)
+		qwArrivalUs = port->qwHostLineFreeUs;
+
+	for (DWORD i = 0; i < dwLength; i++)
+	{
+		DWORD dwIndex;
+
+		while ((port->dwQueueCount >= CCID_EMULATOR_QUEUE_SIZE) && !port->fStop)
+			pthread_cond_wait(&port->cond, &port->mutex);
+		if (port->fStop)
+			break;
+
+		qwArrivalUs += qwByteUs;
+		dwIndex = (port->dwQueueHead + port->dwQueueCount) % CCID_EMULATOR_QUEUE_SIZE;
+		port->abQueue[dwIndex] = abValue[i];
+		port->aqwQueueArrivalUs[dwIndex] = qwArrivalUs;
+		port->dwQueueCount++;
+	}
+
+	port->qwHostLineFreeUs = qwArrivalUs;
+	pthread_cond_broadcast(&port->cond);
+	pthread_mutex_unlock(&port->mutex);
+
+	return TRUE;
+}
+
+/**
+ * @brief Send one byte to the virtual coupler
+ */
+BOOL CCID_LIB(SerialSendByte)(BYTE bValue)
+{
+	return CCID_LIB(SerialSendBytes)(&bValue, 1);
+}
+
+/**
+ * @internal
+ * @brief Let the time go by in the thread of the virtual coupler (the host may send meanwhile)
+ * @return FALSE if the port is being closed
+ */
+static BOOL ccid_emulator_sleep_until(CCID_EMULATOR_PORT_ST* port, uint64_t qwDeadlineUs)
+{
+	while (!port->fStop && (ccid_now_us() < qwDeadlineUs))
+		ccid_cond_wait_until(&port->cond, &port->mutex, qwDeadlineUs);
+	return !port->fStop;
+}
+
+/**
+ * @internal
+ * @brief Send a frame from the virtual coupler to the host, not before the given time
+ * @note The receiver of the driver only wakes up the application on complete messages, so the bytes are handed over together once the last one has gone through the wire
+ */
+static BOOL ccid_emulator_send(CCID_EMULATOR_PORT_ST* port, const BYTE abFrame[], DWORD dwLength, uint64_t qwReadyUs)
+{
+	uint64_t qwEndUs = (qwReadyUs > port->qwDeviceLineFreeUs) ? qwReadyUs : port->qwDeviceLineFreeUs;
+
+	qwEndUs += ccid_wire_time_us(port, dwLength);
+	port->qwDeviceLineFreeUs = qwEndUs;
+
+	if (!ccid_emulator_sleep_until(port, qwEndUs))
+		return FALSE;
+
+	CCID_LIB(InstanceRecvBytesFromISR)(port->bInstance, abFrame, dwLength);
+
+	return TRUE;
+}
+
+/**
+ * @internal
+ * @brief Execute the message the virtual coupler has just received, and send the response (after time extensions if the command is long)
+ */
+static void ccid_emulator_execute(CCID_EMULATOR_PORT_ST* port)
+{
+	uint64_t qwReadyUs = ccid_now_us() + port->Config.dwProcessingUs;
+	DWORD dwLength = ccid_emulator_process(&port->Device, port->abFrame);
+
+	if (dwLength == 0)
+		return;
+
+	if (port->Device.dwDelayMs)
+	{
+		uint64_t qwDoneUs = qwReadyUs + (uint64_t) port->Device.dwDelayMs * 1000;
+
+		while (qwReadyUs + CCID_EMULATOR_TIME_EXTENSION_MS * 1000 < qwDoneUs)
+		{
+			DWORD dwExtLength = ccid_emulator_time_extension(&port->Device, port->abTimeExtension);
+
+			qwReadyUs += CCID_EMULATOR_TIME_EXTENSION_MS * 1000;
+			if (!ccid_emulator_send(port, port->abTimeExtension, dwExtLength, qwReadyUs))
+				return;
+		}
+		qwReadyUs = qwDoneUs;
+	}
+
+	ccid_emulator_send(port, port->abFrame, dwLength, qwReadyUs);
+}
+
+/**
+ * @internal
+ * @brief Thread of the virtual coupler: consume the bytes sent by the host when they arrive, answer, notify the card changes
+ */
+static void* ccid_emulator_task(void* arg)
+{
+	CCID_EMULATOR_PORT_ST* port = (CCID_EMULATOR_PORT_ST*) arg;
+
+	pthread_mutex_lock(&port->mutex);
+
+	while (!port->fStop)
+	{
+		DWORD dwLength;
+
+		if (port->dwQueueCount)
+		{
+			uint64_t qwArrivalUs = port->aqwQueueArrivalUs[port->dwQueueHead];
+
+			if (qwArrivalUs <= ccid_now_us())
+			{
+				BYTE bValue = port->abQueue[port->dwQueueHead];
+
+				port->dwQueueHead = (port->dwQueueHead + 1) % CCID_EMULATOR_QUEUE_SIZE;
+				port->dwQueueCount--;
+				pthread_cond_broadcast(&port->cond); /* There is room in the queue */
+
+				if (ccid_emulator_recv_byte(&port->Device, bValue))
+					ccid_emulator_execute(port);
+				continue;
+			}
+		}
+
+		dwLength = ccid_emulator_notify(&port->Device, port->abFrame);
+		if (dwLength)
+		{
+			ccid_emulator_send(port, port->abFrame, dwLength, ccid_now_us());
+			continue;
+		}
+
+		/* Nothing to do until the next byte arrives, or until the host or the application does something */
+		if (port->dwQueueCount)
+			ccid_cond_wait_until(&port->cond, &port->mutex, port->aqwQueueArrivalUs[port->dwQueueHead]);
+		else
+			pthread_cond_wait(&port->cond, &port->mutex);
+	}
+
+	pthread_mutex_unlock(&port->mutex);
+	return NULL;
+}
+
+/**
+ * @internal
+ * @brief Thread of the virtual coupler that plays a capture back: consume the bytes sent by the host, send the RX records of the capture on time
+ * @note The time of a RX record is counted from the beginning of the TX record before it, divided by the speed, so that the replay does not drift
+ */
+static void* ccid_replay_task(void* arg)
+{
+	CCID_EMULATOR_PORT_ST* port = (CCID_EMULATOR_PORT_ST*) arg;
+	CCID_REPLAY_ST* replay = &port->Replay;
+
+	pthread_mutex_lock(&port->mutex);
+
+	while (!port->fStop)
+	{
+		if (port->dwQueueCount)
+		{
+			BYTE bValue = port->abQueue[port->dwQueueHead];
+			uint64_t qwArrivalUs = port->aqwQueueArrivalUs[port->dwQueueHead];
+
+			port->dwQueueHead = (port->dwQueueHead + 1) % CCID_EMULATOR_QUEUE_SIZE;
+			port->dwQueueCount--;
+			pthread_cond_broadcast(&port->cond); /* There is room in the queue */
+
+			if (ccid_replay_host_byte(replay, bValue))
+				port->qwReplayAnchorUs = qwArrivalUs;
+			continue;
+		}
+
+		if (replay->fRecord && (replay->Record.bType == CCID_CAPTURE_RX))
+		{
+			uint64_t qwDueUs = 0;
+
+			if (replay->dSpeed > 0)
+				qwDueUs = port->qwReplayAnchorUs + (uint64_t) ((DWORD) (replay->Record.dwTimeUs - replay->dwAnchorTimeUs) / replay->dSpeed);
+
+			if (qwDueUs <= ccid_now_us())
+			{
+				CCID_LIB(InstanceRecvBytesFromISR)(port->bInstance, replay->Record.abData, replay->Record.dwLength);
+				ccid_replay_next(replay);
+			}
+			else
+			{
+				/* Until it is time, unless the host sends something */
+				ccid_cond_wait_until(&port->cond, &port->mutex, qwDueUs);
+			}
+			continue;
+		}
+
+		/* Waiting for the host */
+		pthread_cond_wait(&port->cond, &port->mutex);
+	}
+
+	pthread_mutex_unlock(&port->mutex);
+	return NULL;
+}
+
+/**
+ * @brief Notify the task/thread waiting over CCID_WaitWakeup that a message is available
+ */
+void CCID_LIB(WakeupFromISR)(void)
+{
+	CCID_LIB(InstanceWakeupFromISR)(CCID_LIB(GetInstance)());
+}
+
+/**
+ * @brief Notify the task/thread waiting over CCID_WaitWakeup or CCID_WaitWakeupMulti that a message is available for the given instance
+ */
+void CCID_LIB(InstanceWakeupFromISR)(BYTE bInstance)
+{
+	if (bInstance >= CCID_MAX_INSTANCE_COUNT)
+		return;
+
+	pthread_once(&ccid_wakeup_once, ccid_wakeup_init);
+
+	/* The flag stays set until CCID_ClearWakeup */
+	pthread_mutex_lock(&ccid_wakeup_mutex);
+	ccid_wakeup[bInstance] = TRUE;
+	pthread_cond_broadcast(&ccid_wakeup_cond);
+	pthread_mutex_unlock(&ccid_wakeup_mutex);
+}
+
+/**
+ * @brief Start waiting for a message
+ */
+void CCID_LIB(ClearWakeup)(void)
+{
+	pthread_mutex_lock(&ccid_wakeup_mutex);
+	ccid_wakeup[CCID_LIB(GetInstance)()] = FALSE;
+	pthread_mutex_unlock(&ccid_wakeup_mutex);
+}
+
+/**
+ * @brief Wait until a message is available for any of the given instances, or a timeout occurs
+ * @param abInstances the instances to wait for
+ * @param bInstanceCount number of instances in abInstances
+ * @param timeout_ms the timeout, in milliseconds ((DWORD) -1 for INFINITE)
+ * @param pbInstance OUT: the instance that has a message
+ * @note It does not clear the wakeup
+ */
+BOOL CCID_LIB(WaitWakeupMulti)(const BYTE abInstances[], BYTE bInstanceCount, DWORD timeout_ms, BYTE* pbInstance)
+{
+	uint64_t qwDeadlineUs = ccid_now_us() + (uint64_t) timeout_ms * 1000;
+	BOOL fResult = FALSE;
+
+	if ((abInstances == NULL) || (bInstanceCount == 0) || (bInstanceCount > CCID_MAX_INSTANCE_COUNT))
+		return FALSE;
+
+	pthread_once(&ccid_wakeup_once, ccid_wakeup_init);
+	pthread_mutex_lock(&ccid_wakeup_mutex);
+
+	for (;;)
+	{
+		for (BYTE i = 0; i < bInstanceCount; i++)
+		{
+			if ((abInstances[i] < CCID_MAX_INSTANCE_COUNT) && ccid_wakeup[abInstances[i]])
+			{
+				if (pbInstance != NULL)
+					*pbInstance = abInstances[i];
+				fResult = TRUE;
+				break;
+			}
+		}
+
+		if (fResult)
+			break;
+
+		if (timeout_ms == (DWORD) -1)
+		{
+			pthread_cond_wait(&ccid_wakeup_cond, &ccid_wakeup_mutex);
+		}
+		else
+		{
+			if (ccid_now_us() >= qwDeadlineUs)
+				break;
+			ccid_cond_wait_until(&ccid_wakeup_cond, &ccid_wakeup_mutex, qwDeadlineUs);
+		}
+	}
+
+	pthread_mutex_unlock(&ccid_wakeup_mutex);
+
+	return fResult;
+}
+
+/**
+ * @brief Wait until a message is available or a timeout occurs
+ */
+BOOL CCID_LIB(WaitWakeup)(DWORD timeout_ms)
+{
+	BYTE bInstance = CCID_LIB(GetInstance)();
+
+	return CCID_LIB(WaitWakeupMulti)(&bInstance, 1, timeout_ms, NULL);
+}
+
+/**
+ * @brief Milliseconds of a monotonic clock
+ */
+DWORD CCID_LIB(GetTimeMs)(void)
+{
+	return (DWORD) (ccid_now_us() / 1000);
+}
+
+/**
+ * @brief Microseconds of a monotonic clock (for the capture of the traffic, see CCID_CAPTURE)
+ */
+DWORD CCID_LIB(GetTimeUs)(void)
+{
+	return (DWORD) ccid_now_us();
+}
+
+/**
+ * @brief Enter the critical section that protects the locks of the driver and of the PC/SC-Like stack
+ */
+void CCID_LIB(LockEnter)(void)
+{
+	pthread_mutex_lock(&ccid_lock_mutex);
+}
+
+/**
+ * @brief Leave the critical section
+ */
+void CCID_LIB(LockLeave)(void)
+{
+	pthread_mutex_unlock(&ccid_lock_mutex);
+}
+
+/**
+ * @brief Leave the critical section, wait until CCID_LockNotifyAll is called, and enter the critical section again
+ */
+void CCID_LIB(LockWait)(void)
+{
+	pthread_cond_wait(&ccid_lock_cond, &ccid_lock_mutex);
+}
+
+/**
+ * @brief Wake up all the callers waiting in CCID_LockWait
+ */
+void CCID_LIB(LockNotifyAll)(void)
+{
+	pthread_cond_broadcast(&ccid_lock_cond);
+}
+
+/**
+ * @brief Return a non-zero value that identifies the calling thread
+ */
+DWORD CCID_LIB(GetCallerId)(void)
+{
+	return (DWORD) syscall(SYS_gettid);
+}
+
+/**
+ * @brief Read the profile of the device
+ * @note The virtual coupler answers at memory speed (or close to), there is nothing to gain from a profile
+ */
+BOOL CCID_LIB(ProfileRead)(BYTE abData[], DWORD* pdwLength)
+{
+	(void) abData;
+	(void) pdwLength;
+	return FALSE;
+}
+
+/**
+ * @brief Store the profile of the device
+ */
+BOOL CCID_LIB(ProfileWrite)(const BYTE abData[], DWORD dwLength)
+{
+	(void) abData;
+	(void) dwLength;
+	return FALSE;
+}
@@ -0,0 +1,117 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_faults.h
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Fault injection: a decorator of the HAL that drops, corrupts, duplicates or delays the bytes and the frames on the wire, with a deterministic seed
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#ifndef __CCID_FAULTS_H__
+#define __CCID_FAULTS_H__
+
+#include <project.h>
+
+#include "../../pcsc-serial.h"
+#include "../../ccid/ccid.h"
+
+/*
+ * The decorator sits between the driver and the genuine HAL. It is not compiled in the library: the program is linked
+ * with fault_hal.c and with the GNU ld options
+ *   -Wl,--wrap=CCID_SerialSendByte,--wrap=CCID_SerialSendBytes,--wrap=CCID_InstanceRecvByteFromISR,--wrap=CCID_InstanceRecvBytesFromISR,
+ *       --wrap=CCID_SerialRecvByteFromISR,--wrap=CCID_SerialRecvBytesFromISR
+ * so that the driver's calls to the HAL (TX) and the HAL's calls to the driver (RX) go through it.
+ * Both directions are reassembled into frames; every complete frame is hit by the selected fault with the given
+ * probability, the rest of the traffic goes through untouched.
+ */
+
+/* Fault classes */
+#define CCID_FAULT_NONE 0
+#define CCID_FAULT_DROP_BYTE 1 /*!< One byte of the frame is lost */
+#define CCID_FAULT_CORRUPT_BYTE 2 /*!< One bit of one byte of the frame is flipped */
+#define CCID_FAULT_DUPLICATE_BYTE 3 /*!< One byte of the frame is received twice */
+#define CCID_FAULT_DROP_FRAME 4 /*!< The whole frame is lost */
+#define CCID_FAULT_CORRUPT_FRAME 5 /*!< A burst of random bytes overwrites a part of the frame */
+#define CCID_FAULT_DUPLICATE_FRAME 6 /*!< The frame is received twice */
+#define CCID_FAULT_DELAY_FRAME 7 /*!< The frame stalls in its middle for dwDelayMs */
+#define CCID_FAULT_INTERRUPT 8 /*!< A spurious RDR_to_PC_NotifySlotChange comes before the frame (RX only) */
+#define CCID_FAULT_CLASS_COUNT 9
+
+/* Directions */
+#define CCID_FAULT_TX 0x01 /*!< Host to device */
+#define CCID_FAULT_RX 0x02 /*!< Device to host */
+
+/**
+ * @brief What to inject
+ */
+typedef struct
+{
+	BYTE bClass; /*!< CCID_FAULT_xxx */
+	BYTE bDirections; /*!< CCID_FAULT_TX, CCID_FAULT_RX or both */
+	DWORD dwRatePpm; /*!< Probability that a frame is hit, in parts per million */
+	DWORD dwDelayMs; /*!< Stall of CCID_FAULT_DELAY_FRAME */
+	DWORD dwSeed; /*!< Same seed, same traffic --> same faults */
+} CCID_FAULT_CONFIG_ST;
+
+/**
+ * @brief What has been injected since the last CCID_FaultConfigure
+ */
+typedef struct
+{
+	DWORD dwFrames; /*!< Frames seen, both directions */
+	DWORD dwInjected; /*!< Frames hit */
+	DWORD dwInjectedTx;
+	DWORD dwInjectedRx;
+} CCID_FAULT_STATS_ST;
+
+/* Select the fault (all instances), restart the random generators and clear the counters */
+void CCID_LIB(FaultConfigure)(const CCID_FAULT_CONFIG_ST* pConfig);
+void CCID_LIB(FaultGetStats)(CCID_FAULT_STATS_ST* pStats);
+/* Name of a class ("drop-byte"...), and the other way round (CCID_FAULT_CLASS_COUNT if unknown) */
+const char* CCID_LIB(FaultClassName)(BYTE bClass);
+BYTE CCID_LIB(FaultClassFromName)(const char* szName);
+
+#endif
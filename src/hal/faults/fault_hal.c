@@ -0,0 +1,405 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file fault_hal.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Fault injection: a decorator of the HAL (linked with --wrap) that drops, corrupts, duplicates or delays the bytes and the frames on the wire, and injects spurious interrupts
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include <project.h>
+
+#include "../../pcsc-serial.h"
+#include "../../ccid/ccid.h"
+#include "../../ccid/ccid_hal.h"
+#include "../../ccid/ccid_constants.h"
+#include "ccid_faults.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+/* Longest frame on the wire: START_BYTE, endpoint, header, payload, checksum */
+#define FAULT_MAX_FRAME_LENGTH (2 + CCID_HEADER_LENGTH + CCID_MAX_PAYLOAD_LENGTH + 1)
+/* Length of the spurious RDR_to_PC_NotifySlotChange */
+#define FAULT_INTERRUPT_LENGTH (2 + CCID_HEADER_LENGTH + 1 + 1)
+/* Longest burst of CCID_FAULT_CORRUPT_FRAME */
+#define FAULT_BURST_LENGTH 8
+
+/* __wrap_CCID_xxx and __real_CCID_xxx, whatever the prefix of the library */
+#define FAULT_CONCAT(a, b) a##b
+#define FAULT_XCONCAT(a, b) FAULT_CONCAT(a, b)
+#define FAULT_WRAP(f) FAULT_XCONCAT(__wrap_, f)
+#define FAULT_REAL(f) FAULT_XCONCAT(__real_, f)
+
+BOOL FAULT_REAL(CCID_LIB(SerialSendBytes))(const BYTE* abValue, DWORD dwLength);
+BOOL FAULT_WRAP(CCID_LIB(SerialSendBytes))(const BYTE* abValue, DWORD dwLength);
+BOOL FAULT_WRAP(CCID_LIB(SerialSendByte))(BYTE bValue);
+void FAULT_REAL(CCID_LIB(InstanceRecvBytesFromISR))(BYTE bInstance, const BYTE abValues[], DWORD dwLength);
+void FAULT_WRAP(CCID_LIB(InstanceRecvBytesFromISR))(BYTE bInstance, const BYTE abValues[], DWORD dwLength);
+void FAULT_WRAP(CCID_LIB(InstanceRecvByteFromISR))(BYTE bInstance, BYTE bValue);
+void FAULT_WRAP(CCID_LIB(SerialRecvBytesFromISR))(const BYTE abValues[], DWORD dwLength);
+void FAULT_WRAP(CCID_LIB(SerialRecvByteFromISR))(BYTE bValue);
+
+/**
+ * @internal
+ * @brief One direction of one instance: the frame being reassembled, and its own random generator
+ */
+typedef struct
+{
+	BYTE abFrame[FAULT_MAX_FRAME_LENGTH];
+	DWORD dwLength;
+	DWORD dwExpected; /* 0 until the header is there */
+	DWORD dwRandom;
+	BYTE abOut[FAULT_INTERRUPT_LENGTH + 2 * FAULT_MAX_FRAME_LENGTH];
+	DWORD dwFrames;
+	DWORD dwInjected;
+} FAULT_STREAM_ST;
+
+#define FAULT_STREAM_TX 0
+#define FAULT_STREAM_RX 1
+
+static CCID_FAULT_CONFIG_ST fault_config;
+static FAULT_STREAM_ST fault_streams[CCID_MAX_INSTANCE_COUNT][2];
+/* Every instance has its own thread for RX, but the configuration is shared */
+static pthread_mutex_t fault_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* fault_class_names[CCID_FAULT_CLASS_COUNT] =
+{
+	"none", "drop-byte", "corrupt-byte", "duplicate-byte", "drop-frame", "corrupt-frame", "duplicate-frame", "delay-frame", "interrupt"
+};
+
+/**
+ * @internal
+ * @brief xorshift32: small, fast, and the same sequence everywhere
+ */
+static DWORD fault_random(FAULT_STREAM_ST* stream)
+{
+	DWORD x = stream->dwRandom;
+	x ^= (x << 13) & 0xFFFFFFFF;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFF;
+	stream->dwRandom = x & 0xFFFFFFFF;
+	return stream->dwRandom;
+}
+
+/**
+ * @brief Select the fault (all instances), restart the random generators and clear the counters
+ * @note Call it while there is no traffic
+ */
+void CCID_LIB(FaultConfigure)(const CCID_FAULT_CONFIG_ST* pConfig)
+{
+	pthread_mutex_lock(&fault_mutex);
+	fault_config = *pConfig;
+	for (BYTE bInstance = 0; bInstance < CCID_MAX_INSTANCE_COUNT; bInstance++)
+	{
+		for (BYTE bStream = 0; bStream < 2; bStream++)
+		{
+			FAULT_STREAM_ST* stream = &fault_streams[bInstance][bStream];
+
+			stream->dwLength = 0;
+			stream->dwExpected = 0;
+			stream->dwFrames = 0;
+			stream->dwInjected = 0;
+			/* Each stream has its own sequence, so that the faults of one do not depend on the traffic of the others */
+			stream->dwRandom = (pConfig->dwSeed ^ (0x9E3779B9UL * (1 + 2 * bInstance + bStream))) & 0xFFFFFFFF;
+			if (stream->dwRandom == 0)
+				stream->dwRandom = 1;
+		}
+	}
+	pthread_mutex_unlock(&fault_mutex);
+}
+
+/**
+ * @brief What has been injected since the last CCID_FaultConfigure
+ */
+void CCID_LIB(FaultGetStats)(CCID_FAULT_STATS_ST* pStats)
+{
+	memset(pStats, 0, sizeof(*pStats));
+	pthread_mutex_lock(&fault_mutex);
+	for (BYTE bInstance = 0; bInstance < CCID_MAX_INSTANCE_COUNT; bInstance++)
+	{
+		pStats->dwFrames += fault_streams[bInstance][FAULT_STREAM_TX].dwFrames + fault_streams[bInstance][FAULT_STREAM_RX].dwFrames;
+		pStats->dwInjectedTx += fault_streams[bInstance][FAULT_STREAM_TX].dwInjected;
+		pStats->dwInjectedRx += fault_streams[bInstance][FAULT_STREAM_RX].dwInjected;
+	}
+	pthread_mutex_unlock(&fault_mutex);
+	pStats->dwInjected = pStats->dwInjectedTx + pStats->dwInjectedRx;
+}
+
+/**
+ * @brief Name of a fault class, e.g. "drop-byte"
+ */
+const char* CCID_LIB(FaultClassName)(BYTE bClass)
+{
+	if (bClass >= CCID_FAULT_CLASS_COUNT)
+		return "?";
+	return fault_class_names[bClass];
+}
+
+/**
+ * @brief Fault class from its name, CCID_FAULT_CLASS_COUNT if unknown
+ */
+BYTE CCID_LIB(FaultClassFromName)(const char* szName)
+{
+	BYTE bClass;
+
+	for (bClass = 0; bClass < CCID_FAULT_CLASS_COUNT; bClass++)
+		if (!strcmp(szName, fault_class_names[bClass]))
+			break;
+	return bClass;
+}
+
+/**
+ * @internal
+ * @brief Hand bytes over to the other side, as the genuine HAL would have done
+ */
+static BOOL fault_emit(BYTE bInstance, BYTE bStream, const BYTE abValues[], DWORD dwLength)
+{
+	if (dwLength == 0)
+		return TRUE;
+	if (bStream == FAULT_STREAM_TX)
+		return FAULT_REAL(CCID_LIB(SerialSendBytes))(abValues, dwLength);
+	FAULT_REAL(CCID_LIB(InstanceRecvBytesFromISR))(bInstance, abValues, dwLength);
+	return TRUE;
+}
+
+/**
+ * @internal
+ * @brief A frame is complete: hit it (or not), and hand it over
+ */
+static BOOL fault_frame(BYTE bInstance, BYTE bStream, FAULT_STREAM_ST* stream)
+{
+	BYTE bClass = fault_config.bClass;
+	BYTE* abOut = stream->abOut;
+	DWORD dwLength = stream->dwLength;
+	DWORD dwOffset, dwCount;
+	BOOL fResult;
+
+	stream->dwFrames++;
+
+	if ((bClass == CCID_FAULT_NONE) || !(fault_config.bDirections & (bStream == FAULT_STREAM_TX ? CCID_FAULT_TX : CCID_FAULT_RX)))
+		return fault_emit(bInstance, bStream, stream->abFrame, dwLength);
+	if ((bClass == CCID_FAULT_INTERRUPT) && (bStream == FAULT_STREAM_TX))
+		return fault_emit(bInstance, bStream, stream->abFrame, dwLength);
+	if ((fault_random(stream) % 1000000) >= fault_config.dwRatePpm)
+		return fault_emit(bInstance, bStream, stream->abFrame, dwLength);
+
+	stream->dwInjected++;
+
+	/* Where the byte faults hit: anywhere in the frame, START_BYTE and checksum included */
+	dwOffset = fault_random(stream) % dwLength;
+
+	switch (bClass)
+	{
+		case CCID_FAULT_DROP_BYTE:
+			memcpy(abOut, stream->abFrame, dwOffset);
+			memcpy(&abOut[dwOffset], &stream->abFrame[dwOffset + 1], dwLength - dwOffset - 1);
+			return fault_emit(bInstance, bStream, abOut, dwLength - 1);
+
+		case CCID_FAULT_CORRUPT_BYTE:
+			memcpy(abOut, stream->abFrame, dwLength);
+			abOut[dwOffset] ^= (BYTE) (1 << (fault_random(stream) % 8));
+			return fault_emit(bInstance, bStream, abOut, dwLength);
+
+		case CCID_FAULT_DUPLICATE_BYTE:
+			memcpy(abOut, stream->abFrame, dwOffset + 1);
+			memcpy(&abOut[dwOffset + 1], &stream->abFrame[dwOffset], dwLength - dwOffset);
+			return fault_emit(bInstance, bStream, abOut, dwLength + 1);
+
+		case CCID_FAULT_DROP_FRAME:
+			return TRUE;
+
+		case CCID_FAULT_CORRUPT_FRAME:
+			memcpy(abOut, stream->abFrame, dwLength);
+			dwCount = 1 + fault_random(stream) % FAULT_BURST_LENGTH;
+			for (DWORD i = dwOffset; (i < dwLength) && (i < dwOffset + dwCount); i++)
+				abOut[i] = (BYTE) fault_random(stream);
+			return fault_emit(bInstance, bStream, abOut, dwLength);
+
+		case CCID_FAULT_DUPLICATE_FRAME:
+			memcpy(abOut, stream->abFrame, dwLength);
+			memcpy(&abOut[dwLength], stream->abFrame, dwLength);
+			return fault_emit(bInstance, bStream, abOut, 2 * dwLength);
+
+		case CCID_FAULT_DELAY_FRAME:
+			/* The line stalls in the middle of the frame (the RX thread, or the caller, is blocked meanwhile) */
+			dwOffset = dwLength / 2;
+			fResult = fault_emit(bInstance, bStream, stream->abFrame, dwOffset);
+			usleep(1000 * fault_config.dwDelayMs);
+			if (fResult)
+				fResult = fault_emit(bInstance, bStream, &stream->abFrame[dwOffset], dwLength - dwOffset);
+			return fResult;
+
+		case CCID_FAULT_INTERRUPT:
+		{
+			/* RDR_to_PC_NotifySlotChange: a card is in slot 0, and it has changed */
+			BYTE bChecksum = 0;
+
+			memset(abOut, 0, FAULT_INTERRUPT_LENGTH);
+			abOut[0] = START_BYTE;
+			abOut[1] = CCID_COMM_INTERRUPT_RDR_TO_PC;
+			abOut[2] = RDR_TO_PC_INTERRUPT;
+			abOut[2 + CCID_POS_LENGTH] = 1;
+			abOut[2 + CCID_HEADER_LENGTH] = 0x03;
+			for (DWORD i = 1; i < FAULT_INTERRUPT_LENGTH - 1; i++)
+				bChecksum ^= abOut[i];
+			abOut[FAULT_INTERRUPT_LENGTH - 1] = bChecksum;
+			memcpy(&abOut[FAULT_INTERRUPT_LENGTH], stream->abFrame, dwLength);
+			return fault_emit(bInstance, bStream, abOut, FAULT_INTERRUPT_LENGTH + dwLength);
+		}
+
+		default:
+			return fault_emit(bInstance, bStream, stream->abFrame, dwLength);
+	}
+}
+
+/**
+ * @internal
+ * @brief Reassemble the frames of a direction; what does not look like a frame goes through as is
+ */
+static BOOL fault_feed(BYTE bInstance, BYTE bStream, const BYTE abValues[], DWORD dwLength)
+{
+	FAULT_STREAM_ST* stream;
+	BOOL fResult = TRUE;
+
+	if (bInstance >= CCID_MAX_INSTANCE_COUNT)
+		return fault_emit(bInstance, bStream, abValues, dwLength);
+
+	stream = &fault_streams[bInstance][bStream];
+
+	for (DWORD i = 0; i < dwLength; i++)
+	{
+		if ((stream->dwLength == 0) && (abValues[i] != START_BYTE))
+		{
+			if (!fault_emit(bInstance, bStream, &abValues[i], 1))
+				fResult = FALSE;
+			continue;
+		}
+
+		stream->abFrame[stream->dwLength++] = abValues[i];
+
+		if (stream->dwLength == 2 + CCID_HEADER_LENGTH)
+		{
+			const BYTE* abLength = &stream->abFrame[2 + CCID_POS_LENGTH];
+			DWORD dwPayloadLength = abLength[0] | (abLength[1] << 8) | (abLength[2] << 16) | ((DWORD) abLength[3] << 24);
+
+			if (dwPayloadLength > CCID_MAX_PAYLOAD_LENGTH)
+			{
+				/* Not a frame after all */
+				if (!fault_emit(bInstance, bStream, stream->abFrame, stream->dwLength))
+					fResult = FALSE;
+				stream->dwLength = 0;
+				continue;
+			}
+			stream->dwExpected = 2 + CCID_HEADER_LENGTH + dwPayloadLength + 1;
+		}
+
+		if (stream->dwExpected && (stream->dwLength == stream->dwExpected))
+		{
+			if (!fault_frame(bInstance, bStream, stream))
+				fResult = FALSE;
+			stream->dwLength = 0;
+			stream->dwExpected = 0;
+		}
+	}
+
+	return fResult;
+}
+
+/**
+ * @brief TX: the driver sends bytes to the device
+ * @note The bytes of a frame are held until its checksum, then they go to the genuine HAL together
+ */
+BOOL FAULT_WRAP(CCID_LIB(SerialSendBytes))(const BYTE* abValue, DWORD dwLength)
+{
+	if (!CCID_LIB(SerialIsOpen)())
+	{
+		/* Forget the frame that will never be complete */
+		fault_streams[CCID_LIB(GetInstance)()][FAULT_STREAM_TX].dwLength = 0;
+		return FALSE;
+	}
+	return fault_feed(CCID_LIB(GetInstance)(), FAULT_STREAM_TX, abValue, dwLength);
+}
+
+/**
+ * @brief TX: the driver sends one byte to the device
+ */
+BOOL FAULT_WRAP(CCID_LIB(SerialSendByte))(BYTE bValue)
+{
+	return FAULT_WRAP(CCID_LIB(SerialSendBytes))(&bValue, 1);
+}
+
+/**
+ * @brief RX: the HAL hands bytes from the device over to the driver
+ */
+void FAULT_WRAP(CCID_LIB(InstanceRecvBytesFromISR))(BYTE bInstance, const BYTE abValues[], DWORD dwLength)
+{
+	fault_feed(bInstance, FAULT_STREAM_RX, abValues, dwLength);
+}
+
+/**
+ * @brief RX: the HAL hands one byte from the device over to the driver
+ */
+void FAULT_WRAP(CCID_LIB(InstanceRecvByteFromISR))(BYTE bInstance, BYTE bValue)
+{
+	fault_feed(bInstance, FAULT_STREAM_RX, &bValue, 1);
+}
+
+/**
+ * @brief RX: the HAL of a single instance hands bytes over to the driver
+ */
+void FAULT_WRAP(CCID_LIB(SerialRecvBytesFromISR))(const BYTE abValues[], DWORD dwLength)
+{
+	fault_feed(0, FAULT_STREAM_RX, abValues, dwLength);
+}
+
+/**
+ * @brief RX: the HAL of a single instance hands one byte over to the driver
+ */
+void FAULT_WRAP(CCID_LIB(SerialRecvByteFromISR))(BYTE bValue)
+{
+	fault_feed(0, FAULT_STREAM_RX, &bValue, 1);
+}
@@ -53,32 +53,54 @@
 #include <project.h>
 
 #include "../../pcsc-serial.h"
+#include "../../ccid/ccid.h"
 #include "../../ccid/ccid_hal.h"
 #include "../../scard/scard_errors.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <unistd.h>
+#include <poll.h>
 #include <pthread.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
 
-static const char* ccid_comm_name;
-
-static volatile BOOL ccid_comm_open;
-static volatile BOOL ccid_wakeup_flag;
+typedef struct
+{
+	const char* szCommName;
+	volatile BOOL fCommOpen;
+	BOOL fThreadRunning;
+	int iCommHandle;
+	int iWakeupHandle;
+	int iStopHandle;
+	BYTE bInstance;
+	pthread_t threadId;
+} CCID_LINUX_PORT_ST;
 
-static int ccid_comm_handle = -1;
-static int ccid_thread_handle = -1;
-static pthread_t ccid_thread_id;
-static pthread_mutex_t ccid_wakeup_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t ccid_wakeup_cond = PTHREAD_COND_INITIALIZER;
+static CCID_LINUX_PORT_ST ccid_ports[CCID_MAX_INSTANCE_COUNT];
 
+static pthread_mutex_t ccid_lock_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ccid_lock_cond = PTHREAD_COND_INITIALIZER;
 
 static void* ccid_serial_recv_task(void* arg);
-static BOOL ccid_serial_configure(void);
-static BOOL ccid_serial_flush(void);
+static BOOL ccid_serial_configure(int fd);
+static BOOL ccid_serial_flush(int fd);
+
+/**
+ * @internal
+ * @brief The port of the instance selected by CCID_SelectInstance
+ */
+static CCID_LINUX_PORT_ST* ccid_port(void)
+{
+	return &ccid_ports[CCID_LIB(GetInstance)()];
+}
 
 /**
  * @brief Prepare the serial library, specifying the serial comm port
@@ -86,7 +108,24 @@ static BOOL ccid_serial_flush(void);
  */
 void CCID_LIB(SerialInit)(const char* szCommName)
 {
-	ccid_comm_name = szCommName;
+	CCID_LINUX_PORT_ST* port = ccid_port();
+
+	if (port->szCommName == NULL)
+	{
+		/* First call for this instance */
+		port->iCommHandle = -1;
+		port->bInstance = CCID_LIB(GetInstance)();
+		/* The wakeup is an eventfd so several instances may be waited for at once (see CCID_WaitWakeupMulti) */
+		port->iWakeupHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (port->iWakeupHandle < 0)
+			perror("eventfd");
+		/* Tells the receiver thread to exit, even if the device is silent */
+		port->iStopHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (port->iStopHandle < 0)
+			perror("eventfd");
+	}
+
+	port->szCommName = szCommName;
 }
 
 /**
@@ -95,45 +134,56 @@ void CCID_LIB(SerialInit)(const char* szCommName)
  */
 BOOL CCID_LIB(SerialOpen)(void)
 {
+	CCID_LINUX_PORT_ST* port = ccid_port();
+
 	CCID_LIB(SerialClose)();
 	
-	if (ccid_comm_name == NULL)
+	if ((port->szCommName == NULL) || (port->iWakeupHandle < 0) || (port->iStopHandle < 0))
 		return FALSE;
 
-	ccid_comm_handle = open(ccid_comm_name, O_RDWR | O_NOCTTY);
+	/* Non-blocking, so a port that waits for its modem lines does not block us */
+	port->iCommHandle = open(port->szCommName, O_RDWR | O_NOCTTY | O_NONBLOCK);
 
-	if (ccid_comm_handle < 0)
+	if (port->iCommHandle < 0)
 	{
 		perror("open");
 		CCID_LIB(SerialClose)();
 		return FALSE;
 	}
+
+	/* The receiver thread wants blocking reads */
+	if (fcntl(port->iCommHandle, F_SETFL, fcntl(port->iCommHandle, F_GETFL) & ~O_NONBLOCK) < 0)
+	{
+		perror("fcntl");
+		CCID_LIB(SerialClose)();
+		return FALSE;
+	}
 	
 	/* Configure UART */
-	if (!ccid_serial_configure())
+	if (!ccid_serial_configure(port->iCommHandle))
 	{
 		CCID_LIB(SerialClose)();
 		return FALSE;
 	}
 	
 	/* Flush UART */
-	if (!ccid_serial_flush())
+	if (!ccid_serial_flush(port->iCommHandle))
 	{
 		CCID_LIB(SerialClose)();
 		return FALSE;
 	}
 	
 	/* Ready */
-	ccid_comm_open = TRUE;
+	port->fCommOpen = TRUE;
 	
 	/* Create the receiver thread */
-	ccid_thread_handle = pthread_create(&ccid_thread_id, NULL, ccid_serial_recv_task, &ccid_comm_handle);
-	if (ccid_thread_handle < 0)
+	if (pthread_create(&port->threadId, NULL, ccid_serial_recv_task, port) != 0)
 	{
 		perror("pthread_create");
 		CCID_LIB(SerialClose)();
 		return FALSE;
 	}
+	port->fThreadRunning = TRUE;
 	
 	return TRUE;
 }
@@ -144,18 +194,197 @@ BOOL CCID_LIB(SerialOpen)(void)
  */
 void CCID_LIB(SerialClose)(void)
 {
-	ccid_comm_open = FALSE;
-	
-	if (ccid_comm_handle >= 0)
-		close(ccid_comm_handle);
+	CCID_LINUX_PORT_ST* port = ccid_port();
+
+	if (port->szCommName == NULL)
+		return; /* CCID_SerialInit has never been called for this instance */
+
+	port->fCommOpen = FALSE;
 	
-	ccid_comm_handle = -1;
+	if (port->fThreadRunning)
+	{
+		uint64_t value = 1;
+
+		/* Closing the fd would not unblock the thread: tell it to exit, and wait until it does */
+		if (write(port->iStopHandle, &value, sizeof(value)) < 0)
+			perror("write(eventfd)");
+		pthread_join(port->threadId, NULL);
+		port->fThreadRunning = FALSE;
+
+		if (read(port->iStopHandle, &value, sizeof(value)) < 0)
+			perror("read(eventfd)");
+	}
+
+	if (port->iCommHandle >= 0)
+		close(port->iCommHandle);
 	
-	if (ccid_thread_handle >= 0)
+	port->iCommHandle = -1;
+}
+
+/**
+ * @brief Reset the link with the device after a communication error: BREAK, DTR/RTS pulse (if CCID_SERIAL_RESET_DTR), and flush of both directions
+ * @note tcsendbreak is not used, since its BREAK lasts 250 to 500ms. A few milliseconds are enough for the device to restart its framing state machine.
+ * @return TRUE if the link has been reset, FALSE if the port is not open or the ioctls have failed
+ */
+BOOL CCID_LIB(SerialReset)(void)
+{
+	CCID_LINUX_PORT_ST* port = ccid_port();
+	BOOL fResult = TRUE;
+
+	if (!port->fCommOpen)
+		return FALSE;
+
+	/* Let what is being sent go out, the BREAK must not cut a byte in the middle */
+	tcdrain(port->iCommHandle);
+
+	if (ioctl(port->iCommHandle, TIOCSBRK) < 0)
+	{
+		perror("ioctl(TIOCSBRK)");
+		fResult = FALSE;
+	}
+	else
+	{
+		usleep(CCID_SERIAL_BREAK_MS * 1000);
+		if (ioctl(port->iCommHandle, TIOCCBRK) < 0)
+		{
+			perror("ioctl(TIOCCBRK)");
+			fResult = FALSE;
+		}
+	}
+
+#if (CCID_SERIAL_RESET_DTR)
+	{
+		int iLines = TIOCM_DTR | TIOCM_RTS;
+
+		ioctl(port->iCommHandle, TIOCMBIC, &iLines);
+		usleep(CCID_SERIAL_BREAK_MS * 1000);
+		ioctl(port->iCommHandle, TIOCMBIS, &iLines);
+	}
+#endif
+
+	tcflush(port->iCommHandle, TCIOFLUSH);
+
+	return fResult;
+}
+
+/**
+ * @internal
+ * @brief Watch the nearest existing directory on the path of the comm port (e.g. /dev, or /dev/serial when /dev/serial/by-id does not exist yet)
+ */
+static void ccid_serial_watch_path(int fd, const char* szCommName)
+{
+	char szDir[PATH_MAX];
+	struct stat st;
+	char* p;
+
+	snprintf(szDir, sizeof(szDir), "%s", szCommName);
+
+	for (;;)
+	{
+		p = strrchr(szDir, '/');
+		if (p == NULL)
+		{
+			/* Relative name, the port is in the current directory */
+			strcpy(szDir, ".");
+			break;
+		}
+		if (p == szDir)
+		{
+			/* Root directory */
+			szDir[1] = '\0';
+			break;
+		}
+		*p = '\0';
+		if ((stat(szDir, &st) == 0) && S_ISDIR(st.st_mode))
+			break;
+	}
+
+	/* Watching the same directory again only replaces the mask */
+	inotify_add_watch(fd, szDir, IN_CREATE | IN_MOVED_TO | IN_ATTRIB);
+}
+
+/**
+ * @brief Wait until the comm port exists, or until something has changed about it (e.g. udev has set its permissions)
+ * @note Call this function when CCID_SerialOpen has failed, instead of sleeping: it returns as soon as the USB-serial adapter is plugged.
+ * Here it uses inotify on the directory of the port, or on its nearest parent that exists. Any directory works, e.g. a symlink to a pty for the tests.
+ * @param timeout_ms max time to wait, (DWORD)-1 for infinite
+ * @return TRUE if the port exists (and it is worth trying to open it), FALSE after the timeout
+ */
+BOOL CCID_LIB(SerialWaitPort)(DWORD timeout_ms)
+{
+	CCID_LINUX_PORT_ST* port = ccid_port();
+	DWORD dwStart = CCID_LIB(GetTimeMs)();
+	const char* szBaseName;
+	BOOL fExisted;
+	int fd;
+
+	if (port->szCommName == NULL)
+		return FALSE;
+
+	szBaseName = strrchr(port->szCommName, '/');
+	szBaseName = (szBaseName != NULL) ? szBaseName + 1 : port->szCommName;
+
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
 	{
-		pthread_join(ccid_thread_id, NULL);
-		ccid_thread_handle = -1;
+		/* No inotify, fall back to a plain sleep */
+		usleep(1000 * ((timeout_ms == (DWORD)-1) ? 1000 : timeout_ms));
+		return (access(port->szCommName, F_OK) == 0);
 	}
+
+	fExisted = (access(port->szCommName, F_OK) == 0);
+
+	for (;;)
+	{
+		struct pollfd pfd;
+		BYTE abEvents[1024] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+		BOOL fChanged = FALSE;
+		ssize_t len;
+		int timeout = -1;
+
+		/* Arm before looking, so no creation is missed */
+		ccid_serial_watch_path(fd, port->szCommName);
+
+		if (!fExisted && (access(port->szCommName, F_OK) == 0))
+			break; /* It has appeared */
+
+		if (timeout_ms != (DWORD)-1)
+		{
+			DWORD dwElapsed = CCID_LIB(GetTimeMs)() - dwStart;
+			if (dwElapsed >= timeout_ms)
+			{
+				close(fd);
+				return FALSE;
+			}
+			timeout = (int) (timeout_ms - dwElapsed);
+		}
+
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, timeout) <= 0)
+			continue; /* Timeout (checked above), or signal */
+
+		while ((len = read(fd, abEvents, sizeof(abEvents))) > 0)
+		{
+			/* Is it about the port itself? */
+			for (ssize_t i = 0; i < len; )
+			{
+				const struct inotify_event* ev = (const struct inotify_event*) &abEvents[i];
+				if ((ev->len != 0) && !strcmp(ev->name, szBaseName))
+					fChanged = TRUE;
+				i += sizeof(struct inotify_event) + ev->len;
+			}
+		}
+
+		if (access(port->szCommName, F_OK) != 0)
+			fExisted = FALSE; /* Gone, wait until it comes back */
+		else if (fExisted && fChanged)
+			break; /* Still there, but something has changed */
+	}
+
+	close(fd);
+	return TRUE;
 }
 
 /**
@@ -164,7 +393,7 @@ void CCID_LIB(SerialClose)(void)
  */
 BOOL CCID_LIB(SerialIsOpen)(void)
 {
-	return ccid_comm_open;
+	return ccid_port()->fCommOpen;
 }
 
 /**
@@ -175,7 +404,7 @@ BOOL CCID_LIB(SerialSendByte)(BYTE bValue)
 {
 	int done;
 
-	done = write(ccid_comm_handle, &bValue, 1);
+	done = write(ccid_port()->iCommHandle, &bValue, 1);
 	if (done <= 0)
 	{
 		perror("write");
@@ -191,6 +420,7 @@ BOOL CCID_LIB(SerialSendByte)(BYTE bValue)
  */
 BOOL CCID_LIB(SerialSendBytes)(const BYTE* abValue, DWORD dwLength)
 {
+	int fd = ccid_port()->iCommHandle;
 	int done = 0;
 	int tosend;
 	int offset;
@@ -199,7 +429,7 @@ BOOL CCID_LIB(SerialSendBytes)(const BYTE* abValue, DWORD dwLength)
 	offset = 0;
 	while (tosend)
 	{
-		done = write(ccid_comm_handle, &abValue[offset], tosend);
+		done = write(fd, &abValue[offset], tosend);
 		if (done <= 0)
 		{
 			perror("write");
@@ -218,10 +448,25 @@ BOOL CCID_LIB(SerialSendBytes)(const BYTE* abValue, DWORD dwLength)
  */
 void CCID_LIB(WakeupFromISR)(void)
 {
-	pthread_mutex_lock(&ccid_wakeup_mutex);
-	ccid_wakeup_flag = TRUE;
-	pthread_cond_signal(&ccid_wakeup_cond);
-	pthread_mutex_unlock(&ccid_wakeup_mutex);
+	CCID_LIB(InstanceWakeupFromISR)(CCID_LIB(GetInstance)());
+}
+
+/**
+ * @brief Notify the task/thread waiting over CCID_WaitWakeup or CCID_WaitWakeupMulti that a message is available for the given instance
+ * @note This function must be implemented specifically for the OS/target, when CCID_MAX_INSTANCE_COUNT > 1
+ */
+void CCID_LIB(InstanceWakeupFromISR)(BYTE bInstance)
+{
+	uint64_t one = 1;
+
+	if (bInstance >= CCID_MAX_INSTANCE_COUNT)
+		return;
+	if (ccid_ports[bInstance].iWakeupHandle < 0)
+		return;
+
+	/* The eventfd counter stays non-zero (readable) until CCID_ClearWakeup */
+	if (write(ccid_ports[bInstance].iWakeupHandle, &one, sizeof(one)) != sizeof(one))
+		perror("write(eventfd)");
 }
 
 /**
@@ -230,9 +475,51 @@ void CCID_LIB(WakeupFromISR)(void)
  */
 void CCID_LIB(ClearWakeup)(void)
 {
-	pthread_mutex_lock(&ccid_wakeup_mutex);
-	ccid_wakeup_flag = FALSE;
-	pthread_mutex_unlock(&ccid_wakeup_mutex);
+	uint64_t value;
+	CCID_LINUX_PORT_ST* port = ccid_port();
+
+	if (port->iWakeupHandle < 0)
+		return;
+
+	/* The eventfd is non-blocking, reading resets its counter (or fails with EAGAIN if it was already zero) */
+	if (read(port->iWakeupHandle, &value, sizeof(value)) < 0)
+		if (errno != EAGAIN)
+			perror("read(eventfd)");
+}
+
+/**
+ * @internal
+ * @brief Wait until one of the given eventfds becomes readable, or a timeout occurs
+ * @return the index of the first readable eventfd, or -1 in case of timeout or error
+ */
+static int ccid_wait_wakeup_fds(struct pollfd fds[], int count, DWORD timeout_ms)
+{
+	int rc;
+	
+	for (int i = 0; i < count; i++)
+	{
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+
+	do
+	{
+		/* (DWORD) -1 means INFINITE */
+		rc = poll(fds, count, (timeout_ms == (DWORD) -1) ? -1 : (int) timeout_ms);
+	}
+	while ((rc < 0) && (errno == EINTR));
+
+	if (rc < 0)
+	{
+		perror("poll");
+		return -1;
+	}
+
+	for (int i = 0; i < count; i++)
+		if (fds[i].revents & POLLIN)
+			return i;
+
+	return -1;
 }
 
 /**
@@ -241,29 +528,226 @@ void CCID_LIB(ClearWakeup)(void)
  */
 BOOL CCID_LIB(WaitWakeup)(DWORD timeout_ms)
 {
-	struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-	ts.tv_sec  += 2; // timeout_ms / 1000;
-	//ts.tv_nsec += (timeout_ms % 1000) * 1000 * 1000;
-	(void) timeout_ms;
+	struct pollfd fds[1];
+
+	fds[0].fd = ccid_port()->iWakeupHandle;
+	if (fds[0].fd < 0)
+		return FALSE;
 
-	pthread_mutex_lock(&ccid_wakeup_mutex);
-	while (!ccid_wakeup_flag)
+	return (ccid_wait_wakeup_fds(fds, 1, timeout_ms) == 0);
+}
+
+/**
+ * @brief Wait until a message is available for any of the given instances, or a timeout occurs
+ * @param abInstances the instances to wait for
+ * @param bInstanceCount number of instances in abInstances
+ * @param timeout_ms the timeout, in milliseconds ((DWORD) -1 for INFINITE)
+ * @param pbInstance OUT: the instance that has a message
+ * @note This function must be implemented specifically for the OS/target, when CCID_MAX_INSTANCE_COUNT > 1. It does not clear the wakeup.
+ */
+BOOL CCID_LIB(WaitWakeupMulti)(const BYTE abInstances[], BYTE bInstanceCount, DWORD timeout_ms, BYTE* pbInstance)
+{
+	struct pollfd fds[CCID_MAX_INSTANCE_COUNT];
+	int index;
+
+	if ((abInstances == NULL) || (bInstanceCount == 0) || (bInstanceCount > CCID_MAX_INSTANCE_COUNT))
+		return FALSE;
+
+	for (BYTE i = 0; i < bInstanceCount; i++)
 	{
-		int rc;
-		rc = pthread_cond_timedwait(&ccid_wakeup_cond, &ccid_wakeup_mutex, &ts);
-		if (rc == ETIMEDOUT)
-		{
-			pthread_mutex_unlock(&ccid_wakeup_mutex);
+		if (abInstances[i] >= CCID_MAX_INSTANCE_COUNT)
 			return FALSE;
-		}
-		if (rc < 0)
-		{
-			perror("pthread_cond_timedwait");
+		/* A negative fd is ignored by poll */
+		fds[i].fd = ccid_ports[abInstances[i]].iWakeupHandle;
+	}
+
+	index = ccid_wait_wakeup_fds(fds, bInstanceCount, timeout_ms);
+	if (index < 0)
+		return FALSE;
+
+	if (pbInstance != NULL)
+		*pbInstance = abInstances[index];
+	return TRUE;
+}
+
+/**
+ * @brief Milliseconds of a monotonic clock
+ * @note This function must be implemented specifically for the OS/target
+ */
+DWORD CCID_LIB(GetTimeMs)(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (DWORD) (ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/**
+ * @brief Microseconds of a monotonic clock (for the capture of the traffic, see CCID_CAPTURE)
+ * @note This function must be implemented specifically for the OS/target
+ */
+DWORD CCID_LIB(GetTimeUs)(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (DWORD) (ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/**
+ * @brief Enter the critical section that protects the locks of the driver and of the PC/SC-Like stack
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockEnter)(void)
+{
+	pthread_mutex_lock(&ccid_lock_mutex);
+}
+
+/**
+ * @brief Leave the critical section
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockLeave)(void)
+{
+	pthread_mutex_unlock(&ccid_lock_mutex);
+}
+
+/**
+ * @brief Leave the critical section, wait until CCID_LockNotifyAll is called, and enter the critical section again
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockWait)(void)
+{
+	pthread_cond_wait(&ccid_lock_cond, &ccid_lock_mutex);
+}
+
+/**
+ * @brief Wake up all the callers waiting in CCID_LockWait
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockNotifyAll)(void)
+{
+	pthread_cond_broadcast(&ccid_lock_cond);
+}
+
+/**
+ * @brief Return a non-zero value that identifies the calling thread
+ * @note This function must be implemented specifically for the OS/target
+ */
+DWORD CCID_LIB(GetCallerId)(void)
+{
+	return (DWORD) syscall(SYS_gettid);
+}
+
+/**
+ * @internal
+ * @brief Path of the profile of the selected port: $CCID_PROFILE_DIR, $XDG_CACHE_HOME/ccid-serial or ~/.cache/ccid-serial, then the port name with '/' replaced by '_'
+ * @return FALSE if there is no port, or no place to store the profile
+ */
+static BOOL ccid_profile_path(char szPath[], size_t size, BOOL fCreateDir)
+{
+	CCID_LINUX_PORT_ST* port = ccid_port();
+	const char* szDir = getenv("CCID_PROFILE_DIR");
+	char szParent[PATH_MAX];
+	char szName[PATH_MAX];
+	size_t i;
+
+	if (port->szCommName == NULL)
+		return FALSE;
+
+	szParent[0] = '\0';
+	if (szDir == NULL)
+	{
+		const char* szCache = getenv("XDG_CACHE_HOME");
+		const char* szHome = getenv("HOME");
+
+		if (szCache != NULL)
+			snprintf(szParent, sizeof(szParent), "%s", szCache);
+		else if (szHome != NULL)
+			snprintf(szParent, sizeof(szParent), "%s/.cache", szHome);
+		else
 			return FALSE;
-		}
 	}
-	pthread_mutex_unlock(&ccid_wakeup_mutex);
+
+	for (i = 0; (port->szCommName[i] != '\0') && (i < sizeof(szName) - 1); i++)
+		szName[i] = (port->szCommName[i] == '/') ? '_' : port->szCommName[i];
+	szName[i] = '\0';
+
+	if (szDir != NULL)
+	{
+		if (fCreateDir)
+			mkdir(szDir, 0700);
+		return (snprintf(szPath, size, "%s/%s.profile", szDir, szName) < (int) size);
+	}
+
+	if (fCreateDir)
+	{
+		char szOurDir[PATH_MAX];
+		mkdir(szParent, 0700);
+		snprintf(szOurDir, sizeof(szOurDir), "%s/ccid-serial", szParent);
+		mkdir(szOurDir, 0700);
+	}
+	return (snprintf(szPath, size, "%s/ccid-serial/%s.profile", szParent, szName) < (int) size);
+}
+
+/**
+ * @brief Read the profile of the device on the selected port
+ * @note This function must be implemented specifically for the OS/target. Here the profile is a file (see ccid_profile_path).
+ */
+BOOL CCID_LIB(ProfileRead)(BYTE abData[], DWORD* pdwLength)
+{
+	char szPath[PATH_MAX];
+	ssize_t len;
+	int fd;
+
+	if ((abData == NULL) || (pdwLength == NULL))
+		return FALSE;
+	if (!ccid_profile_path(szPath, sizeof(szPath), FALSE))
+		return FALSE;
+
+	fd = open(szPath, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return FALSE;
+	len = read(fd, abData, *pdwLength);
+	close(fd);
+
+	if (len < 0)
+		return FALSE;
+	*pdwLength = (DWORD) len;
+	return TRUE;
+}
+
+/**
+ * @brief Write (or remove, if dwLength is 0) the profile of the device on the selected port
+ * @note This function must be implemented specifically for the OS/target. Here the profile is a file, replaced atomically so a crash never leaves half a profile.
+ */
+BOOL CCID_LIB(ProfileWrite)(const BYTE abData[], DWORD dwLength)
+{
+	char szPath[PATH_MAX];
+	char szTempPath[PATH_MAX + 8];
+	int fd;
+
+	if (!ccid_profile_path(szPath, sizeof(szPath), dwLength != 0))
+		return FALSE;
+
+	if ((dwLength == 0) || (abData == NULL))
+		return (unlink(szPath) == 0) || (errno == ENOENT);
+
+	snprintf(szTempPath, sizeof(szTempPath), "%s.tmp", szPath);
+	fd = open(szTempPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return FALSE;
+	if (write(fd, abData, dwLength) != (ssize_t) dwLength)
+	{
+		close(fd);
+		unlink(szTempPath);
+		return FALSE;
+	}
+	close(fd);
+
+	if (rename(szTempPath, szPath) != 0)
+	{
+		unlink(szTempPath);
+		return FALSE;
+	}
 	return TRUE;
 }
 
@@ -273,24 +757,54 @@ BOOL CCID_LIB(WaitWakeup)(DWORD timeout_ms)
  */
 static void* ccid_serial_recv_task(void* arg)
 {
-	int fd = *(int *)arg;
+	CCID_LINUX_PORT_ST* port = (CCID_LINUX_PORT_ST*) arg;
+	struct pollfd fds[2];
+
+	fds[0].fd = port->iCommHandle;
+	fds[0].events = POLLIN;
+	fds[1].fd = port->iStopHandle;
+	fds[1].events = POLLIN;
 	
-    while (ccid_comm_open)
+	while (port->fCommOpen)
 	{
-		BYTE bValue;
-        if (read(fd, &bValue, 1) > 0)
+		BYTE abValue[64];
+		int done;
+
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+
+		if (fds[1].revents & POLLIN)
+			break; /* CCID_SerialClose */
+
+		if (!fds[0].revents)
+			continue;
+
+		/* Take all that has arrived (at least one byte) */
+		done = read(port->iCommHandle, abValue, sizeof(abValue));
+		if (done > 0)
 		{
-			CCID_LIB(SerialRecvByteFromISR)(bValue);
-        }
-    }
-    return NULL;
+			CCID_LIB(InstanceRecvBytesFromISR)(port->bInstance, abValue, done);
+		}
+		else if ((done == 0) || ((errno != EINTR) && (errno != EAGAIN)))
+		{
+			/* The device is gone: wake up the waiters, they'll find that the port is closed */
+			port->fCommOpen = FALSE;
+			CCID_LIB(InstanceWakeupFromISR)(port->bInstance);
+		}
+	}
+	return NULL;
 }	
 
 /**
  * @brief Configure the UART for CCID operation
  * @note This function must be implemented specifically for the OS/target
  */
-static BOOL ccid_serial_configure(void)
+static BOOL ccid_serial_configure(int fd)
 {
 	struct termios newtio;
   
@@ -311,7 +825,7 @@ static BOOL ccid_serial_configure(void)
 	newtio.c_cc[VTIME] = 0;       // inter-character timer unused
 	newtio.c_cc[VMIN]  = 1;        // blocking read until 1 chars received
 
-	if (tcsetattr(ccid_comm_handle, TCSANOW, &newtio))
+	if (tcsetattr(fd, TCSANOW, &newtio))
 	{
 		perror("tcsetattr");
 		return FALSE;
@@ -324,9 +838,9 @@ static BOOL ccid_serial_configure(void)
  * @brief Flush the UART
  * @note This function must be implemented specifically for the OS/target
  */
-static BOOL ccid_serial_flush(void)
+static BOOL ccid_serial_flush(int fd)
 {
-	if (tcflush(ccid_comm_handle, TCIFLUSH))
+	if (tcflush(fd, TCIFLUSH))
 	{
 		perror("tcflush");
 		return FALSE;		
@@ -90,6 +90,19 @@ BOOL CCID_LIB(SerialSendBytes)(const BYTE* abValue, DWORD dwLength)
 	return TRUE;
 }
 
+/**
+ * @brief Reset the link with the device after a communication error: send a BREAK once the pending bytes are out
+ * @note The bytes received before the BREAK are dropped by CCID_Recover, there is no FIFO to flush here
+ */
+BOOL CCID_LIB(SerialReset)(void)
+{
+	uart_tx_wait_blocking(UART_ID);
+	uart_set_break(UART_ID, true);
+	sleep_ms(CCID_SERIAL_BREAK_MS);
+	uart_set_break(UART_ID, false);
+	return TRUE;
+}
+
 /**
  * @todo Optimize this part if you have a kernel
  */
@@ -130,3 +143,87 @@ BOOL CCID_LIB(WaitWakeup)(DWORD timeout_ms)
 	return TRUE;
 }
 
+/**
+ * @brief Milliseconds of a monotonic clock
+ * @note This function must be implemented specifically for the OS/target
+ */
+DWORD CCID_LIB(GetTimeMs)(void)
+{
+	return to_ms_since_boot(get_absolute_time());
+}
+
+/**
+ * @brief Microseconds of a monotonic clock (for the capture of the traffic, see CCID_CAPTURE)
+ * @note This function must be implemented specifically for the OS/target
+ */
+DWORD CCID_LIB(GetTimeUs)(void)
+{
+	return time_us_32();
+}
+
+/**
+ * @brief Enter the critical section that protects the locks of the driver and of the PC/SC-Like stack
+ * @note This function must be implemented specifically for the OS/target. Without a kernel, there is only one caller, and nothing to do.
+ */
+void CCID_LIB(LockEnter)(void)
+{
+
+}
+
+/**
+ * @brief Leave the critical section
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockLeave)(void)
+{
+
+}
+
+/**
+ * @brief Leave the critical section, wait until CCID_LockNotifyAll is called, and enter the critical section again
+ * @note This function must be implemented specifically for the OS/target. Without a kernel, there is no other caller to wait for.
+ */
+void CCID_LIB(LockWait)(void)
+{
+
+}
+
+/**
+ * @brief Wake up all the callers waiting in CCID_LockWait
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockNotifyAll)(void)
+{
+
+}
+
+/**
+ * @brief Return a non-zero value that identifies the calling task/thread
+ * @note This function must be implemented specifically for the OS/target. Without a kernel, there is only one caller.
+ */
+DWORD CCID_LIB(GetCallerId)(void)
+{
+	return 1;
+}
+
+/**
+ * @brief Read the profile of the device (see CCID_LoadProfile)
+ * @note This function must be implemented specifically for the target, e.g. in flash or EEPROM. Without storage, return FALSE: the driver asks the device at every startup.
+ */
+BOOL CCID_LIB(ProfileRead)(BYTE abData[], DWORD* pdwLength)
+{
+	(void) abData;
+	(void) pdwLength;
+	return FALSE;
+}
+
+/**
+ * @brief Write (or erase, if dwLength is 0) the profile of the device (see CCID_SaveProfile)
+ * @note This function must be implemented specifically for the target, e.g. in flash or EEPROM. Without storage, return FALSE.
+ */
+BOOL CCID_LIB(ProfileWrite)(const BYTE abData[], DWORD dwLength)
+{
+	(void) abData;
+	(void) dwLength;
+	return FALSE;
+}
@@ -58,15 +58,16 @@
 
 /**
  * @todo Write your UART RX interrupt handler so that CCID_LIB(SerialRecvByteFromISR)(bValue) is called everytime a byte is received
+ * (or CCID_LIB(SerialRecvBytesFromISR)(abValues, dwLength) for all the bytes of the FIFO or of the DMA buffer)
  */
 
 /**
  * @brief Prepare the serial library
  * @note This function may have a different prototype, depending on the OS/target requirements
  */
-void CCID_LIB(SerialInit)(void)
+void CCID_LIB(SerialInit)(const char* szCommName)
 {
-
+#error Implement CCID_SerialInit: remember the comm port (szCommName may be ignored if there is only one UART)
 }
 
 /**
@@ -75,7 +76,7 @@ void CCID_LIB(SerialInit)(void)
  */
 BOOL CCID_LIB(SerialOpen)(void)
 {
-
+#error Implement CCID_SerialOpen: 38400bps, 8 data bits, 1 stop bit, no parity, no flow control, RX interrupt enabled
 }
 
 /**
@@ -84,7 +85,7 @@ BOOL CCID_LIB(SerialOpen)(void)
  */
 void CCID_LIB(SerialClose)(void)
 {
-
+#error Implement CCID_SerialClose
 }
 
 /**
@@ -93,7 +94,7 @@ void CCID_LIB(SerialClose)(void)
  */
 BOOL CCID_LIB(SerialIsOpen)(void)
 {
-
+#error Implement CCID_SerialIsOpen
 }
 
 /**
@@ -102,7 +103,7 @@ BOOL CCID_LIB(SerialIsOpen)(void)
  */
 BOOL CCID_LIB(SerialSendByte)(BYTE bValue)
 {
-
+#error Implement CCID_SerialSendByte
 }
 
 /**
@@ -118,6 +119,26 @@ BOOL CCID_LIB(SerialSendBytes)(const BYTE* abValue, DWORD dwLength)
 	return TRUE;
 }
 
+/**
+ * @brief Reset the link with the device after a communication error
+ * @note This function must be implemented specifically for the OS/target. Send a BREAK (a few ms), then flush both directions.
+ * Return FALSE if the target cannot do it: CCID_Recover fails, and the caller falls back to waiting 1200ms.
+ */
+BOOL CCID_LIB(SerialReset)(void)
+{
+	return FALSE;
+}
+
+/**
+ * @brief Wait for the comm port to appear (hosts where it comes and goes, e.g. USB-serial adapters)
+ * @note Only the PC sample calls it: the UART of an MCU is always there
+ */
+BOOL CCID_LIB(SerialWaitPort)(DWORD timeout_ms)
+{
+	(void) timeout_ms;
+	return TRUE;
+}
+
 /**
  * @todo Optimize this part if you have a kernel
  */
@@ -157,3 +178,101 @@ BOOL CCID_LIB(WaitWakeup)(DWORD timeout_ms)
 	return TRUE;
 }
 
+/**
+ * @brief Milliseconds of a monotonic clock
+ * @note This function must be implemented specifically for the OS/target
+ */
+DWORD CCID_LIB(GetTimeMs)(void)
+{
+	/* A clock that does not run would make every timeout never expire */
+#error Implement CCID_GetTimeMs: return the value of a timer that runs at 1kHz
+}
+
+/**
+ * @brief Microseconds of a monotonic clock
+ * @note This function must be implemented specifically for the OS/target, but only if CCID_CAPTURE, CCID_HISTOGRAMS, CCID_TRACE or CCID_TIMELINE is set
+ */
+DWORD CCID_LIB(GetTimeUs)(void)
+{
+#if (CCID_CAPTURE || CCID_HISTOGRAMS || CCID_TRACE || CCID_TIMELINE)
+#error Implement CCID_GetTimeUs: return the value of a timer that runs at 1MHz
+#else
+	/* Never called */
+	return 0;
+#endif
+}
+
+/**
+ * @todo Without a kernel, define SKEL_SINGLE_TASK in project.h: the locks do nothing. Otherwise write them with the mutex and the condition of your kernel
+ */
+
+#if (!defined(SKEL_SINGLE_TASK))
+#error Implement CCID_LockEnter, CCID_LockLeave, CCID_LockWait, CCID_LockNotifyAll and CCID_GetCallerId with your kernel, or define SKEL_SINGLE_TASK if only one task calls the library
+#endif
+
+/**
+ * @brief Enter the critical section that protects the locks of the driver and of the PC/SC-Like stack
+ * @note This function must be implemented specifically for the OS/target. Without a kernel, there is only one caller, and nothing to do.
+ */
+void CCID_LIB(LockEnter)(void)
+{
+
+}
+
+/**
+ * @brief Leave the critical section
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockLeave)(void)
+{
+
+}
+
+/**
+ * @brief Leave the critical section, wait until CCID_LockNotifyAll is called, and enter the critical section again
+ * @note This function must be implemented specifically for the OS/target. Without a kernel, there is no other caller to wait for.
+ */
+void CCID_LIB(LockWait)(void)
+{
+
+}
+
+/**
+ * @brief Wake up all the callers waiting in CCID_LockWait
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockNotifyAll)(void)
+{
+
+}
+
+/**
+ * @brief Return a non-zero value that identifies the calling task/thread
+ * @note This function must be implemented specifically for the OS/target. Without a kernel, there is only one caller.
+ */
+DWORD CCID_LIB(GetCallerId)(void)
+{
+	return 1;
+}
+
+/**
+ * @brief Read the profile of the device (see CCID_LoadProfile)
+ * @note This function must be implemented specifically for the target, e.g. in flash or EEPROM. Without storage, return FALSE: the driver asks the device at every startup.
+ */
+BOOL CCID_LIB(ProfileRead)(BYTE abData[], DWORD* pdwLength)
+{
+	(void) abData;
+	(void) pdwLength;
+	return FALSE;
+}
+
+/**
+ * @brief Write (or erase, if dwLength is 0) the profile of the device (see CCID_SaveProfile)
+ * @note This function must be implemented specifically for the target, e.g. in flash or EEPROM. Without storage, return FALSE.
+ */
+BOOL CCID_LIB(ProfileWrite)(const BYTE abData[], DWORD dwLength)
+{
+	(void) abData;
+	(void) dwLength;
+	return FALSE;
+}
@@ -56,6 +56,19 @@
 #include "../../ccid/ccid_hal.h"
 #include "../../scard/scard_errors.h"
 
+#include <cfgmgr32.h>
+#if (defined(_MSC_VER))
+#pragma comment(lib, "cfgmgr32.lib")
+#endif
+
+/* If the configuration manager does not take the notification request (it needs Windows 8), CCID_SerialWaitPort looks for the port that often */
+#define CCID_SERIAL_WAIT_PORT_POLL_MS 50
+/* Some drivers do not register the COMPORT interface: even with the notifications, CCID_SerialWaitPort looks for the port that often */
+#define CCID_SERIAL_WAIT_PORT_RECHECK_MS 1000
+
+/* GUID_DEVINTERFACE_COMPORT (ntddser.h) */
+static const GUID ccid_guid_comport = { 0x86E0D1E0, 0x8089, 0x11D0, { 0x9C, 0xE4, 0x08, 0x00, 0x3E, 0x30, 0x1F, 0x73 } };
+
 static BOOL ccid_serial_configure(void);
 static BOOL ccid_serial_flush(void);
 static DWORD WINAPI ccid_serial_recv_task(void* unused);
@@ -66,6 +79,9 @@ static HANDLE hEvent = INVALID_HANDLE_VALUE;
 
 static const char* ccid_comm_name;
 
+static SRWLOCK ccid_lock_srw = SRWLOCK_INIT;
+static CONDITION_VARIABLE ccid_lock_cond = CONDITION_VARIABLE_INIT;
+
 /**
  * @brief Prepare the serial library, specifying the serial comm port
  * @note This function may have a different prototype, depending on the OS/target requirements
@@ -169,6 +185,130 @@ void CCID_LIB(SerialClose)(void)
 	}	
 }
 
+/**
+ * @brief Reset the link with the device after a communication error: BREAK, DTR/RTS pulse (if CCID_SERIAL_RESET_DTR), and flush of both directions
+ * @return TRUE if the link has been reset, FALSE if the port is not open
+ */
+BOOL CCID_LIB(SerialReset)(void)
+{
+	if (hComm == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	if (!SetCommBreak(hComm))
+		return FALSE;
+	Sleep(CCID_SERIAL_BREAK_MS);
+	ClearCommBreak(hComm);
+
+#if (CCID_SERIAL_RESET_DTR)
+	EscapeCommFunction(hComm, CLRDTR);
+	EscapeCommFunction(hComm, CLRRTS);
+	Sleep(CCID_SERIAL_BREAK_MS);
+	EscapeCommFunction(hComm, SETDTR);
+	EscapeCommFunction(hComm, SETRTS);
+#endif
+
+	PurgeComm(hComm, PURGE_TXCLEAR | PURGE_RXCLEAR);
+
+	return TRUE;
+}
+
+/**
+ * @internal
+ * @brief Called by the configuration manager when a comm port appears
+ */
+static DWORD CALLBACK ccid_serial_port_arrival(HCMNOTIFICATION hNotify, PVOID pContext, CM_NOTIFY_ACTION action, PCM_NOTIFY_EVENT_DATA pEventData, DWORD dwEventDataSize)
+{
+	(void) hNotify;
+	(void) pEventData;
+	(void) dwEventDataSize;
+
+	if (action == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL)
+		SetEvent((HANDLE) pContext);
+
+	return ERROR_SUCCESS;
+}
+
+/**
+ * @brief Wait until the comm port exists (e.g. the USB-serial adapter has been plugged)
+ * @note Call this function when CCID_SerialOpen has failed, instead of sleeping.
+ * Here the configuration manager tells when a comm port (GUID_DEVINTERFACE_COMPORT) arrives, then the DOS device name is looked for.
+ * If CM_Register_Notification fails, the DOS device name is looked for every CCID_SERIAL_WAIT_PORT_POLL_MS instead.
+ * @param timeout_ms max time to wait, (DWORD)-1 for infinite
+ * @return TRUE if the port exists (and it is worth trying to open it), FALSE after the timeout
+ */
+BOOL CCID_LIB(SerialWaitPort)(DWORD timeout_ms)
+{
+	char szTarget[MAX_PATH];
+	const char* szName;
+	DWORD dwStart = GetTickCount();
+	CM_NOTIFY_FILTER filter;
+	HCMNOTIFICATION hNotify = NULL;
+	HANDLE hArrival;
+	BOOL fExisted;
+	BOOL fResult = FALSE;
+
+	if (ccid_comm_name == NULL)
+		return FALSE;
+
+	/* "\\.\COM10" is the same as "COM10" */
+	szName = ccid_comm_name;
+	if (!strncmp(szName, "\\\\.\\", 4))
+		szName += 4;
+
+	/* Register before looking, so no arrival is missed */
+	hArrival = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (hArrival != NULL)
+	{
+		memset(&filter, 0, sizeof(filter));
+		filter.cbSize = sizeof(filter);
+		filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+		filter.u.DeviceInterface.ClassGuid = ccid_guid_comport;
+		if (CM_Register_Notification(&filter, hArrival, ccid_serial_port_arrival, &hNotify) != CR_SUCCESS)
+			hNotify = NULL;
+	}
+
+	fExisted = (QueryDosDeviceA(szName, szTarget, sizeof(szTarget)) != 0);
+
+	for (;;)
+	{
+		DWORD dwWait = (hNotify != NULL) ? CCID_SERIAL_WAIT_PORT_RECHECK_MS : CCID_SERIAL_WAIT_PORT_POLL_MS;
+
+		if (timeout_ms != (DWORD)-1)
+		{
+			DWORD dwElapsed = GetTickCount() - dwStart;
+			if (dwElapsed >= timeout_ms)
+				break;
+			if (dwWait > timeout_ms - dwElapsed)
+				dwWait = timeout_ms - dwElapsed;
+		}
+
+		if (hNotify != NULL)
+			WaitForSingleObject(hArrival, dwWait);
+		else
+			Sleep(dwWait);
+
+		if (QueryDosDeviceA(szName, szTarget, sizeof(szTarget)) != 0)
+		{
+			if (!fExisted)
+			{
+				fResult = TRUE; /* It has appeared */
+				break;
+			}
+		}
+		else
+		{
+			fExisted = FALSE; /* Gone, wait until it comes back */
+		}
+	}
+
+	if (hNotify != NULL)
+		CM_Unregister_Notification(hNotify);
+	if (hArrival != NULL)
+		CloseHandle(hArrival);
+
+	return fResult;
+}
+
 /**
  * @brief Returns TRUE if the serial comm port is open, FALSE otherwise
  * @note This function must be implemented specifically for the OS/target
@@ -253,6 +393,152 @@ BOOL CCID_LIB(WaitWakeup)(DWORD timeout_ms)
 	return FALSE;
 }
 
+/**
+ * @brief Milliseconds of a monotonic clock
+ * @note This function must be implemented specifically for the OS/target
+ */
+DWORD CCID_LIB(GetTimeMs)(void)
+{
+	return GetTickCount();
+}
+
+/**
+ * @brief Microseconds of a monotonic clock (for the capture of the traffic, see CCID_CAPTURE)
+ * @note This function must be implemented specifically for the OS/target
+ */
+DWORD CCID_LIB(GetTimeUs)(void)
+{
+	LARGE_INTEGER counter, frequency;
+
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (DWORD) ((counter.QuadPart / frequency.QuadPart) * 1000000 + ((counter.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart);
+}
+
+/**
+ * @brief Enter the critical section that protects the locks of the driver and of the PC/SC-Like stack
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockEnter)(void)
+{
+	AcquireSRWLockExclusive(&ccid_lock_srw);
+}
+
+/**
+ * @brief Leave the critical section
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockLeave)(void)
+{
+	ReleaseSRWLockExclusive(&ccid_lock_srw);
+}
+
+/**
+ * @brief Leave the critical section, wait until CCID_LockNotifyAll is called, and enter the critical section again
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockWait)(void)
+{
+	SleepConditionVariableSRW(&ccid_lock_cond, &ccid_lock_srw, INFINITE, 0);
+}
+
+/**
+ * @brief Wake up all the callers waiting in CCID_LockWait
+ * @note This function must be implemented specifically for the OS/target
+ */
+void CCID_LIB(LockNotifyAll)(void)
+{
+	WakeAllConditionVariable(&ccid_lock_cond);
+}
+
+/**
+ * @brief Return a non-zero value that identifies the calling thread
+ * @note This function must be implemented specifically for the OS/target
+ */
+DWORD CCID_LIB(GetCallerId)(void)
+{
+	return GetCurrentThreadId();
+}
+
+/**
+ * @internal
+ * @brief Path of the profile of the port: %LOCALAPPDATA%\ccid-serial, then the port name with the special characters replaced by '_'
+ */
+static BOOL ccid_profile_path(char szPath[], size_t size, BOOL fCreateDir)
+{
+	const char* szAppData = getenv("LOCALAPPDATA");
+	char szDir[MAX_PATH];
+	char szName[MAX_PATH];
+	size_t i;
+
+	if ((ccid_comm_name == NULL) || (szAppData == NULL))
+		return FALSE;
+
+	for (i = 0; (ccid_comm_name[i] != '\0') && (i < sizeof(szName) - 1); i++)
+		szName[i] = strchr("\\/:.", ccid_comm_name[i]) ? '_' : ccid_comm_name[i];
+	szName[i] = '\0';
+
+	snprintf(szDir, sizeof(szDir), "%s\\ccid-serial", szAppData);
+	if (fCreateDir)
+		CreateDirectoryA(szDir, NULL);
+
+	return (snprintf(szPath, size, "%s\\%s.profile", szDir, szName) < (int) size);
+}
+
+/**
+ * @brief Read the profile of the device on the port
+ * @note This function must be implemented specifically for the OS/target. Here the profile is a file (see ccid_profile_path).
+ */
+BOOL CCID_LIB(ProfileRead)(BYTE abData[], DWORD* pdwLength)
+{
+	char szPath[MAX_PATH];
+	FILE* f;
+
+	if ((abData == NULL) || (pdwLength == NULL))
+		return FALSE;
+	if (!ccid_profile_path(szPath, sizeof(szPath), FALSE))
+		return FALSE;
+
+	f = fopen(szPath, "rb");
+	if (f == NULL)
+		return FALSE;
+	*pdwLength = (DWORD) fread(abData, 1, *pdwLength, f);
+	fclose(f);
+	return TRUE;
+}
+
+/**
+ * @brief Write (or remove, if dwLength is 0) the profile of the device on the port
+ * @note This function must be implemented specifically for the OS/target. Here the profile is a file, replaced atomically so a crash never leaves half a profile.
+ */
+BOOL CCID_LIB(ProfileWrite)(const BYTE abData[], DWORD dwLength)
+{
+	char szPath[MAX_PATH];
+	char szTempPath[MAX_PATH + 8];
+	FILE* f;
+	BOOL fOk;
+
+	if (!ccid_profile_path(szPath, sizeof(szPath), dwLength != 0))
+		return FALSE;
+
+	if ((dwLength == 0) || (abData == NULL))
+		return DeleteFileA(szPath) || (GetLastError() == ERROR_FILE_NOT_FOUND);
+
+	snprintf(szTempPath, sizeof(szTempPath), "%s.tmp", szPath);
+	f = fopen(szTempPath, "wb");
+	if (f == NULL)
+		return FALSE;
+	fOk = (fwrite(abData, 1, dwLength, f) == dwLength);
+	if (fclose(f) != 0)
+		fOk = FALSE;
+
+	if (fOk)
+		fOk = MoveFileExA(szTempPath, szPath, MOVEFILE_REPLACE_EXISTING);
+	if (!fOk)
+		DeleteFileA(szTempPath);
+	return fOk;
+}
+
 /**
  * @brief Receive bytes coming from the CCID device; call CCID_RecvByteFromISR every time a byte arrives
  * @note This function must be implemented specifically for the OS/target. It is namely the UART's RX ISR.
@@ -0,0 +1,298 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_ifd.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief pcsc-lite IFD handler for the SpringCard serial couplers
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+/*
+ * This file sees the types of pcsc-lite only (DWORD is an unsigned long there, BOOL a short): it talks to the driver through ccid_ifd_bridge.h.
+ * Lun: the reader is in the upper 16 bits, the slot in the lower 16 bits.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <ifdhandler.h>
+#include <reader.h>
+
+#include "ccid_ifd_bridge.h"
+
+#define CCID_IFD_READER(Lun) ((unsigned long) ((Lun) >> 16))
+#define CCID_IFD_SLOT(Lun) ((unsigned char) ((Lun) & 0x0000FFFF))
+
+#define CCID_IFD_VENDOR_NAME "SpringCard"
+
+/**
+ * @internal
+ * @brief What pcscd shall know of a result of the bridge
+ */
+static RESPONSECODE ccid_ifd_response(int result)
+{
+	switch (result)
+	{
+		case CCID_IFD_OK:
+			return IFD_SUCCESS;
+		case CCID_IFD_NO_CARD:
+			return IFD_ICC_NOT_PRESENT;
+		case CCID_IFD_TIMEOUT:
+			return IFD_RESPONSE_TIMEOUT;
+		case CCID_IFD_INSUFFICIENT_BUFFER:
+			return IFD_ERROR_INSUFFICIENT_BUFFER;
+		case CCID_IFD_NO_DEVICE:
+			return IFD_NO_SUCH_DEVICE;
+		case CCID_IFD_COMM_ERROR:
+			return IFD_COMMUNICATION_ERROR;
+		default:
+			return IFD_COMMUNICATION_ERROR;
+	}
+}
+
+/**
+ * @brief Open the reader declared by DEVICENAME in reader.conf, e.g. /dev/ttyUSB0
+ */
+RESPONSECODE IFDHCreateChannelByName(DWORD Lun, LPSTR DeviceName)
+{
+	return ccid_ifd_response(ccid_ifd_open(CCID_IFD_READER(Lun), DeviceName));
+}
+
+/**
+ * @brief Open the reader declared by CHANNELID in reader.conf: 0x0103F8 is /dev/ttyS0, 0x0102F8 /dev/ttyS1, 0x0103E8 /dev/ttyS2, 0x0102E8 /dev/ttyS3
+ */
+RESPONSECODE IFDHCreateChannel(DWORD Lun, DWORD Channel)
+{
+	char szDevice[32];
+	int iPort;
+
+	switch (Channel)
+	{
+		case 0x0103F8: iPort = 0; break;
+		case 0x0102F8: iPort = 1; break;
+		case 0x0103E8: iPort = 2; break;
+		case 0x0102E8: iPort = 3; break;
+		default: iPort = (int) (Channel & 0xFF); break;
+	}
+
+	snprintf(szDevice, sizeof(szDevice), "/dev/ttyS%d", iPort);
+	return ccid_ifd_response(ccid_ifd_open(CCID_IFD_READER(Lun), szDevice));
+}
+
+RESPONSECODE IFDHCloseChannel(DWORD Lun)
+{
+	ccid_ifd_close(CCID_IFD_READER(Lun));
+	return IFD_SUCCESS;
+}
+
+RESPONSECODE IFDHGetCapabilities(DWORD Lun, DWORD Tag, PDWORD Length, PUCHAR Value)
+{
+	unsigned long ulLength;
+	unsigned char bSlotCount;
+	int result;
+
+	switch (Tag)
+	{
+		case TAG_IFD_ATR:
+		case SCARD_ATTR_ATR_STRING:
+			ulLength = *Length;
+			result = ccid_ifd_get_atr(CCID_IFD_READER(Lun), CCID_IFD_SLOT(Lun), Value, &ulLength);
+			*Length = (result == CCID_IFD_OK) ? ulLength : 0;
+			return ccid_ifd_response(result);
+
+		case TAG_IFD_SLOTS_NUMBER:
+			if (*Length < 1)
+				return IFD_ERROR_INSUFFICIENT_BUFFER;
+			result = ccid_ifd_slot_count(CCID_IFD_READER(Lun), &bSlotCount);
+			if (result != CCID_IFD_OK)
+				return ccid_ifd_response(result);
+			Value[0] = bSlotCount;
+			*Length = 1;
+			return IFD_SUCCESS;
+
+		case TAG_IFD_SIMULTANEOUS_ACCESS:
+			/* One reader per instance of the driver */
+			if (*Length < 1)
+				return IFD_ERROR_INSUFFICIENT_BUFFER;
+			Value[0] = ccid_ifd_max_readers();
+			*Length = 1;
+			return IFD_SUCCESS;
+
+		case TAG_IFD_THREAD_SAFE:
+			/* The bridge takes a mutex around every call */
+			if (*Length < 1)
+				return IFD_ERROR_INSUFFICIENT_BUFFER;
+			Value[0] = 1;
+			*Length = 1;
+			return IFD_SUCCESS;
+
+		case TAG_IFD_SLOT_THREAD_SAFE:
+			/* The slots of a device share the serial link: one exchange at a time */
+			if (*Length < 1)
+				return IFD_ERROR_INSUFFICIENT_BUFFER;
+			Value[0] = 0;
+			*Length = 1;
+			return IFD_SUCCESS;
+
+		case SCARD_ATTR_VENDOR_NAME:
+			if (*Length < sizeof(CCID_IFD_VENDOR_NAME))
+				return IFD_ERROR_INSUFFICIENT_BUFFER;
+			memcpy(Value, CCID_IFD_VENDOR_NAME, sizeof(CCID_IFD_VENDOR_NAME));
+			*Length = sizeof(CCID_IFD_VENDOR_NAME);
+			return IFD_SUCCESS;
+
+		case SCARD_ATTR_MAXINPUT:
+			if (*Length < 4)
+				return IFD_ERROR_INSUFFICIENT_BUFFER;
+			ulLength = ccid_ifd_max_length(CCID_IFD_READER(Lun));
+			if (ulLength == 0)
+				return IFD_COMMUNICATION_ERROR;
+			Value[0] = (UCHAR) ulLength;
+			Value[1] = (UCHAR) (ulLength >> 8);
+			Value[2] = (UCHAR) (ulLength >> 16);
+			Value[3] = (UCHAR) (ulLength >> 24);
+			*Length = 4;
+			return IFD_SUCCESS;
+
+		default:
+			return IFD_ERROR_TAG;
+	}
+}
+
+RESPONSECODE IFDHSetCapabilities(DWORD Lun, DWORD Tag, DWORD Length, PUCHAR Value)
+{
+	(void) Lun;
+	(void) Tag;
+	(void) Length;
+	(void) Value;
+	return IFD_NOT_SUPPORTED;
+}
+
+/**
+ * @brief The device talks T=0 or T=1 to the card itself and takes APDUs: there is nothing to negotiate here
+ */
+RESPONSECODE IFDHSetProtocolParameters(DWORD Lun, DWORD Protocol, UCHAR Flags, UCHAR PTS1, UCHAR PTS2, UCHAR PTS3)
+{
+	(void) Lun;
+	(void) Flags;
+	(void) PTS1;
+	(void) PTS2;
+	(void) PTS3;
+
+	if ((Protocol != SCARD_PROTOCOL_T0) && (Protocol != SCARD_PROTOCOL_T1))
+		return IFD_PROTOCOL_NOT_SUPPORTED;
+	return IFD_SUCCESS;
+}
+
+RESPONSECODE IFDHPowerICC(DWORD Lun, DWORD Action, PUCHAR Atr, PDWORD AtrLength)
+{
+	unsigned long ulAtrLength = *AtrLength;
+	int result;
+
+	switch (Action)
+	{
+		case IFD_POWER_UP:
+		case IFD_RESET:
+			result = ccid_ifd_power_up(CCID_IFD_READER(Lun), CCID_IFD_SLOT(Lun), Action == IFD_RESET, Atr, &ulAtrLength);
+			*AtrLength = (result == CCID_IFD_OK) ? ulAtrLength : 0;
+			break;
+
+		case IFD_POWER_DOWN:
+			result = ccid_ifd_power_down(CCID_IFD_READER(Lun), CCID_IFD_SLOT(Lun));
+			*AtrLength = 0;
+			break;
+
+		default:
+			return IFD_NOT_SUPPORTED;
+	}
+
+	return ccid_ifd_response(result);
+}
+
+RESPONSECODE IFDHTransmitToICC(DWORD Lun, SCARD_IO_HEADER SendPci, PUCHAR TxBuffer, DWORD TxLength, PUCHAR RxBuffer, PDWORD RxLength, PSCARD_IO_HEADER RecvPci)
+{
+	unsigned long ulRecvLength = *RxLength;
+	int result;
+
+	result = ccid_ifd_transmit(CCID_IFD_READER(Lun), CCID_IFD_SLOT(Lun), TxBuffer, TxLength, RxBuffer, &ulRecvLength);
+	*RxLength = ulRecvLength;
+	if (RecvPci != NULL)
+		RecvPci->Protocol = SendPci.Protocol;
+	return ccid_ifd_response(result);
+}
+
+/**
+ * @brief Escape commands go to the device as they are (SCARD_Control of the PC/SC-Like stack)
+ */
+RESPONSECODE IFDHControl(DWORD Lun, DWORD dwControlCode, PUCHAR TxBuffer, DWORD TxLength, PUCHAR RxBuffer, DWORD RxLength, LPDWORD pdwBytesReturned)
+{
+	unsigned long ulRecvLength = RxLength;
+	int result;
+
+	/* No PC/SC v2 part 10 feature */
+	if (dwControlCode == CM_IOCTL_GET_FEATURE_REQUEST)
+	{
+		*pdwBytesReturned = 0;
+		return IFD_SUCCESS;
+	}
+	if (dwControlCode != IOCTL_SMARTCARD_VENDOR_IFD_EXCHANGE)
+	{
+		*pdwBytesReturned = 0;
+		return IFD_ERROR_NOT_SUPPORTED;
+	}
+
+	result = ccid_ifd_control(CCID_IFD_READER(Lun), TxBuffer, TxLength, RxBuffer, &ulRecvLength);
+	*pdwBytesReturned = ulRecvLength;
+	return ccid_ifd_response(result);
+}
+
+/**
+ * @brief pcscd calls this every few hundred milliseconds: the answer comes from the notifications, not from the serial link
+ */
+RESPONSECODE IFDHICCPresence(DWORD Lun)
+{
+	return ccid_ifd_response(ccid_ifd_presence(CCID_IFD_READER(Lun), CCID_IFD_SLOT(Lun)));
+}
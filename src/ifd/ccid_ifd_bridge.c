@@ -0,0 +1,494 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_ifd_bridge.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Between the pcsc-lite IFD handler and the driver: the driver side
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#include <project.h>
+
+#include "../pcsc-serial.h"
+#include "../scard/scard.h"
+#include "../ccid/ccid.h"
+#include "../ccid/ccid_hal.h"
+#include "ccid_ifd_bridge.h"
+
+#include <pthread.h>
+
+/* As many readers as the driver has instances */
+#define CCID_IFD_MAX_READERS CCID_MAX_INSTANCE_COUNT
+/* A device that has been lost is looked for again at most this often */
+#define CCID_IFD_RECONNECT_MS 1000
+
+/**
+ * @internal
+ * @brief A reader of pcscd, i.e. an instance of the driver
+ */
+typedef struct
+{
+	BOOL fOpen;
+	BOOL fReady;
+	unsigned long ulReader; /* Lun >> 16 */
+	char szDevice[256];
+	BYTE bSlotCount;
+	DWORD dwLastAttemptMs;
+	CCID_SLOT_SET_ST present; /* As the notifications say */
+	CCID_SLOT_SET_ST changed; /* Changes that have not been reported to pcscd yet */
+	CCID_SLOT_SET_ST reported; /* Last answer to pcscd */
+	BYTE abAtr[CCID_MAX_SLOT_COUNT][CCID_IFD_MAX_ATR_LENGTH];
+	DWORD adwAtrLength[CCID_MAX_SLOT_COUNT];
+} CCID_IFD_READER_ST;
+
+BOOL fVerbose = FALSE;
+
+/* Guards the table of readers and the state of their slots: pcscd's threads go through the bridge one at a time */
+static pthread_mutex_t ccid_ifd_mutex = PTHREAD_MUTEX_INITIALIZER;
+static CCID_IFD_READER_ST ccid_ifd_readers[CCID_IFD_MAX_READERS];
+
+/**
+ * @brief pcscd never cancels anything, it stops the reader instead
+ */
+BOOL SCARD_LIB(IsCancelledHook)(void)
+{
+	return FALSE;
+}
+
+/**
+ * @internal
+ * @brief What pcscd shall know of a return code of the driver
+ */
+static int ccid_ifd_result(LONG rc)
+{
+	switch (rc)
+	{
+		case SCARD_ERR(S_SUCCESS):
+			return CCID_IFD_OK;
+		case SCARD_ERR(E_NO_SMARTCARD):
+		case SCARD_ERR(W_REMOVED_CARD):
+			return CCID_IFD_NO_CARD;
+		case SCARD_ERR(E_TIMEOUT):
+			return CCID_IFD_TIMEOUT;
+		case SCARD_ERR(E_INSUFFICIENT_BUFFER):
+			return CCID_IFD_INSUFFICIENT_BUFFER;
+		default:
+			return SCARD_LIB(IsFatalError)(rc) ? CCID_IFD_COMM_ERROR : CCID_IFD_ERROR;
+	}
+}
+
+/**
+ * @internal
+ * @brief Open the device, start it with the notifications, and learn the initial state of the slots
+ */
+static int ccid_ifd_connect(CCID_IFD_READER_ST* reader)
+{
+	LONG rc;
+
+	reader->dwLastAttemptMs = CCID_LIB(GetTimeMs)();
+
+	if (CCID_LIB(SerialIsOpen)())
+		CCID_LIB(SerialClose)();
+	if (!CCID_LIB(SerialOpen)())
+		return CCID_IFD_NO_DEVICE;
+
+	CCID_LIB(Init)();
+	rc = CCID_LIB(Ping)();
+	if (rc != SCARD_ERR(S_SUCCESS))
+		rc = CCID_LIB(Recover)();
+	/* With the notifications, the presence of the cards costs nothing on the serial link */
+	if (rc == SCARD_ERR(S_SUCCESS))
+		rc = CCID_LIB(Start)(TRUE);
+	if (rc == SCARD_ERR(S_SUCCESS))
+	{
+		SCARD_LIB(Init)();
+		rc = CCID_LIB(GetSlotCount)(&reader->bSlotCount);
+	}
+	if (rc != SCARD_ERR(S_SUCCESS))
+	{
+		printf("%s: no device (rc=%lX)\n", reader->szDevice, rc);
+		CCID_LIB(SerialClose)();
+		return CCID_IFD_COMM_ERROR;
+	}
+	if (reader->bSlotCount > CCID_MAX_SLOT_COUNT)
+		reader->bSlotCount = CCID_MAX_SLOT_COUNT;
+
+	/* The notifications only tell what changes: the state of the slots when we start costs a GetSlotStatus each */
+	CCID_LIB(SlotSetClear)(&reader->present);
+	CCID_LIB(SlotSetClear)(&reader->changed);
+	CCID_LIB(SlotSetClear)(&reader->reported);
+	for (BYTE bSlot = 0; bSlot < reader->bSlotCount; bSlot++)
+	{
+		BOOL fPresent = FALSE;
+
+		if ((SCARD_LIB(Status)(bSlot, &fPresent, NULL) == SCARD_ERR(S_SUCCESS)) && fPresent)
+			CCID_LIB(SlotSetAdd)(&reader->present, bSlot);
+		reader->adwAtrLength[bSlot] = 0;
+	}
+
+	reader->fReady = TRUE;
+	return CCID_IFD_OK;
+}
+
+/**
+ * @internal
+ * @brief Select the instance of a reader, and find the device again if it has been lost
+ */
+static int ccid_ifd_select(unsigned long ulReader, CCID_IFD_READER_ST** ppReader)
+{
+	for (BYTE bInstance = 0; bInstance < CCID_IFD_MAX_READERS; bInstance++)
+	{
+		CCID_IFD_READER_ST* reader = &ccid_ifd_readers[bInstance];
+
+		if (!reader->fOpen || (reader->ulReader != ulReader))
+			continue;
+
+		CCID_LIB(SelectInstance)(bInstance);
+		*ppReader = reader;
+
+		if (reader->fReady && SCARD_LIB(IsValidContext)())
+			return CCID_IFD_OK;
+
+		/* pcscd keeps on asking, the device is not looked for at every call */
+		reader->fReady = FALSE;
+		if (CCID_LIB(GetTimeMs)() - reader->dwLastAttemptMs < CCID_IFD_RECONNECT_MS)
+			return CCID_IFD_COMM_ERROR;
+		return ccid_ifd_connect(reader);
+	}
+
+	return CCID_IFD_NO_DEVICE;
+}
+
+/**
+ * @brief How many readers may be open at the same time (pcscd's TAG_IFD_SIMULTANEOUS_ACCESS)
+ */
+unsigned char ccid_ifd_max_readers(void)
+{
+	return CCID_IFD_MAX_READERS;
+}
+
+/**
+ * @brief Open the device of a reader (pcscd's IFDHCreateChannelByName)
+ */
+int ccid_ifd_open(unsigned long ulReader, const char* szDevice)
+{
+	CCID_IFD_READER_ST* reader = NULL;
+	int result;
+
+	if ((szDevice == NULL) || (strlen(szDevice) >= sizeof(reader->szDevice)))
+		return CCID_IFD_ERROR;
+
+	pthread_mutex_lock(&ccid_ifd_mutex);
+
+	fVerbose = (getenv("CCID_SERIAL_VERBOSE") != NULL);
+
+	for (BYTE bInstance = 0; bInstance < CCID_IFD_MAX_READERS; bInstance++)
+	{
+		if (ccid_ifd_readers[bInstance].fOpen)
+			continue;
+
+		reader = &ccid_ifd_readers[bInstance];
+		memset(reader, 0, sizeof(CCID_IFD_READER_ST));
+		reader->ulReader = ulReader;
+		strcpy(reader->szDevice, szDevice);
+
+		CCID_LIB(SelectInstance)(bInstance);
+		CCID_LIB(SerialInit)(reader->szDevice);
+		break;
+	}
+
+	if (reader == NULL)
+	{
+		printf("%s: too many readers (CCID_MAX_INSTANCE_COUNT is %d)\n", szDevice, CCID_MAX_INSTANCE_COUNT);
+		result = CCID_IFD_NO_DEVICE;
+	}
+	else
+	{
+		result = ccid_ifd_connect(reader);
+		reader->fOpen = (result == CCID_IFD_OK);
+		if (!reader->fOpen)
+			CCID_LIB(SerialClose)();
+	}
+
+	pthread_mutex_unlock(&ccid_ifd_mutex);
+	return result;
+}
+
+/**
+ * @brief Close the device of a reader (pcscd's IFDHCloseChannel)
+ */
+void ccid_ifd_close(unsigned long ulReader)
+{
+	CCID_IFD_READER_ST* reader;
+
+	pthread_mutex_lock(&ccid_ifd_mutex);
+	if (ccid_ifd_select(ulReader, &reader) != CCID_IFD_NO_DEVICE)
+	{
+		if (reader->fReady)
+		{
+			for (BYTE bSlot = 0; bSlot < reader->bSlotCount; bSlot++)
+				SCARD_LIB(Disconnect)(bSlot);
+			CCID_LIB(Stop)();
+		}
+		CCID_LIB(SerialClose)();
+		reader->fOpen = FALSE;
+	}
+	pthread_mutex_unlock(&ccid_ifd_mutex);
+}
+
+/**
+ * @brief Number of slots of the device of a reader
+ */
+int ccid_ifd_slot_count(unsigned long ulReader, unsigned char* pbSlotCount)
+{
+	CCID_IFD_READER_ST* reader;
+	int result;
+
+	pthread_mutex_lock(&ccid_ifd_mutex);
+	result = ccid_ifd_select(ulReader, &reader);
+	if (result == CCID_IFD_OK)
+		*pbSlotCount = reader->bSlotCount;
+	pthread_mutex_unlock(&ccid_ifd_mutex);
+	return result;
+}
+
+/**
+ * @brief Longest command or response the device of a reader accepts
+ */
+unsigned long ccid_ifd_max_length(unsigned long ulReader)
+{
+	CCID_IFD_READER_ST* reader;
+	unsigned long ulLength = 0;
+
+	pthread_mutex_lock(&ccid_ifd_mutex);
+	if (ccid_ifd_select(ulReader, &reader) == CCID_IFD_OK)
+		ulLength = CCID_LIB(MaxPayloadLength)();
+	pthread_mutex_unlock(&ccid_ifd_mutex);
+	return ulLength;
+}
+
+/**
+ * @brief Is there a card in the slot (pcscd's IFDHICCPresence, that it calls every few hundred milliseconds)?
+ * @note Answered from the notifications of the device, so that the polling of pcscd costs nothing on the serial link
+ */
+int ccid_ifd_presence(unsigned long ulReader, unsigned char bSlot)
+{
+	CCID_IFD_READER_ST* reader;
+	CCID_SLOT_SET_ST present, changed;
+	CCID_PACKET_ST packet;
+	BYTE abInterruptBuffer[CCID_MAX_INTERRUPT_PAYLOAD_LENGTH];
+	BOOL fChanged = FALSE;
+	BOOL fPresent;
+	int result;
+
+	pthread_mutex_lock(&ccid_ifd_mutex);
+	result = ccid_ifd_select(ulReader, &reader);
+	if (result != CCID_IFD_OK)
+		goto done;
+
+	/* A notification that has come while nobody was exchanging: it is complete, so this does not wait. The packet then tells the changes received during the exchanges as well */
+	if (CCID_LIB(InterruptPending)())
+	{
+		CCID_LIB(PacketInit)(&packet);
+		packet.abRecvPayload = abInterruptBuffer;
+		packet.dwRecvPayloadMaxLen = sizeof(abInterruptBuffer);
+		if (CCID_LIB(WaitInterrupt)(&packet, 0) == SCARD_ERR(S_SUCCESS))
+		{
+			CCID_LIB(DecodeInterrupt)(packet.abRecvPayload, packet.Header.p.Length.dw, NULL, &present, &changed);
+			fChanged = TRUE;
+		}
+	}
+
+	/* Otherwise the notifications received during an exchange; the changes are kept until every slot has been asked for */
+	if (!fChanged)
+		fChanged = CCID_LIB(GetSlotChanges)(&present, &changed);
+
+	if (fChanged)
+	{
+		for (BYTE i = 0; i < reader->bSlotCount; i++)
+		{
+			if (!CCID_LIB(SlotSetContains)(&changed, i))
+				continue;
+			if (CCID_LIB(SlotSetContains)(&present, i))
+				CCID_LIB(SlotSetAdd)(&reader->present, i);
+			else
+				CCID_LIB(SlotSetRemove)(&reader->present, i);
+			CCID_LIB(SlotSetAdd)(&reader->changed, i);
+			reader->adwAtrLength[i] = 0;
+		}
+	}
+
+	fPresent = CCID_LIB(SlotSetContains)(&reader->present, bSlot);
+	if (CCID_LIB(SlotSetContains)(&reader->changed, bSlot))
+	{
+		CCID_LIB(SlotSetRemove)(&reader->changed, bSlot);
+		/* Removed and inserted again between two calls: pcscd shall see it go, or it would keep on talking to the previous card */
+		if (fPresent && CCID_LIB(SlotSetContains)(&reader->reported, bSlot))
+			fPresent = FALSE;
+	}
+
+	if (fPresent)
+		CCID_LIB(SlotSetAdd)(&reader->reported, bSlot);
+	else
+		CCID_LIB(SlotSetRemove)(&reader->reported, bSlot);
+	result = fPresent ? CCID_IFD_OK : CCID_IFD_NO_CARD;
+
+done:
+	pthread_mutex_unlock(&ccid_ifd_mutex);
+	return result;
+}
+
+/**
+ * @brief Power the card up, or reset it (pcscd's IFDHPowerICC)
+ * @note Power up is a cold reset: pcscd asks for it when a card has been inserted, the previous one may have been left powered
+ */
+int ccid_ifd_power_up(unsigned long ulReader, unsigned char bSlot, int fReset, unsigned char abAtr[], unsigned long* pulAtrLength)
+{
+	CCID_IFD_READER_ST* reader;
+	BYTE abBuffer[CCID_IFD_MAX_ATR_LENGTH];
+	DWORD dwAtrLength = sizeof(abBuffer);
+	int result;
+
+	pthread_mutex_lock(&ccid_ifd_mutex);
+	result = ccid_ifd_select(ulReader, &reader);
+	if ((result == CCID_IFD_OK) && (bSlot >= reader->bSlotCount))
+		result = CCID_IFD_ERROR;
+	if (result == CCID_IFD_OK)
+		result = ccid_ifd_result(SCARD_LIB(Reconnect)(bSlot, fReset ? SCARD_DISPOSITION(RESET_CARD) : SCARD_DISPOSITION(UNPOWER_CARD), abBuffer, &dwAtrLength));
+	if ((result == CCID_IFD_OK) && (dwAtrLength > *pulAtrLength))
+		result = CCID_IFD_INSUFFICIENT_BUFFER;
+	if (result == CCID_IFD_OK)
+	{
+		memcpy(reader->abAtr[bSlot], abBuffer, dwAtrLength);
+		reader->adwAtrLength[bSlot] = dwAtrLength;
+		memcpy(abAtr, abBuffer, dwAtrLength);
+		*pulAtrLength = dwAtrLength;
+	}
+	pthread_mutex_unlock(&ccid_ifd_mutex);
+	return result;
+}
+
+/**
+ * @brief Power the card down (pcscd's IFDHPowerICC)
+ */
+int ccid_ifd_power_down(unsigned long ulReader, unsigned char bSlot)
+{
+	CCID_IFD_READER_ST* reader;
+	int result;
+
+	pthread_mutex_lock(&ccid_ifd_mutex);
+	result = ccid_ifd_select(ulReader, &reader);
+	if ((result == CCID_IFD_OK) && (bSlot >= reader->bSlotCount))
+		result = CCID_IFD_ERROR;
+	if (result == CCID_IFD_OK)
+	{
+		reader->adwAtrLength[bSlot] = 0;
+		result = ccid_ifd_result(SCARD_LIB(Disconnect)(bSlot));
+	}
+	pthread_mutex_unlock(&ccid_ifd_mutex);
+	return result;
+}
+
+/**
+ * @brief The ATR of the card, as of the last power up (pcscd's TAG_IFD_ATR)
+ */
+int ccid_ifd_get_atr(unsigned long ulReader, unsigned char bSlot, unsigned char abAtr[], unsigned long* pulAtrLength)
+{
+	CCID_IFD_READER_ST* reader;
+	int result;
+
+	pthread_mutex_lock(&ccid_ifd_mutex);
+	result = ccid_ifd_select(ulReader, &reader);
+	if ((result == CCID_IFD_OK) && (bSlot >= reader->bSlotCount))
+		result = CCID_IFD_ERROR;
+	if ((result == CCID_IFD_OK) && (reader->adwAtrLength[bSlot] > *pulAtrLength))
+		result = CCID_IFD_INSUFFICIENT_BUFFER;
+	if (result == CCID_IFD_OK)
+	{
+		memcpy(abAtr, reader->abAtr[bSlot], reader->adwAtrLength[bSlot]);
+		*pulAtrLength = reader->adwAtrLength[bSlot];
+	}
+	pthread_mutex_unlock(&ccid_ifd_mutex);
+	return result;
+}
+
+/**
+ * @brief Send an APDU to the card, and get its response (pcscd's IFDHTransmitToICC)
+ */
+int ccid_ifd_transmit(unsigned long ulReader, unsigned char bSlot, const unsigned char abSend[], unsigned long ulSendLength, unsigned char abRecv[], unsigned long* pulRecvLength)
+{
+	CCID_IFD_READER_ST* reader;
+	DWORD dwRecvLength = (DWORD) *pulRecvLength;
+	int result;
+
+	pthread_mutex_lock(&ccid_ifd_mutex);
+	result = ccid_ifd_select(ulReader, &reader);
+	if ((result == CCID_IFD_OK) && (bSlot >= reader->bSlotCount))
+		result = CCID_IFD_ERROR;
+	if (result == CCID_IFD_OK)
+		result = ccid_ifd_result(SCARD_LIB(Transmit)(bSlot, abSend, (DWORD) ulSendLength, abRecv, &dwRecvLength));
+	*pulRecvLength = (result == CCID_IFD_OK) ? dwRecvLength : 0;
+	pthread_mutex_unlock(&ccid_ifd_mutex);
+	return result;
+}
+
+/**
+ * @brief Send a command to the device itself, and get its response (pcscd's IFDHControl)
+ */
+int ccid_ifd_control(unsigned long ulReader, const unsigned char abSend[], unsigned long ulSendLength, unsigned char abRecv[], unsigned long* pulRecvLength)
+{
+	CCID_IFD_READER_ST* reader;
+	DWORD dwRecvLength = (DWORD) *pulRecvLength;
+	int result;
+
+	pthread_mutex_lock(&ccid_ifd_mutex);
+	result = ccid_ifd_select(ulReader, &reader);
+	if (result == CCID_IFD_OK)
+		result = ccid_ifd_result(SCARD_LIB(Control)(abSend, (DWORD) ulSendLength, abRecv, &dwRecvLength));
+	*pulRecvLength = (result == CCID_IFD_OK) ? dwRecvLength : 0;
+	pthread_mutex_unlock(&ccid_ifd_mutex);
+	return result;
+}
@@ -0,0 +1,83 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid_ifd_bridge.h
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Between the pcsc-lite IFD handler and the driver (their headers do not mix: both define BYTE, DWORD, BOOL...)
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup ccid
+ */
+
+#ifndef __CCID_IFD_BRIDGE_H__
+#define __CCID_IFD_BRIDGE_H__
+
+/* Only standard types here, this header is included by both sides */
+
+/* The outcome of a call, that each side maps to its own codes */
+#define CCID_IFD_OK 0
+#define CCID_IFD_NO_CARD 1
+#define CCID_IFD_TIMEOUT 2
+#define CCID_IFD_INSUFFICIENT_BUFFER 3
+#define CCID_IFD_COMM_ERROR 4
+#define CCID_IFD_NO_DEVICE 5
+#define CCID_IFD_ERROR 6
+
+/* Longest ATR */
+#define CCID_IFD_MAX_ATR_LENGTH 33
+
+unsigned char ccid_ifd_max_readers(void);
+int ccid_ifd_open(unsigned long ulReader, const char* szDevice);
+void ccid_ifd_close(unsigned long ulReader);
+int ccid_ifd_slot_count(unsigned long ulReader, unsigned char* pbSlotCount);
+unsigned long ccid_ifd_max_length(unsigned long ulReader);
+
+int ccid_ifd_presence(unsigned long ulReader, unsigned char bSlot);
+int ccid_ifd_power_up(unsigned long ulReader, unsigned char bSlot, int fReset, unsigned char abAtr[], unsigned long* pulAtrLength);
+int ccid_ifd_power_down(unsigned long ulReader, unsigned char bSlot);
+int ccid_ifd_get_atr(unsigned long ulReader, unsigned char bSlot, unsigned char abAtr[], unsigned long* pulAtrLength);
+int ccid_ifd_transmit(unsigned long ulReader, unsigned char bSlot, const unsigned char abSend[], unsigned long ulSendLength, unsigned char abRecv[], unsigned long* pulRecvLength);
+int ccid_ifd_control(unsigned long ulReader, const unsigned char abSend[], unsigned long ulSendLength, unsigned char abRecv[], unsigned long* pulRecvLength);
+
+#endif
@@ -76,11 +76,26 @@
  */
 #define SCARD_ERR(name) CONCAT(SCARD_ERR_, name)
 
+/**
+ * @brief Macro to set the namespace (prefix) of the PC/SC-Like stack library (card dispositions, see SCARD_EndTransaction).
+ * Typically this would be "SCARD_", but this would collide with the system's includes, as for the error codes.
+ * Default is therefore "SCARD_DISP_", but you may change it for any other prefix
+ */
+#define SCARD_DISPOSITION(name) CONCAT(SCARD_DISP_, name)
+
  /**
   * @brief Max number of slots supported by the library.
-  * @note If only the contactless slot is used, 1 is enough
+  * The actual number of slots is read from the device at runtime (see CCID_GetSlotCount), this is only the upper bound for the static buffers:
+  * on a device that has more slots, only the first CCID_MAX_SLOT_COUNT ones are used (CCID_GetSlotCount returns the limit). The project may define it in project.h.
+  * @note If only the contactless slot is used, 1 is enough. The CCID standard allows up to 256 slots, the driver up to 255.
   */
+#if (!defined(CCID_MAX_SLOT_COUNT))
 #define CCID_MAX_SLOT_COUNT 6
+#endif
+
+#if (CCID_MAX_SLOT_COUNT > 255)
+#error The slots are numbered with a BYTE, CCID_MAX_SLOT_COUNT must not be above 255
+#endif
 
 /**
  * @brief Max payload size of the CCID buffers.
@@ -94,9 +109,132 @@
 
 /**
  * @brief Max payload size of the CCID interrupt buffers.
- * This is 2 bits per slot. 4 will fit any device.
+ * This is 2 bits per slot. 4 will fit any device with up to 16 slots; above this the size follows CCID_MAX_SLOT_COUNT.
  */
+#if (CCID_MAX_SLOT_COUNT > 16)
+#define CCID_MAX_INTERRUPT_PAYLOAD_LENGTH ((CCID_MAX_SLOT_COUNT + 3) / 4)
+#else
 #define CCID_MAX_INTERRUPT_PAYLOAD_LENGTH 4
+#endif
+
+/**
+ * @brief Max number of devices (instances of the CCID driver) that may be used at the same time.
+ * Every instance has its own serial port, receiver and slot status. The instance that the functions work with is chosen with CCID_SelectInstance, by every thread for itself.
+ * @note Values above 1 require a HAL that implements CCID_InstanceWakeupFromISR and CCID_WaitWakeupMulti, and that feeds the receiver with CCID_InstanceRecvBytesFromISR (its ISR or thread has no selected instance). The project may define it in project.h.
+ */
+#if (!defined(CCID_MAX_INSTANCE_COUNT))
+#define CCID_MAX_INSTANCE_COUNT 1
+#endif
+
+/**
+ * @brief Storage class of the instance selected by CCID_SelectInstance.
+ * Every thread has its own selection, so that threads working with different devices (e.g. one waiting over SCARD_GetStatusChangeMulti, others calling SCARD_Transmit) do not retarget each other.
+ * Useless with a single instance; define it empty on a target that has several instances but no thread-local storage. The project may define it in project.h.
+ */
+#if (!defined(CCID_THREAD_LOCAL))
+#if (CCID_MAX_INSTANCE_COUNT == 1)
+#define CCID_THREAD_LOCAL
+#elif (defined(_MSC_VER))
+#define CCID_THREAD_LOCAL __declspec(thread)
+#elif (defined(__GNUC__))
+#define CCID_THREAD_LOCAL __thread
+#else
+#define CCID_THREAD_LOCAL _Thread_local
+#endif
+#endif
+
+/**
+ * @brief Does SCARD_Connect negotiate the fastest bit rate allowed by the card (TA1 of the ATR) and by the device?
+ * Set to 0 to always keep the default Fi/Di. The project may define it in project.h.
+ */
+#if (!defined(SCARD_AUTO_PPS))
+#define SCARD_AUTO_PPS 1
+#endif
+
+/**
+ * @brief Is the reset input of the device wired to the DTR/RTS lines of the host?
+ * If so, CCID_SerialReset pulses DTR and RTS in addition to sending a BREAK. The project may define it in project.h.
+ */
+#if (!defined(CCID_SERIAL_RESET_DTR))
+#define CCID_SERIAL_RESET_DTR 0
+#endif
+
+/**
+ * @brief Does the CCID driver record the serial traffic (see CCID_CaptureEnable and CCID_CaptureRead)?
+ * The HAL must then provide CCID_GetTimeUs. The project may define it in project.h.
+ */
+#if (!defined(CCID_CAPTURE))
+#define CCID_CAPTURE 0
+#endif
+
+/**
+ * @brief Size of the ring where the capture tap records the bytes, for every instance and every direction (a power of 2).
+ * Every chunk of bytes takes 6 bytes more; the ring must hold what the link carries between two calls to CCID_CaptureRead. The project may define it in project.h.
+ */
+#if (!defined(CCID_CAPTURE_RING_SIZE))
+#define CCID_CAPTURE_RING_SIZE 4096
+#endif
+
+#if (CCID_CAPTURE && (CCID_MAX_INSTANCE_COUNT > 16))
+#error The capture records have room for 16 instances only
+#endif
+
+/**
+ * @brief Does the CCID driver count the frames, the bytes, the errors... of every link and every slot (see CCID_GetStats)?
+ * It takes (17 + 5 * CCID_MAX_SLOT_COUNT) DWORDs per instance, and an atomic increment here and there. The project may define it in project.h.
+ */
+#if (!defined(CCID_STATS))
+#define CCID_STATS 1
+#endif
+
+/**
+ * @brief Does the CCID driver keep a latency histogram of every command and of every slot (see CCID_GetHistograms)?
+ * It takes (CCID_HISTOGRAM_COMMAND_COUNT + CCID_MAX_SLOT_COUNT) * (2 + CCID_HISTOGRAM_BUCKET_COUNT) DWORDs per instance, roughly 9kB.
+ * The HAL must then provide CCID_GetTimeUs. The project may define it in project.h.
+ */
+#if (!defined(CCID_HISTOGRAMS))
+#define CCID_HISTOGRAMS 0
+#endif
+
+/**
+ * @brief Does the CCID driver record its events (exchanges, time extensions, errors...) into a binary trace ring, instead of printing them when fVerbose is set (see CCID_TraceRead)?
+ * Recording an event takes a few atomic operations and never blocks, so the trace may stay on in production. The HAL must then provide CCID_GetTimeUs. The project may define it in project.h.
+ */
+#if (!defined(CCID_TRACE))
+#define CCID_TRACE 0
+#endif
+
+/**
+ * @brief Number of records in the trace ring, shared by all the instances (a power of 2). The oldest ones are overwritten. The project may define it in project.h.
+ */
+#if (!defined(CCID_TRACE_RING_SIZE))
+#define CCID_TRACE_RING_SIZE 256
+#endif
+
+/**
+ * @brief Critical section around the counters, the histograms and the trace ring index, where the compiler has no atomic read-modify-write (Cortex-M0, compilers other than GCC, clang and MSVC).
+ * CCID_IRQ_SAVE() masks the interrupts and returns the previous state as a DWORD, CCID_IRQ_RESTORE(s) puts it back. On Cortex-M0 with GCC or clang, the default saves and sets PRIMASK. With any other compiler there is no default: every counter and the trace ring must then have a single writer, i.e. CCID_Trace must not be called from an ISR and from a task at the same time.
+ * Masking the interrupts does not stop the other core of a dual-core MCU such as the RP2040: the library must run on one core. The project may define both in project.h, e.g. save_and_disable_interrupts() and restore_interrupts(s) with the Pico SDK.
+ */
+#if (defined(CCID_IRQ_SAVE) != defined(CCID_IRQ_RESTORE))
+#error "Define both CCID_IRQ_SAVE and CCID_IRQ_RESTORE, or none of them"
+#endif
+
+/**
+ * @brief Does the CCID driver timestamp the stages of every exchange, to tell where the time goes (see CCID_ExchangeEx)?
+ * It takes 5 calls to CCID_GetTimeUs per exchange, 2 of them in the ISR. The HAL must then provide CCID_GetTimeUs. The project may define it in project.h.
+ */
+#if (!defined(CCID_TIMELINE))
+#define CCID_TIMELINE 0
+#endif
+
+/**
+ * @brief Does the CCID driver have USDT probes at every stage of the protocol, for bpftrace or perf (see ccid_probes.h)?
+ * Linux only, it needs <sys/sdt.h> (systemtap-sdt-dev). The project may define it in project.h.
+ */
+#if (!defined(CCID_PROBES))
+#define CCID_PROBES 0
+#endif
 
 /* Dynamic configuration of the PC/SC-Like stack and of the CCID driver */
 /* -------------------------------------------------------------------- */
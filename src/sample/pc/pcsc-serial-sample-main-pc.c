@@ -70,9 +70,43 @@ const char* szCommDevice = "COM5";
 /* Our reference reader uses /dev/ttyS5 */
 const char* szCommDevice = "/dev/ttyS5";
 #define sleep_ms(x) usleep(1000 * x)
+#if (CCID_MAX_INSTANCE_COUNT > 1)
+#include <glob.h>
+#define SAMPLE_DISCOVERY
+#endif
+#if (CCID_CAPTURE)
+#include <signal.h>
+#include <pthread.h>
+#include "../../capture/ccid_capture_file.h"
+#define SAMPLE_CAPTURE
+#endif
+#if (CCID_STATS)
+#include "../../exporter/ccid_exporter.h"
+#define SAMPLE_EXPORTER
+#endif
 #endif
 
 static BOOL parse_args(int argc, char** argv);
+#if (CCID_STATS)
+static void print_link_stats(void);
+#endif
+
+#if (defined(SAMPLE_DISCOVERY))
+/* Ports to look for a device at, e.g. "/dev/ttyUSB*" */
+static const char* szScanPattern = NULL;
+static BOOL discover_device(void);
+#endif
+
+#if (defined(SAMPLE_CAPTURE))
+/* File to record the serial traffic into */
+static const char* szCaptureFile = NULL;
+static BOOL stop_capture_on_signal(void);
+#endif
+
+#if (defined(SAMPLE_EXPORTER))
+/* Where to export the counters to */
+static const char* szExporterAddress = NULL;
+#endif
 
 int main(int argc, char** argv)
 {
@@ -90,6 +124,15 @@ int main(int argc, char** argv)
 		printf("Usage:\n");
 		printf("\tpcsc-serial-windows-demo [-d <COMM PORT>] [-i] [-c] [-t] [-v]\n");
 		printf("\t\t-d <COM PORT>: select the comm. device (default is COM5)\n");
+#if (defined(SAMPLE_DISCOVERY))
+		printf("\t\t-s <PATTERN>: look for devices on all the ports matching the pattern (e.g. \"/dev/ttyUSB*\"), and use the first one\n");
+#endif
+#if (defined(SAMPLE_CAPTURE))
+		printf("\t\t-w <FILE>: record the serial traffic into the file (play it back with -d replay:<FILE>, see the emulator project)\n");
+#endif
+#if (defined(SAMPLE_EXPORTER))
+		printf("\t\t-m <ADDRESS>: export the counters for Prometheus, ADDRESS is unix:<PATH>, tcp:<PORT> (localhost) or file:<PATH>\n");
+#endif
 		printf("\t\t-i: use notifications (Interrupt endpoint)\n");
 		printf("\t\t-c: run ECHO test over SCardControl\n");
 		printf("\t\t-t: run ECHO test over SCardTransmit\n");
@@ -97,8 +140,43 @@ int main(int argc, char** argv)
 		return -1;
 	}
 
+#if (defined(SAMPLE_CAPTURE))
+	/* Ctrl+C is the way out: the capture must still get what remains before the process ends */
+	if ((szCaptureFile != NULL) && !stop_capture_on_signal())
+		return -1;
+#endif
+
+#if (defined(SAMPLE_DISCOVERY))
+	if (szScanPattern != NULL)
+		if (!discover_device())
+			return -1;
+#endif
+
 	printf("Using communication device: %s\n", szCommDevice);
 
+#if (defined(SAMPLE_CAPTURE))
+	if (szCaptureFile != NULL)
+	{
+		if (!CCID_LIB(CaptureFileStart)(szCaptureFile))
+			return -1;
+		printf("Recording the serial traffic into %s\n", szCaptureFile);
+	}
+#endif
+
+#if (defined(SAMPLE_EXPORTER))
+	if (szExporterAddress != NULL)
+	{
+		if (!CCID_LIB(ExporterStart)(szExporterAddress))
+		{
+#if (defined(SAMPLE_CAPTURE))
+			CCID_LIB(CaptureFileStop)();
+#endif
+			return -1;
+		}
+		printf("Exporting the counters to %s\n", szExporterAddress);
+	}
+#endif
+
 	/* Prepare the underlying hardware and lower layer software */
 	/* -------------------------------------------------------- */
 
@@ -114,7 +192,8 @@ int main(int argc, char** argv)
 		if (!CCID_LIB(SerialOpen)())
 		{
 			printf("Failed to open serial port %s\n", szCommDevice);
-			sleep_ms(1000);
+			/* Wait until the port appears (or changes), and try again at once */
+			CCID_LIB(SerialWaitPort)(1000);
 			continue;
 		}
 
@@ -130,6 +209,12 @@ int main(int argc, char** argv)
 		printf("Pinging the device (if some)\n");
 		rc = CCID_LIB(Ping)();
 		if (rc != SCARD_ERR(S_SUCCESS))
+		{
+			/* Reset the link and ping again: a device that is out of sync answers within a few ms */
+			printf("Resetting the link\n");
+			rc = CCID_LIB(Recover)();
+		}
+		if (rc != SCARD_ERR(S_SUCCESS))
 		{
 			printf("No device found on port %s (rc=%lX)\n", szCommDevice, rc);
 			/* Close the serial port */
@@ -156,12 +241,23 @@ int main(int argc, char** argv)
 		/* The sample is a loop, if we come back here, this means that we have lost the device */
 		/* ----------------------------------------------------------------------------------- */
 		printf("*** It seems that we've lost the device... ***\n");
+#if (CCID_STATS)
+		print_link_stats();
+#endif
+#if (CCID_TRACE)
+		/* The last events of the driver, to see how it ended */
+		if (fVerbose)
+			CCID_LIB(TracePrint)();
+#endif
 
 		/* Close the serial port */
 		printf("Closing the serial port\n");
 		CCID_LIB(SerialClose)();
 	}
 	
+#if (defined(SAMPLE_CAPTURE))
+	CCID_LIB(CaptureFileStop)();
+#endif
 	return 0;
 }
 
@@ -177,6 +273,27 @@ static BOOL parse_args(int argc, char** argv)
 				szCommDevice = argv[i + 1];
 				i++;  // Skip next item since we just processed it
 			}
+#if (defined(SAMPLE_DISCOVERY))
+			else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+			{
+				szScanPattern = argv[i + 1];
+				i++;
+			}
+#endif
+#if (defined(SAMPLE_CAPTURE))
+			else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+			{
+				szCaptureFile = argv[i + 1];
+				i++;
+			}
+#endif
+#if (defined(SAMPLE_EXPORTER))
+			else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+			{
+				szExporterAddress = argv[i + 1];
+				i++;
+			}
+#endif
 			else if (!strcmp(argv[i], "-i"))
 			{
 				fCcidUseNotifications = TRUE;
@@ -215,6 +332,122 @@ static BOOL parse_args(int argc, char** argv)
 	return TRUE;
 }
 
+#if (defined(SAMPLE_DISCOVERY))
+static BOOL discover_device(void)
+{
+	static CCID_DISCOVERY_ST candidates[64];
+	static glob_t ports;
+	DWORD count = 0;
+	LONG rc;
+
+	if ((glob(szScanPattern, 0, NULL, &ports) != 0) || (ports.gl_pathc == 0))
+	{
+		printf("No port matches %s\n", szScanPattern);
+		return FALSE;
+	}
+
+	for (size_t i = 0; (i < ports.gl_pathc) && (count < sizeof(candidates) / sizeof(candidates[0])); i++)
+		candidates[count++].szCommName = ports.gl_pathv[i];
+
+	printf("Looking for devices on %lu port(s)...\n", count);
+	rc = CCID_LIB(Discover)(candidates, count, 300);
+
+	for (DWORD i = 0; i < count; i++)
+	{
+		if (candidates[i].fFound)
+		{
+			printf("\t%s: device found (%lums)", candidates[i].szCommName, candidates[i].dwResponseTimeMs);
+			if (candidates[i].fHasProfile)
+				printf(", serial number %s, %d slot(s)", candidates[i].Profile.szSerialNumber, candidates[i].Profile.bSlotCount);
+			printf("\n");
+		}
+		else if (fVerbose)
+		{
+			printf("\t%s: no device (rc=%lX)\n", candidates[i].szCommName, candidates[i].lResult);
+		}
+	}
+
+	if (rc != SCARD_ERR(S_SUCCESS))
+	{
+		printf("No device found\n");
+		return FALSE;
+	}
+
+	/* Use the first one (ports stays allocated, szCommDevice points into it) */
+	for (DWORD i = 0; i < count; i++)
+	{
+		if (candidates[i].fFound)
+		{
+			szCommDevice = candidates[i].szCommName;
+			break;
+		}
+	}
+	return TRUE;
+}
+#endif
+
+#if (defined(SAMPLE_CAPTURE))
+static sigset_t capture_signals;
+
+/* Waits for Ctrl+C or kill, outside of any signal handler, so it may join the capture thread and close the file */
+static void* capture_signal_task(void* arg)
+{
+	int signal;
+
+	(void) arg;
+	sigwait(&capture_signals, &signal);
+	printf("\nStopping the capture into %s\n", szCaptureFile);
+	CCID_LIB(CaptureFileStop)();
+	exit(0);
+	return NULL;
+}
+
+/* Must be called before any other thread is created, so they all inherit the mask and only capture_signal_task gets SIGINT and SIGTERM */
+static BOOL stop_capture_on_signal(void)
+{
+	pthread_t thread;
+
+	sigemptyset(&capture_signals);
+	sigaddset(&capture_signals, SIGINT);
+	sigaddset(&capture_signals, SIGTERM);
+	if ((pthread_sigmask(SIG_BLOCK, &capture_signals, NULL) != 0) || (pthread_create(&thread, NULL, capture_signal_task, NULL) != 0))
+	{
+		perror("stop_capture_on_signal");
+		return FALSE;
+	}
+	pthread_detach(thread);
+	return TRUE;
+}
+#endif
+
+#if (CCID_STATS)
+static void print_link_stats(void)
+{
+	CCID_STATS_ST stats;
+
+	CCID_LIB(GetStats)(&stats);
+	printf("Link: %lu frames/%lu bytes sent, %lu frames/%lu bytes received, %lu timeouts, %lu checksum errors, %lu protocol errors, %lu overruns, %lu driver errors, %lu reconnects\n",
+		stats.Link.dwTxFrames, stats.Link.dwTxBytes, stats.Link.dwRxFrames, stats.Link.dwRxBytes, stats.Link.dwTimeouts,
+		stats.Link.dwErrorChecksum, stats.Link.dwErrorProtocol, stats.Link.dwErrorOverrun, stats.Link.dwDriverErrors, stats.Link.dwReconnects);
+#if (CCID_HISTOGRAMS)
+	{
+		/* Large, hence static */
+		static CCID_HISTOGRAMS_ST histograms;
+
+		/* What has happened with this connection only */
+		CCID_LIB(GetHistograms)(&histograms, TRUE);
+		for (BYTE bCommand = 0; bCommand < CCID_HISTOGRAM_COMMAND_COUNT; bCommand++)
+		{
+			const CCID_HISTOGRAM_ST* pHistogram = &histograms.aCommands[bCommand];
+			if (pHistogram->dwCount)
+				printf("\t%s: %lu, p50 %luus, p99 %luus, max %luus\n", CCID_LIB(HistogramCommandName)(bCommand), pHistogram->dwCount,
+					CCID_LIB(HistogramPercentile)(pHistogram, 500), CCID_LIB(HistogramPercentile)(pHistogram, 990), pHistogram->dwMaxUs);
+		}
+	}
+#endif
+}
+#endif
+
 BOOL SCARD_LIB(IsCancelledHook)(void)
 {
 	/* Dummy function */
@@ -73,7 +73,7 @@ static const BYTE APDU_GET_UID[] = { 0xFF, 0xCA, 0x00, 0x00, 0x00 };
 static void sample_on_slot(BYTE slot);
 static WORD get_status_word(BYTE abRecvApdu[], DWORD wRecvLength);
 
-static BOOL wait_status_change(DWORD timeout);
+static BOOL wait_status_change(DWORD timeout, CCID_SLOT_SET_ST* pPresentSlots);
 
 static BOOL start_pcsc(void);
 static BOOL stop_pcsc(void);
@@ -90,7 +90,13 @@ static BOOL test_echo_transmit(BYTE slot);
 void sample(void)
 {
 	BYTE slotCount;
-	BOOL cardPresent[CCID_MAX_SLOT_COUNT] = { 0 };
+	CCID_SLOT_SET_ST cardPresent;
+	CCID_SLOT_SET_ST presentSlots;
+	CCID_PROFILE_ST profile;
+	BOOL fHasProfile;
+	BOOL fWarmStart;
+
+	CCID_LIB(SlotSetClear)(&cardPresent);
 
 	printf("Running sample application with the found CCID device...\n");
 
@@ -98,41 +104,69 @@ void sample(void)
 	if (!ping_device())
 		goto done;
 
-	/* Retrieve and print the device descriptor */
-	dump_device_descriptor();
-	if (!SCARD_LIB(IsValidContext)())
-		goto done;
+	/* If we already know this device, we don't have to ask it again */
+	fWarmStart = (CCID_LIB(LoadProfile)(&profile) == SCARD_ERR(S_SUCCESS));
+	fHasProfile = fWarmStart;
 
-	/* Retrieve and print the configuration descriptor */
-	dump_configuration_descriptor();
-	if (!SCARD_LIB(IsValidContext)())
-		goto done;
+	if (fWarmStart)
+	{
+		printf("Using the profile of device %s (firmware %X.%02X)\n", profile.szSerialNumber, profile.abDeviceDescriptor[13], profile.abDeviceDescriptor[12]);
+	}
+	else
+	{
+		/* Retrieve and print the device descriptor */
+		dump_device_descriptor();
+		if (!SCARD_LIB(IsValidContext)())
+			goto done;
 
-	/* Retrieve and print all the string descriptors */
-	dump_string_descriptors();
-	if (!SCARD_LIB(IsValidContext)())
-		goto done;
+		/* Retrieve and print the configuration descriptor */
+		dump_configuration_descriptor();
+		if (!SCARD_LIB(IsValidContext)())
+			goto done;
+
+		/* Retrieve and print all the string descriptors */
+		dump_string_descriptors();
+		if (!SCARD_LIB(IsValidContext)())
+			goto done;
+
+		/* Retrieve and print the interface descriptor */
+		dump_interface_descriptor();
+		if (!SCARD_LIB(IsValidContext)())
+			goto done;
+	}
 
-	/* Retrieve and print the interface descriptor */
-	dump_interface_descriptor();
-	if (!SCARD_LIB(IsValidContext)())
-		goto done;
-	
 	/* Activate the configuration */
 	printf("Starting PC/SC...\n");
 	if (!start_pcsc())
+	{
+		/* Maybe not the device we know */
+		if (fWarmStart)
+			CCID_LIB(ForgetProfile)();
 		goto done;
+	}
+
+	if (fWarmStart)
+	{
+		slotCount = profile.bSlotCount;
+	}
+	else
+	{
+		/* Verify we still can ping the device */
+		if (!ping_device())
+			goto done;
+
+		/* Get the slot count */
+		printf("Reading slot count\n");
+		slotCount = get_slot_count();
+		if (slotCount == 0)
+			goto done;
+
+		/* Remember the device for the next time */
+		fHasProfile = (CCID_LIB(CreateProfile)(&profile) == SCARD_ERR(S_SUCCESS));
+		if (fHasProfile)
+			CCID_LIB(SaveProfile)(&profile);
+	}
 
-	/* Verify we still can ping the device */
-	if (!ping_device())
-		goto done;
-	
-	/* Get the slot count */
-	printf("Reading slot count\n");
-	slotCount = get_slot_count();
-	if (slotCount == 0)
-		goto done;
-	
 	printf("Device has %d slot(s)\n", slotCount);
 	if (slotCount > CCID_MAX_SLOT_COUNT)
 	{
@@ -156,6 +190,7 @@ void sample(void)
 	while (SCARD_LIB(IsValidContext)())
 	{
 		BYTE slot;
+		BOOL fNotified = FALSE;
 
 		if (fCcidUseNotifications)
 		{
@@ -163,7 +198,7 @@ void sample(void)
 			printf("Waiting for a change");
 
 			/* Wait forever */
-			wait_status_change((DWORD)-1); /* Use -1 for INFINITE timeout */
+			fNotified = wait_status_change((DWORD)-1, &presentSlots); /* Use -1 for INFINITE timeout */
 			if (!SCARD_LIB(IsValidContext)())
 				goto done;
 
@@ -181,26 +216,31 @@ void sample(void)
 			if (!SCARD_LIB(IsValidContext)())
 				goto done;
 
-			if (card_is_present(slot))
+			/* The notification tells which slots have a card, no need to ask the device again */
+			if (fNotified ? CCID_LIB(SlotSetContains)(&presentSlots, slot) : card_is_present(slot))
 			{
-				if (!cardPresent[slot])
+				if (!CCID_LIB(SlotSetContains)(&cardPresent, slot))
 				{
 					/* A card has been inserted in this slot */
-					cardPresent[slot] = TRUE;
+					CCID_LIB(SlotSetAdd)(&cardPresent, slot);
 					printf("Card inserted in slot %d\n", slot);
 
 					/* Run sample over this card */
 					sample_on_slot(slot);
+
+					/* Keep what the driver has learnt (e.g. the bit rates refused by the device) */
+					if (fHasProfile)
+						CCID_LIB(SaveProfile)(&profile);
 					
 					printf("Transaction with card in slot %d terminated\n", slot);
 				}
 			}
 			else
 			{
-				if (cardPresent[slot])
+				if (CCID_LIB(SlotSetContains)(&cardPresent, slot))
 				{
 					/* The card has been removed from this slot */
-					cardPresent[slot] = FALSE;
+					CCID_LIB(SlotSetRemove)(&cardPresent, slot);
 					printf("Card removed from slot %d\n", slot);
 				}				
 			}			
@@ -264,8 +304,14 @@ static void sample_on_slot(BYTE slot)
 
 	if (fTestEchoTransmit && SCARD_LIB(IsValidContext)())
 	{
+		BOOL fTestOK;
+
 		printf("Please wait during the test (echo over SCardTransmit)...\n");
-		if (!test_echo_transmit(slot))
+		/* Nobody else shall talk to the card during the test */
+		SCARD_LIB(BeginTransaction)(slot);
+		fTestOK = test_echo_transmit(slot);
+		SCARD_LIB(EndTransaction)(slot, SCARD_DISPOSITION(LEAVE_CARD));
+		if (!fTestOK)
 		{
 			printf("Test failed!\n");
 			return;
@@ -307,9 +353,9 @@ static BOOL stop_pcsc(void)
 	return TRUE;
 }
 
-static BOOL wait_status_change(DWORD timeout)
+static BOOL wait_status_change(DWORD timeout, CCID_SLOT_SET_ST* pPresentSlots)
 {
-	LONG rc = SCARD_LIB(GetStatusChange)(timeout);
+	LONG rc = SCARD_LIB(GetStatusChangeSet)(timeout, pPresentSlots, NULL);
 	if (rc != SCARD_ERR(S_SUCCESS))
 	{
 		/* Timeout is a "normal" error */
@@ -414,7 +460,7 @@ static void dump_configuration_descriptor(void)
 static void dump_interface_descriptor(void)
 {
 	DWORD dwRecvLength = sizeof(abInOutBuffer);
-	DWORD t;
+	CCID_CLASS_DESCRIPTOR_ST ccidDescriptor;
 	LONG rc = CCID_LIB(GetDescriptor)(4, 0, abInOutBuffer, &dwRecvLength);
 	if (rc != SCARD_ERR(S_SUCCESS))
 	{
@@ -446,51 +492,34 @@ static void dump_interface_descriptor(void)
 	printf("\tiInterface: %d\n", abInOutBuffer[8]);
 	printf("\n");
 
-	if (dwRecvLength < 9 + 54)
+	rc = CCID_LIB(ParseClassDescriptor)(abInOutBuffer, dwRecvLength, &ccidDescriptor);
+	if (rc != SCARD_ERR(S_SUCCESS))
 	{
-		printf("Wrong size for CCID class descriptor (expected at least 54 bytes to follow, got %lu)\n", dwRecvLength - 9);
-		return;				
+		printf("No valid CCID class descriptor after the interface descriptor (rc=%lX)\n", rc);
+		return;
 	}
 
-	if ((abInOutBuffer[9] != 54) || (abInOutBuffer[10] != 0x21))
-	{
-		printf("Wrong format for CCID class descriptor (expected header is %02X%02X, got %02X%02X)\n", 54, 0x21, abInOutBuffer[9], abInOutBuffer[10]);		
-		return;		
-	}
-	
 	printf("CCID class descriptor:\n");
-    printf("\tbLength: %d\n", abInOutBuffer[9]);
-    printf("\tbDescriptorType: %d\n", abInOutBuffer[10]);
-    printf("\twVersion: %X.%02X\n", abInOutBuffer[12], abInOutBuffer[11]);
-    printf("\tbMaxSlotIndex: %d\n", abInOutBuffer[13]);
-	printf("\tbVoltageSupport: %02X\n", abInOutBuffer[14]);
-	t = (abInOutBuffer[18] << 24) | (abInOutBuffer[17] << 16) | (abInOutBuffer[16] << 8) | abInOutBuffer[15];
-	printf("\tdwProtocols: %08lX\n", t);
-	t = (abInOutBuffer[22] << 24) | (abInOutBuffer[21] << 16) | (abInOutBuffer[20] << 8) | abInOutBuffer[19];
-	printf("\tdwDefaultClock: %lu\n", t);
-	t = (abInOutBuffer[26] << 24) | (abInOutBuffer[25] << 16) | (abInOutBuffer[24] << 8) | abInOutBuffer[23];
-	printf("\tdwMaximumClocks: %lu\n", t);
-	printf("\tbNumClockSupported: %d\n", abInOutBuffer[27]);
-	t = (abInOutBuffer[31] << 24) | (abInOutBuffer[30] << 16) | (abInOutBuffer[29] << 8) | abInOutBuffer[28];
-	printf("\tdwDataRate: %lu\n", t);
-	t = (abInOutBuffer[35] << 24) | (abInOutBuffer[34] << 16) | (abInOutBuffer[33] << 8) | abInOutBuffer[32];
-	printf("\tdwMaxDataRate: %lu\n", t);
-	printf("\tbNumDataRatesSupported: %d\n", abInOutBuffer[36]);
-	t = (abInOutBuffer[40] << 24) | (abInOutBuffer[39] << 16) | (abInOutBuffer[38] << 8) | abInOutBuffer[37];
-	printf("\tdwMaxIFSD: %lu\n", t);
-	t = (abInOutBuffer[44] << 24) | (abInOutBuffer[43] << 16) | (abInOutBuffer[42] << 8) | abInOutBuffer[41];
-	printf("\tdwSynchProtocols: %08lX\n", t);
-	t = (abInOutBuffer[48] << 24) | (abInOutBuffer[47] << 16) | (abInOutBuffer[46] << 8) | abInOutBuffer[45];
-	printf("\tdwMechanical: %08lX\n", t);
-	t = (abInOutBuffer[52] << 24) | (abInOutBuffer[51] << 16) | (abInOutBuffer[50] << 8) | abInOutBuffer[49];
-	printf("\tdwFeatures: %08lX\n", t);
-	t = (abInOutBuffer[56] << 24) | (abInOutBuffer[55] << 16) | (abInOutBuffer[54] << 8) | abInOutBuffer[53];
-	printf("\tdwMaxCCIDMessageLength: %lu\n", t);
-	printf("\tbClassGetResponse: %02X\n", abInOutBuffer[57]);
-	printf("\tbClassEnvelope: %02X\n", abInOutBuffer[58]);
-	printf("\twLcdLayout: %02X%02X\n", abInOutBuffer[60], abInOutBuffer[59]);
-	printf("\tbPINSupport: %02X\n", abInOutBuffer[61]);
-	printf("\tbMaxCCIDBusySlots: %02X\n", abInOutBuffer[62]);
+    printf("\twVersion: %X.%02X\n", ccidDescriptor.wVersion >> 8, ccidDescriptor.wVersion & 0xFF);
+    printf("\tbMaxSlotIndex: %d\n", ccidDescriptor.bMaxSlotIndex);
+	printf("\tbVoltageSupport: %02X\n", ccidDescriptor.bVoltageSupport);
+	printf("\tdwProtocols: %08lX\n", ccidDescriptor.dwProtocols);
+	printf("\tdwDefaultClock: %lu\n", ccidDescriptor.dwDefaultClock);
+	printf("\tdwMaximumClocks: %lu\n", ccidDescriptor.dwMaximumClock);
+	printf("\tbNumClockSupported: %d\n", ccidDescriptor.bNumClockSupported);
+	printf("\tdwDataRate: %lu\n", ccidDescriptor.dwDataRate);
+	printf("\tdwMaxDataRate: %lu\n", ccidDescriptor.dwMaxDataRate);
+	printf("\tbNumDataRatesSupported: %d\n", ccidDescriptor.bNumDataRatesSupported);
+	printf("\tdwMaxIFSD: %lu\n", ccidDescriptor.dwMaxIFSD);
+	printf("\tdwSynchProtocols: %08lX\n", ccidDescriptor.dwSynchProtocols);
+	printf("\tdwMechanical: %08lX\n", ccidDescriptor.dwMechanical);
+	printf("\tdwFeatures: %08lX\n", ccidDescriptor.dwFeatures);
+	printf("\tdwMaxCCIDMessageLength: %lu\n", ccidDescriptor.dwMaxCCIDMessageLength);
+	printf("\tbClassGetResponse: %02X\n", ccidDescriptor.bClassGetResponse);
+	printf("\tbClassEnvelope: %02X\n", ccidDescriptor.bClassEnvelope);
+	printf("\twLcdLayout: %04X\n", ccidDescriptor.wLcdLayout);
+	printf("\tbPINSupport: %02X\n", ccidDescriptor.bPINSupport);
+	printf("\tbMaxCCIDBusySlots: %02X\n", ccidDescriptor.bMaxCCIDBusySlots);
 
 	#if 0
 	/* ---------------------------------------------------------------------- */
@@ -57,17 +57,37 @@
 #ifndef __SCARD_H__
 #define __SCARD_H__
 
+#include "../ccid/ccid_typedefs.h"
+
+/* What to do with the card at the end of a transaction */
+/* ---------------------------------------------------- */
+
+typedef enum
+{
+	SCARD_DISPOSITION(LEAVE_CARD)      = 0x0000, /*!< Do nothing */
+	SCARD_DISPOSITION(RESET_CARD)      = 0x0001, /*!< Reset the card (the ATR is not returned) */
+	SCARD_DISPOSITION(UNPOWER_CARD)    = 0x0002  /*!< Power the card off */
+} SCARD_LIB_DISPOSITION;
+
 /* Core functions, counterpart to PC/SC standard functions */
 /* ------------------------------------------------------- */
 
 LONG SCARD_LIB(Status)(BYTE bSlot, BOOL* pfCardPresent, BOOL* pfCardPowered);
 LONG SCARD_LIB(Connect)(BYTE bSlot, BYTE abAtr[], DWORD *pdwAtrLength);
 LONG SCARD_LIB(Disconnect)(BYTE bSlot);
+LONG SCARD_LIB(Reconnect)(BYTE bSlot, DWORD dwInitialization, BYTE abAtr[], DWORD *pdwAtrLength);
 LONG SCARD_LIB(Transmit)(BYTE bSlot, const BYTE abSendApdu[], DWORD dwSendLength, BYTE abRecvApdu[], DWORD *pwRecvLength);
 LONG SCARD_LIB(Control)(const BYTE abSendBuffer[], DWORD dwSendLength, BYTE abRecvBuffer[], DWORD* pdwRecvLength);
 
+LONG SCARD_LIB(BeginTransaction)(BYTE bSlot);
+LONG SCARD_LIB(EndTransaction)(BYTE bSlot, DWORD dwDisposition);
+
 LONG SCARD_LIB(GetStatusChange)(DWORD dwTimeoutMs);
 LONG SCARD_LIB(GetStatusChangeEx)(DWORD dwTimeoutMs, DWORD* pdwPresentSlots, DWORD* pdwChangedSlots);
+LONG SCARD_LIB(GetStatusChangeSet)(DWORD dwTimeoutMs, CCID_SLOT_SET_ST* pPresentSlots, CCID_SLOT_SET_ST* pChangedSlots);
+#if (CCID_MAX_INSTANCE_COUNT > 1)
+LONG SCARD_LIB(GetStatusChangeMulti)(const BYTE abInstances[], BYTE bInstanceCount, DWORD dwTimeoutMs, BYTE* pbInstance, CCID_SLOT_SET_ST* pPresentSlots, CCID_SLOT_SET_ST* pChangedSlots);
+#endif
 
 /* Functions specific to the PC/SC-Like library */
 /* -------------------------------------------- */
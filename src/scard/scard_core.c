@@ -54,6 +54,52 @@
 
 #include "scard_i.h"
 
+/* ISO/IEC 7816-3: the ATR is 33 bytes at most */
+#define SCARD_MAX_ATR_LENGTH 33
+
+/* What we know about the card in a slot */
+typedef struct
+{
+	BOOL fPowered;
+	BYTE bAtrLength;
+	BYTE abAtr[SCARD_MAX_ATR_LENGTH];
+} SCARD_SLOT_ST;
+
+static SCARD_SLOT_ST scard_slot[CCID_MAX_INSTANCE_COUNT][CCID_MAX_SLOT_COUNT];
+/* Set when the device has refused a warm reset (PowerOn on a powered card) */
+static BOOL scard_no_warm_reset[CCID_MAX_INSTANCE_COUNT];
+
+/**
+ * @internal
+ * @brief The card in this slot is not powered anymore (or has been removed)
+ */
+static void scard_forget_atr(BYTE bSlot)
+{
+	if (bSlot < CCID_MAX_SLOT_COUNT)
+		scard_slot[CCID_LIB(GetInstance)()][bSlot].fPowered = FALSE;
+}
+
+/**
+ * @internal
+ * @brief Remember the ATR of the card that has just been powered
+ */
+static void scard_remember_atr(BYTE bSlot, const BYTE abAtr[], DWORD dwAtrLength)
+{
+	SCARD_SLOT_ST* slot;
+
+	if (bSlot >= CCID_MAX_SLOT_COUNT)
+		return;
+
+	slot = &scard_slot[CCID_LIB(GetInstance)()][bSlot];
+	slot->fPowered = FALSE;
+	if (dwAtrLength > SCARD_MAX_ATR_LENGTH)
+		return; /* Not a valid ATR, don't keep it */
+
+	memcpy(slot->abAtr, abAtr, dwAtrLength);
+	slot->bAtrLength = (BYTE) dwAtrLength;
+	slot->fPowered = TRUE;
+}
+
 /**
  * @brief Retrieve the status of a slot:
  * - is there a card in the slot or not?
@@ -83,9 +129,12 @@ LONG SCARD_LIB(Status)(BYTE bSlot, BOOL* pfCardPresent, BOOL* pfCardPowered)
 	packet.bEndpoint = CCID_COMM_BULK_PC_TO_RDR;
 	packet.Header.p.bRequest = PC_TO_RDR_GETSLOTSTATUS;
 	packet.Header.p.Data.BulkOut.bSlot = bSlot;
-	packet.Header.p.Data.BulkOut.bSequence = CCID_LIB(GetSequence)(bSlot);
 
+	scard_lock_slot(bSlot);
+	packet.Header.p.Data.BulkOut.bSequence = CCID_LIB(GetSequence)(bSlot);
 	rc = CCID_LIB(Exchange)(&packet, BULK_TIMEOUT);
+	scard_unlock_slot(bSlot);
+
 	if (SCARD_LIB(IsFatalError)(rc))
 		return rc; /* Fatal error encountered, no need to go further */
 
@@ -110,12 +159,14 @@ LONG SCARD_LIB(Status)(BYTE bSlot, BOOL* pfCardPresent, BOOL* pfCardPowered)
 					*pfCardPresent = TRUE;
 				if (pfCardPowered != NULL)
 					*pfCardPowered = FALSE;
+				scard_forget_atr(bSlot);
 			break;
 			case 0x02:
 				if (pfCardPresent != NULL)
 					*pfCardPresent = FALSE;
 				if (pfCardPowered != NULL)
 					*pfCardPowered = FALSE;
+				scard_forget_atr(bSlot);
 			break;
 			case 0x03:
 			default:
@@ -139,19 +190,52 @@ LONG SCARD_LIB(Status)(BYTE bSlot, BOOL* pfCardPresent, BOOL* pfCardPowered)
  * @return SCARD_W_UNRESPONSIVE_CARD: there's a card in the slot, but it is mute
  * @return Other code if internal or communication error has occured
  * @note This function is based on CCID PC_TO_RDR_IccPowerOn
+ * @note When SCARD_AUTO_PPS is set, the fastest bit rate allowed by the card and the device is negotiated at once (see CCID_SetParameters)
  * @see SCARD_Status
  * @see SCARD_Disconnect
  **/
 LONG SCARD_LIB(Connect)(BYTE bSlot, BYTE abAtr[], DWORD* pdwAtrLength)
 {
-	CCID_PACKET_ST packet;
+	DWORD dwAtrMaxLength;
 	LONG rc;
 
 	if ((abAtr == NULL) || (pdwAtrLength == NULL))
 		return SCARD_ERR(E_INVALID_PARAMETER);
 
+	dwAtrMaxLength = *pdwAtrLength;
+
+	scard_lock_slot(bSlot);
+
+	rc = scard_power_on(bSlot, abAtr, pdwAtrLength, NULL);
+
+#if (SCARD_AUTO_PPS)
+	if (rc == SCARD_ERR(S_SUCCESS))
+		rc = scard_negotiate_pps(bSlot, abAtr, dwAtrMaxLength, pdwAtrLength);
+#else
+	(void) dwAtrMaxLength;
+#endif
+
+	scard_unlock_slot(bSlot);
+
+	return rc;
+}
+
+/**
+ * @internal
+ * @brief Power the card on, and retrieve its ATR
+ * @note The caller must own the slot
+ * @param pfNotSupported OUT: TRUE if the device has failed the command with bError = CMD_NOT_SUPPORTED (may be NULL)
+ */
+LONG scard_power_on(BYTE bSlot, BYTE abAtr[], DWORD* pdwAtrLength, BOOL* pfNotSupported)
+{
+	CCID_PACKET_ST packet;
+	LONG rc;
+
 	CCID_LIB(PacketInit)(&packet);
 
+	/* The ATR we are about to get is the one of the card that is in the slot now */
+	CCID_LIB(TakeSlotChange)(bSlot);
+
 	packet.bEndpoint = CCID_COMM_BULK_PC_TO_RDR;
 	packet.Header.p.bRequest = PC_TO_RDR_ICCPOWERON;
 	packet.Header.p.Data.BulkOut.bSlot = bSlot;
@@ -162,6 +246,9 @@ LONG SCARD_LIB(Connect)(BYTE bSlot, BYTE abAtr[], DWORD* pdwAtrLength)
 
 	rc = CCID_LIB(Exchange)(&packet, BULK_TIMEOUT);
 
+	if (pfNotSupported != NULL)
+		*pfNotSupported = (rc == SCARD_ERR(E_UNEXPECTED)) && ((packet.Header.p.Data.BulkIn.bSlotStatus & 0xC0) == 0x40) && (packet.Header.p.Data.BulkIn.bSlotError == CCID_ERR_CMD_NOT_SUPPORTED);
+
 	if (rc == SCARD_ERR(S_SUCCESS))
 	{
 		if (packet.Header.p.bRequest != RDR_TO_PC_DATABLOCK)
@@ -171,9 +258,116 @@ LONG SCARD_LIB(Connect)(BYTE bSlot, BYTE abAtr[], DWORD* pdwAtrLength)
 		else
 		{
 			*pdwAtrLength = packet.Header.p.Length.dw;
+			scard_remember_atr(bSlot, abAtr, *pdwAtrLength);
+		}
+	}
+	else
+	{
+		scard_forget_atr(bSlot);
+	}
+
+	return rc;
+}
+
+/**
+ * @brief Reconnect to the card in the given slot, resetting it or not
+ * @note This is not exactly the same prototype as SCardReconnect in the PC/SC standard, but it provides the same feature
+ * @param bSlot slot number (0 for the contactless slot, 1 for the 1st contact slot, etc)
+ * @param dwInitialization what to do with the card:
+ * - SCARD_DISP_LEAVE_CARD: nothing if the card is already powered (its ATR is returned without talking to the device), power it otherwise
+ *   The card is powered again if an interrupt has reported its removal or a change in the slot since (see CCID_TakeSlotChange)
+ * - SCARD_DISP_RESET_CARD: warm reset, the card stays powered; falls back to a cold reset if the device fails the PowerOn with bError = CMD_NOT_SUPPORTED (and then never tries again), or with any other error this time only
+ * - SCARD_DISP_UNPOWER_CARD: cold reset, the card is powered off then on again
+ * @param abAtr buffer to receive the ATR (must be at least 32-byte long)
+ * @param pdwAtrLength IN: the size of the ATR buffer; OUT: the actual length of the ATR
+ * @return SCARD_S_SUCCESS success, ATR is valid
+ * @return Same codes as SCARD_Connect otherwise
+ * @note The warm reset is a single PC_TO_RDR_IccPowerOn on a powered card, where a cold reset costs a PC_TO_RDR_IccPowerOff more, and a longer ATR
+ * @see SCARD_Connect
+ **/
+LONG SCARD_LIB(Reconnect)(BYTE bSlot, DWORD dwInitialization, BYTE abAtr[], DWORD* pdwAtrLength)
+{
+	SCARD_SLOT_ST* slot;
+	DWORD dwAtrMaxLength;
+	BOOL fCold = TRUE;
+	LONG rc;
+
+	if ((abAtr == NULL) || (pdwAtrLength == NULL))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+	if (bSlot >= CCID_MAX_SLOT_COUNT)
+		return SCARD_ERR(E_INVALID_PARAMETER);
+	if (dwInitialization > SCARD_DISPOSITION(UNPOWER_CARD))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	dwAtrMaxLength = *pdwAtrLength;
+	slot = &scard_slot[CCID_LIB(GetInstance)()][bSlot];
+
+	scard_lock_slot(bSlot);
+
+	/* The card we have powered may have been removed or replaced meanwhile: its ATR is not worth anything then */
+	if (slot->fPowered && CCID_LIB(TakeSlotChange)(bSlot))
+		scard_forget_atr(bSlot);
+
+	if ((dwInitialization == SCARD_DISPOSITION(LEAVE_CARD)) && slot->fPowered)
+	{
+		/* Nothing to do, we already know the ATR */
+		if (dwAtrMaxLength < slot->bAtrLength)
+		{
+			rc = SCARD_ERR(E_INSUFFICIENT_BUFFER);
+		}
+		else
+		{
+			memcpy(abAtr, slot->abAtr, slot->bAtrLength);
+			*pdwAtrLength = slot->bAtrLength;
+			rc = SCARD_ERR(S_SUCCESS);
 		}
+		scard_unlock_slot(bSlot);
+		return rc;
 	}
 
+	if ((dwInitialization == SCARD_DISPOSITION(RESET_CARD)) && slot->fPowered && !scard_no_warm_reset[CCID_LIB(GetInstance)()])
+	{
+		BOOL fNotSupported;
+
+		/* Warm reset: power on again, without powering off first */
+		rc = scard_power_on(bSlot, abAtr, pdwAtrLength, &fNotSupported);
+		fCold = FALSE;
+
+		if (fNotSupported)
+		{
+			/* The device does not support PowerOn on a powered card, don't try again */
+			scard_trace(CCID_TRACE_NO_WARM_RESET, bSlot, 0, 0);
+			scard_no_warm_reset[CCID_LIB(GetInstance)()] = TRUE;
+			fCold = TRUE;
+		}
+		else if ((rc == SCARD_ERR(E_UNEXPECTED)) && CCID_LIB(IsValidDriver)())
+		{
+			/* Some other failure of the command (e.g. slot busy): use the cold reset this time only */
+			fCold = TRUE;
+		}
+		else if (rc == SCARD_ERR(W_UNRESPONSIVE_CARD))
+		{
+			/* The card did not like it, try harder */
+			fCold = TRUE;
+		}
+	}
+
+	if (fCold)
+	{
+		*pdwAtrLength = dwAtrMaxLength;
+		if (slot->fPowered || (dwInitialization != SCARD_DISPOSITION(LEAVE_CARD)))
+			SCARD_LIB(Disconnect)(bSlot);
+		rc = scard_power_on(bSlot, abAtr, pdwAtrLength, NULL);
+	}
+
+#if (SCARD_AUTO_PPS)
+	/* After a reset, the card is back to the default bit rate */
+	if (rc == SCARD_ERR(S_SUCCESS))
+		rc = scard_negotiate_pps(bSlot, abAtr, dwAtrMaxLength, pdwAtrLength);
+#endif
+
+	scard_unlock_slot(bSlot);
+
 	return rc;
 }
 
@@ -197,9 +391,12 @@ LONG SCARD_LIB(Disconnect)(BYTE bSlot)
 	packet.bEndpoint = CCID_COMM_BULK_PC_TO_RDR;
 	packet.Header.p.bRequest = PC_TO_RDR_ICCPOWEROFF;
 	packet.Header.p.Data.BulkOut.bSlot = bSlot;
-	packet.Header.p.Data.BulkOut.bSequence = CCID_LIB(GetSequence)(bSlot);
 
+	scard_lock_slot(bSlot);
+	packet.Header.p.Data.BulkOut.bSequence = CCID_LIB(GetSequence)(bSlot);
 	rc = CCID_LIB(Exchange)(&packet, BULK_TIMEOUT);
+	scard_forget_atr(bSlot);
+	scard_unlock_slot(bSlot);
 
 	if ((rc == SCARD_ERR(W_UNSUPPORTED_CARD)) ||
 		(rc == SCARD_ERR(W_UNRESPONSIVE_CARD)) ||
@@ -212,6 +409,46 @@ LONG SCARD_LIB(Disconnect)(BYTE bSlot)
 	return rc;
 }
 
+/**
+ * @internal
+ * @brief Exchange one PC_TO_RDR_XfrBlock / RDR_TO_PC_DataBlock with the device
+ * @note The caller must own the slot. bLevelParameter and pbChainParameter are only meaningful when the C-APDU or the R-APDU is chained (extended APDU level)
+ */
+static LONG scard_xfr_block(BYTE bSlot, const BYTE abSendBlock[], DWORD dwSendLength, BYTE bLevelParameter, BYTE abRecvBlock[], DWORD* pdwRecvLength, BYTE* pbChainParameter)
+{
+	CCID_PACKET_ST packet;
+	DWORD dwRecvMaxLength = *pdwRecvLength;
+	LONG rc;
+
+	CCID_LIB(PacketInit)(&packet);
+
+	packet.bEndpoint = CCID_COMM_BULK_PC_TO_RDR;
+	packet.Header.p.bRequest = PC_TO_RDR_XFRBLOCK;
+	packet.Header.p.Data.BulkOut.bSlot = bSlot;
+	packet.Header.p.Data.BulkOut.bParam2 = bLevelParameter; /* wLevelParameter, LSB */
+
+	packet.abSendPayload = abSendBlock;
+	packet.Header.p.Length.dw = dwSendLength;
+
+	/* A block of the response is never longer than a message */
+	if (dwRecvMaxLength > CCID_LIB(MaxPayloadLength)())
+		dwRecvMaxLength = CCID_LIB(MaxPayloadLength)();
+
+	packet.abRecvPayload = abRecvBlock;
+	packet.dwRecvPayloadMaxLen = dwRecvMaxLength;
+
+	packet.Header.p.Data.BulkOut.bSequence = CCID_LIB(GetSequence)(bSlot);
+	rc = CCID_LIB(Exchange)(&packet, CCID_LIB(BulkTimeout)(dwSendLength + dwRecvMaxLength));
+
+	if (rc == SCARD_ERR(S_SUCCESS))
+	{
+		*pdwRecvLength = packet.Header.p.Length.dw;
+		*pbChainParameter = packet.Header.p.Data.BulkIn.bStatusOrRfu;
+	}
+
+	return rc;
+}
+
 /**
  * @brief Send a command (C-APDU) to the card, and receive its response (R-APDU)
  * @note This is not exactly the same prototype as SCardTransmit in the PC/SC standard, but it provides the same feature
@@ -223,43 +460,77 @@ LONG SCARD_LIB(Disconnect)(BYTE bSlot)
  * @return SCARD_S_SUCCESS success
  * @return SCARD_W_REMOVED_CARD the card has been removed during the exchange
  * @return Other code if internal or communication error has occured.
- * @note This function is based on CCID PC_TO_RDR_XfrBlock
+ * @note This function is based on CCID PC_TO_RDR_XfrBlock. When the C-APDU does not fit in a single message (see CCID_MaxPayloadLength), it is chained, provided that the device works at the extended APDU level
  * @see SCARD_Connect
  * @see SCARD_Control
  **/
 LONG SCARD_LIB(Transmit)(BYTE bSlot, const BYTE abSendApdu[], DWORD dwSendLength, BYTE abRecvApdu[], DWORD *pdwRecvLength)
 {
-	CCID_PACKET_ST packet;
+	DWORD dwMaxPayloadLength = CCID_LIB(MaxPayloadLength)();
+	BOOL fChaining = ((CCID_LIB(GetFeatures)() & CCID_FEATURE_LEVEL_MASK) == CCID_FEATURE_LEVEL_EXT_APDU);
+	DWORD dwRecvMaxLength = 0;
+	DWORD dwSendOffset = 0;
+	DWORD dwRecvOffset = 0;
+	DWORD dwRecvLength;
+	BYTE bChainParameter = CCID_CHAIN_NONE;
 	LONG rc;
 
 	if (abSendApdu == NULL)
 		return SCARD_ERR(E_INVALID_PARAMETER);
 	if ((abRecvApdu != NULL) && (pdwRecvLength == NULL))
 		return SCARD_ERR(E_INVALID_PARAMETER);
-	if (dwSendLength > CCID_MAX_PAYLOAD_LENGTH)
-		return SCARD_ERR(E_NO_MEMORY);	
+	if ((dwSendLength > dwMaxPayloadLength) && !fChaining)
+		return SCARD_ERR(E_NO_MEMORY);
 
-	CCID_LIB(PacketInit)(&packet);
+	if ((abRecvApdu != NULL) && (pdwRecvLength != NULL))
+		dwRecvMaxLength = *pdwRecvLength;
 
-	packet.bEndpoint = CCID_COMM_BULK_PC_TO_RDR;
-	packet.Header.p.bRequest = PC_TO_RDR_XFRBLOCK;
-	packet.Header.p.Data.BulkOut.bSlot = bSlot;
-	packet.Header.p.Data.BulkOut.bSequence = CCID_LIB(GetSequence)(bSlot);
+	/* Wait for the end of the transaction of another caller (if some) */
+	scard_lock_slot(bSlot);
 
-	packet.abSendPayload = abSendApdu;
-	packet.Header.p.Length.dw = dwSendLength;
+	/* Send the C-APDU, in as many blocks as required by the size of the messages */
+	do
+	{
+		DWORD dwBlockLength = dwSendLength - dwSendOffset;
+		BYTE bLevelParameter = CCID_CHAIN_NONE;
 
-	if (pdwRecvLength != NULL)
+		if (dwSendLength > dwMaxPayloadLength)
+		{
+			if (dwBlockLength > dwMaxPayloadLength)
+				dwBlockLength = dwMaxPayloadLength;
+
+			if (dwSendOffset == 0)
+				bLevelParameter = CCID_CHAIN_BEGIN;
+			else if (dwSendOffset + dwBlockLength < dwSendLength)
+				bLevelParameter = CCID_CHAIN_CONTINUE;
+			else
+				bLevelParameter = CCID_CHAIN_END;
+		}
+
+		dwRecvLength = dwRecvMaxLength;
+		rc = scard_xfr_block(bSlot, &abSendApdu[dwSendOffset], dwBlockLength, bLevelParameter, abRecvApdu, &dwRecvLength, &bChainParameter);
+		dwSendOffset += dwBlockLength;
+	}
+	while ((rc == SCARD_ERR(S_SUCCESS)) && (dwSendOffset < dwSendLength));
+
+	if (rc == SCARD_ERR(S_SUCCESS))
+		dwRecvOffset = dwRecvLength;
+
+	/* Receive the rest of the R-APDU, if the device has chained it */
+	while (fChaining && (rc == SCARD_ERR(S_SUCCESS)) &&
+		((bChainParameter == CCID_CHAIN_BEGIN) || (bChainParameter == CCID_CHAIN_CONTINUE)))
 	{
-		packet.abRecvPayload = abRecvApdu;
-		packet.dwRecvPayloadMaxLen = *pdwRecvLength;
+		dwRecvLength = dwRecvMaxLength - dwRecvOffset;
+		rc = scard_xfr_block(bSlot, NULL, 0, CCID_CHAIN_EMPTY, (abRecvApdu != NULL) ? &abRecvApdu[dwRecvOffset] : NULL, &dwRecvLength, &bChainParameter);
+		if (rc == SCARD_ERR(S_SUCCESS))
+			dwRecvOffset += dwRecvLength;
 	}
 
-	rc = CCID_LIB(Exchange)(&packet, BULK_TIMEOUT);
+	scard_unlock_slot(bSlot);
 
 	if (rc == SCARD_ERR(S_SUCCESS))
 		if (pdwRecvLength != NULL)
-			*pdwRecvLength = packet.Header.p.Length.dw;
+			*pdwRecvLength = dwRecvOffset;
 
 	if ((rc == SCARD_ERR(W_UNSUPPORTED_CARD)) ||
 		(rc == SCARD_ERR(W_UNRESPONSIVE_CARD)) ||
@@ -269,6 +540,9 @@ LONG SCARD_LIB(Transmit)(BYTE bSlot, const BYTE abSendApdu[], DWORD dwSendLength
 		rc = SCARD_ERR(W_REMOVED_CARD);
 	}
 
+	if (rc == SCARD_ERR(W_REMOVED_CARD))
+		scard_forget_atr(bSlot);
+
 	return rc;
 }
 
@@ -294,7 +568,7 @@ LONG SCARD_LIB(Control)(const BYTE abSendBuffer[], DWORD dwSendLength, BYTE abRe
 		return SCARD_ERR(E_INVALID_PARAMETER);
 	if ((abRecvBuffer != NULL) && (pdwRecvLength == NULL))
 		return SCARD_ERR(E_INVALID_PARAMETER);
-	if (dwSendLength > CCID_MAX_PAYLOAD_LENGTH)
+	if (dwSendLength > CCID_LIB(MaxPayloadLength)())
 		return SCARD_ERR(E_NO_MEMORY);
 
 	CCID_LIB(PacketInit)(&packet);
@@ -343,81 +617,132 @@ LONG SCARD_LIB(Control)(const BYTE abSendBuffer[], DWORD dwSendLength, BYTE abRe
 }
 
 /**
- * @brief Wait for a notification (interrupt) from the device
+ * @brief Wait for a notification (interrupt) from the device, and report the status of every slot
  * @note This function shall not be used if the interrupts have not been enabled when calling CCID_Start
  * @note This is not exactly the same prototype as SCardGetStatusChange in the PC/SC standard, but it provides the same feature
  * @param dwTimeoutMs the timeout, in milliseconds
- * @param pdwPresentSlots OUT: the slots were a card is present (1 bit per slot, bit set if card present, unset if card absent)
- * @param pdwChangedSlots OUT: the slots were the status has changed (1 bit per slot, bit set if card has been inserted or removed, unset otherwise)
+ * @param pPresentSlots OUT: the slots were a card is present (may be NULL)
+ * @param pChangedSlots OUT: the slots were the status has changed, i.e. a card has been inserted or removed (may be NULL)
  * @return SCARD_S_SUCCESS success
  * @return SCARD_E_TIMEOUT no change and the timeout has occured
  * @return Other code if internal or communication error has occured
+ * @note The notifications received during the other exchanges are not lost: if a change has already been reported by the device, this function returns at once
  * @note This function is based on CCID INTERRUPT endpoint
  * @see SCARD_Status
- * @see SCARD_GetStatusChange
+ * @see SCARD_GetStatusChangeEx
  **/
-LONG SCARD_LIB(GetStatusChangeEx)(DWORD dwTimeoutMs, DWORD* pdwPresentSlots, DWORD* pdwChangedSlots)
+LONG SCARD_LIB(GetStatusChangeSet)(DWORD dwTimeoutMs, CCID_SLOT_SET_ST* pPresentSlots, CCID_SLOT_SET_ST* pChangedSlots)
 {
 	CCID_PACKET_ST packet;
 	BYTE abInterruptBuffer[CCID_MAX_INTERRUPT_PAYLOAD_LENGTH];
-	LONG rc;
-	DWORD dwPresentSlots = 0;
-	DWORD dwChangedSlots = 0;
+	LONG rc = SCARD_ERR(S_SUCCESS);
 
-	CCID_LIB(PacketInit)(&packet);
+	if (!CCID_LIB(GetSlotChanges)(pPresentSlots, pChangedSlots))
+	{
+		/* Nothing pending, wait for the device */
+		CCID_LIB(PacketInit)(&packet);
 
-	packet.abRecvPayload = abInterruptBuffer;
-	packet.dwRecvPayloadMaxLen = sizeof(abInterruptBuffer);
+		packet.abRecvPayload = abInterruptBuffer;
+		packet.dwRecvPayloadMaxLen = sizeof(abInterruptBuffer);
 
-	rc = CCID_LIB(WaitInterrupt)(&packet, dwTimeoutMs);
+		rc = CCID_LIB(WaitInterrupt)(&packet, dwTimeoutMs);
 
-	if (rc == SCARD_ERR(S_SUCCESS))
+		/* The packet tells the changes, WaitInterrupt has consumed them */
+		if (rc == SCARD_ERR(S_SUCCESS))
+			CCID_LIB(DecodeInterrupt)(packet.abRecvPayload, packet.Header.p.Length.dw, NULL, pPresentSlots, pChangedSlots);
+	}
+
+	return rc;
+}
+
+#if (CCID_MAX_INSTANCE_COUNT > 1)
+/**
+ * @brief Wait for a notification (interrupt) from any of several devices, and report the status of every slot of the device that has changed
+ * @note This function shall not be used if the interrupts have not been enabled when calling CCID_Start on every device
+ * @note This is not exactly the same prototype as SCardGetStatusChange in the PC/SC standard, but it provides the same feature (waiting for several readers at once)
+ * @param abInstances the instances of the driver (i.e. the devices) to wait for
+ * @param bInstanceCount number of instances in abInstances
+ * @param dwTimeoutMs the timeout, in milliseconds
+ * @param pbInstance OUT: the instance that has changed, or that has failed (may be NULL). This instance is left selected, for the calling thread only (see CCID_SelectInstance).
+ * @param pPresentSlots OUT: the slots were a card is present in this device (may be NULL)
+ * @param pChangedSlots OUT: the slots were the status has changed in this device (may be NULL)
+ * @return SCARD_S_SUCCESS success
+ * @return SCARD_E_TIMEOUT no change and the timeout has occured
+ * @return SCARD_E_READER_UNAVAILABLE the device reported in pbInstance is not available anymore
+ * @return Other code if internal or communication error has occured with the device reported in pbInstance
+ * @note A single thread waits for all the devices at once, over CCID_WaitWakeupMulti
+ * @see SCARD_GetStatusChangeSet
+ **/
+LONG SCARD_LIB(GetStatusChangeMulti)(const BYTE abInstances[], BYTE bInstanceCount, DWORD dwTimeoutMs, BYTE* pbInstance, CCID_SLOT_SET_ST* pPresentSlots, CCID_SLOT_SET_ST* pChangedSlots)
+{
+	BYTE bInstance;
+	LONG rc;
+
+	if ((abInstances == NULL) || (bInstanceCount == 0) || (bInstanceCount > CCID_MAX_INSTANCE_COUNT))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	for (;;)
 	{
-		if (packet.Header.p.Length.dw > 1)
-		{
-			if (abInterruptBuffer[0] & 0x01)
-				dwPresentSlots |= 0x00000001;
-			if (abInterruptBuffer[0] & 0x02)
-				dwChangedSlots |= 0x00000001;
-			if (abInterruptBuffer[0] & 0x04)
-				dwPresentSlots |= 0x00000002;
-			if (abInterruptBuffer[0] & 0x08)
-				dwChangedSlots |= 0x00000002;
-			if (abInterruptBuffer[0] & 0x10)
-				dwPresentSlots |= 0x00000004;
-			if (abInterruptBuffer[0] & 0x20)
-				dwChangedSlots |= 0x00000004;
-			if (abInterruptBuffer[0] & 0x40)
-				dwPresentSlots |= 0x00000008;
-			if (abInterruptBuffer[0] & 0x80)
-				dwChangedSlots |= 0x00000008;
-		}
-		if (packet.Header.p.Length.dw > 2)
+		/* A change may have been received during another exchange, or a device may have been lost */
+		for (BYTE i = 0; i < bInstanceCount; i++)
 		{
-			if (abInterruptBuffer[1] & 0x01)
-				dwPresentSlots |= 0x00000010;
-			if (abInterruptBuffer[1] & 0x02)
-				dwChangedSlots |= 0x00000010;
-			if (abInterruptBuffer[1] & 0x04)
-				dwPresentSlots |= 0x00000020;
-			if (abInterruptBuffer[1] & 0x08)
-				dwChangedSlots |= 0x00000020;
-			if (abInterruptBuffer[1] & 0x10)
-				dwPresentSlots |= 0x00000040;
-			if (abInterruptBuffer[1] & 0x20)
-				dwChangedSlots |= 0x00000040;
-			if (abInterruptBuffer[1] & 0x40)
-				dwPresentSlots |= 0x00000080;
-			if (abInterruptBuffer[1] & 0x80)
-				dwChangedSlots |= 0x00000080;
+			if (!CCID_LIB(SelectInstance)(abInstances[i]))
+				return SCARD_ERR(E_INVALID_PARAMETER);
+			if (pbInstance != NULL)
+				*pbInstance = abInstances[i];
+			if (!SCARD_LIB(IsValidContext)())
+				return SCARD_ERR(E_READER_UNAVAILABLE);
+			if (CCID_LIB(GetSlotChanges)(pPresentSlots, pChangedSlots))
+				return SCARD_ERR(S_SUCCESS);
 		}
 
-		D(printf("Interrupt, slots present: %08lX, slots changed: %08lX\n", dwPresentSlots, dwChangedSlots));
+		/* Wait for the first device that has something to say */
+		if (!CCID_LIB(WaitWakeupMulti)(abInstances, bInstanceCount, dwTimeoutMs, &bInstance))
+			return SCARD_ERR(E_TIMEOUT);
+
+		CCID_LIB(SelectInstance)(bInstance);
+		if (pbInstance != NULL)
+			*pbInstance = bInstance;
+
+		/* The message is already there, no need to wait */
+		rc = SCARD_LIB(GetStatusChangeSet)(0, pPresentSlots, pChangedSlots);
+		if (rc != SCARD_ERR(E_TIMEOUT))
+			return rc;
+	}
+}
+#endif
+
+/**
+ * @brief Wait for a notification (interrupt) from the device
+ * @note This function shall not be used if the interrupts have not been enabled when calling CCID_Start
+ * @note This is not exactly the same prototype as SCardGetStatusChange in the PC/SC standard, but it provides the same feature
+ * @param dwTimeoutMs the timeout, in milliseconds
+ * @param pdwPresentSlots OUT: the slots were a card is present (1 bit per slot, bit set if card present, unset if card absent)
+ * @param pdwChangedSlots OUT: the slots were the status has changed (1 bit per slot, bit set if card has been inserted or removed, unset otherwise)
+ * @return SCARD_S_SUCCESS success
+ * @return SCARD_E_TIMEOUT no change and the timeout has occured
+ * @return Other code if internal or communication error has occured
+ * @note Only the first 32 slots are reported, use SCARD_GetStatusChangeSet for devices having more slots
+ * @note This function is based on CCID INTERRUPT endpoint
+ * @see SCARD_Status
+ * @see SCARD_GetStatusChange
+ * @see SCARD_GetStatusChangeSet
+ **/
+LONG SCARD_LIB(GetStatusChangeEx)(DWORD dwTimeoutMs, DWORD* pdwPresentSlots, DWORD* pdwChangedSlots)
+{
+	CCID_SLOT_SET_ST presentSlots, changedSlots;
+	LONG rc;
+
+	rc = SCARD_LIB(GetStatusChangeSet)(dwTimeoutMs, &presentSlots, &changedSlots);
+
+	if (rc == SCARD_ERR(S_SUCCESS))
+	{
+		scard_trace(CCID_TRACE_STATUS_CHANGE, presentSlots.adwSlots[0], changedSlots.adwSlots[0], 0);
 
 		if (pdwPresentSlots != NULL)
-			*pdwPresentSlots = dwPresentSlots;
+			*pdwPresentSlots = presentSlots.adwSlots[0];
 		if (pdwChangedSlots != NULL)
-			*pdwChangedSlots = dwChangedSlots;		
+			*pdwChangedSlots = changedSlots.adwSlots[0];
 	}
 	
 	return rc;
@@ -54,7 +54,7 @@
 
 #include "scard_i.h"
 
-static BOOL scard_valid;
+static BOOL scard_valid[CCID_MAX_INSTANCE_COUNT];
 
 /**
  * @internal
@@ -63,7 +63,7 @@ static BOOL scard_valid;
 void scard_raise_error(const char* msg)
 {
 	printf("\nError in PC/SC-Like stack: %s\n", msg);
-	scard_valid = FALSE;
+	scard_valid[CCID_LIB(GetInstance)()] = FALSE;
 }
 
 /**
@@ -71,7 +71,7 @@ void scard_raise_error(const char* msg)
  */
 void SCARD_LIB(Init)(void)
 {
-	scard_valid = TRUE;
+	scard_valid[CCID_LIB(GetInstance)()] = TRUE;
 }
 
 /**
@@ -84,26 +84,28 @@ void SCARD_LIB(Init)(void)
  */
 BOOL SCARD_LIB(IsValidContext)(void)
 {
-	if (scard_valid)
+	BYTE bInstance = CCID_LIB(GetInstance)();
+
+	if (scard_valid[bInstance])
 	{
 		/* Hook to be able to change the status (not used on all targets) */
 		if (SCARD_LIB(IsCancelledHook)())
 		{
 			printf("PC/SC-Like context not valid, operation has been cancelled by the user\n");
-			scard_valid = FALSE;
+			scard_valid[bInstance] = FALSE;
 		}
 		if (!CCID_LIB(IsValidDriver)())
 		{
 			printf("PC/SC-Like context not valid, the CCID driver has reported an error\n");
-			scard_valid = FALSE;
+			scard_valid[bInstance] = FALSE;
 		}		
 		if (!CCID_LIB(SerialIsOpen)())
 		{
 			printf("PC/SC-Like context not valid, CCID serial port is not open\n");
-			scard_valid = FALSE;
+			scard_valid[bInstance] = FALSE;
 		}
 	}
-	return scard_valid;
+	return scard_valid[bInstance];
 }
 
 /**
@@ -65,4 +65,17 @@
 
 void scard_raise_error(const char* msg);
 
+void scard_lock_slot(BYTE bSlot);
+void scard_unlock_slot(BYTE bSlot);
+
+LONG scard_power_on(BYTE bSlot, BYTE abAtr[], DWORD* pdwAtrLength, BOOL* pfNotSupported);
+LONG scard_negotiate_pps(BYTE bSlot, BYTE abAtr[], DWORD dwAtrMaxLength, DWORD* pdwAtrLength);
+
+/* The events go to the trace ring of the CCID driver, or are debug messages (see CCID_TRACE) */
+#if (CCID_TRACE)
+#define scard_trace(wEvent, a0, a1, a2) CCID_LIB(Trace)((wEvent), (DWORD) (a0), (DWORD) (a1), (DWORD) (a2))
+#else
+#define scard_trace(wEvent, a0, a1, a2) D(CCID_LIB(TracePrintEvent)((wEvent), (DWORD) (a0), (DWORD) (a1), (DWORD) (a2)))
+#endif
+
 #endif
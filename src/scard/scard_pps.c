@@ -0,0 +1,182 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file scard_pps.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Negotiation of the bit rate of the card (PPS) after SCARD_Connect
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup scard
+ */
+
+#include "scard_i.h"
+
+#if (SCARD_AUTO_PPS)
+
+/* Value of D for every Di (ISO/IEC 7816-3, table 8), 0 for RFU */
+static const BYTE scard_di_values[16] = { 0, 1, 2, 4, 8, 16, 32, 64, 12, 20, 0, 0, 0, 0, 0, 0 };
+
+/* Values of Di, from the fastest to the slowest bit rate (default Di=1 excluded) */
+static const BYTE scard_di_by_speed[] = { 7, 6, 9, 5, 8, 4, 3, 2 };
+
+/**
+ * @internal
+ * @brief Find TA1 (Fi/Di) in the ATR
+ * @return FALSE if the ATR has no TA1, or if the card is in specific mode (TA2 present) and does not accept a PPS
+ */
+static BOOL scard_atr_get_ta1(const BYTE abAtr[], DWORD dwAtrLength, BYTE* pbTA1)
+{
+	DWORD dwOffset = 2;
+	BOOL fHasTA1 = FALSE;
+	BYTE bY;
+
+	if (dwAtrLength < 2)
+		return FALSE;
+
+	/* Y1 is in T0 */
+	bY = abAtr[1] >> 4;
+
+	for (BYTE i = 1; ; i++)
+	{
+		if (bY & 0x01)
+		{
+			if (dwOffset >= dwAtrLength)
+				return FALSE; /* Truncated ATR */
+			if (i == 1)
+			{
+				*pbTA1 = abAtr[dwOffset];
+				fHasTA1 = TRUE;
+			}
+			if (i == 2)
+				return FALSE; /* Specific mode */
+			dwOffset++;
+		}
+		if (bY & 0x02)
+			dwOffset++; /* TBi */
+		if (bY & 0x04)
+			dwOffset++; /* TCi */
+		if (!(bY & 0x08))
+			break; /* No TDi */
+		if (dwOffset >= dwAtrLength)
+			return FALSE; /* Truncated ATR */
+		bY = abAtr[dwOffset++] >> 4;
+	}
+
+	return fHasTA1;
+}
+
+/**
+ * @internal
+ * @brief Negotiate the fastest Fi/Di allowed by the card (TA1) and accepted by the device, just after the card has been powered
+ * @note The caller must own the slot. If the negotiation fails, the default parameters are restored, and the card is powered again if it has become mute.
+ * @return SCARD_S_SUCCESS if the card is ready (at whatever speed)
+ */
+LONG scard_negotiate_pps(BYTE bSlot, BYTE abAtr[], DWORD dwAtrMaxLength, DWORD* pdwAtrLength)
+{
+	BYTE abParameters[CCID_PARAMETERS_T1_LENGTH];
+	DWORD dwParametersLength = sizeof(abParameters);
+	BYTE bProtocol, bTA1, bFi, bDi;
+	LONG rc;
+
+	if (CCID_LIB(GetFeatures)() & CCID_FEATURE_AUTO_NEGOTIATION)
+		return SCARD_ERR(S_SUCCESS); /* The device negotiates by itself */
+
+	if (!scard_atr_get_ta1(abAtr, *pdwAtrLength, &bTA1))
+		return SCARD_ERR(S_SUCCESS); /* Nothing to negotiate */
+
+	bFi = bTA1 & 0xF0;
+	bDi = bTA1 & 0x0F;
+	if (scard_di_values[bDi] <= 1)
+		return SCARD_ERR(S_SUCCESS); /* The card is not faster than the default */
+
+	/* Start from the parameters the device has deduced from the ATR */
+	rc = CCID_LIB(GetParameters)(bSlot, &bProtocol, abParameters, &dwParametersLength);
+	if (rc != SCARD_ERR(S_SUCCESS))
+	{
+		D(printf("PPS: GetParameters failed (rc=%lX), keeping the default bit rate\n", rc));
+		return CCID_LIB(IsValidDriver)() ? SCARD_ERR(S_SUCCESS) : rc;
+	}
+
+	if (abParameters[0] == bTA1)
+		return SCARD_ERR(S_SUCCESS); /* The device has already negotiated by itself */
+
+	for (BYTE i = 0; i < sizeof(scard_di_by_speed); i++)
+	{
+		BYTE bTryDi = scard_di_by_speed[i];
+
+		if (scard_di_values[bTryDi] > scard_di_values[bDi])
+			continue; /* Faster than the card */
+
+		abParameters[0] = bFi | bTryDi;
+		rc = CCID_LIB(SetParameters)(bSlot, bProtocol, abParameters, dwParametersLength);
+		if (rc == SCARD_ERR(S_SUCCESS))
+		{
+			D(printf("PPS: Fi/Di=%02X (card allows %02X)\n", abParameters[0], bTA1));
+			return rc;
+		}
+
+		if (!CCID_LIB(IsValidDriver)())
+			return rc; /* Communication error with the device */
+		if ((rc == SCARD_ERR(W_UNRESPONSIVE_CARD)) || (rc == SCARD_ERR(W_REMOVED_CARD)))
+			break; /* The card has not survived; a slower Di is not going to help */
+
+		/* The device has rejected this Fi/Di, try a slower one */
+		D(printf("PPS: Fi/Di=%02X rejected (rc=%lX)\n", abParameters[0], rc));
+	}
+
+	/* Back to the default parameters */
+	CCID_LIB(ResetParameters)(bSlot);
+
+	if (rc == SCARD_ERR(W_UNRESPONSIVE_CARD))
+	{
+		/* The card is mute after the failed PPS, power it again */
+		SCARD_LIB(Disconnect)(bSlot);
+		*pdwAtrLength = dwAtrMaxLength;
+		return scard_power_on(bSlot, abAtr, pdwAtrLength, NULL);
+	}
+
+	return (rc == SCARD_ERR(W_REMOVED_CARD)) ? rc : SCARD_ERR(S_SUCCESS);
+}
+
+#endif
@@ -0,0 +1,153 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file scard_transaction.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Transactions: exclusive access to a slot, across several calls
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup scard
+ */
+
+#include "scard_i.h"
+
+/* The owner of every slot; SCARD_BeginTransaction takes it for long, the other functions take it for one call */
+static CCID_TICKET_LOCK_ST scard_slot_lock[CCID_MAX_INSTANCE_COUNT][CCID_MAX_SLOT_COUNT];
+
+/**
+ * @internal
+ * @brief Take the slot, waiting for the end of the transaction of another caller (if some)
+ */
+void scard_lock_slot(BYTE bSlot)
+{
+	if (bSlot < CCID_MAX_SLOT_COUNT)
+		CCID_LIB(TicketLock)(&scard_slot_lock[CCID_LIB(GetInstance)()][bSlot]);
+}
+
+/**
+ * @internal
+ * @brief Release the slot taken by scard_lock_slot
+ */
+void scard_unlock_slot(BYTE bSlot)
+{
+	if (bSlot < CCID_MAX_SLOT_COUNT)
+		CCID_LIB(TicketUnlock)(&scard_slot_lock[CCID_LIB(GetInstance)()][bSlot]);
+}
+
+/**
+ * @brief Start a transaction on the slot: until SCARD_EndTransaction, the other callers can't access the card
+ * @note This is not exactly the same prototype as SCardBeginTransaction in the PC/SC standard, but it provides the same feature
+ * @param bSlot slot number (0 for the contactless slot, 1 for the 1st contact slot, etc)
+ * @return SCARD_S_SUCCESS success, the caller is the only one to talk to the card
+ * @return SCARD_E_INVALID_PARAMETER the slot number is invalid
+ * @note The caller waits until the transactions started before have ended (first come, first served)
+ * @note Transactions may be nested, every call to SCARD_BeginTransaction must be followed by a call to SCARD_EndTransaction
+ * @see SCARD_EndTransaction
+ **/
+LONG SCARD_LIB(BeginTransaction)(BYTE bSlot)
+{
+	if (bSlot >= CCID_MAX_SLOT_COUNT)
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	scard_lock_slot(bSlot);
+
+	return SCARD_ERR(S_SUCCESS);
+}
+
+/**
+ * @brief End the transaction on the slot, and let the next caller (if some) access the card
+ * @note This is not exactly the same prototype as SCardEndTransaction in the PC/SC standard, but it provides the same feature
+ * @param bSlot slot number (0 for the contactless slot, 1 for the 1st contact slot, etc)
+ * @param dwDisposition what to do with the card: SCARD_DISP_LEAVE_CARD, SCARD_DISP_RESET_CARD or SCARD_DISP_UNPOWER_CARD
+ * @return SCARD_S_SUCCESS success
+ * @return SCARD_E_NOT_TRANSACTED the caller has no transaction on this slot
+ * @return Other code if the disposition has failed. The transaction is ended anyway.
+ * @note The disposition only applies when the outermost transaction ends
+ * @see SCARD_BeginTransaction
+ **/
+LONG SCARD_LIB(EndTransaction)(BYTE bSlot, DWORD dwDisposition)
+{
+	CCID_TICKET_LOCK_ST* lock;
+	BYTE abAtr[64];
+	DWORD dwAtrLength = sizeof(abAtr);
+	LONG rc = SCARD_ERR(S_SUCCESS);
+
+	if (bSlot >= CCID_MAX_SLOT_COUNT)
+		return SCARD_ERR(E_INVALID_PARAMETER);
+	if (dwDisposition > SCARD_DISPOSITION(UNPOWER_CARD))
+		return SCARD_ERR(E_INVALID_PARAMETER);
+
+	lock = &scard_slot_lock[CCID_LIB(GetInstance)()][bSlot];
+
+	switch (CCID_LIB(TicketDepth)(lock))
+	{
+		case 0:
+			return SCARD_ERR(E_NOT_TRANSACTED);
+
+		case 1:
+			/* We are still the owner while we apply the disposition */
+			switch (dwDisposition)
+			{
+				case SCARD_DISPOSITION(LEAVE_CARD):
+				break;
+				case SCARD_DISPOSITION(RESET_CARD):
+					/* Warm reset if the device supports it */
+					rc = SCARD_LIB(Reconnect)(bSlot, SCARD_DISPOSITION(RESET_CARD), abAtr, &dwAtrLength);
+				break;
+				case SCARD_DISPOSITION(UNPOWER_CARD):
+				default:
+					rc = SCARD_LIB(Disconnect)(bSlot);
+				break;
+			}
+		break;
+
+		default:
+			/* Nested transaction, the outermost one will apply the disposition */
+		break;
+	}
+
+	CCID_LIB(TicketUnlock)(lock);
+
+	return rc;
+}
@@ -0,0 +1,598 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid-serial-simulator.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Coupler simulator: the virtual coupler behind a pseudo-terminal, so the unmodified Linux HAL and programs can be tested end-to-end
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+/* posix_openpt and friends */
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <project.h>
+
+#include "../pcsc-serial.h"
+#include "../hal/emulator/ccid_emulator.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <termios.h>
+#include <poll.h>
+#include <errno.h>
+#include <time.h>
+
+/* Max number of lines in a script */
+#define SIM_MAX_EVENTS 256
+/* Max number of frames waiting to be written to the host */
+#define SIM_MAX_OUTPUTS 8
+
+/*
+ * The script is a text file, one event per line: "<time in ms since start> <command> [<argument>]"
+ * - insert <slot>, remove <slot>: card insertion or removal (notified if the host wants so)
+ * - processing <us>: time the coupler takes for every command, from now on
+ * - noise <ppm>: probability (parts per million) that a byte sent to the host is corrupted, from now on
+ * - garbage <count>: send that many random bytes to the host
+ * - silence <ms>: ignore everything that the host sends during that time (e.g. the coupler reboots)
+ * - unplug <ms>: remove the pseudo-terminal, and create a new one (same link) after that time
+ * - exit: the simulator terminates
+ * Empty lines and lines starting with '#' are ignored.
+ */
+typedef struct
+{
+	DWORD dwAtMs;
+	char szCommand[16];
+	DWORD dwArg;
+} SIM_EVENT_ST;
+
+typedef struct
+{
+	uint64_t qwAtUs;
+	DWORD dwLength;
+	BYTE abFrame[CCID_EMULATOR_MAX_FRAME_LENGTH];
+} SIM_OUTPUT_ST;
+
+static SIM_EVENT_ST sim_events[SIM_MAX_EVENTS];
+static DWORD sim_event_count;
+static DWORD sim_event_next;
+
+/* Frames waiting for their time on the wire, in order */
+static SIM_OUTPUT_ST sim_outputs[SIM_MAX_OUTPUTS];
+static DWORD sim_output_head;
+static DWORD sim_output_count;
+
+/* A long command (ECHO with a delay): its time extensions, then its response */
+static BOOL sim_pending;
+static uint64_t sim_pending_ext_us;
+static uint64_t sim_pending_done_us;
+static SIM_OUTPUT_ST sim_pending_response;
+static BYTE sim_pending_ext[3 + CCID_HEADER_LENGTH];
+static DWORD sim_pending_ext_length;
+
+static CCID_EMULATOR_CONFIG_ST sim_config;
+static CCID_EMULATOR_DEVICE_ST sim_device;
+
+static int sim_master = -1;
+static int sim_slave = -1;
+static const char* sim_link = NULL;
+static uint64_t sim_start_us;
+static uint64_t sim_line_free_us;
+static uint64_t sim_silence_until_us;
+static uint64_t sim_replug_at_us;
+static DWORD sim_noise_ppm;
+static DWORD sim_random = 12345;
+
+BOOL fVerbose = FALSE;
+
+static BOOL parse_args(int argc, char** argv);
+
+static const char* szConfig = "";
+static const char* szScript = NULL;
+
+static uint64_t sim_now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static DWORD sim_elapsed_ms(void)
+{
+	return (DWORD) ((sim_now_us() - sim_start_us) / 1000);
+}
+
+static BYTE sim_get_random(void)
+{
+	sim_random = sim_random * 1664525 + 1013904223; // Parameters from Numerical Recipes
+	return (BYTE) (sim_random >> 24);
+}
+
+static uint64_t sim_wire_time_us(DWORD dwLength)
+{
+	if (sim_config.dwBaudRate == 0)
+		return 0;
+	return (uint64_t) dwLength * 10 * 1000000 / sim_config.dwBaudRate;
+}
+
+static void sim_dump(const char* szWhat, const BYTE abData[], DWORD dwLength)
+{
+	if (!fVerbose)
+		return;
+	fprintf(stderr, "[%8lu] %s ", (unsigned long) sim_elapsed_ms(), szWhat);
+	for (DWORD i = 0; i < dwLength; i++)
+		fprintf(stderr, "%02X", abData[i]);
+	fprintf(stderr, "\n");
+}
+
+/**
+ * @brief Load the script of events
+ */
+static BOOL load_script(const char* szFileName)
+{
+	char szLine[256];
+	DWORD dwLine = 0;
+	FILE* f = fopen(szFileName, "r");
+
+	if (f == NULL)
+	{
+		perror(szFileName);
+		return FALSE;
+	}
+
+	while (fgets(szLine, sizeof(szLine), f) != NULL)
+	{
+		SIM_EVENT_ST* event = &sim_events[sim_event_count];
+		unsigned long ulAtMs, ulArg = 0;
+		int n;
+
+		dwLine++;
+		if ((szLine[0] == '#') || (szLine[0] == '\n') || (szLine[0] == '\r') || (szLine[0] == '\0'))
+			continue;
+
+		if (sim_event_count >= SIM_MAX_EVENTS)
+		{
+			fprintf(stderr, "%s: too many events (max %d)\n", szFileName, SIM_MAX_EVENTS);
+			break;
+		}
+
+		n = sscanf(szLine, "%lu %15s %lu", &ulAtMs, event->szCommand, &ulArg);
+		if (n < 2)
+		{
+			fprintf(stderr, "%s:%lu: syntax error\n", szFileName, (unsigned long) dwLine);
+			fclose(f);
+			return FALSE;
+		}
+		event->dwAtMs = (DWORD) ulAtMs;
+		event->dwArg = (DWORD) ulArg;
+
+		if ((sim_event_count > 0) && (event->dwAtMs < sim_events[sim_event_count - 1].dwAtMs))
+		{
+			fprintf(stderr, "%s:%lu: the events must be in chronological order\n", szFileName, (unsigned long) dwLine);
+			fclose(f);
+			return FALSE;
+		}
+
+		sim_event_count++;
+	}
+
+	fclose(f);
+	return TRUE;
+}
+
+/**
+ * @brief Create the pseudo-terminal, and the link to its slave side if asked
+ */
+static BOOL plug(void)
+{
+	struct termios tio;
+	const char* szSlaveName;
+
+	sim_master = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((sim_master < 0) || (grantpt(sim_master) < 0) || (unlockpt(sim_master) < 0))
+	{
+		perror("posix_openpt");
+		return FALSE;
+	}
+	szSlaveName = ptsname(sim_master);
+
+	/* We keep the slave side open too, so the master does not hang up when the host closes the port */
+	sim_slave = open(szSlaveName, O_RDWR | O_NOCTTY);
+	if (sim_slave < 0)
+	{
+		perror(szSlaveName);
+		return FALSE;
+	}
+
+	/* The host will do the same, but nothing shall be echoed before it does */
+	tcgetattr(sim_slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(sim_slave, TCSANOW, &tio);
+
+	if (sim_link != NULL)
+	{
+		char szTemp[PATH_MAX];
+
+		/* Atomic replacement, a host waiting for the port sees it appear at once */
+		snprintf(szTemp, sizeof(szTemp), "%s.tmp", sim_link);
+		unlink(szTemp);
+		if ((symlink(szSlaveName, szTemp) < 0) || (rename(szTemp, sim_link) < 0))
+		{
+			perror(sim_link);
+			return FALSE;
+		}
+	}
+
+	printf("PTY %s\n", (sim_link != NULL) ? sim_link : szSlaveName);
+	fflush(stdout);
+
+	ccid_emulator_reset(&sim_device, &sim_config, 0);
+	sim_output_count = 0;
+	sim_pending = FALSE;
+	sim_line_free_us = 0;
+
+	return TRUE;
+}
+
+/**
+ * @brief Remove the pseudo-terminal, as if the USB-serial adapter was unplugged
+ */
+static void unplug(void)
+{
+	if (sim_link != NULL)
+		unlink(sim_link);
+	if (sim_slave >= 0)
+		close(sim_slave);
+	if (sim_master >= 0)
+		close(sim_master);
+	sim_slave = -1;
+	sim_master = -1;
+}
+
+/**
+ * @brief Queue a frame for the host, not before the given time
+ */
+static void schedule(const BYTE abFrame[], DWORD dwLength, uint64_t qwReadyUs)
+{
+	SIM_OUTPUT_ST* output;
+
+	if (sim_output_count >= SIM_MAX_OUTPUTS)
+	{
+		fprintf(stderr, "Too many frames for the host, one is dropped\n");
+		return;
+	}
+
+	output = &sim_outputs[(sim_output_head + sim_output_count) % SIM_MAX_OUTPUTS];
+	sim_output_count++;
+
+	if (qwReadyUs < sim_line_free_us)
+		qwReadyUs = sim_line_free_us;
+	sim_line_free_us = qwReadyUs + sim_wire_time_us(dwLength);
+
+	output->qwAtUs = sim_line_free_us;
+	output->dwLength = dwLength;
+	memcpy(output->abFrame, abFrame, dwLength);
+}
+
+/**
+ * @brief Write a frame to the host, with some noise if the script says so
+ */
+static void write_frame(BYTE abFrame[], DWORD dwLength)
+{
+	if (sim_noise_ppm)
+	{
+		for (DWORD i = 0; i < dwLength; i++)
+		{
+			DWORD dwDraw = ((DWORD) sim_get_random() << 16) | ((DWORD) sim_get_random() << 8) | sim_get_random();
+			if ((dwDraw % 1000000) < sim_noise_ppm)
+				abFrame[i] ^= 1 << (sim_get_random() % 8);
+		}
+	}
+
+	sim_dump(">", abFrame, dwLength);
+	if (write(sim_master, abFrame, dwLength) != (ssize_t) dwLength)
+		perror("write");
+}
+
+/**
+ * @brief The coupler has received a complete message: build the response, and schedule it (after time extensions if the command is long)
+ */
+static void execute(void)
+{
+	BYTE abFrame[CCID_EMULATOR_MAX_FRAME_LENGTH];
+	uint64_t qwReadyUs = sim_now_us() + sim_config.dwProcessingUs;
+	DWORD dwLength;
+
+	sim_dump("<", sim_device.abRecvMessage, sim_device.dwRecvOffset);
+
+	dwLength = ccid_emulator_process(&sim_device, abFrame);
+	if (dwLength == 0)
+		return;
+
+	if (sim_device.dwDelayMs == 0)
+	{
+		schedule(abFrame, dwLength, qwReadyUs);
+		return;
+	}
+
+	sim_pending = TRUE;
+	sim_pending_ext_length = ccid_emulator_time_extension(&sim_device, sim_pending_ext);
+	sim_pending_ext_us = qwReadyUs + CCID_EMULATOR_TIME_EXTENSION_MS * 1000;
+	sim_pending_done_us = qwReadyUs + (uint64_t) sim_device.dwDelayMs * 1000;
+	sim_pending_response.dwLength = dwLength;
+	memcpy(sim_pending_response.abFrame, abFrame, dwLength);
+}
+
+/**
+ * @brief Run the events of the script whose time has come
+ */
+static BOOL run_events(void)
+{
+	while ((sim_event_next < sim_event_count) && (sim_events[sim_event_next].dwAtMs <= sim_elapsed_ms()))
+	{
+		const SIM_EVENT_ST* event = &sim_events[sim_event_next++];
+		uint64_t qwNowUs = sim_now_us();
+
+		if (fVerbose)
+			fprintf(stderr, "[%8lu] %s %lu\n", (unsigned long) sim_elapsed_ms(), event->szCommand, (unsigned long) event->dwArg);
+
+		if (!strcmp(event->szCommand, "insert") || !strcmp(event->szCommand, "remove"))
+		{
+			ccid_emulator_set_card_present(&sim_device, (BYTE) event->dwArg, !strcmp(event->szCommand, "insert"));
+		}
+		else if (!strcmp(event->szCommand, "processing"))
+		{
+			sim_config.dwProcessingUs = event->dwArg;
+		}
+		else if (!strcmp(event->szCommand, "noise"))
+		{
+			sim_noise_ppm = event->dwArg;
+		}
+		else if (!strcmp(event->szCommand, "garbage"))
+		{
+			BYTE abGarbage[CCID_EMULATOR_MAX_FRAME_LENGTH];
+			DWORD dwLength = (event->dwArg < sizeof(abGarbage)) ? event->dwArg : sizeof(abGarbage);
+
+			for (DWORD i = 0; i < dwLength; i++)
+				abGarbage[i] = sim_get_random();
+			schedule(abGarbage, dwLength, qwNowUs);
+		}
+		else if (!strcmp(event->szCommand, "silence"))
+		{
+			sim_silence_until_us = qwNowUs + (uint64_t) event->dwArg * 1000;
+			sim_pending = FALSE;
+			sim_output_count = 0;
+			ccid_emulator_reset_receiver(&sim_device);
+		}
+		else if (!strcmp(event->szCommand, "unplug"))
+		{
+			unplug();
+			sim_replug_at_us = qwNowUs + (uint64_t) event->dwArg * 1000;
+		}
+		else if (!strcmp(event->szCommand, "exit"))
+		{
+			return FALSE;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown command in script: %s\n", event->szCommand);
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * @brief Send what is due: time extensions and response of a long command, queued frames, notifications
+ * @return the time of the next thing to send, 0 if none
+ */
+static uint64_t run_outputs(void)
+{
+	BYTE abFrame[CCID_EMULATOR_MAX_FRAME_LENGTH];
+	uint64_t qwNowUs = sim_now_us();
+	uint64_t qwNextUs = 0;
+	DWORD dwLength;
+
+	if (sim_pending)
+	{
+		if (qwNowUs >= sim_pending_done_us)
+		{
+			schedule(sim_pending_response.abFrame, sim_pending_response.dwLength, sim_pending_done_us);
+			sim_pending = FALSE;
+		}
+		else
+		{
+			if ((qwNowUs >= sim_pending_ext_us) && (sim_pending_ext_us < sim_pending_done_us))
+			{
+				schedule(sim_pending_ext, sim_pending_ext_length, sim_pending_ext_us);
+				sim_pending_ext_us += CCID_EMULATOR_TIME_EXTENSION_MS * 1000;
+			}
+			qwNextUs = (sim_pending_ext_us < sim_pending_done_us) ? sim_pending_ext_us : sim_pending_done_us;
+		}
+	}
+
+	dwLength = ccid_emulator_notify(&sim_device, abFrame);
+	if (dwLength)
+		schedule(abFrame, dwLength, qwNowUs);
+
+	while (sim_output_count)
+	{
+		SIM_OUTPUT_ST* output = &sim_outputs[sim_output_head];
+
+		if (output->qwAtUs > qwNowUs)
+		{
+			if ((qwNextUs == 0) || (output->qwAtUs < qwNextUs))
+				qwNextUs = output->qwAtUs;
+			break;
+		}
+
+		write_frame(output->abFrame, output->dwLength);
+		sim_output_head = (sim_output_head + 1) % SIM_MAX_OUTPUTS;
+		sim_output_count--;
+	}
+
+	return qwNextUs;
+}
+
+int main(int argc, char** argv)
+{
+	if (!parse_args(argc, argv))
+	{
+		printf("Usage:\n");
+		printf("\tccid-serial-simulator [-c <CONFIG>] [-l <LINK>] [-s <SCRIPT>] [-r <SEED>] [-v]\n");
+		printf("\t\t-c <CONFIG>: configuration of the virtual coupler, e.g. \"38400,slots=2,nodelay\" (0 for no wire delay)\n");
+		printf("\t\t-l <LINK>: create a symbolic link to the pseudo-terminal, e.g. /tmp/ttyCCID\n");
+		printf("\t\t-s <SCRIPT>: run the events of the script (card insertion/removal, delays, noise...)\n");
+		printf("\t\t-r <SEED>: seed of the noise and garbage\n");
+		printf("\t\t-v: verbose output (on stderr)\n");
+		printf("\tThe name of the pseudo-terminal (or of the link) is written on stdout, give it to the program under test with -d\n");
+		return -1;
+	}
+
+	{
+		char szFullConfig[256];
+
+		snprintf(szFullConfig, sizeof(szFullConfig), "sim:%s", szConfig);
+		ccid_emulator_default_config(&sim_config);
+		if (!ccid_emulator_parse_config(&sim_config, szFullConfig))
+		{
+			fprintf(stderr, "Invalid configuration: %s\n", szConfig);
+			return -1;
+		}
+	}
+
+	if ((szScript != NULL) && !load_script(szScript))
+		return -1;
+
+	sim_start_us = sim_now_us();
+
+	if (!plug())
+		return -1;
+
+	for (;;)
+	{
+		struct pollfd fds[1];
+		uint64_t qwNextUs;
+		uint64_t qwNowUs;
+		int timeout_ms = -1;
+		int rc;
+
+		if (!run_events())
+			break;
+
+		if ((sim_master < 0) && (sim_replug_at_us <= sim_now_us()))
+			if (!plug())
+				return -1;
+
+		qwNextUs = (sim_master >= 0) ? run_outputs() : sim_replug_at_us;
+
+		/* Sleep until the next output, the next event, or some input */
+		qwNowUs = sim_now_us();
+		if (sim_event_next < sim_event_count)
+		{
+			uint64_t qwEventUs = sim_start_us + (uint64_t) sim_events[sim_event_next].dwAtMs * 1000;
+			if ((qwNextUs == 0) || (qwEventUs < qwNextUs))
+				qwNextUs = qwEventUs;
+		}
+		if (qwNextUs != 0)
+			timeout_ms = (qwNextUs > qwNowUs) ? (int) ((qwNextUs - qwNowUs + 999) / 1000) : 0;
+
+		fds[0].fd = sim_master;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+
+		rc = poll(fds, 1, timeout_ms);
+		if ((rc < 0) && (errno != EINTR))
+		{
+			perror("poll");
+			break;
+		}
+
+		if ((rc > 0) && (fds[0].revents & POLLIN))
+		{
+			BYTE abBuffer[256];
+			ssize_t len = read(sim_master, abBuffer, sizeof(abBuffer));
+
+			if (len < 0)
+			{
+				perror("read");
+				break;
+			}
+
+			/* During a silence, what the host sends is lost */
+			if (sim_now_us() < sim_silence_until_us)
+				continue;
+
+			for (ssize_t i = 0; i < len; i++)
+				if (ccid_emulator_recv_byte(&sim_device, abBuffer[i]))
+					execute();
+		}
+	}
+
+	unplug();
+	return 0;
+}
+
+static BOOL parse_args(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-c") && (i + 1 < argc))
+			szConfig = argv[++i];
+		else if (!strcmp(argv[i], "-l") && (i + 1 < argc))
+			sim_link = argv[++i];
+		else if (!strcmp(argv[i], "-s") && (i + 1 < argc))
+			szScript = argv[++i];
+		else if (!strcmp(argv[i], "-r") && (i + 1 < argc))
+			sim_random = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-v"))
+			fVerbose = TRUE;
+		else
+			return FALSE;
+	}
+	return TRUE;
+}
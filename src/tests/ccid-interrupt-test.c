@@ -0,0 +1,200 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid-interrupt-test.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Test of CCID_WaitInterrupt (emulator HAL): a slot change is reported once, a second call without CCID_GetSlotChanges waits for the next one
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include <project.h>
+
+#include "../pcsc-serial.h"
+#include "../scard/scard.h"
+#include "../ccid/ccid.h"
+#include "../ccid/ccid_hal.h"
+#include "../hal/emulator/ccid_emulator.h"
+
+/* How long the second call must wait, when nothing has changed */
+#define TEST_TIMEOUT_MS 200
+
+BOOL fVerbose = FALSE;
+
+/**
+ * @brief The test never cancels anything
+ */
+BOOL SCARD_LIB(IsCancelledHook)(void)
+{
+	return FALSE;
+}
+
+/**
+ * @brief Wait for a notification, and tell whether the slot is reported as changed, with the expected presence
+ */
+static BOOL expect_change(const char* szCase, BYTE bSlot, BOOL fPresent)
+{
+	CCID_PACKET_ST packet;
+	BYTE abInterruptBuffer[CCID_MAX_INTERRUPT_PAYLOAD_LENGTH];
+	CCID_SLOT_SET_ST present, changed;
+	LONG rc;
+
+	CCID_LIB(PacketInit)(&packet);
+	packet.abRecvPayload = abInterruptBuffer;
+	packet.dwRecvPayloadMaxLen = sizeof(abInterruptBuffer);
+
+	rc = CCID_LIB(WaitInterrupt)(&packet, 1000);
+	if (rc != SCARD_ERR(S_SUCCESS))
+	{
+		printf("FAIL %s: no notification (rc=%lX)\n", szCase, rc);
+		return FALSE;
+	}
+
+	CCID_LIB(DecodeInterrupt)(packet.abRecvPayload, packet.Header.p.Length.dw, NULL, &present, &changed);
+	if (!CCID_LIB(SlotSetContains)(&changed, bSlot) || (CCID_LIB(SlotSetContains)(&present, bSlot) != fPresent))
+	{
+		printf("FAIL %s: slot %d is not reported as %s\n", szCase, bSlot, fPresent ? "inserted" : "removed");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * @brief Call CCID_WaitInterrupt again, without CCID_GetSlotChanges: nothing has changed, it must wait for the whole timeout
+ */
+static BOOL expect_nothing(const char* szCase)
+{
+	CCID_PACKET_ST packet;
+	BYTE abInterruptBuffer[CCID_MAX_INTERRUPT_PAYLOAD_LENGTH];
+	DWORD dwStartMs, dwElapsedMs;
+	LONG rc;
+
+	CCID_LIB(PacketInit)(&packet);
+	packet.abRecvPayload = abInterruptBuffer;
+	packet.dwRecvPayloadMaxLen = sizeof(abInterruptBuffer);
+
+	dwStartMs = CCID_LIB(GetTimeMs)();
+	rc = CCID_LIB(WaitInterrupt)(&packet, TEST_TIMEOUT_MS);
+	dwElapsedMs = CCID_LIB(GetTimeMs)() - dwStartMs;
+
+	if (rc != SCARD_ERR(E_TIMEOUT))
+	{
+		printf("FAIL %s: the second call has returned rc=%lX after %ums, the change has been reported twice\n", szCase, rc, dwElapsedMs);
+		return FALSE;
+	}
+	if (dwElapsedMs < TEST_TIMEOUT_MS)
+	{
+		printf("FAIL %s: the second call has returned after %ums only\n", szCase, dwElapsedMs);
+		return FALSE;
+	}
+	if (CCID_LIB(GetSlotChanges)(NULL, NULL))
+	{
+		printf("FAIL %s: CCID_GetSlotChanges reports the change again\n", szCase);
+		return FALSE;
+	}
+
+	printf("OK   %s\n", szCase);
+	return TRUE;
+}
+
+int main(int argc, char** argv)
+{
+	BYTE abAtr[33];
+	DWORD dwAtrLength = sizeof(abAtr);
+	BYTE abSendBuffer[] = { 0xFF, 0xFD, 0x00, 0x00, 0x10 };
+	BYTE abRecvBuffer[64];
+	DWORD dwRecvLength = sizeof(abRecvBuffer);
+	BOOL fResult = TRUE;
+	LONG rc;
+
+	(void) argc;
+	(void) argv;
+
+	CCID_LIB(SerialInit)("emu:115200,slots=2");
+	if (!CCID_LIB(SerialOpen)())
+	{
+		printf("Failed to open the virtual coupler\n");
+		return 1;
+	}
+
+	CCID_LIB(Init)();
+	rc = CCID_LIB(Start)(TRUE);
+	if (rc == SCARD_ERR(S_SUCCESS))
+	{
+		SCARD_LIB(Init)();
+		rc = SCARD_LIB(Connect)(1, abAtr, &dwAtrLength);
+	}
+	if (rc != SCARD_ERR(S_SUCCESS))
+	{
+		printf("No card in slot 1 (rc=%lX)\n", rc);
+		CCID_LIB(SerialClose)();
+		return 1;
+	}
+
+	/* The notification is received by CCID_WaitInterrupt itself */
+	CCID_LIB(EmulatorSetCardPresent)(0, FALSE);
+	if (!expect_change("change received while waiting", 0, FALSE) || !expect_nothing("change received while waiting"))
+		fResult = FALSE;
+
+	/* The notification is received during an exchange, CCID_WaitInterrupt rebuilds it from the slot changes */
+	CCID_LIB(EmulatorSetCardPresent)(0, TRUE);
+	rc = SCARD_LIB(Transmit)(1, abSendBuffer, sizeof(abSendBuffer), abRecvBuffer, &dwRecvLength);
+	if (rc != SCARD_ERR(S_SUCCESS))
+	{
+		printf("FAIL the exchange has failed (rc=%lX)\n", rc);
+		fResult = FALSE;
+	}
+	else if (!expect_change("change received during an exchange", 0, TRUE) || !expect_nothing("change received during an exchange"))
+	{
+		fResult = FALSE;
+	}
+
+	SCARD_LIB(Disconnect)(1);
+	CCID_LIB(Stop)();
+	CCID_LIB(SerialClose)();
+
+	return fResult ? 0 : 1;
+}
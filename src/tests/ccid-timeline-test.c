@@ -0,0 +1,248 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid-timeline-test.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Test of the timeline of the exchanges (emulator HAL): the stages never go backwards, even when the response comes before CCID_SerialSendBytes returns, or among notifications and time extensions
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include <project.h>
+
+#include "../pcsc-serial.h"
+#include "../scard/scard.h"
+#include "../ccid/ccid.h"
+#include "../ccid/ccid_hal.h"
+#include "../hal/emulator/ccid_emulator.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+/* Exchanges for every configuration, while the card of the second slot comes and goes */
+#define TEST_ITERATIONS 2000
+/* Then exchanges where one out of two asks for a time extension (when the ECHO instruction waits) */
+#define TEST_TIME_EXTENSIONS 40
+
+BOOL fVerbose = FALSE;
+
+/**
+ * @brief The test never cancels anything
+ */
+BOOL SCARD_LIB(IsCancelledHook)(void)
+{
+	return FALSE;
+}
+
+#if (CCID_TIMELINE)
+
+/* The configurations: synchronous answers (the response is there before CCID_SerialSendBytes returns), then a genuine wire */
+static const char* aszConfigs[] =
+{
+	"emu:0,sync,slots=2",
+	"emu:115200,nodelay,slots=2"
+};
+
+static volatile BOOL fToggling;
+static DWORD dwTimeExtensions;
+
+/**
+ * @brief Insert and remove the card of the second slot all along, so that notifications come among the responses
+ */
+static void* toggle_card(void* arg)
+{
+	BOOL fPresent = FALSE;
+
+	(void) arg;
+
+	while (fToggling)
+	{
+		CCID_LIB(EmulatorSetCardPresent)(1, fPresent);
+		fPresent = !fPresent;
+		usleep(500);
+	}
+
+	CCID_LIB(EmulatorSetCardPresent)(1, TRUE);
+	return NULL;
+}
+
+/**
+ * @brief Check one timeline: no stage may go backwards (it would wrap around to a huge value), and the stages make the whole exchange
+ */
+static BOOL check_timeline(const CCID_EXCHANGE_TIMELINE_ST* pTimeline, DWORD dwIteration)
+{
+	const DWORD adwStages[] =
+	{
+		pTimeline->dwQueueUs, pTimeline->dwEncodeUs, pTimeline->dwTxUs, pTimeline->dwDeviceUs,
+		pTimeline->dwRxUs, pTimeline->dwWakeupUs, pTimeline->dwReturnUs
+	};
+	DWORD dwSumUs = 0;
+
+	for (BYTE i = 0; i < sizeof(adwStages) / sizeof(adwStages[0]); i++)
+	{
+		if (adwStages[i] > pTimeline->dwTotalUs)
+		{
+			printf("Exchange %u: stage %u is %uus, longer than the exchange (%uus)\n", dwIteration, i, adwStages[i], pTimeline->dwTotalUs);
+			return FALSE;
+		}
+		dwSumUs += adwStages[i];
+	}
+
+	if (dwSumUs != pTimeline->dwTotalUs)
+	{
+		printf("Exchange %u: the stages make %uus, the exchange %uus\n", dwIteration, dwSumUs, pTimeline->dwTotalUs);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * @brief One ECHO through SCardTransmit, and the check of its timeline
+ */
+static BOOL test_exchange(const char* szConfig, DWORD dwIteration, BYTE bP2)
+{
+	BYTE abSendBuffer[] = { 0xFF, 0xFD, 0x00, bP2, 0x04, 0x01, 0x02, 0x03, 0x04, 0x10 };
+	BYTE abRecvBuffer[64];
+	DWORD dwRecvLength = sizeof(abRecvBuffer);
+	CCID_EXCHANGE_TIMELINE_ST timeline;
+	LONG rc;
+
+	rc = SCARD_LIB(Transmit)(0, abSendBuffer, sizeof(abSendBuffer), abRecvBuffer, &dwRecvLength);
+	if (rc != SCARD_ERR(S_SUCCESS))
+	{
+		printf("%s: exchange %u failed (rc=%lX)\n", szConfig, dwIteration, rc);
+		return FALSE;
+	}
+
+	CCID_LIB(GetLastTimeline)(&timeline);
+	dwTimeExtensions += timeline.dwTimeExtensions;
+	if (!check_timeline(&timeline, dwIteration))
+	{
+		printf("%s: queue=%u encode=%u tx=%u device=%u rx=%u wakeup=%u return=%u total=%u\n", szConfig,
+			timeline.dwQueueUs, timeline.dwEncodeUs, timeline.dwTxUs, timeline.dwDeviceUs,
+			timeline.dwRxUs, timeline.dwWakeupUs, timeline.dwReturnUs, timeline.dwTotalUs);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * @brief Run the exchanges on a configuration
+ */
+static BOOL test_config(const char* szConfig)
+{
+	BYTE abAtr[33];
+	DWORD dwAtrLength = sizeof(abAtr);
+	pthread_t thread;
+	BOOL fResult = TRUE;
+	LONG rc;
+
+	dwTimeExtensions = 0;
+	CCID_LIB(SerialInit)(szConfig);
+	if (!CCID_LIB(SerialOpen)())
+	{
+		printf("%s: failed to open the port\n", szConfig);
+		return FALSE;
+	}
+
+	CCID_LIB(Init)();
+	rc = CCID_LIB(Start)(TRUE);
+	if (rc == SCARD_ERR(S_SUCCESS))
+	{
+		SCARD_LIB(Init)();
+		rc = SCARD_LIB(Connect)(0, abAtr, &dwAtrLength);
+	}
+	if (rc != SCARD_ERR(S_SUCCESS))
+	{
+		printf("%s: no card in slot 0 (rc=%lX)\n", szConfig, rc);
+		CCID_LIB(SerialClose)();
+		return FALSE;
+	}
+
+	/* First the notifications among the responses, then the time extensions: the receiver only holds two messages, a notification could not come between a time extension and its response in synchronous mode */
+	fToggling = TRUE;
+	pthread_create(&thread, NULL, toggle_card, NULL);
+
+	for (DWORD i = 0; (i < TEST_ITERATIONS) && fResult; i++)
+		fResult = test_exchange(szConfig, i, 0x00);
+
+	fToggling = FALSE;
+	pthread_join(thread, NULL);
+	/* Let the last notification go through */
+	usleep(10000);
+
+	/* P2 = 81: the ECHO instruction lasts 1s, and the coupler sends a time extension first */
+	for (DWORD i = 0; (i < TEST_TIME_EXTENSIONS) && fResult; i++)
+		fResult = test_exchange(szConfig, TEST_ITERATIONS + i, (i & 1) ? 0x81 : 0x00);
+
+	SCARD_LIB(Disconnect)(0);
+	CCID_LIB(Stop)();
+	CCID_LIB(SerialClose)();
+
+	printf("%s: %s (%u time extensions)\n", szConfig, fResult ? "OK" : "FAIL", dwTimeExtensions);
+	return fResult;
+}
+
+#endif
+
+int main(int argc, char** argv)
+{
+	BOOL fResult = TRUE;
+
+	(void) argc;
+	(void) argv;
+
+#if (CCID_TIMELINE)
+	for (DWORD i = 0; i < sizeof(aszConfigs) / sizeof(aszConfigs[0]); i++)
+		if (!test_config(aszConfigs[i]))
+			fResult = FALSE;
+#else
+	printf("CCID_TIMELINE is not enabled, nothing to test\n");
+#endif
+
+	return fResult ? 0 : 1;
+}
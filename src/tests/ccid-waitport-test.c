@@ -0,0 +1,196 @@
+/*
+
+ This code is Copyright (c) 2015-2023 SPRINGCARD SAS, FRANCE - www.springcard.com
+
+ Redistribution and use in source (source code) and binary (object code)
+  forms, with or without modification, are permitted provided that the
+  following conditions are met :
+  1. Redistributed source code or object code must be used only in conjunction
+	 with a genuine SpringCard product,
+  2. Redistributed source code must retain the above copyright notice, this
+	 list of conditions and the disclaimer below,
+  3. Redistributed object code must reproduce the above copyright notice,
+	 this list of conditions and the disclaimer below in the documentation
+	 and/or other materials provided with the distribution,
+  4. The name of SpringCard may not be used to endorse or promote products
+	 derived from this software or in any other form without specific prior
+	 written permission from SpringCard,
+  5. Redistribution of any modified code must be labeled
+	"Code derived from original SpringCard copyrighted source code".
+
+  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+  ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED
+  TO THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+  PARTICULAR PURPOSE.
+  SPRINGCARD SHALL NOT BE LIABLE FOR INFRINGEMENTS OF THIRD PARTIES RIGHTS
+  BASED ON THIS SOFTWARE. ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+  PARTICULAR PURPOSE ARE DISCLAIMED. SPRINGCARD DOES NOT WARRANT THAT THE
+  FUNCTIONS CONTAINED IN THIS SOFTWARE WILL MEET THE USER'S REQUIREMENTS OR
+  THAT THE OPERATION OF IT WILL BE UNINTERRUPTED OR ERROR-FREE. IN NO EVENT,
+  UNLESS REQUIRED BY APPLICABLE LAW, SHALL SPRINGCARD BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+  OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+  NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. ALSO, SPRINGCARD IS UNDER
+  NO OBLIGATION TO MAINTAIN, CORRECT, UPDATE, CHANGE, MODIFY, OR OTHERWISE
+  SUPPORT THIS SOFTWARE.
+*/
+
+/**
+ * @file ccid-waitport-test.c
+ * @author SpringCard
+ * @date 2026-10-18
+ * @brief Test of CCID_SerialWaitPort (Linux HAL): the port is a symlink to a pty that appears after a delay, the wait must end as soon as it does
+ * 
+ * @copyright Copyright (c) SpringCard SAS, France, 2015-2023
+ *
+ * @addtogroup sample
+ */
+
+#include <project.h>
+
+#include "../pcsc-serial.h"
+#include "../scard/scard.h"
+#include "../ccid/ccid.h"
+#include "../ccid/ccid_hal.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <pty.h>
+
+/* When the port appears */
+#define TEST_DELAY_MS 300
+/* How late CCID_SerialWaitPort may return after that (a polling loop would be later, by its period) */
+#define TEST_MAX_LATENCY_MS 40
+
+BOOL fVerbose = FALSE;
+
+typedef struct
+{
+	char szDir[PATH_MAX];  /* Directory to create first, if not empty */
+	char szLink[PATH_MAX]; /* The port: a symlink to the slave side of a pty */
+	char szPty[PATH_MAX];
+	DWORD dwCreatedMs;
+} TEST_PORT_ST;
+
+BOOL SCARD_LIB(IsCancelledHook)(void)
+{
+	return FALSE;
+}
+
+static void* create_port(void* arg)
+{
+	TEST_PORT_ST* port = (TEST_PORT_ST*) arg;
+
+	usleep(1000 * TEST_DELAY_MS);
+	if ((port->szDir[0] != '\0') && (mkdir(port->szDir, 0700) != 0))
+		perror("mkdir");
+	if (symlink(port->szPty, port->szLink) != 0)
+		perror("symlink");
+	port->dwCreatedMs = CCID_LIB(GetTimeMs)();
+
+	return NULL;
+}
+
+/* Wait for the port, while a thread creates it; return FALSE if the wait has not ended within TEST_MAX_LATENCY_MS */
+static BOOL test_appears(const char* szName, TEST_PORT_ST* port)
+{
+	pthread_t thread;
+	DWORD dwReturnedMs, dwLatency;
+	BOOL fResult;
+
+	CCID_LIB(SerialInit)(port->szLink);
+	pthread_create(&thread, NULL, create_port, port);
+	fResult = CCID_LIB(SerialWaitPort)(5000);
+	dwReturnedMs = CCID_LIB(GetTimeMs)();
+	pthread_join(thread, NULL);
+	/* The thread takes its time after the symlink, the wait may even have ended first */
+	dwLatency = (dwReturnedMs > port->dwCreatedMs) ? (dwReturnedMs - port->dwCreatedMs) : 0;
+
+	if (!fResult)
+	{
+		printf("FAIL %s: the port has appeared, but the wait has timed out\n", szName);
+		return FALSE;
+	}
+	if (dwLatency > TEST_MAX_LATENCY_MS)
+	{
+		printf("FAIL %s: the wait has ended %lums after the port has appeared\n", szName, dwLatency);
+		return FALSE;
+	}
+
+	printf("OK   %s (%lums)\n", szName, dwLatency);
+	return TRUE;
+}
+
+/* Wait for a port that never comes */
+static BOOL test_timeout(const char* szName, const char* szLink)
+{
+	DWORD dwStart = CCID_LIB(GetTimeMs)();
+	DWORD dwElapsed;
+	BOOL fResult;
+
+	CCID_LIB(SerialInit)(szLink);
+	fResult = CCID_LIB(SerialWaitPort)(200);
+	dwElapsed = CCID_LIB(GetTimeMs)() - dwStart;
+
+	if (fResult || (dwElapsed < 200))
+	{
+		printf("FAIL %s: the wait has returned %s after %lums\n", szName, fResult ? "TRUE" : "FALSE", dwElapsed);
+		return FALSE;
+	}
+
+	printf("OK   %s (%lums)\n", szName, dwElapsed);
+	return TRUE;
+}
+
+int main(int argc, char** argv)
+{
+	char szRoot[] = "/tmp/ccid-waitport-XXXXXX";
+	TEST_PORT_ST ports[2];
+	int iMaster, iSlave;
+	BOOL fSuccess = TRUE;
+
+	(void) argc;
+	(void) argv;
+
+	if (mkdtemp(szRoot) == NULL)
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+	if (openpty(&iMaster, &iSlave, NULL, NULL, NULL) != 0)
+	{
+		perror("openpty");
+		return 1;
+	}
+
+	memset(ports, 0, sizeof(ports));
+
+	/* The port appears in a directory that exists */
+	snprintf(ports[0].szLink, sizeof(ports[0].szLink), "%s/ttyCCID", szRoot);
+	/* The directory of the port does not exist yet (e.g. /dev/serial/by-id before the first adapter is plugged) */
+	snprintf(ports[1].szDir, sizeof(ports[1].szDir), "%s/by-id", szRoot);
+	snprintf(ports[1].szLink, sizeof(ports[1].szLink), "%s/by-id/ttyCCID", szRoot);
+
+	for (DWORD i = 0; i < 2; i++)
+		if (ttyname_r(iSlave, ports[i].szPty, sizeof(ports[i].szPty)) != 0)
+			return 1;
+
+	fSuccess &= test_timeout("port absent", ports[0].szLink);
+	fSuccess &= test_appears("port created", &ports[0]);
+	fSuccess &= test_appears("directory and port created", &ports[1]);
+
+	unlink(ports[0].szLink);
+	unlink(ports[1].szLink);
+	rmdir(ports[1].szDir);
+	rmdir(szRoot);
+	close(iSlave);
+	close(iMaster);
+
+	return fSuccess ? 0 : 1;
+}